@@ -0,0 +1,318 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  base_bench.cpp
+    @author Ralph Blach
+    @brief The base station decoder on a capture of a large fleet, with 0 to 8 threads.
+
+    The capture has BASE_BENCH_NODES trackers sending a fix a second for BASE_BENCH_SECONDS.
+    Each tracker sends one of the formats of the firmware, chosen by its address:
+    - position packets, every tenth with the altitude and dop
+    - batches of BASE_BENCH_BATCH
+    - the legacy ascii packet
+    - position packets, some of which are lost and sent later in history packets
+    Some frames are sent again with the same header id, as after a lost ack.  Each history
+    packet also carries a fix that did arrive live.  There are telemetry packets, link
+    requests, console text and a few broken RX lines as well.  The capture is made in memory
+    by the firmware's own encoders and base_frame_format.  It is fed to a base_station in
+    pieces the size of a serial read.
+
+    Each run has to end up with every fix made, once, at the position it was made at, with
+    the same counters whatever the number of threads.
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <packet_builder.h>
+#include <position_packet.h>
+#include <latency_stats.h>
+#include <link_adapter.h>
+#include "../tools/base_station.h"
+#include "bench.h"
+
+/**
+    @brief the capture
+*/
+#define BASE_BENCH_NODES 250     /*!< trackers */
+#define BASE_BENCH_SECONDS 240   /*!< seconds of fixes */
+#define BASE_BENCH_BATCH 4       /*!< fixes in a batch */
+#define BASE_BENCH_RESENT 20     /*!< one frame in this many is sent twice */
+#define BASE_BENCH_LOST 5        /*!< one fix in this many of the history trackers is lost */
+#define BASE_BENCH_READ 4096     /*!< bytes fed at a time */
+
+/**
+    @brief one tracker while the capture is made
+*/
+struct base_bench_node
+{
+    uint8_t address;
+    char call_sign[CALL_SIGN_LENGTH + 1];
+    uint8_t id;                              /*!< header id of the next frame */
+    struct position_fix fix;                 /*!< the last fix */
+    std::vector<struct position_fix> held;   /*!< fixes for the next batch or history packet */
+    struct position_fix acked;               /*!< a fix that arrived, sent again with the history */
+    bool have_acked;                         /*!< acked is one */
+};
+
+/**
+    @brief a fix as it has to come out, by address, date and time of day
+*/
+struct base_bench_expected
+{
+    int32_t latitude;
+    int32_t longitude;
+    uint32_t tolerance; /*!< 1e-7 degrees it may be off by, the ascii packet has 1e-4 minutes */
+};
+
+static uint64_t key(uint8_t address, const struct position_fix &fix)
+{
+    return (uint64_t)address << 48 | (uint64_t)fix.date << 32 | fix.time_of_day;
+}
+
+static void frame(std::string &capture, base_bench_node &node, const uint8_t *data, uint8_t length,
+                  uint32_t time, std::mt19937 &random_numbers)
+{
+    /**
+        @brief add the RX line of a frame, twice now and then
+    */
+    struct base_frame received;
+    char line[40 + 2 * BASE_FRAME_MAX];
+    received.time = time;
+    received.from = node.address;
+    received.id = node.id++;
+    received.flags = 0;
+    received.rssi = (int16_t)(-50 - (int)(random_numbers() % 50));
+    received.length = length;
+    memcpy(received.data, data, length);
+    capture.append(line, base_frame_format(&received, line, sizeof(line)));
+    if (random_numbers() % BASE_BENCH_RESENT == 0)
+    {
+        received.flags = 0x40;
+        received.time += 30;
+        capture.append(line, base_frame_format(&received, line, sizeof(line)));
+    }
+}
+
+static uint8_t ascii_packet(const struct position_fix &fix, uint8_t *buffer)
+{
+    /**
+        @brief what POSITION_PACKET_LEGACY_ASCII sends for a fix
+    */
+    uint32_t latitude = (uint32_t)labs(fix.latitude);
+    uint32_t longitude = (uint32_t)labs(fix.longitude);
+    char text[BASE_FRAME_MAX + 1];
+    int length = snprintf(text, sizeof(text), "%.6s,%02u%02u%02u.000,A,%02u%07.4f,%c,%03u%07.4f,%c,%02u%02u%02u",
+                          fix.call_sign, fix.time_of_day / 360000, fix.time_of_day / 6000 % 60,
+                          fix.time_of_day / 100 % 60, latitude / 10000000, latitude % 10000000 * 60 / 1e7,
+                          fix.latitude < 0 ? 'S' : 'N', longitude / 10000000, longitude % 10000000 * 60 / 1e7,
+                          fix.longitude < 0 ? 'W' : 'E', fix.date & 0x1f, (fix.date >> 5) & 0x0f, fix.date >> 9);
+    memcpy(buffer, text, length);
+    return (uint8_t)length;
+}
+
+static uint64_t make_capture(std::string &capture, std::map<uint64_t, base_bench_expected> &expected,
+                             uint32_t seed)
+{
+    /**
+        @brief the capture of the whole fleet, the fixes it has to decode to, and its frames
+    */
+    std::vector<base_bench_node> fleet(BASE_BENCH_NODES);
+    std::mt19937 random_numbers(seed);
+    struct latency_stats stats;
+    struct packet_builder builder;
+    uint8_t packet[BASE_FRAME_MAX];
+    uint8_t records[3][POSITION_RECORD_LENGTH];
+    uint8_t length;
+    uint64_t lines = 0;
+
+    latency_stats_reset(&stats);
+    for (uint16_t index = 0; index < BASE_BENCH_NODES; index++)
+    {
+        base_bench_node &node = fleet[index];
+        node.address = (uint8_t)(2 + index);
+        snprintf(node.call_sign, sizeof(node.call_sign), "bs%04u", index);
+        node.id = (uint8_t)random_numbers();
+        memset(&node.fix, 0, sizeof(node.fix));
+        memcpy(node.fix.call_sign, node.call_sign, CALL_SIGN_LENGTH);
+        node.fix.flags = POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID;
+        node.fix.latitude = 357800000 + (int32_t)(random_numbers() % 1000000) - 500000;
+        node.fix.longitude = -786400000 + (int32_t)(random_numbers() % 1000000) - 500000;
+        node.fix.date = 23 << 9 | 8 << 5 | 17;
+        node.have_acked = false;
+    }
+    for (uint32_t second = 0; second < BASE_BENCH_SECONDS; second++)
+    {
+        for (base_bench_node &node : fleet)
+        {
+            uint8_t mode = node.address % 4;
+            uint32_t time = second * 1000 + node.address;
+            struct position_fix &fix = node.fix;
+            fix.time_of_day = (43200 + second) * 100;
+            fix.latitude += (int32_t)(random_numbers() % 2001) - 1000;
+            fix.longitude += (int32_t)(random_numbers() % 2001) - 1000;
+            fix.speed = (uint16_t)(random_numbers() % 5000);
+            fix.course = (uint16_t)(random_numbers() % 36000);
+            fix.flags &= ~(POSITION_FLAG_ALTITUDE_VALID | POSITION_FLAG_DOP_VALID);
+            if (mode == 0 && second % 10 == 0)
+            {
+                fix.flags |= POSITION_FLAG_ALTITUDE_VALID | POSITION_FLAG_DOP_VALID;
+                fix.altitude = 1200;
+                fix.satellites = 9;
+                fix.hdop = 110;
+            }
+            expected[key(node.address, fix)] = {fix.latitude, fix.longitude, mode == 2 ? 20u : 0u};
+            if (mode == 0 || (mode == 3 && random_numbers() % BASE_BENCH_LOST != 0))
+            {
+                length = position_packet_encode(&fix, packet, sizeof(packet));
+                frame(capture, node, packet, length, time, random_numbers);
+                lines++;
+                node.acked = fix;
+                node.have_acked = true;
+            }
+            else if (mode == 1)
+            {
+                node.held.push_back(fix);
+                if (node.held.size() == BASE_BENCH_BATCH || second == BASE_BENCH_SECONDS - 1)
+                {
+                    packet_builder_start(&builder, packet, sizeof(packet));
+                    position_batch_start(&builder, node.call_sign, &node.held[0]);
+                    for (size_t held = 1; held < node.held.size(); held++)
+                    {
+                        position_batch_append(&builder, &node.held[held - 1], &node.held[held]);
+                    }
+                    frame(capture, node, packet, packet_builder_finish(&builder), time, random_numbers);
+                    lines++;
+                    node.held.clear();
+                }
+            }
+            else if (mode == 2)
+            {
+                frame(capture, node, packet, ascii_packet(fix, packet), time, random_numbers);
+                lines++;
+            }
+            else
+            {
+                node.held.push_back(fix);
+            }
+            // the lost fixes go again with one that did arrive, two at a time
+            if (mode == 3 && (node.held.size() == 2 || (second == BASE_BENCH_SECONDS - 1 && !node.held.empty())))
+            {
+                uint8_t count = 0;
+                if (node.have_acked)
+                {
+                    position_record_pack(&node.acked, records[count++]);
+                }
+                for (const struct position_fix &held : node.held)
+                {
+                    position_record_pack(&held, records[count++]);
+                }
+                length = position_history_encode(node.call_sign, records[0], count, packet, sizeof(packet));
+                frame(capture, node, packet, length, time + 500, random_numbers);
+                lines++;
+                node.held.clear();
+            }
+            if ((second + node.address) % 30 == 0)
+            {
+                latency_stats_delivery(&stats, true, 1, -70);
+                length = latency_telemetry_encode(&stats, node.call_sign, packet, sizeof(packet));
+                frame(capture, node, packet, length, time + 700, random_numbers);
+                lines++;
+            }
+            if ((second + node.address) % 97 == 0)
+            {
+                packet[0] = LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION;
+                packet[1] = (uint8_t)(random_numbers() % LINK_PROFILE_COUNT);
+                frame(capture, node, packet, LINK_PROFILE_LENGTH, time + 800, random_numbers);
+                lines++;
+            }
+        }
+        capture.append("console text, the gps rate is 9600\r\n");
+        if (second % 60 == 59)
+        {
+            capture.append("RX 1 2 3 4 -50 B1C\n");
+        }
+    }
+    return lines;
+}
+
+static bool check(const base_station &station, const std::map<uint64_t, base_bench_expected> &expected)
+{
+    /**
+        @brief every fix is on its track once, where it was made
+    */
+    uint64_t fixes = 0;
+    for (const auto &entry : station.nodes)
+    {
+        for (const struct base_fix &fix : entry.second.track)
+        {
+            std::map<uint64_t, base_bench_expected>::const_iterator found = expected.find(key(entry.first, fix.fix));
+            if (found == expected.end() ||
+                (uint32_t)labs(found->second.latitude - fix.fix.latitude) > found->second.tolerance ||
+                (uint32_t)labs(found->second.longitude - fix.fix.longitude) > found->second.tolerance)
+            {
+                return false;
+            }
+            fixes++;
+        }
+    }
+    return fixes == expected.size();
+}
+
+static bool same(const base_stats &a, const base_stats &b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+int base_bench(const bench_options &options)
+/**@brief frames a second of the base station decoder with 0 to 8 threads
+ *
+ * @param options the command line options, the seed is used for the capture
+ * @return 0 if every run decoded every fix once, with the same counters
+ */
+{
+    static const unsigned thread_counts[] = {0, 1, 2, 4, 8};
+    std::map<uint64_t, base_bench_expected> expected;
+    std::string capture;
+    base_stats first;
+    int failed = 0;
+
+    uint64_t frames = make_capture(capture, expected, options.seed);
+    printf("  %u trackers, %u s, %llu frames and %zu fixes in %.1f MB, %u cpus\n", BASE_BENCH_NODES,
+           BASE_BENCH_SECONDS, (unsigned long long)frames, expected.size(), capture.size() / 1e6,
+           std::thread::hardware_concurrency());
+    printf("  %7s | %9s %9s %7s %7s %7s\n", "threads", "frames/s", "MB/s", "frames", "again", "fixes");
+    for (size_t index = 0; index < sizeof(thread_counts) / sizeof(thread_counts[0]); index++)
+    {
+        double started = bench_seconds();
+        base_station station(thread_counts[index]);
+        for (size_t offset = 0; offset < capture.size(); offset += BASE_BENCH_READ)
+        {
+            station.feed(capture.data() + offset, std::min((size_t)BASE_BENCH_READ, capture.size() - offset));
+        }
+        station.finish();
+        double seconds = bench_seconds() - started;
+        printf("  %7u | %9.0f %9.1f %7llu %7llu %7llu\n", thread_counts[index], station.stats.frames / seconds,
+               capture.size() / seconds / 1e6, (unsigned long long)station.stats.frames,
+               (unsigned long long)station.stats.duplicate_frames, (unsigned long long)station.stats.fixes);
+        if (!check(station, expected))
+        {
+            printf("  FAIL: the tracks with %u threads are not the fixes that were sent\n", thread_counts[index]);
+            failed = 1;
+        }
+        if (index == 0)
+        {
+            first = station.stats;
+        }
+        else if (!same(first, station.stats))
+        {
+            printf("  FAIL: %u threads counted differently from decoding in feed\n", thread_counts[index]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
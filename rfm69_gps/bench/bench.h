@@ -0,0 +1,63 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file bench.h
+    @brief Shared pieces of the host benchmark harness, only built by [env:native].
+**/
+#ifndef bench_h
+#define bench_h
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+    @brief options from the command line, shared by every suite
+*/
+struct bench_options
+{
+    uint32_t sentences;              /*!< size of the synthetic corpus */
+    double min_sentences_per_second; /*!< fail the run below this end to end rate, 0 is no check */
+    uint32_t seed;                   /*!< seed for the synthetic corpus */
+    std::vector<std::string> files;  /*!< recorded corpora to replay */
+};
+
+/**
+    @brief a benchmark suite, returns 0 on success
+*/
+struct bench_suite
+{
+    const char *name;
+    const char *description;
+    int (*run)(const bench_options &options);
+};
+
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+static inline double bench_seconds(void)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+extern int nmea_pipeline_bench(const bench_options &options);
+extern int geo_bench(const bench_options &options);
+extern int tdma_bench(const bench_options &options);
+extern int link_bench(const bench_options &options);
+extern int fleet_bench(const bench_options &options);
+extern int base_bench(const bench_options &options);
+extern int boot_bench(const bench_options &options);
+
+#endif
@@ -0,0 +1,98 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  bench_main.cpp
+    @author Ralph Blach
+    @brief Entry point of the host benchmark harness.
+
+    Build and run it with
+        pio run -e native && .pio/build/native/program [options] [suite] [capture files]
+    options
+        -n sentences  size of the synthetic corpus, default 200000
+        -m rate       fail if the end to end rate drops below this many sentences a second
+        -s seed       seed for the synthetic corpus
+        -l            list the suites
+    With no suite named every suite is run.  Any other argument is a recorded capture that is
+    replayed after the synthetic corpus, bench/corpus/drive.nmea is one.
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+static const bench_suite suites[] = {
+    {"nmea", "gps ingestion, parse and packet throughput", nmea_pipeline_bench},
+    {"geo", "integer coordinate kernel accuracy and speed against double", geo_bench},
+    {"tdma", "trackers on one channel sending at will against in gps time slots", tdma_bench},
+    {"link", "adaptive bit rate and power against fixed profiles on a fading channel", link_bench},
+    {"fleet", "end to end delivery, latency and channel use of 1 to 64 simulated trackers", fleet_bench},
+    {"base", "base station decoder frames a second on a fleet capture, 0 to 8 threads", base_bench},
+    {"boot", "settings from each kind of eeprom and the time to first transmit", boot_bench},
+};
+
+#define NUMBER_OF_SUITES (sizeof(suites) / sizeof(suites[0]))
+
+static const bench_suite *find_suite(const char *name)
+{
+    for (size_t index = 0; index < NUMBER_OF_SUITES; index++)
+    {
+        if (strcmp(suites[index].name, name) == 0)
+        {
+            return &suites[index];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    bench_options options;
+    const bench_suite *selected = NULL;
+    int result = 0;
+
+    options.sentences = 200000;
+    options.min_sentences_per_second = 0;
+    options.seed = 1;
+    for (int index = 1; index < argc; index++)
+    {
+        if (strcmp(argv[index], "-n") == 0 && index + 1 < argc)
+        {
+            options.sentences = (uint32_t)strtoul(argv[++index], NULL, 0);
+        }
+        else if (strcmp(argv[index], "-m") == 0 && index + 1 < argc)
+        {
+            options.min_sentences_per_second = strtod(argv[++index], NULL);
+        }
+        else if (strcmp(argv[index], "-s") == 0 && index + 1 < argc)
+        {
+            options.seed = (uint32_t)strtoul(argv[++index], NULL, 0);
+        }
+        else if (strcmp(argv[index], "-l") == 0)
+        {
+            for (size_t suite = 0; suite < NUMBER_OF_SUITES; suite++)
+            {
+                printf("%-12s %s\n", suites[suite].name, suites[suite].description);
+            }
+            return 0;
+        }
+        else if (selected == NULL && find_suite(argv[index]) != NULL)
+        {
+            selected = find_suite(argv[index]);
+        }
+        else
+        {
+            options.files.push_back(argv[index]);
+        }
+    }
+    for (size_t index = 0; index < NUMBER_OF_SUITES; index++)
+    {
+        if (selected != NULL && selected != &suites[index])
+        {
+            continue;
+        }
+        printf("== %s: %s\n", suites[index].name, suites[index].description);
+        result |= suites[index].run(options);
+    }
+    return result;
+}
@@ -0,0 +1,201 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  boot_bench.cpp
+    @author Ralph Blach
+    @brief The settings a boot loads from each kind of eeprom, and the time to first transmit.
+
+    rfm_69_setup is run on an erased eeprom, on one with only the old bytes 0 to 8, on the
+    block those were moved into, on that block with a byte spoiled, and on old bytes that are
+    not a call sign.  Each has to give the settings node_config.h says it does, and the block
+    has to be written only when the old bytes are moved.  Then a corpus is replayed into the
+    gps uart at 9600 baud on the virtual clock, the loop running after every BOOT_CHUNK bytes,
+    and the boot stages are printed.  The radio stand-in acks every frame at once, so the
+    first ack is the first send.  The stages before the first sentence only take the virtual
+    time of their delays, which is the radio reset.
+**/
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <RH_RF69.h>
+#include <rfm_69_functions.h>
+#include <node_config.h>
+#include <report_policy.h>
+#include <boot_stats.h>
+#include "bench.h"
+#include "nmea_corpus.h"
+
+/**
+    @brief the replay
+*/
+#define BOOT_CHUNK 16           /*!< bytes fed to the uart between passes of the loop */
+#define BOOT_BAUD 9600          /*!< the rate the gps starts at */
+#define BOOT_LIMIT 600          /*!< seconds of the corpus to replay at most */
+
+extern RH_RF69 rf69;
+extern struct node_config node_config;
+extern struct boot_stats boot;
+
+/**
+    @brief one kind of eeprom
+*/
+struct boot_case
+{
+    const char *name;
+    const char *legacy;    /*!< bytes 0 to 8, NULL leaves them as they are */
+    bool spoil;            /*!< flip a byte of the block */
+    bool version_1;        /*!< make the block one of version 1 */
+    bool erase;            /*!< erase everything first */
+    uint8_t source;        /*!< the node_config_source it has to load from */
+    const char *call_sign; /*!< the call sign it has to load */
+    uint8_t sync_words[2]; /*!< and the network */
+    uint8_t slot;
+};
+
+static const boot_case cases[] = {
+    {"erased", NULL, false, false, true, NODE_CONFIG_FROM_DEFAULTS, "N0CALL", {0x2d, 0xd4}, 0xff},
+    {"old bytes", "KD4XYZ\xaa\xbb\x03", false, false, true, NODE_CONFIG_FROM_LEGACY, "KD4XYZ", {0xaa, 0xbb}, 3},
+    {"block", NULL, false, false, false, NODE_CONFIG_FROM_BLOCK, "KD4XYZ", {0xaa, 0xbb}, 3},
+    {"version 1", NULL, false, true, false, NODE_CONFIG_FROM_VERSION_1, "KD4XYZ", {0xaa, 0xbb}, 3},
+    {"spoiled", "KD4XY \xff\xff\x05", true, false, false, NODE_CONFIG_FROM_LEGACY, "KD4XY ", {0x2d, 0xd4}, 5},
+    {"garbage", "\x12K4\xffZZ\x00\x00\x07", false, false, true, NODE_CONFIG_FROM_DEFAULTS, "N0CALL", {0x2d, 0xd4}, 0xff},
+};
+
+static void erase_eeprom(void)
+{
+    for (uint16_t address = 0; address < EEPROM.length(); address++)
+    {
+        EEPROM.update(address, 0xff);
+    }
+}
+
+static bool run_case(const boot_case &entry)
+{
+    /**
+        @brief set up the eeprom, boot, and check what was loaded
+    */
+    static const char *const sources[] = {"block", "old bytes", "defaults", "version 1"};
+    uint8_t block[NODE_CONFIG_VERSION_1_LENGTH];
+    uint16_t crc;
+    uint32_t writes;
+    bool good;
+
+    if (entry.erase)
+    {
+        erase_eeprom();
+    }
+    if (entry.legacy != NULL)
+    {
+        for (uint8_t index = 0; index <= NODE_CONFIG_LEGACY_SLOT; index++)
+        {
+            EEPROM.update(index, (uint8_t)entry.legacy[index]);
+        }
+    }
+    if (entry.spoil)
+    {
+        EEPROM.update(NODE_CONFIG_EEPROM_START + 9, EEPROM.read(NODE_CONFIG_EEPROM_START + 9) ^ 0x01);
+    }
+    if (entry.version_1)
+    {
+        // the same settings, with the version 1 crc straight after the link profile
+        EEPROM.get(NODE_CONFIG_EEPROM_START, block);
+        block[1] = 1;
+        crc = node_config_crc(block, sizeof(block));
+        EEPROM.put(NODE_CONFIG_EEPROM_START, block);
+        EEPROM.put(NODE_CONFIG_EEPROM_START + NODE_CONFIG_VERSION_1_LENGTH, crc);
+    }
+    writes = EEPROM.native_writes();
+    native_set_micros(1000000);
+    rfm_69_setup();
+    writes = EEPROM.native_writes() - writes;
+    good = boot.config_source == entry.source && memcmp(node_config.call_sign, entry.call_sign, CALL_SIGN_LENGTH) == 0 &&
+           memcmp(node_config.sync_words, entry.sync_words, 2) == 0 && node_config.slot == entry.slot &&
+           memcmp(rf69.native_sync_words, entry.sync_words, 2) == 0 &&
+           node_config.version == NODE_CONFIG_VERSION &&
+           node_config.parked_fix_interval == REPORT_DEFAULT_PARKED_FIX_INTERVAL &&
+           (writes != 0) == (entry.source == NODE_CONFIG_FROM_LEGACY || entry.source == NODE_CONFIG_FROM_VERSION_1);
+    printf("  %-10s from %-9s call %.6s, sync 0x%02x 0x%02x, slot %3u, %2u eeprom writes, setup %.3f ms  %s\n",
+           entry.name, sources[boot.config_source], node_config.call_sign, node_config.sync_words[0],
+           node_config.sync_words[1], node_config.slot, writes, boot_stats_elapsed(&boot, BOOT_READY) / 1000.0,
+           good ? "ok" : "WRONG");
+    return good;
+}
+
+static bool replay(const char *name, const nmea_corpus &corpus)
+{
+    /**
+        @brief boot on an erased eeprom and feed the corpus at the gps rate until the first ack
+    */
+    static const char *const names[BOOT_STAGES] = {"setup", "config", "radio", "ready", "sentence", "fix", "send", "ack"};
+    const uint64_t byte_time = 10 * 1000000ULL / BOOT_BAUD;
+    size_t limit = corpus.bytes.size();
+
+    if ((uint64_t)limit * byte_time > BOOT_LIMIT * 1000000ULL)
+    {
+        limit = (size_t)(BOOT_LIMIT * 1000000ULL / byte_time);
+    }
+    erase_eeprom();
+    native_set_micros(1000000);
+    rfm_69_setup();
+    Serial1.native_clear();
+    rf69.native_sent.clear();
+    for (size_t offset = 0; offset < limit && !boot_stats_reached(&boot, BOOT_ACK); offset += BOOT_CHUNK)
+    {
+        size_t length = limit - offset < BOOT_CHUNK ? limit - offset : BOOT_CHUNK;
+        native_advance_micros(length * byte_time);
+        Serial1.native_feed((const uint8_t *)corpus.bytes.data() + offset, length);
+        rfm_69_loop();
+    }
+    printf("  corpus %s, ms from the start of setup\n", name);
+    for (uint8_t stage = BOOT_CONFIG; stage < BOOT_STAGES; stage++)
+    {
+        if (boot_stats_reached(&boot, stage))
+        {
+            printf("    %-9s %10.3f\n", names[stage], boot_stats_elapsed(&boot, stage) / 1000.0);
+        }
+        else
+        {
+            printf("    %-9s %10s\n", names[stage], "never");
+        }
+    }
+    if (!boot_stats_reached(&boot, BOOT_SEND))
+    {
+        printf("  nothing was sent in %u s of the corpus\n", BOOT_LIMIT);
+        return false;
+    }
+    printf("  time to first transmit %.3f ms, %.3f ms of it after the first fix\n",
+           boot_stats_elapsed(&boot, BOOT_SEND) / 1000.0,
+           (boot_stats_elapsed(&boot, BOOT_SEND) - boot_stats_elapsed(&boot, BOOT_FIX)) / 1000.0);
+    return true;
+}
+
+int boot_bench(const bench_options &options)
+{
+    nmea_corpus corpus;
+    bool good = true;
+
+    for (const boot_case &entry : cases)
+    {
+        good = run_case(entry) && good;
+    }
+    if (options.files.empty())
+    {
+        nmea_corpus_synthesize(options.sentences, options.seed, corpus);
+        good = replay("synthetic", corpus) && good;
+    }
+    for (const std::string &path : options.files)
+    {
+        if (!nmea_corpus_load(path, corpus))
+        {
+            fprintf(stderr, "cannot read %s\n", path.c_str());
+            return 1;
+        }
+        good = replay(path.c_str(), corpus) && good;
+    }
+    // the other suites start from an erased eeprom
+    erase_eeprom();
+    return good ? 0 : 1;
+}
@@ -0,0 +1,398 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  fleet_bench.cpp
+    @author Ralph Blach
+    @brief End to end delivery, latency and channel use of a fleet of trackers.
+
+    Each tracker drives its own made up track around the base station, parking now and then,
+    and its gps sends an RMC a fix interval apart, FLEET_GPS_DELAY ms after the utc second.
+    The tracker then does what the loop does with it.  The sentence is tokenized by
+    parse_gps_data and decoded by position_fix_from_rmc.  The fix is passed through the report
+    policy and the fix interval it asks for is kept.  The position packet or batch is built
+    and committed to the tracker's own tx_queue, on a sim_radio, with the gate of its own
+    slot_scheduler in the slotted runs.  The sketch keeps its state in globals, so one
+    process cannot run rfm_69_loop more than once; each simulated tracker holds its own copy
+    of that state instead.
+
+    The base station decodes every frame it gets whole, so a fix counts as delivered once it
+    is in a packet that arrived, whether its ack made it back or not.  The latency is from
+    the line feed of the RMC to the ack at the tracker.  Everything runs on the virtual clock
+    and is seeded, so a run gives the same numbers every time, and the suite checks that.
+**/
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+#include <Arduino.h>
+#include <rfm_69_functions.h>
+#include <position_packet.h>
+#include <report_policy.h>
+#include <tx_queue.h>
+#include <fix_batch.h>
+#include <slot_scheduler.h>
+#include "bench.h"
+#include "nmea_corpus.h"
+#include "sim_channel.h"
+
+/**
+    @brief the simulated fleet
+*/
+#define FLEET_SECONDS 600        /*!< seconds of fixes */
+#define FLEET_DRAIN 10           /*!< seconds after the last fix for the retries to finish */
+#define FLEET_STEP 250           /*!< us the clock moves between passes of the loops */
+#define FLEET_GPS_DELAY 80       /*!< ms from the utc second to the line feed of the RMC */
+#define FLEET_GPS_SPREAD 2000    /*!< us each tracker's delay is off by at most */
+#define FLEET_SLOTS 64           /*!< slots in a second in the slotted runs */
+#define FLEET_BATCH 4            /*!< fixes in a batch in the batched runs */
+#define FLEET_BIT_RATE 250000    /*!< the modem setting of the firmware */
+#define FLEET_BASE_ADDRESS 1
+#define FLEET_TOKENS 15
+
+/**
+    @brief how the trackers send
+*/
+enum fleet_mode
+{
+    FLEET_AT_WILL, /*!< as the firmware does by default, each report as soon as it is made */
+    FLEET_SLOTTED, /*!< in a slot of FLEET_SLOTS, see slot_scheduler.h */
+    FLEET_BATCHED, /*!< FLEET_BATCH fixes a packet, see fix_batch.h */
+};
+
+static const char *const mode_names[] = {"at will", "slots", "batch"};
+
+/**
+    @brief one tracker
+*/
+struct fleet_node
+{
+    fleet_node(sim_channel &channel, uint8_t address) : radio(channel, address) {}
+    sim_radio radio;
+    struct tx_queue queue;
+    struct report_policy policy;
+    struct slot_scheduler scheduler;
+    struct fix_batch batch;
+    char call_sign[CALL_SIGN_LENGTH];
+    double latitude;        /*!< degrees */
+    double longitude;       /*!< degrees */
+    double speed;           /*!< m/s */
+    double target_speed;    /*!< m/s it is speeding up or slowing down to */
+    double course;          /*!< degrees */
+    uint32_t phase_left;    /*!< seconds until it parks or drives off */
+    int32_t gps_offset;     /*!< us its line feeds are off FLEET_GPS_DELAY */
+    uint32_t second;        /*!< the utc second of the next fix */
+    uint64_t next_fix;      /*!< micros of the line feed of the next fix */
+    std::map<uint32_t, uint64_t> reported; /*!< line feed micros of each fix sent, by time of day */
+};
+
+/**
+    @brief what one run delivered
+*/
+struct fleet_result
+{
+    uint32_t fixes;             /*!< fixes the gps made */
+    uint32_t reported;          /*!< fixes the policy sent */
+    uint32_t delivered;         /*!< of them, decoded at the base station */
+    uint32_t timeouts;          /*!< acks that did not come in time */
+    uint32_t failed;            /*!< frames given up on */
+    uint32_t collided;          /*!< frames lost to another frame */
+    double utilization;         /*!< part of the time the channel was in use */
+    std::vector<double> latency; /*!< ms from line feed to ack, of every acked fix */
+    bool operator==(const fleet_result &other) const
+    {
+        return fixes == other.fixes && reported == other.reported && delivered == other.delivered &&
+               timeouts == other.timeouts && failed == other.failed && collided == other.collided &&
+               latency == other.latency;
+    }
+};
+
+static std::map<const struct tx_queue *, fleet_node *> owners;
+static fleet_result *current;
+static fleet_mode current_mode;
+
+static void for_each_fix(const uint8_t *data, uint8_t length, const std::function<void(const position_fix &)> &visit)
+{
+    /**
+        @brief the fixes of a position or batch packet
+    */
+    struct position_fix fix;
+    struct position_batch_reader reader;
+    if (position_batch_first(&reader, data, length, &fix))
+    {
+        do
+        {
+            visit(fix);
+        } while (position_batch_next(&reader, &fix));
+    }
+    else if (position_packet_decode(data, length, &fix))
+    {
+        visit(fix);
+    }
+}
+
+static void complete(struct tx_queue *queue, const struct tx_frame *frame, bool delivered, uint8_t attempts)
+{
+    fleet_node *node = owners[queue];
+    uint64_t now = native_micros64();
+    if (current_mode == FLEET_BATCHED)
+    {
+        fix_batch_complete(&node->batch, frame, delivered);
+    }
+    if (!delivered)
+    {
+        return;
+    }
+    for_each_fix(frame->data, frame->length, [&](const position_fix &fix) {
+        std::map<uint32_t, uint64_t>::iterator line_feed = node->reported.find(fix.time_of_day);
+        if (line_feed != node->reported.end())
+        {
+            current->latency.push_back((now - line_feed->second) / 1000.0);
+            node->reported.erase(line_feed);
+        }
+    });
+}
+
+static void drive(fleet_node &node, std::mt19937 &random_numbers, uint32_t seconds)
+{
+    /**
+        @brief move the tracker on by some seconds, it drives for a few minutes, parks for a
+        few minutes, and turns now and then
+    */
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::normal_distribution<double> wander(0, 3);
+    for (uint32_t second = 0; second < seconds; second++)
+    {
+        if (node.phase_left == 0)
+        {
+            node.target_speed = node.target_speed > 0 ? 0 : 8 + 17 * unit(random_numbers);
+            node.phase_left = 60 + (uint32_t)(240 * unit(random_numbers));
+        }
+        node.phase_left--;
+        node.speed += fmax(-3, fmin(3, node.target_speed - node.speed));
+        if (node.speed > 1)
+        {
+            node.course += unit(random_numbers) < 0.02 ? (unit(random_numbers) < 0.5 ? -90 : 90) : wander(random_numbers);
+            node.course = fmod(node.course + 360, 360);
+            node.latitude += node.speed * cos(node.course * M_PI / 180) / 111320;
+            node.longitude += node.speed * sin(node.course * M_PI / 180) / (111320 * cos(node.latitude * M_PI / 180));
+        }
+    }
+}
+
+static std::string rmc(const fleet_node &node)
+{
+    /**
+        @brief the RMC the gps would send for the tracker now
+    */
+    char body[128];
+    uint32_t time = 43200 + node.second;
+    double latitude = fabs(node.latitude);
+    double longitude = fabs(node.longitude);
+    snprintf(body, sizeof(body), "GPRMC,%02u%02u%02u.000,A,%02d%07.4f,%c,%03d%07.4f,%c,%.2f,%.2f,170823,,,A",
+             time / 3600, time / 60 % 60, time % 60, (int)latitude, (latitude - (int)latitude) * 60,
+             node.latitude < 0 ? 'S' : 'N', (int)longitude, (longitude - (int)longitude) * 60,
+             node.longitude < 0 ? 'W' : 'E', node.speed * 3600 / 1852, node.speed > 1 ? node.course : 0.0);
+    return nmea_with_checksum(body);
+}
+
+static void fix(fleet_node &node, fleet_mode mode, fleet_result &result)
+{
+    /**
+        @brief what the loop does with an RMC
+    */
+    char scratch[128];
+    char *tokens[FLEET_TOKENS];
+    struct position_fix fix;
+    uint8_t *buffer;
+    uint8_t length;
+    int number_of_tokens;
+
+    strncpy(scratch, rmc(node).c_str(), sizeof(scratch) - 1);
+    scratch[sizeof(scratch) - 1] = 0;
+    number_of_tokens = parse_gps_data(scratch, tokens);
+    if (!position_fix_from_rmc(tokens, number_of_tokens, node.call_sign, &fix))
+    {
+        return;
+    }
+    result.fixes++;
+    if (mode == FLEET_SLOTTED)
+    {
+        slot_scheduler_sync(&node.scheduler, fix.time_of_day, micros());
+    }
+    if (report_policy_check(&node.policy, &fix) == REPORT_REASON_NONE)
+    {
+        return;
+    }
+    result.reported++;
+    node.reported[fix.time_of_day] = native_micros64();
+    if (mode == FLEET_BATCHED)
+    {
+        fix_batch_add(&node.batch, &node.queue, node.call_sign, &fix, FLEET_BASE_ADDRESS, micros());
+        return;
+    }
+    buffer = tx_queue_reserve(&node.queue);
+    if (buffer != NULL)
+    {
+        length = position_packet_encode(&fix, buffer, RH_RF69_MAX_MESSAGE_LEN);
+        tx_queue_commit_from(&node.queue, length, FLEET_BASE_ADDRESS, micros());
+    }
+}
+
+static fleet_result run(uint8_t nodes, fleet_mode mode, double loss, uint32_t seed)
+{
+    /**
+        @brief simulate nodes trackers for FLEET_SECONDS and let their queues drain
+    */
+    sim_channel channel(FLEET_BIT_RATE, FLEET_BASE_ADDRESS, 1000);
+    std::vector<std::unique_ptr<fleet_node>> fleet;
+    std::set<std::pair<uint8_t, uint32_t>> received;
+    std::mt19937 random_numbers(seed * 7919 + nodes);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::uniform_int_distribution<int32_t> spread(-FLEET_GPS_SPREAD, FLEET_GPS_SPREAD);
+    fleet_result result = {};
+    uint64_t start;
+    uint64_t end;
+
+    native_set_micros(1000000);
+    randomSeed(seed + nodes);
+    channel.noise.seed(seed);
+    channel.loss = loss;
+    start = native_micros64();
+    end = start + (uint64_t)(FLEET_SECONDS + FLEET_DRAIN) * 1000000;
+    owners.clear();
+    current = &result;
+    current_mode = mode;
+    channel.on_delivery = [&](const sim_transmission &frame) {
+        for_each_fix(frame.payload.data(), (uint8_t)frame.payload.size(), [&](const position_fix &fix) {
+            if (received.insert(std::make_pair(frame.from, fix.time_of_day)).second)
+            {
+                result.delivered++;
+            }
+        });
+    };
+    for (uint8_t index = 0; index < nodes; index++)
+    {
+        fleet.emplace_back(new fleet_node(channel, FLEET_BASE_ADDRESS + 1 + index));
+        fleet_node &node = *fleet.back();
+        tx_queue_init(&node.queue, &node.radio, FLEET_BASE_ADDRESS + 1 + index);
+        node.queue.bit_rate = FLEET_BIT_RATE;
+        node.queue.on_complete = complete;
+        owners[&node.queue] = &node;
+        report_policy_init(&node.policy);
+        slot_scheduler_init(&node.scheduler, index, FLEET_SLOTS);
+        if (mode == FLEET_SLOTTED)
+        {
+            node.queue.gate = slot_scheduler_gate;
+            node.queue.gate_context = &node.scheduler;
+        }
+        fix_batch_init(&node.batch, mode == FLEET_BATCHED ? FLEET_BATCH : 0, 5000);
+        snprintf(node.call_sign, sizeof(node.call_sign), "fl%03u", index);
+        node.latitude = 35.78 + (unit(random_numbers) - 0.5) * 0.1;
+        node.longitude = -78.64 + (unit(random_numbers) - 0.5) * 0.1;
+        node.speed = 0;
+        node.target_speed = 0;
+        node.course = 360 * unit(random_numbers);
+        node.phase_left = (uint32_t)(300 * unit(random_numbers));
+        node.gps_offset = spread(random_numbers);
+        node.second = 0;
+        node.next_fix = start + FLEET_GPS_DELAY * 1000 + node.gps_offset;
+    }
+    while (native_micros64() < end)
+    {
+        native_advance_micros(FLEET_STEP);
+        channel.step();
+        for (std::unique_ptr<fleet_node> &node : fleet)
+        {
+            if (node->second < FLEET_SECONDS && native_micros64() >= node->next_fix)
+            {
+                fix(*node, mode, result);
+                // the gps makes its next fix when the policy asked for
+                uint32_t interval = (node->policy.fix_interval + 999) / 1000;
+                drive(*node, random_numbers, interval);
+                node->second += interval;
+                node->next_fix = start + (uint64_t)node->second * 1000000 + FLEET_GPS_DELAY * 1000 + node->gps_offset;
+            }
+            if (mode == FLEET_BATCHED)
+            {
+                fix_batch_service(&node->batch, &node->queue);
+            }
+            tx_queue_service(&node->queue);
+        }
+    }
+    for (const std::unique_ptr<fleet_node> &node : fleet)
+    {
+        result.timeouts += node->queue.stats.retries;
+        result.failed += node->queue.stats.failed;
+    }
+    result.collided = channel.stats.collided;
+    result.utilization = (double)channel.stats.busy / (end - start);
+    owners.clear();
+    return result;
+}
+
+static double percentile(const std::vector<double> &sorted, double part)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t)(part * sorted.size()))];
+}
+
+int fleet_bench(const bench_options &options)
+/**@brief delivery ratio, fix to ack latency and channel use for fleets of 1 to 64 trackers
+ *
+ * @param options the command line options, the seed is used for the tracks, the loss and the backoffs
+ * @return 0 if a lone tracker on a clean channel delivered every fix and a repeated run gave the same numbers
+ */
+{
+    static const uint8_t fleet_sizes[] = {1, 8, 32, 64};
+    static const double losses[] = {0, 0.1};
+    static const fleet_mode modes[] = {FLEET_AT_WILL, FLEET_SLOTTED, FLEET_BATCHED};
+    double started = bench_seconds();
+    double simulated = 0;
+    int failed = 0;
+
+    printf("  %u s of fixes at %u bps, latency in ms from the RMC line feed to the ack\n", FLEET_SECONDS,
+           FLEET_BIT_RATE);
+    printf("  %-7s %4s %5s | %6s %6s %7s | %6s %6s %6s %6s | %6s %5s %5s %5s\n", "mode", "loss", "nodes", "fixes",
+           "sent", "deliv", "p50", "p90", "p99", "max", "tmout", "fail", "coll", "busy");
+    for (size_t loss = 0; loss < sizeof(losses) / sizeof(losses[0]); loss++)
+    {
+        for (size_t mode = 0; mode < sizeof(modes) / sizeof(modes[0]); mode++)
+        {
+            for (size_t size = 0; size < sizeof(fleet_sizes) / sizeof(fleet_sizes[0]); size++)
+            {
+                fleet_result result = run(fleet_sizes[size], modes[mode], losses[loss], options.seed);
+                std::sort(result.latency.begin(), result.latency.end());
+                simulated += (FLEET_SECONDS + FLEET_DRAIN) * fleet_sizes[size];
+                printf("  %-7s %3.0f%% %5u | %6u %6u %6.1f%% | %6.1f %6.1f %6.1f %6.1f | %6u %5u %5u %4.1f%%\n",
+                       mode_names[modes[mode]], losses[loss] * 100, fleet_sizes[size], result.fixes,
+                       result.reported, result.reported ? 100.0 * result.delivered / result.reported : 0.0,
+                       percentile(result.latency, 0.5), percentile(result.latency, 0.9),
+                       percentile(result.latency, 0.99), result.latency.empty() ? 0.0 : result.latency.back(),
+                       result.timeouts, result.failed, result.collided, 100 * result.utilization);
+                if (fleet_sizes[size] == 1 && losses[loss] == 0 && result.delivered != result.reported)
+                {
+                    printf("  FAIL: a lone tracker on a clean channel lost fixes\n");
+                    failed = 1;
+                }
+            }
+        }
+    }
+    fleet_result first = run(8, FLEET_AT_WILL, 0.1, options.seed);
+    fleet_result second = run(8, FLEET_AT_WILL, 0.1, options.seed);
+    if (!(first == second))
+    {
+        printf("  FAIL: the same run gave different numbers\n");
+        failed = 1;
+    }
+    printf("  %.0f tracker seconds simulated in %.1f s\n", simulated, bench_seconds() - started);
+    return failed;
+}
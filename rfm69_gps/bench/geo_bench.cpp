@@ -0,0 +1,270 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  geo_bench.cpp
+    @author Ralph Blach
+    @brief Accuracy and speed of the integer coordinate kernel against double precision.
+
+    Every function in geo_fixed.h and nmea_parse_coordinate is run over an exhaustive or a
+    dense sweep of its inputs and compared with the same thing done in doubles the way a
+    host program would, with strtod, cos and atan2.  The worst error is printed with the
+    cycles per call of both, and the suite fails if an error is past the limit the header
+    promises.  The cycles are host cycles, on the 32u4 the double side would also pull in the
+    floating point library.
+**/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <nmea.h>
+#include <geo_fixed.h>
+#include "bench.h"
+
+/**
+    @brief the worst errors allowed before the suite fails
+*/
+#define GEO_LIMIT_COORDINATE 1  /*!< 1e-7 degrees, for the four minute digits the gps sends */
+#define GEO_LIMIT_SPEED 1       /*!< cm/s */
+#define GEO_LIMIT_COS 40        /*!< Q15, 0.0012 */
+#define GEO_LIMIT_BEARING 2     /*!< 0.01 degrees */
+#define GEO_LIMIT_DISTANCE 0.01 /*!< of the distance, past the 2 m the whole meter axes can lose */
+
+static const double earth_radius = 6371008.8;
+
+/**
+    @brief the worst error of one function and the time of both versions
+*/
+struct geo_result
+{
+    const char *name;
+    uint32_t cases;
+    double worst;
+    double limit;
+    const char *unit;
+    uint64_t fixed_cycles;
+    uint64_t double_cycles;
+};
+
+static volatile double double_sink;
+static volatile int32_t fixed_sink;
+
+static int report(const geo_result &result)
+{
+    printf("  %-11s %9u cases, worst %8.3f %-14s limit %6.3f, fixed %6.1f cycles, double %6.1f cycles\n",
+           result.name, result.cases, result.worst, result.unit, result.limit,
+           result.cases ? (double)result.fixed_cycles / result.cases : 0.0,
+           result.cases ? (double)result.double_cycles / result.cases : 0.0);
+    if (result.worst > result.limit)
+    {
+        printf("  FAIL: %s is off by %.3f %s\n", result.name, result.worst, result.unit);
+        return 1;
+    }
+    return 0;
+}
+
+static double double_coordinate(const char *text, const char *hemisphere)
+{
+    double value = strtod(text, NULL);
+    double degrees = floor(value / 100);
+    value = degrees + (value - degrees * 100) / 60;
+    return hemisphere[0] == 'S' || hemisphere[0] == 'W' ? -value : value;
+}
+
+static int coordinate_sweep(void)
+{
+    /**
+        @brief every four digit minute of a few whole degrees, both hemispheres
+    */
+    static const uint16_t degrees[] = {0, 1, 45, 89, 90, 120, 179};
+    geo_result result = {"coordinate", 0, 0, GEO_LIMIT_COORDINATE, "1e-7 degrees", 0, 0};
+    char text[16];
+    bool present;
+    uint64_t start;
+    int32_t fixed;
+    double reference;
+
+    for (size_t index = 0; index < sizeof(degrees) / sizeof(degrees[0]); index++)
+    {
+        for (uint32_t minutes = 0; minutes < 600000; minutes++)
+        {
+            const char *hemisphere = (minutes & 1) ? "S" : "E";
+            snprintf(text, sizeof(text), "%u%02u.%04u", degrees[index], minutes / 10000, minutes % 10000);
+            start = bench_cycles();
+            fixed = nmea_parse_coordinate(text, hemisphere, &present);
+            result.fixed_cycles += bench_cycles() - start;
+            fixed_sink = fixed;
+            start = bench_cycles();
+            reference = double_coordinate(text, hemisphere);
+            result.double_cycles += bench_cycles() - start;
+            double_sink = reference;
+            result.worst = fmax(result.worst, fabs(fixed - reference * 1e7));
+            result.cases++;
+        }
+    }
+    return report(result);
+}
+
+static int speed_sweep(void)
+{
+    /**
+        @brief every speed a position_fix can hold
+    */
+    geo_result result = {"speed", 0, 0, GEO_LIMIT_SPEED, "cm/s", 0, 0};
+    uint64_t start;
+    uint16_t fixed;
+    double reference;
+
+    for (uint32_t speed = 0; speed <= 0xffff; speed++)
+    {
+        start = bench_cycles();
+        fixed = geo_knots_to_cms((uint16_t)speed);
+        result.fixed_cycles += bench_cycles() - start;
+        fixed_sink = fixed;
+        start = bench_cycles();
+        reference = speed * 0.01 * 1852.0 / 36.0;
+        result.double_cycles += bench_cycles() - start;
+        double_sink = reference;
+        result.worst = fmax(result.worst, fabs(fixed - reference));
+        result.cases++;
+    }
+    return report(result);
+}
+
+static int cos_sweep(void)
+{
+    /**
+        @brief every angle in 0.01 degrees, cos and sin
+    */
+    geo_result result = {"cos sin", 0, 0, GEO_LIMIT_COS, "Q15", 0, 0};
+    uint64_t start;
+    int32_t fixed;
+    double reference;
+
+    for (uint32_t angle = 0; angle < 36000; angle++)
+    {
+        start = bench_cycles();
+        fixed = geo_cos((uint16_t)angle);
+        result.fixed_cycles += bench_cycles() - start;
+        start = bench_cycles();
+        reference = cos(angle * M_PI / 18000);
+        result.double_cycles += bench_cycles() - start;
+        double_sink = reference;
+        result.worst = fmax(result.worst, fabs(fixed - reference * GEO_Q15_ONE));
+        fixed = geo_sin((uint16_t)angle);
+        result.worst = fmax(result.worst, fabs(fixed - sin(angle * M_PI / 18000) * GEO_Q15_ONE));
+        result.cases++;
+    }
+    return report(result);
+}
+
+static int bearing_sweep(void)
+{
+    /**
+        @brief every angle in 0.01 degrees at a few lengths, checked against atan2 of the same
+        rounded offset so only the kernel's own error is counted
+    */
+    static const double lengths[] = {100, 3000, 32000, 1000000000};
+    geo_result result = {"bearing", 0, 0, GEO_LIMIT_BEARING, "0.01 degrees", 0, 0};
+    uint64_t start;
+    int32_t east;
+    int32_t north;
+    uint16_t fixed;
+    double reference;
+    double error;
+
+    for (size_t index = 0; index < sizeof(lengths) / sizeof(lengths[0]); index++)
+    {
+        for (uint32_t angle = 0; angle < 36000; angle++)
+        {
+            east = (int32_t)lround(lengths[index] * sin(angle * M_PI / 18000));
+            north = (int32_t)lround(lengths[index] * cos(angle * M_PI / 18000));
+            start = bench_cycles();
+            fixed = geo_bearing(east, north);
+            result.fixed_cycles += bench_cycles() - start;
+            start = bench_cycles();
+            reference = atan2((double)east, (double)north) * 18000 / M_PI;
+            result.double_cycles += bench_cycles() - start;
+            double_sink = reference;
+            error = fmod(fabs(fixed - reference), 36000);
+            result.worst = fmax(result.worst, fmin(error, 36000 - error));
+            result.cases++;
+        }
+    }
+    return report(result);
+}
+
+static double haversine(int32_t from_latitude, int32_t from_longitude, int32_t to_latitude, int32_t to_longitude)
+{
+    double phi1 = from_latitude * 1e-7 * M_PI / 180;
+    double phi2 = to_latitude * 1e-7 * M_PI / 180;
+    double dphi = phi2 - phi1;
+    double dlambda = (to_longitude - from_longitude) * 1e-7 * M_PI / 180;
+    double a = sin(dphi / 2) * sin(dphi / 2) + cos(phi1) * cos(phi2) * sin(dlambda / 2) * sin(dlambda / 2);
+    return 2 * earth_radius * asin(sqrt(a));
+}
+
+static int distance_sweep(uint32_t seed)
+{
+    /**
+        @brief random pairs up to 30 km apart anywhere from 80 south to 80 north, against the
+        haversine on the mean earth radius.  The error is a fraction of the distance past 2 m,
+        both axes and the length are rounded down to whole meters
+    */
+    geo_result result = {"distance", 0, 0, GEO_LIMIT_DISTANCE, "of the distance", 0, 0};
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int32_t> latitude(-800000000, 800000000);
+    std::uniform_int_distribution<int32_t> longitude(-1800000000, 1799999999);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    uint64_t start;
+    int32_t from_latitude;
+    int32_t from_longitude;
+    int32_t to_latitude;
+    int32_t to_longitude;
+    uint16_t fixed;
+    double reference;
+    double error;
+
+    for (uint32_t index = 0; index < 1000000; index++)
+    {
+        from_latitude = latitude(random);
+        from_longitude = longitude(random);
+        // up to 0.19 degrees, 21 km, each way so the pair is no more than 30 km apart
+        to_latitude = from_latitude + (int32_t)(unit(random) * 1900000);
+        to_longitude = from_longitude + (int32_t)(unit(random) * 1900000 / cos(from_latitude * 1e-7 * M_PI / 180));
+        start = bench_cycles();
+        fixed = geo_distance(from_latitude, from_longitude, to_latitude, to_longitude);
+        result.fixed_cycles += bench_cycles() - start;
+        start = bench_cycles();
+        reference = haversine(from_latitude, from_longitude, to_latitude, to_longitude);
+        result.double_cycles += bench_cycles() - start;
+        double_sink = reference;
+        if (reference > GEO_MAX_OFFSET)
+        {
+            continue;
+        }
+        error = fabs(fixed - reference) - 2;
+        if (error > 0)
+        {
+            result.worst = fmax(result.worst, error / reference);
+        }
+        result.cases++;
+    }
+    return report(result);
+}
+
+int geo_bench(const bench_options &options)
+/**@brief the fixed point coordinate kernel against double precision
+ *
+ * @param options the command line options, the seed is used for the distance pairs
+ * @return 0 if every error was within its limit
+ */
+{
+    int result = 0;
+    result |= coordinate_sweep();
+    result |= speed_sweep();
+    result |= cos_sweep();
+    result |= bearing_sweep();
+    result |= distance_sweep(options.seed);
+    return result;
+}
@@ -0,0 +1,248 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  link_bench.cpp
+    @author Ralph Blach
+    @brief The link adapter against the two fixed profiles, over a fading channel.
+
+    One tracker sends a 25 byte fix a second to the base station over a sim_channel with
+    LINK_BENCH_FADING dB of fading.  It runs once for each path loss, and once with a path
+    loss that walks from near to the edge of range and back.  Each run is made three times:
+    fixed at GFSK_Rb250Fd250 and +20 dBm as the firmware used to be, fixed at the slowest
+    and loudest profile, and with the link adapter.  The base station side of the change
+    requests is done here the way link_adapter.h asks for it.  It acks a request on the old
+    profile and then listens on the new one, and it goes home after LINK_ADAPT_SILENCE ms
+    without a frame.
+**/
+#include <stdio.h>
+#include <math.h>
+#include <Arduino.h>
+#include <tx_queue.h>
+#include <link_adapter.h>
+#include "bench.h"
+#include "sim_channel.h"
+
+/**
+    @brief the simulated link
+*/
+#define LINK_BENCH_SECONDS 600      /*!< seconds of fixes in each run */
+#define LINK_BENCH_DRAIN 10         /*!< seconds after the last fix for the retries to finish */
+#define LINK_BENCH_STEP 100         /*!< us the clock moves between passes of the loop */
+#define LINK_BENCH_FADING 4.0       /*!< dB */
+#define LINK_BENCH_PACKET_LENGTH 25 /*!< a version 1 position packet */
+#define LINK_BENCH_FIXED 5          /*!< the profile the firmware used before, GFSK_Rb250Fd250 at +20 dBm */
+#define LINK_BENCH_BASE_ADDRESS 1
+#define LINK_BENCH_ADDRESS 2
+
+/**
+    @brief how the profile is picked in a run
+*/
+enum link_policy
+{
+    LINK_POLICY_FIXED,  /*!< LINK_BENCH_FIXED all the time */
+    LINK_POLICY_HOME,   /*!< LINK_ADAPT_HOME all the time */
+    LINK_POLICY_ADAPT,  /*!< the link adapter */
+};
+
+/**
+    @brief what one run delivered
+*/
+struct link_result
+{
+    uint32_t offered;    /*!< fixes made */
+    uint32_t delivered;  /*!< of them, received at the base station */
+    double air;          /*!< ms the tracker sent for */
+    double charge;       /*!< mA ms the tracker sent with */
+    uint32_t requests;   /*!< change requests */
+    uint32_t silences;   /*!< times the tracker went home after a silence */
+    double out_of_step;  /*!< seconds the two ends were on different profiles */
+    double mean_profile; /*!< the profile in use, averaged over the run */
+};
+
+static struct link_adapter *bench_adapter;
+
+static void complete(struct tx_queue *queue, const struct tx_frame *frame, bool delivered, uint8_t attempts)
+{
+    link_adapter_complete(bench_adapter, frame, delivered, attempts);
+}
+
+static void apply(void *context, const struct link_profile *profile)
+{
+    sim_radio *radio = (sim_radio *)context;
+    radio->modem = profile->modem;
+    radio->bit_rate = profile->bit_rate;
+    radio->power = profile->power;
+    radio->sensitivity = profile->sensitivity;
+    radio->current = profile->current;
+}
+
+static void listen(sim_channel &channel, uint8_t index)
+{
+    struct link_profile profile;
+    link_adapter_profile(index, &profile);
+    channel.base_links[LINK_BENCH_ADDRESS] = {profile.modem, profile.bit_rate, profile.sensitivity};
+}
+
+static link_result run(link_policy policy, double near_loss, double far_loss, uint32_t seed)
+{
+    /**
+        @brief one tracker for LINK_BENCH_SECONDS, the path loss goes from near_loss to far_loss
+        at half time and back
+    */
+    sim_channel channel(250000, LINK_BENCH_BASE_ADDRESS, 1000);
+    sim_radio radio(channel, LINK_BENCH_ADDRESS);
+    struct tx_queue queue;
+    struct link_adapter adapter;
+    struct link_profile profile;
+    std::vector<bool> received(LINK_BENCH_SECONDS, false);
+    link_result result = {};
+    uint8_t base_profile = LINK_ADAPT_HOME;
+    uint64_t last_heard;
+    uint64_t start;
+    uint64_t end;
+    uint64_t next_fix;
+    uint64_t now;
+    uint32_t second = 0;
+    uint64_t steps = 0;
+    uint8_t packet[LINK_BENCH_PACKET_LENGTH] = {0};
+
+    native_set_micros(1000000);
+    randomSeed(seed);
+    channel.noise.seed(seed);
+    channel.fading = LINK_BENCH_FADING;
+    start = native_micros64();
+    last_heard = start;
+    next_fix = start + 100000;
+    end = start + (uint64_t)(LINK_BENCH_SECONDS + LINK_BENCH_DRAIN) * 1000000;
+    tx_queue_init(&queue, &radio, LINK_BENCH_ADDRESS);
+    if (policy == LINK_POLICY_ADAPT)
+    {
+        bench_adapter = &adapter;
+        queue.on_complete = complete;
+        link_adapter_init(&adapter, &queue, apply, &radio);
+    }
+    else
+    {
+        base_profile = policy == LINK_POLICY_FIXED ? LINK_BENCH_FIXED : LINK_ADAPT_HOME;
+        link_adapter_profile(base_profile, &profile);
+        apply(&radio, &profile);
+        queue.bit_rate = profile.bit_rate;
+    }
+    listen(channel, base_profile);
+    channel.on_delivery = [&](const sim_transmission &frame) {
+        uint8_t index;
+        last_heard = frame.end;
+        if (link_profile_decode(frame.payload.data(), (uint8_t)frame.payload.size(), &index))
+        {
+            // the ack is already set up on the old profile
+            base_profile = index;
+            listen(channel, base_profile);
+            return;
+        }
+        index = frame.payload[0];
+        uint32_t fix = frame.payload[1] | (uint32_t)frame.payload[2] << 8;
+        if (index == 0 && fix < LINK_BENCH_SECONDS && !received[fix])
+        {
+            received[fix] = true;
+            result.delivered++;
+        }
+    };
+    while ((now = native_micros64()) < end)
+    {
+        double position = (double)(now - start) / ((uint64_t)LINK_BENCH_SECONDS * 1000000);
+        radio.path_loss = near_loss + (far_loss - near_loss) * (position < 0.5 ? position * 2 : fmax(0, 2 - position * 2));
+        native_advance_micros(LINK_BENCH_STEP);
+        channel.step();
+        if (policy == LINK_POLICY_ADAPT)
+        {
+            if (base_profile != LINK_ADAPT_HOME && native_micros64() - last_heard > LINK_ADAPT_SILENCE * 1000ULL)
+            {
+                base_profile = LINK_ADAPT_HOME;
+                listen(channel, base_profile);
+            }
+            link_adapter_service(&adapter, LINK_BENCH_BASE_ADDRESS);
+            if (adapter.profile != base_profile)
+            {
+                result.out_of_step += LINK_BENCH_STEP / 1e6;
+            }
+            result.mean_profile += adapter.profile;
+        }
+        else
+        {
+            result.mean_profile += base_profile;
+        }
+        steps++;
+        if (second < LINK_BENCH_SECONDS && native_micros64() >= next_fix)
+        {
+            packet[1] = (uint8_t)second;
+            packet[2] = (uint8_t)(second >> 8);
+            tx_queue_push(&queue, packet, sizeof(packet), LINK_BENCH_BASE_ADDRESS);
+            result.offered++;
+            second++;
+            next_fix += 1000000;
+        }
+        tx_queue_service(&queue);
+    }
+    result.air = radio.tx_micros / 1000.0;
+    result.charge = radio.tx_charge;
+    result.mean_profile /= steps;
+    if (policy == LINK_POLICY_ADAPT)
+    {
+        result.requests = adapter.stats.requests;
+        result.silences = adapter.stats.silences;
+    }
+    return result;
+}
+
+static void print_result(const link_result &result)
+{
+    printf(" %5.1f%% %5.2f %6.1f", result.offered ? 100.0 * result.delivered / result.offered : 0.0,
+           result.delivered ? result.air / result.delivered : 0.0,
+           result.delivered ? result.charge / result.delivered : 0.0);
+}
+
+int link_bench(const bench_options &options)
+/**@brief delivery, air time and charge per fix of the link adapter and the fixed profiles
+ *
+ * @param options the command line options, the seed is used for the fading and the backoffs
+ * @return 0 if the adapter delivered nearly as much as the better fixed profile in every run
+ */
+{
+    static const double losses[][2] = {{60, 60}, {80, 80}, {95, 95}, {105, 105}, {110, 110},
+                                       {115, 115}, {120, 120}, {60, 120}};
+    int failed = 0;
+
+    printf("  one fix a second for %d s, %.0f dB fading, air ms and charge mA ms per delivered fix\n",
+           LINK_BENCH_SECONDS, LINK_BENCH_FADING);
+    printf("  %-9s | %-25s | %-25s | %s\n", "path loss", "250k +20dBm: deliv air  mAms",
+           "9.6k +20dBm: deliv air mAms", "adaptive: deliv  air  mAms profile requests silences step s");
+    for (size_t index = 0; index < sizeof(losses) / sizeof(losses[0]); index++)
+    {
+        link_result fixed = run(LINK_POLICY_FIXED, losses[index][0], losses[index][1], options.seed);
+        link_result home = run(LINK_POLICY_HOME, losses[index][0], losses[index][1], options.seed);
+        link_result adapt = run(LINK_POLICY_ADAPT, losses[index][0], losses[index][1], options.seed);
+        if (losses[index][0] == losses[index][1])
+        {
+            printf("  %6.0f dB |", losses[index][0]);
+        }
+        else
+        {
+            printf("  %3.0f-%3.0fdB |", losses[index][0], losses[index][1]);
+        }
+        printf("        ");
+        print_result(fixed);
+        printf(" |        ");
+        print_result(home);
+        printf(" |     ");
+        print_result(adapt);
+        printf(" %7.1f %8u %8u %6.1f\n", adapt.mean_profile, adapt.requests, adapt.silences, adapt.out_of_step);
+        // a fix lost while the adapter finds its way down is allowed for
+        if (adapt.delivered + adapt.offered / 50 < fixed.delivered || adapt.delivered + adapt.offered / 50 < home.delivered)
+        {
+            printf("  FAIL: the adapter delivered %u of %u fixes\n", adapt.delivered, adapt.offered);
+            failed = 1;
+        }
+    }
+    return failed;
+}
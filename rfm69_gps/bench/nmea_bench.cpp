@@ -0,0 +1,221 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  nmea_bench.cpp
+    @author Ralph Blach
+    @brief Throughput of the ingestion, parse and packet stages on the host.
+
+    Each corpus is fed to the Serial1 stand-in 32 bytes at a time, about what arrives between two
+    passes of loop() on the real board.  The stages are first timed one at a time, then the whole
+    firmware loop is timed end to end.  Cycle counts are host cycles, they are for comparing one
+    build with the next, not for predicting the 32u4.
+**/
+#include <Arduino.h>
+#include <RH_RF69.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <rfm_69_functions.h>
+#include <gps_ingest.h>
+#include <position_packet.h>
+#include <report_policy.h>
+#include <tx_queue.h>
+#include <fix_batch.h>
+#include "bench.h"
+#include "nmea_corpus.h"
+
+#define BENCH_CHUNK 32
+#define BENCH_TOKENS 15
+
+extern RH_RF69 rf69;
+extern struct report_policy report_policy;
+extern struct tx_queue transmit_queue;
+extern struct fix_batch fix_batch;
+
+/**
+    @brief per stage totals for one corpus
+*/
+struct stage_totals
+{
+    uint64_t ingest_cycles;
+    uint64_t parse_cycles;
+    uint64_t packet_cycles;
+    uint32_t sentences;
+    uint32_t rmc_sentences;
+    uint32_t packets;
+};
+
+static void run_stages(const nmea_corpus &corpus, stage_totals &totals)
+{
+    /**
+        @brief time each stage on its own
+
+        @param corpus the bytes to replay
+        @param totals where the times are added
+    */
+    std::vector<std::string> rmc;
+    const char call_sign[CALL_SIGN_LENGTH] = {'N', '0', 'C', 'A', 'L', 'L'};
+    char scratch[GPS_RECEIVER_BUFFER_SIZE];
+    char *tokens[BENCH_TOKENS];
+    uint8_t packet[RH_RF69_MAX_MESSAGE_LEN];
+
+    gps_ingest_begin(9600);
+    Serial1.native_clear();
+    for (size_t offset = 0; offset < corpus.bytes.size(); offset += BENCH_CHUNK)
+    {
+        size_t length = corpus.bytes.size() - offset < BENCH_CHUNK ? corpus.bytes.size() - offset : BENCH_CHUNK;
+        struct gps_sentence *ready[GPS_SENTENCE_SLOTS];
+        uint8_t count = 0;
+        Serial1.native_feed((const uint8_t *)corpus.bytes.data() + offset, length);
+        uint64_t start = bench_cycles();
+        gps_ingest_service();
+        while (count < GPS_SENTENCE_SLOTS && (ready[count] = gps_ingest_next()) != NULL)
+        {
+            count++;
+        }
+        totals.ingest_cycles += bench_cycles() - start;
+        for (uint8_t index = 0; index < count; index++)
+        {
+            totals.sentences++;
+            if (strncmp(ready[index]->data + 3, "RMC", 3) == 0)
+            {
+                rmc.push_back(ready[index]->data);
+            }
+            gps_ingest_release(ready[index]);
+        }
+    }
+    totals.rmc_sentences += rmc.size();
+    for (size_t index = 0; index < rmc.size(); index++)
+    {
+        struct position_fix fix;
+        int number_of_tokens;
+        strncpy(scratch, rmc[index].c_str(), sizeof(scratch) - 1);
+        scratch[sizeof(scratch) - 1] = 0;
+        uint64_t start = bench_cycles();
+        number_of_tokens = parse_gps_data(scratch, tokens);
+        uint64_t middle = bench_cycles();
+        if (position_fix_from_rmc(tokens, number_of_tokens, call_sign, &fix) &&
+            position_packet_encode(&fix, packet, sizeof(packet)) != 0)
+        {
+            totals.packets++;
+        }
+        totals.packet_cycles += bench_cycles() - middle;
+        totals.parse_cycles += middle - start;
+    }
+}
+
+static double run_end_to_end(const nmea_corpus &corpus, uint32_t &packets)
+{
+    /**
+        @brief replay the corpus through rfm_69_loop
+
+        @param corpus the bytes to replay
+        @param packets set to the number of radio packets sent
+        @return the wall clock time in seconds
+    */
+    double start;
+    packets = 0;
+    rfm_69_setup();
+    Serial1.native_clear();
+    rf69.native_sent.clear();
+    start = bench_seconds();
+    for (size_t offset = 0; offset < corpus.bytes.size(); offset += BENCH_CHUNK)
+    {
+        size_t length = corpus.bytes.size() - offset < BENCH_CHUNK ? corpus.bytes.size() - offset : BENCH_CHUNK;
+        Serial1.native_feed((const uint8_t *)corpus.bytes.data() + offset, length);
+        for (uint8_t pass = 0; pass < GPS_SENTENCE_SLOTS; pass++)
+        {
+            rfm_69_loop();
+        }
+        if (rf69.native_sent.size() > 1024)
+        {
+            packets += rf69.native_sent.size();
+            rf69.native_sent.clear();
+        }
+    }
+    packets += rf69.native_sent.size();
+    rf69.native_sent.clear();
+    return bench_seconds() - start;
+}
+
+static int bench_corpus(const char *name, const nmea_corpus &corpus, const bench_options &options)
+{
+    stage_totals totals;
+    struct gps_ingest_stats before;
+    struct gps_ingest_stats stats;
+    uint32_t packets;
+    double seconds;
+    double per_second;
+    uint32_t airtime;
+
+    memset(&totals, 0, sizeof(totals));
+    // the ingestion counters run from power up, only report what this corpus added
+    gps_ingest_get_stats(&before);
+    run_stages(corpus, totals);
+    gps_ingest_get_stats(&stats);
+    stats.sentences -= before.sentences;
+    stats.truncated -= before.truncated;
+    stats.dropped_sentences -= before.dropped_sentences;
+    stats.dropped_bytes -= before.dropped_bytes;
+    stats.checksum_errors -= before.checksum_errors;
+    seconds = run_end_to_end(corpus, packets);
+    per_second = seconds > 0 ? totals.sentences / seconds : 0;
+    // rfm_69_setup starts the queue and the batch over, so these are for this corpus alone
+    airtime = tx_queue_airtime(&transmit_queue);
+
+    printf("corpus %s: %zu bytes, %u lines\n", name, corpus.bytes.size(), corpus.lines);
+    if (corpus.kind_count[NMEA_LINE_VALID_RMC] != 0)
+    {
+        printf("  mix: %u valid rmc, %u void rmc, %u other, %u truncated, %u bad checksum, %u garbage\n",
+               corpus.kind_count[NMEA_LINE_VALID_RMC], corpus.kind_count[NMEA_LINE_VOID_RMC],
+               corpus.kind_count[NMEA_LINE_OTHER], corpus.kind_count[NMEA_LINE_TRUNCATED],
+               corpus.kind_count[NMEA_LINE_BAD_CHECKSUM], corpus.kind_count[NMEA_LINE_GARBAGE]);
+    }
+    printf("  ingest: %u sentences, %u checksum errors, %u truncated, %u dropped sentences, %u dropped bytes\n",
+           stats.sentences, stats.checksum_errors, stats.truncated, stats.dropped_sentences, stats.dropped_bytes);
+    printf("  stages: ingest %.0f cycles/sentence, parse %.0f cycles/rmc, packet %.0f cycles/rmc\n",
+           totals.sentences ? (double)totals.ingest_cycles / totals.sentences : 0.0,
+           totals.rmc_sentences ? (double)totals.parse_cycles / totals.rmc_sentences : 0.0,
+           totals.rmc_sentences ? (double)totals.packet_cycles / totals.rmc_sentences : 0.0);
+    printf("  end to end: %u rmc, %u packets, %.0f sentences/s, %.0f bytes/s\n", totals.rmc_sentences, packets,
+           per_second, seconds > 0 ? corpus.bytes.size() / seconds : 0.0);
+    printf("  report policy: %u suppressed, first %u, status %u, heartbeat %u, distance %u, course %u, speed %u, "
+           "burst %u\n",
+           report_policy.suppressed, report_policy.reasons[REPORT_REASON_FIRST],
+           report_policy.reasons[REPORT_REASON_STATUS], report_policy.reasons[REPORT_REASON_HEARTBEAT],
+           report_policy.reasons[REPORT_REASON_DISTANCE], report_policy.reasons[REPORT_REASON_COURSE],
+           report_policy.reasons[REPORT_REASON_SPEED], report_policy.reasons[REPORT_REASON_BURST]);
+    printf("  air: %u ms for %u fixes delivered, %.1f fixes per air second\n", airtime, fix_batch.stats.delivered,
+           airtime ? fix_batch.stats.delivered * 1000.0 / airtime : 0.0);
+    if (options.min_sentences_per_second > 0 && per_second < options.min_sentences_per_second)
+    {
+        printf("  FAIL: %.0f sentences/s is below the %.0f floor\n", per_second, options.min_sentences_per_second);
+        return 1;
+    }
+    return 0;
+}
+
+int nmea_pipeline_bench(const bench_options &options)
+/**@brief the nmea ingestion, parse and packet benchmark
+ *
+ * @param options the command line options
+ * @return 0 if every corpus was above the rate floor
+ */
+{
+    int result = 0;
+    nmea_corpus corpus;
+    nmea_corpus_synthesize(options.sentences, options.seed, corpus);
+    result |= bench_corpus("synthetic", corpus, options);
+    for (size_t index = 0; index < options.files.size(); index++)
+    {
+        if (!nmea_corpus_load(options.files[index], corpus))
+        {
+            printf("cannot read %s\n", options.files[index].c_str());
+            result = 1;
+            continue;
+        }
+        result |= bench_corpus(options.files[index].c_str(), corpus, options);
+    }
+    return result;
+}
@@ -0,0 +1,188 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  nmea_corpus.cpp
+    @author Ralph Blach
+    @brief Recorded and synthetic NMEA corpora for the host benchmarks.
+
+    The synthetic corpus looks like what the MT3333 sends with RMC, GGA and GSA enabled, a GSV
+    now and then, and a sprinkling of void fixes, cut off lines, bad checksums and line noise.
+**/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include "nmea_corpus.h"
+
+std::string nmea_with_checksum(const std::string &body)
+{
+    /**
+        @brief wrap a sentence body in $ and *hh
+
+        @param body the text between the $ and the *
+        @return the full sentence without the CR LF
+    */
+    char trailer[4];
+    uint8_t checksum = 0;
+    for (size_t index = 0; index < body.size(); index++)
+    {
+        checksum ^= (uint8_t)body[index];
+    }
+    snprintf(trailer, sizeof(trailer), "*%02X", checksum);
+    return "$" + body + trailer;
+}
+
+bool nmea_corpus_load(const std::string &path, nmea_corpus &corpus)
+/**@brief read a recorded capture, the file is replayed byte for byte
+ *
+ * @param path the capture file
+ * @param corpus where the bytes are placed
+ * @return false if the file could not be read
+ */
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    corpus.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    corpus.lines = 0;
+    memset(corpus.kind_count, 0, sizeof(corpus.kind_count));
+    for (size_t index = 0; index < corpus.bytes.size(); index++)
+    {
+        if (corpus.bytes[index] == '\n')
+        {
+            corpus.lines++;
+        }
+    }
+    return true;
+}
+
+static std::string coordinate(double value, bool latitude)
+{
+    char text[24];
+    char hemisphere = latitude ? (value < 0 ? 'S' : 'N') : (value < 0 ? 'W' : 'E');
+    double magnitude = fabs(value);
+    int degrees = (int)magnitude;
+    double minutes = (magnitude - degrees) * 60.0;
+    snprintf(text, sizeof(text), latitude ? "%02d%07.4f,%c" : "%03d%07.4f,%c", degrees, minutes, hemisphere);
+    return text;
+}
+
+void nmea_corpus_synthesize(uint32_t sentences, uint32_t seed, nmea_corpus &corpus)
+/**@brief build a synthetic capture of a moving receiver
+ *
+ * @param sentences the number of lines to generate
+ * @param seed seed for the random choices, the same seed gives the same corpus
+ * @param corpus where the bytes are placed
+ */
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    double latitude = 35.7796;
+    double longitude = -78.6382;
+    double course = 45.0;
+    double speed = 0.0;
+    uint32_t time_of_day = 14 * 3600;
+    uint32_t epoch_line = 0;
+    char text[128];
+
+    corpus.bytes.clear();
+    corpus.bytes.reserve((size_t)sentences * 72);
+    corpus.lines = 0;
+    memset(corpus.kind_count, 0, sizeof(corpus.kind_count));
+    while (corpus.lines < sentences)
+    {
+        std::string line;
+        nmea_line_kind kind = NMEA_LINE_OTHER;
+        char time_text[16];
+        double roll = unit(generator);
+        bool void_fix = unit(generator) < 0.1;
+        snprintf(time_text, sizeof(time_text), "%02u%02u%02u.000", time_of_day / 3600 % 24, time_of_day / 60 % 60,
+                 time_of_day % 60);
+        if (roll < 0.02)
+        {
+            // a line the uart lost the end of
+            snprintf(text, sizeof(text), "GPRMC,%s,A,%s", time_text, coordinate(latitude, true).c_str());
+            line = nmea_with_checksum(text).substr(0, 24);
+            kind = NMEA_LINE_TRUNCATED;
+        }
+        else if (roll < 0.03)
+        {
+            snprintf(text, sizeof(text), "GPRMC,%s,A,%s,%s,%.2f,%.2f,170823,,,A", time_text,
+                     coordinate(latitude, true).c_str(), coordinate(longitude, false).c_str(), speed, course);
+            line = nmea_with_checksum(text);
+            line[line.size() - 1] = line[line.size() - 1] == '0' ? '1' : '0';
+            kind = NMEA_LINE_BAD_CHECKSUM;
+        }
+        else if (roll < 0.04)
+        {
+            size_t length = 5 + generator() % 60;
+            for (size_t index = 0; index < length; index++)
+            {
+                char value = (char)(generator() & 0xff);
+                line += (value == '\n' || value == '\r') ? '#' : value;
+            }
+            kind = NMEA_LINE_GARBAGE;
+        }
+        else
+        {
+            switch (epoch_line++ % 4)
+            {
+            case 0:
+                if (void_fix)
+                {
+                    snprintf(text, sizeof(text), "GPGGA,%s,,,,,0,00,,,M,,M,,", time_text);
+                }
+                else
+                {
+                    snprintf(text, sizeof(text), "GPGGA,%s,%s,%s,1,%02u,%.2f,%.1f,M,-33.7,M,,", time_text,
+                             coordinate(latitude, true).c_str(), coordinate(longitude, false).c_str(),
+                             (unsigned)(5 + generator() % 8), 0.8 + unit(generator), 90.0 + 10 * unit(generator));
+                }
+                break;
+            case 1:
+                snprintf(text, sizeof(text), "GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79");
+                break;
+            case 2:
+                if (generator() % 4 == 0)
+                {
+                    snprintf(text, sizeof(text), "GPGSV,3,1,10,10,63,137,17,13,25,300,29,15,76,013,33,18,48,059,26");
+                    break;
+                }
+                epoch_line++;
+                // no GSV this epoch
+                [[fallthrough]];
+            default:
+                if (void_fix)
+                {
+                    snprintf(text, sizeof(text), "GPRMC,%s,V,,,,,,,170823,,,N", time_text);
+                    kind = NMEA_LINE_VOID_RMC;
+                }
+                else
+                {
+                    snprintf(text, sizeof(text), "GPRMC,%s,A,%s,%s,%.2f,%.2f,170823,,,A", time_text,
+                             coordinate(latitude, true).c_str(), coordinate(longitude, false).c_str(), speed,
+                             course);
+                    kind = NMEA_LINE_VALID_RMC;
+                }
+                // move on to the next second
+                speed = speed + (unit(generator) - 0.5) * 2.0;
+                speed = speed < 0 ? 0 : (speed > 60 ? 60 : speed);
+                course = fmod(course + (unit(generator) - 0.5) * 20.0 + 360.0, 360.0);
+                latitude += speed * 0.5144 / 111320.0 * cos(course * M_PI / 180.0);
+                longitude += speed * 0.5144 / (111320.0 * cos(latitude * M_PI / 180.0)) * sin(course * M_PI / 180.0);
+                time_of_day++;
+                break;
+            }
+            line = nmea_with_checksum(text);
+        }
+        corpus.bytes += line;
+        corpus.bytes += "\r\n";
+        corpus.kind_count[kind]++;
+        corpus.lines++;
+    }
+}
@@ -0,0 +1,42 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file nmea_corpus.h
+    @brief Load recorded NMEA captures and build large synthetic ones for the benchmarks.
+**/
+#ifndef nmea_corpus_h
+#define nmea_corpus_h
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+    @brief the kinds of line the synthetic generator produces
+*/
+enum nmea_line_kind
+{
+    NMEA_LINE_VALID_RMC = 0,
+    NMEA_LINE_VOID_RMC,
+    NMEA_LINE_OTHER,
+    NMEA_LINE_TRUNCATED,
+    NMEA_LINE_BAD_CHECKSUM,
+    NMEA_LINE_GARBAGE,
+    NMEA_LINE_KINDS
+};
+
+/**
+    @brief a corpus is the raw byte stream exactly as the uart would deliver it
+*/
+struct nmea_corpus
+{
+    std::string bytes;
+    uint32_t lines;
+    uint32_t kind_count[NMEA_LINE_KINDS]; /*!< only filled in for synthetic corpora */
+};
+
+extern bool nmea_corpus_load(const std::string &path, nmea_corpus &corpus);
+extern void nmea_corpus_synthesize(uint32_t sentences, uint32_t seed, nmea_corpus &corpus);
+extern std::string nmea_with_checksum(const std::string &body);
+
+#endif
@@ -0,0 +1,285 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  sim_channel.cpp
+    @author Ralph Blach
+    @brief Air time, collisions and the acking base station of the simulated channel.
+**/
+#include <math.h>
+#include <Arduino.h>
+#include <RadioHead.h>
+#include "sim_channel.h"
+
+sim_radio::sim_radio(sim_channel &channel, uint8_t address)
+    : address(address), busy_until(0), modem(0), bit_rate(0), power(20), sensitivity(-127), current(130),
+      path_loss(0), tx_micros(0), tx_charge(0), channel(channel)
+{
+    _thisAddress = address;
+    _mode = RHModeIdle;
+    channel.attach(this);
+}
+
+RHGenericDriver::RHMode sim_radio::mode(void)
+{
+    if (_mode == RHModeTx && native_micros64() >= busy_until)
+    {
+        _mode = RHModeIdle;
+    }
+    return _mode;
+}
+
+bool sim_radio::available(void)
+{
+    if (mode() == RHModeTx || _mode == RHModeSleep || inbox.empty())
+    {
+        return false;
+    }
+    _mode = RHModeRx;
+    return true;
+}
+
+bool sim_radio::recv(uint8_t *buf, uint8_t *len)
+{
+    if (!available())
+    {
+        return false;
+    }
+    sim_transmission &frame = inbox.front();
+    uint8_t length = frame.payload.size() < *len ? (uint8_t)frame.payload.size() : *len;
+    memcpy(buf, frame.payload.data(), length);
+    *len = length;
+    _rxHeaderTo = frame.to;
+    _rxHeaderFrom = frame.from;
+    _rxHeaderId = frame.id;
+    _rxHeaderFlags = frame.flags;
+    _lastRssi = (int16_t)lround(frame.rssi);
+    inbox.pop_front();
+    _rxGood++;
+    return true;
+}
+
+bool sim_radio::send(const uint8_t *data, uint8_t len)
+{
+    sim_transmission frame;
+    if (len > maxMessageLength() || mode() == RHModeTx)
+    {
+        return false;
+    }
+    frame.from = _txHeaderFrom;
+    frame.to = _txHeaderTo;
+    frame.id = _txHeaderId;
+    frame.flags = _txHeaderFlags;
+    frame.payload.assign(data, data + len);
+    frame.modem = modem;
+    frame.bit_rate = bit_rate;
+    frame.sensitivity = sensitivity;
+    frame.rssi = power - path_loss;
+    busy_until = channel.transmit(frame);
+    tx_micros += busy_until - native_micros64();
+    tx_charge += (busy_until - native_micros64()) / 1000.0 * current;
+    _mode = RHModeTx;
+    _txGood++;
+    return true;
+}
+
+uint8_t sim_radio::maxMessageLength(void)
+{
+    return 60;
+}
+
+bool sim_radio::sleep(void)
+{
+    // a frame still going out finishes first, like the real radio
+    if (mode() != RHModeTx)
+    {
+        _mode = RHModeSleep;
+    }
+    return true;
+}
+
+sim_channel::sim_channel(uint32_t bit_rate, uint8_t base_address, uint32_t turnaround)
+    : bit_rate(bit_rate), base_address(base_address), turnaround(turnaround), base_power(20), fading(0), loss(0),
+      last_step(native_micros64())
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void sim_channel::attach(sim_radio *radio)
+{
+    radios.push_back(radio);
+}
+
+uint64_t sim_channel::airtime(uint8_t length, uint32_t rate) const
+{
+    if (rate == 0)
+    {
+        rate = bit_rate;
+    }
+    return ((uint64_t)(SIM_FRAME_OVERHEAD + length) * 8 * 1000000 + rate - 1) / rate;
+}
+
+sim_radio *sim_channel::radio_at(uint8_t address)
+{
+    for (sim_radio *radio : radios)
+    {
+        if (radio->address == address)
+        {
+            return radio;
+        }
+    }
+    return NULL;
+}
+
+bool sim_channel::heard(const sim_transmission &frame, uint8_t modem, int16_t sensitivity)
+{
+    if (loss > 0 && std::uniform_real_distribution<double>(0, 1)(noise) < loss)
+    {
+        return false;
+    }
+    return frame.modem == modem && frame.rssi >= sensitivity;
+}
+
+uint64_t sim_channel::transmit(const sim_transmission &transmission)
+/**@brief put a frame on the air now
+ *
+ * @param transmission the frame, its times are filled in here
+ * @return micros when it is out
+ */
+{
+    sim_transmission frame = transmission;
+    frame.start = native_micros64();
+    frame.end = frame.start + airtime((uint8_t)frame.payload.size(), frame.bit_rate);
+    frame.collided = false;
+    if (fading > 0)
+    {
+        frame.rssi += std::normal_distribution<double>(0, fading)(noise);
+    }
+    for (sim_transmission &other : air)
+    {
+        if (other.end > frame.start)
+        {
+            other.collided = true;
+            frame.collided = true;
+        }
+    }
+    if (frame.flags & RH_FLAGS_ACK)
+    {
+        stats.acks++;
+    }
+    else
+    {
+        stats.frames++;
+    }
+    air.push_back(frame);
+    return frame.end;
+}
+
+void sim_channel::step(void)
+/**@brief hand out the frames that are finished, and start the acks that are due
+ *
+ * @return Nothing
+ */
+{
+    uint64_t now = native_micros64();
+    uint64_t busy_from = last_step;
+    size_t index;
+
+    for (index = 0; index < pending.size();)
+    {
+        if (pending[index].start <= now)
+        {
+            transmit(pending[index]);
+            pending.erase(pending.begin() + index);
+            continue;
+        }
+        index++;
+    }
+    // the time with something on the air since the last step
+    for (const sim_transmission &frame : air)
+    {
+        uint64_t from = frame.start > busy_from ? frame.start : busy_from;
+        uint64_t to = frame.end < now ? frame.end : now;
+        if (to > from)
+        {
+            stats.busy += to - from;
+            busy_from = to;
+        }
+    }
+    last_step = now;
+    for (index = 0; index < air.size();)
+    {
+        sim_transmission &frame = air[index];
+        if (frame.end > now)
+        {
+            index++;
+            continue;
+        }
+        if (frame.collided)
+        {
+            if (frame.flags & RH_FLAGS_ACK)
+            {
+                stats.acks_collided++;
+            }
+            else
+            {
+                stats.collided++;
+            }
+        }
+        else if (frame.to == base_address && !(frame.flags & RH_FLAGS_ACK))
+        {
+            sim_transmission ack = {};
+            std::map<uint8_t, sim_base_link>::const_iterator link = base_links.find(frame.from);
+            sim_radio *radio = radio_at(frame.from);
+            // the ack goes out the way the base station was listening, a change asked for in
+            // this frame only starts after it
+            if (link != base_links.end())
+            {
+                ack.modem = link->second.modem;
+                ack.bit_rate = link->second.bit_rate;
+                ack.sensitivity = link->second.sensitivity;
+            }
+            else
+            {
+                ack.modem = frame.modem;
+                ack.bit_rate = frame.bit_rate;
+                ack.sensitivity = frame.sensitivity;
+            }
+            if (!heard(frame, ack.modem, ack.sensitivity))
+            {
+                stats.lost++;
+            }
+            else
+            {
+                if (on_delivery)
+                {
+                    on_delivery(frame);
+                }
+                ack.start = frame.end + turnaround;
+                ack.from = base_address;
+                ack.to = frame.from;
+                ack.id = frame.id;
+                ack.flags = RH_FLAGS_ACK;
+                ack.payload.push_back('!');
+                ack.rssi = base_power - (radio != NULL ? radio->path_loss : 0);
+                pending.push_back(ack);
+            }
+        }
+        else
+        {
+            sim_radio *radio = radio_at(frame.to);
+            if (radio != NULL && radio->mode() != RHGenericDriver::RHModeSleep)
+            {
+                if (heard(frame, radio->modem, radio->sensitivity))
+                {
+                    radio->inbox.push_back(frame);
+                }
+                else if (frame.flags & RH_FLAGS_ACK)
+                {
+                    stats.acks_lost++;
+                }
+            }
+        }
+        air.erase(air.begin() + index);
+    }
+}
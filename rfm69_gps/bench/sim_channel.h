@@ -0,0 +1,146 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file sim_channel.h
+    @brief A shared radio channel for several simulated trackers and one base station.
+
+    The RH_RF69 stand-in sends a frame the moment it is asked and has nobody else on the air.
+    sim_radio is a RadioHead driver for one tracker on a sim_channel instead.  Every frame has
+    the air time of its bytes at the bit rate of its sender, and two frames that are on the air
+    at the same time are both lost.  The base station acks every data frame it gets whole,
+    after a turnaround, and its acks can collide too.
+
+    Each tracker has a path loss to the base station, the same both ways, and the channel adds
+    a normal fading of fading dB to every frame, and loses one in loss of them outright.  A frame is only heard if it arrives over
+    the receiver's sensitivity, on the modem setting the receiver is listening with.  The
+    base station listens to each tracker with its base_links entry, or to anything if it
+    has none.
+
+    Time is the virtual clock of the native build, the harness moves it with
+    native_advance_micros and calls sim_channel::step after each move.
+**/
+#ifndef sim_channel_h
+#define sim_channel_h
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+#include <vector>
+#include <RHGenericDriver.h>
+
+/**
+    @brief bytes on the air around each payload, the same as TX_QUEUE_FRAME_OVERHEAD
+*/
+#define SIM_FRAME_OVERHEAD 13
+
+/**
+    @brief one frame on the air
+*/
+struct sim_transmission
+{
+    uint64_t start;               /*!< micros when the first bit went out */
+    uint64_t end;                 /*!< micros when the last bit went out */
+    uint8_t from;
+    uint8_t to;
+    uint8_t id;
+    uint8_t flags;
+    std::vector<uint8_t> payload;
+    bool collided;                /*!< another frame was on the air with it */
+    uint8_t modem;                /*!< the modem setting it was sent with */
+    uint32_t bit_rate;            /*!< bits a second, 0 is the channel bit rate */
+    int16_t sensitivity;          /*!< dBm it has to arrive with, for its bit rate */
+    double rssi;                  /*!< dBm it arrives with, the fading is added when it is sent */
+};
+
+/**
+    @brief how the base station listens to one tracker
+*/
+struct sim_base_link
+{
+    uint8_t modem;
+    uint32_t bit_rate;
+    int16_t sensitivity;
+};
+
+/**
+    @brief what the channel has carried
+*/
+struct sim_channel_stats
+{
+    uint32_t frames;       /*!< data frames put on the air */
+    uint32_t collided;     /*!< of them, lost to another frame */
+    uint32_t acks;         /*!< acks the base station sent */
+    uint32_t acks_collided; /*!< of them, lost to another frame */
+    uint32_t lost;         /*!< data frames that were too weak, on another modem setting or lost */
+    uint32_t acks_lost;    /*!< acks that were too weak, on another modem setting or lost */
+    uint64_t busy;         /*!< micros with at least one frame on the air */
+};
+
+class sim_channel;
+
+/**
+    @brief the radio of one tracker on the channel
+*/
+class sim_radio : public RHGenericDriver
+{
+public:
+    sim_radio(sim_channel &channel, uint8_t address);
+    virtual bool available(void);
+    virtual bool recv(uint8_t *buf, uint8_t *len);
+    virtual bool send(const uint8_t *data, uint8_t len);
+    virtual uint8_t maxMessageLength(void);
+    virtual RHMode mode(void);
+    virtual bool sleep(void);
+
+    uint8_t address;                    /*!< the node address */
+    uint64_t busy_until;                /*!< micros when the frame being sent is out */
+    uint8_t modem;                      /*!< the modem setting, only frames sent with it are heard */
+    uint32_t bit_rate;                  /*!< bits a second, 0 is the channel bit rate */
+    int8_t power;                       /*!< dBm */
+    int16_t sensitivity;                /*!< dBm a frame has to arrive with at this bit rate */
+    uint8_t current;                    /*!< mA while sending */
+    double path_loss;                   /*!< dB to the base station */
+    uint64_t tx_micros;                 /*!< time spent sending */
+    double tx_charge;                   /*!< mA ms spent sending */
+    std::deque<sim_transmission> inbox; /*!< frames received whole */
+
+private:
+    sim_channel &channel;
+};
+
+/**
+    @brief the air, and the base station listening on it
+*/
+class sim_channel
+{
+public:
+    sim_channel(uint32_t bit_rate, uint8_t base_address, uint32_t turnaround);
+    void attach(sim_radio *radio);
+    uint64_t transmit(const sim_transmission &transmission);
+    void step(void);
+    uint64_t airtime(uint8_t length, uint32_t rate = 0) const;
+
+    uint32_t bit_rate;        /*!< bits a second */
+    uint8_t base_address;     /*!< the base station, it acks every frame for it */
+    uint32_t turnaround;      /*!< micros from the end of a frame to the start of its ack */
+    int8_t base_power;        /*!< dBm of the acks */
+    double fading;            /*!< dB, the standard deviation of the fading of each frame */
+    double loss;              /*!< the chance a frame is lost whatever its strength, 0 to 1 */
+    std::mt19937 noise;       /*!< for the fading */
+    std::map<uint8_t, sim_base_link> base_links; /*!< how the base station listens to each tracker */
+    struct sim_channel_stats stats;
+    /** called for every frame the base station gets whole, retries included */
+    std::function<void(const sim_transmission &)> on_delivery;
+
+private:
+    std::vector<sim_radio *> radios;
+    std::vector<sim_transmission> air;     /*!< frames on the air or not looked at yet */
+    std::vector<sim_transmission> pending; /*!< acks waiting for the turnaround */
+    uint64_t last_step;
+    bool heard(const sim_transmission &frame, uint8_t modem, int16_t sensitivity);
+    sim_radio *radio_at(uint8_t address);
+};
+
+#endif
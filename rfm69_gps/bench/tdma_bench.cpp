@@ -0,0 +1,248 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  tdma_bench.cpp
+    @author Ralph Blach
+    @brief Goodput of several trackers on one channel, sending at will against sending in slots.
+
+    Each tracker gets a fix a second, its RMC line feed comes TDMA_GPS_DELAY ms after the utc
+    second give or take a few ms of its own and a ms of jitter, and it queues a 25 byte
+    position packet then.  Without slots every tracker sends as soon as its packet is queued,
+    so they all send within a few ms of each other and the retries are what spreads them out.
+    With slots each one takes the utc time of its fix into a slot_scheduler, the tx_queue gate,
+    and sends in its own slot of TDMA_SLOTS.  Every tracker runs the real tx_queue, with its
+    default retries, on a sim_radio.  The local clocks are all the one virtual clock, so the
+    rate tracking of the scheduler is not exercised here.
+
+    All the trackers of that table draw their backoffs from one random().  A second table runs
+    identical trackers at will, each with its own random() and the same gps delay: unseeded,
+    every one starts random() from the same state, and seeded, each starts from its address
+    mixed with noise the way seed_random in rfm69_gps.cpp does at boot.
+**/
+#include <stdio.h>
+#include <memory>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include <tx_queue.h>
+#include <slot_scheduler.h>
+#include "bench.h"
+#include "sim_channel.h"
+
+/**
+    @brief the simulated network
+*/
+#define TDMA_SLOTS 32          /*!< slots in a second */
+#define TDMA_SECONDS 60        /*!< seconds of fixes */
+#define TDMA_DRAIN 5           /*!< seconds after the last fix for the retries to finish */
+#define TDMA_STEP 100          /*!< us the clock moves between passes of the loops */
+#define TDMA_GPS_DELAY 80      /*!< ms from the utc second to the line feed of the RMC */
+#define TDMA_GPS_SPREAD 2000   /*!< us each tracker's delay is off by at most, it is fixed per tracker */
+#define TDMA_GPS_JITTER 1000   /*!< us the delay moves by from fix to fix */
+#define TDMA_TURNAROUND 1000   /*!< us the base station takes to ack */
+#define TDMA_PACKET_LENGTH 25  /*!< a version 1 position packet */
+#define TDMA_BASE_ADDRESS 1
+
+/**
+    @brief where the backoffs of the trackers are drawn from
+*/
+enum tdma_random
+{
+    TDMA_RANDOM_SHARED,   /*!< one random() for all of them */
+    TDMA_RANDOM_UNSEEDED, /*!< one each, never seeded, so they all start from 1 */
+    TDMA_RANDOM_SEEDED,   /*!< one each, seeded from the address and noise */
+};
+
+/**
+    @brief one tracker
+*/
+struct tdma_node
+{
+    tdma_node(sim_channel &channel, uint8_t address) : radio(channel, address) {}
+    sim_radio radio;
+    struct tx_queue queue;
+    struct slot_scheduler scheduler;
+    int32_t gps_offset;    /*!< us this tracker's line feed is off the network's delay */
+    uint64_t next_fix;     /*!< micros of its next line feed */
+    uint32_t second;       /*!< the utc second of that fix */
+    unsigned long random_state; /*!< its own random(), unless they share one */
+};
+
+/**
+    @brief what one run delivered
+*/
+struct tdma_result
+{
+    uint32_t offered;   /*!< fixes queued */
+    uint32_t delivered; /*!< of them, received at the base station, once each */
+    uint32_t frames;    /*!< data frames on the air */
+    uint32_t collided;  /*!< of them, lost */
+    uint32_t retries;   /*!< resends of all the queues */
+    double latency;     /*!< mean ms from the line feed to the first whole reception */
+    double busy;        /*!< part of the time the channel was in use */
+};
+
+static tdma_result run(uint8_t nodes, uint32_t bit_rate, bool slotted, uint32_t seed,
+                       uint8_t random_source = TDMA_RANDOM_SHARED)
+{
+    /**
+        @brief simulate nodes trackers for TDMA_SECONDS and let their queues drain, identical
+        trackers of their own random() have the same gps delay as well
+    */
+    sim_channel channel(bit_rate, TDMA_BASE_ADDRESS, TDMA_TURNAROUND);
+    std::vector<std::unique_ptr<tdma_node>> network;
+    std::vector<std::vector<uint64_t>> fixed_at(nodes, std::vector<uint64_t>(TDMA_SECONDS, 0));
+    std::vector<std::vector<bool>> received(nodes, std::vector<bool>(TDMA_SECONDS, false));
+    std::mt19937 random_numbers(seed + nodes);
+    std::uniform_int_distribution<int32_t> spread(-TDMA_GPS_SPREAD, TDMA_GPS_SPREAD);
+    std::uniform_int_distribution<int32_t> jitter(-TDMA_GPS_JITTER, TDMA_GPS_JITTER);
+    tdma_result result = {};
+    double latency_total = 0;
+    uint64_t start;
+    uint64_t end;
+    uint8_t packet[TDMA_PACKET_LENGTH] = {0};
+
+    native_set_micros(1000000);
+    randomSeed(seed + nodes);
+    start = native_micros64();
+    channel.on_delivery = [&](const sim_transmission &frame) {
+        uint8_t node = frame.payload[0];
+        uint32_t second = frame.payload[1] | (uint32_t)frame.payload[2] << 8;
+        if (node < nodes && second < TDMA_SECONDS && !received[node][second])
+        {
+            received[node][second] = true;
+            result.delivered++;
+            latency_total += (frame.end - fixed_at[node][second]) / 1000.0;
+        }
+    };
+    for (uint8_t index = 0; index < nodes; index++)
+    {
+        network.emplace_back(new tdma_node(channel, TDMA_BASE_ADDRESS + 1 + index));
+        tdma_node &node = *network.back();
+        tx_queue_init(&node.queue, &node.radio, TDMA_BASE_ADDRESS + 1 + index);
+        node.queue.bit_rate = bit_rate;
+        slot_scheduler_init(&node.scheduler, index, TDMA_SLOTS);
+        if (slotted)
+        {
+            node.queue.gate = slot_scheduler_gate;
+            node.queue.gate_context = &node.scheduler;
+        }
+        node.gps_offset = random_source == TDMA_RANDOM_SHARED ? spread(random_numbers) : 0;
+        node.random_state = 1;
+        if (random_source == TDMA_RANDOM_SEEDED)
+        {
+            // the rssi and micros() samples of seed_random are noise, the address is the address
+            uint32_t noise = random_numbers();
+            node.random_state = ((uint32_t)(TDMA_BASE_ADDRESS + 1 + index) << 5) ^ noise;
+        }
+        node.second = 0;
+        node.next_fix = start + TDMA_GPS_DELAY * 1000 + node.gps_offset + jitter(random_numbers);
+    }
+    end = start + (uint64_t)(TDMA_SECONDS + TDMA_DRAIN) * 1000000;
+    while (native_micros64() < end)
+    {
+        native_advance_micros(TDMA_STEP);
+        channel.step();
+        for (uint8_t index = 0; index < nodes; index++)
+        {
+            tdma_node &node = *network[index];
+            if (node.second < TDMA_SECONDS && native_micros64() >= node.next_fix)
+            {
+                // 12:00:00 utc and on, in the 10 ms ticks of a position_fix
+                slot_scheduler_sync(&node.scheduler, (43200 + node.second) * 100, micros());
+                packet[0] = index;
+                packet[1] = (uint8_t)node.second;
+                packet[2] = (uint8_t)(node.second >> 8);
+                fixed_at[index][node.second] = native_micros64();
+                if (tx_queue_push(&node.queue, packet, sizeof(packet), TDMA_BASE_ADDRESS))
+                {
+                    result.offered++;
+                }
+                node.second++;
+                node.next_fix = start + (uint64_t)node.second * 1000000 + TDMA_GPS_DELAY * 1000 + node.gps_offset +
+                                jitter(random_numbers);
+            }
+            if (random_source != TDMA_RANDOM_SHARED)
+            {
+                native_set_random_state(node.random_state);
+                tx_queue_service(&node.queue);
+                node.random_state = native_random_state();
+            }
+            else
+            {
+                tx_queue_service(&node.queue);
+            }
+        }
+    }
+    for (const std::unique_ptr<tdma_node> &node : network)
+    {
+        result.retries += node->queue.stats.retries;
+    }
+    result.frames = channel.stats.frames;
+    result.collided = channel.stats.collided;
+    result.latency = result.delivered ? latency_total / result.delivered : 0;
+    result.busy = (double)channel.stats.busy / (end - start);
+    return result;
+}
+
+static void print_result(const tdma_result &result)
+{
+    printf(" %6.2f %6.1f%% %5u %5u %7.1f %5.1f%%", (double)result.delivered / TDMA_SECONDS,
+           result.offered ? 100.0 * result.delivered / result.offered : 0.0,
+           result.collided, result.retries, result.latency, 100 * result.busy);
+}
+
+int tdma_bench(const bench_options &options)
+/**@brief delivered fixes a second for 1 to TDMA_SLOTS trackers, with and without slots
+ *
+ * @param options the command line options, the seed is used for the gps delays and the backoffs
+ * @return 0 if the slotted runs delivered every fix without a collision
+ */
+{
+    static const uint32_t bit_rates[] = {250000, 38400};
+    static const uint8_t node_counts[] = {1, 2, 4, 8, 16, 24, 32};
+    static const uint8_t identical_counts[] = {2, 4, 8};
+    int failed = 0;
+
+    printf("  %d slots of %d ms, fixes %d ms after the second +-%d.%d ms, %d s\n", TDMA_SLOTS,
+           SLOT_FRAME_LENGTH / TDMA_SLOTS, TDMA_GPS_DELAY, (TDMA_GPS_SPREAD + TDMA_GPS_JITTER) / 1000,
+           (TDMA_GPS_SPREAD + TDMA_GPS_JITTER) % 1000 / 100, TDMA_SECONDS);
+    printf("  %6s %5s | %-46s | %-46s\n", "bps", "nodes", "at will: fix/s  deliv  coll retry  lat ms   busy",
+           "slotted: fix/s  deliv  coll retry  lat ms   busy");
+    for (size_t rate = 0; rate < sizeof(bit_rates) / sizeof(bit_rates[0]); rate++)
+    {
+        for (size_t count = 0; count < sizeof(node_counts) / sizeof(node_counts[0]); count++)
+        {
+            tdma_result aloha = run(node_counts[count], bit_rates[rate], false, options.seed);
+            tdma_result slotted = run(node_counts[count], bit_rates[rate], true, options.seed);
+            printf("  %6u %5u |        ", bit_rates[rate], node_counts[count]);
+            print_result(aloha);
+            printf(" |        ");
+            print_result(slotted);
+            printf("\n");
+            if (slotted.collided != 0 || slotted.delivered != slotted.offered)
+            {
+                printf("  FAIL: %u slotted trackers at %u bps lost frames\n", node_counts[count], bit_rates[rate]);
+                failed = 1;
+            }
+        }
+    }
+    printf("  identical trackers at will, each with its own random()\n");
+    printf("  %6s %5s | %-46s | %-46s\n", "bps", "nodes", "unseeded: fix/s  deliv  coll retry  lat ms   busy",
+           "seeded:   fix/s  deliv  coll retry  lat ms   busy");
+    for (size_t rate = 0; rate < sizeof(bit_rates) / sizeof(bit_rates[0]); rate++)
+    {
+        for (size_t count = 0; count < sizeof(identical_counts) / sizeof(identical_counts[0]); count++)
+        {
+            tdma_result unseeded = run(identical_counts[count], bit_rates[rate], false, options.seed, TDMA_RANDOM_UNSEEDED);
+            tdma_result seeded = run(identical_counts[count], bit_rates[rate], false, options.seed, TDMA_RANDOM_SEEDED);
+            printf("  %6u %5u |        ", bit_rates[rate], identical_counts[count]);
+            print_result(unseeded);
+            printf(" |        ");
+            print_result(seeded);
+            printf("\n");
+        }
+    }
+    return failed;
+}
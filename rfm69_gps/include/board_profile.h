@@ -0,0 +1,121 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file board_profile.h
+    @brief The radio and led pins of each supported board.
+
+    Each board is a specialization of board_profile, and every specialization must have the same
+    four members, board_profile_check makes sure of it.  A misspelled or missing pin is a compile
+    error instead of a pin that quietly becomes 0.  The board being built for is picked once,
+    at the bottom, and is called board.
+**/
+#ifndef board_profile_h
+#define board_profile_h
+#include <stdint.h>
+
+/**
+    @brief the boards the tracker runs on
+*/
+enum class board_id : uint8_t
+{
+    feather_32u4, /*!< Feather 32u4 with the radio on board */
+    feather_m0,   /*!< Feather M0 with the radio on board */
+    feather_328p, /*!< Feather 328P with a radio wing */
+    esp8266,      /*!< ESP8266 feather with a radio wing */
+    esp32,        /*!< ESP32 feather with a radio wing */
+    native        /*!< the linux host build, see native/include */
+};
+
+/**
+    @brief the pins of a board, only the specializations below exist
+*/
+template <board_id Board> struct board_profile;
+
+template <> struct board_profile<board_id::feather_32u4>
+{
+    static constexpr uint8_t rfm69_cs = 8;
+    static constexpr uint8_t rfm69_int = 7;
+    static constexpr uint8_t rfm69_rst = 4;
+    static constexpr uint8_t led = 13;
+};
+
+template <> struct board_profile<board_id::feather_m0>
+{
+    static constexpr uint8_t rfm69_cs = 8;
+    static constexpr uint8_t rfm69_int = 3;
+    static constexpr uint8_t rfm69_rst = 4;
+    static constexpr uint8_t led = 13;
+};
+
+template <> struct board_profile<board_id::feather_328p>
+{
+    static constexpr uint8_t rfm69_cs = 4;
+    static constexpr uint8_t rfm69_int = 3;
+    static constexpr uint8_t rfm69_rst = 2; // "A"
+    static constexpr uint8_t led = 13;
+};
+
+template <> struct board_profile<board_id::esp8266>
+{
+    static constexpr uint8_t rfm69_cs = 2;   // "E"
+    static constexpr uint8_t rfm69_int = 15; // "B", this was RFM69_IRQ and never reached the driver
+    static constexpr uint8_t rfm69_rst = 16; // "D"
+    static constexpr uint8_t led = 0;
+};
+
+template <> struct board_profile<board_id::esp32>
+{
+    static constexpr uint8_t rfm69_cs = 33;  // "B"
+    static constexpr uint8_t rfm69_int = 27; // "A"
+    static constexpr uint8_t rfm69_rst = 13; // same as LED
+    static constexpr uint8_t led = 13;
+};
+
+template <> struct board_profile<board_id::native>
+{
+    static constexpr uint8_t rfm69_cs = 8;
+    static constexpr uint8_t rfm69_int = 7;
+    static constexpr uint8_t rfm69_rst = 4;
+    static constexpr uint8_t led = 13;
+};
+
+/**
+    @brief check a profile, it fails to compile if a pin is missing or has the wrong type
+*/
+template <typename Profile> constexpr bool board_profile_check()
+{
+    const uint8_t *pins[] = {&Profile::rfm69_cs, &Profile::rfm69_int, &Profile::rfm69_rst, &Profile::led};
+    (void)pins;
+    // the radio needs its own chip select, interrupt and reset, the led may share the reset
+    return Profile::rfm69_cs != Profile::rfm69_int && Profile::rfm69_cs != Profile::rfm69_rst &&
+           Profile::rfm69_int != Profile::rfm69_rst && Profile::rfm69_cs != Profile::led &&
+           Profile::rfm69_int != Profile::led;
+}
+
+#if defined(NATIVE_BUILD)
+constexpr board_id this_board = board_id::native;
+#elif defined(__AVR_ATmega32U4__)
+constexpr board_id this_board = board_id::feather_32u4;
+#elif defined(ADAFRUIT_FEATHER_M0)
+constexpr board_id this_board = board_id::feather_m0;
+#elif defined(__AVR_ATmega328P__)
+constexpr board_id this_board = board_id::feather_328p;
+#elif defined(ESP8266)
+constexpr board_id this_board = board_id::esp8266;
+#elif defined(ESP32)
+constexpr board_id this_board = board_id::esp32;
+#else
+#error "no board profile for this board, add one to board_profile.h"
+#endif
+
+typedef board_profile<this_board> board; /*!< the pins of the board being built for */
+
+static_assert(board_profile_check<board_profile<board_id::feather_32u4>>(), "feather 32u4 pins clash");
+static_assert(board_profile_check<board_profile<board_id::feather_m0>>(), "feather m0 pins clash");
+static_assert(board_profile_check<board_profile<board_id::feather_328p>>(), "feather 328p pins clash");
+static_assert(board_profile_check<board_profile<board_id::esp8266>>(), "esp8266 pins clash");
+static_assert(board_profile_check<board_profile<board_id::esp32>>(), "esp32 pins clash");
+static_assert(board_profile_check<board_profile<board_id::native>>(), "native pins clash");
+
+#endif
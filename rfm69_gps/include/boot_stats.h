@@ -0,0 +1,73 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file boot_stats.h
+    @brief When each step of the boot happened, up to the first fix on the air and its ack.
+
+    rfm_69_setup and the loop mark each stage the first time it is reached, with micros():
+      | stage | when |
+      |:------|:-----|
+      | BOOT_SETUP | rfm_69_setup starts, the others are timed from it |
+      | BOOT_CONFIG | the settings are loaded, see node_config.h |
+      | BOOT_RADIO | the radio is set up and ready to send |
+      | BOOT_READY | rfm_69_setup is done |
+      | BOOT_SENTENCE | the first good sentence from the gps |
+      | BOOT_FIX | the first valid fix |
+      | BOOT_SEND | the first frame on the air, the time to first transmit |
+      | BOOT_ACK | the first frame the base station acked |
+    The radio needs RFM69_RESET_READY us after its reset before it can be set up.  Setup pulses
+    the reset first and does the gps link, the settings and the fix store while the radio comes
+    up, and then only waits for what is left of it.  The gps is never waited for, its commands
+    are queued and gps_link sends them from the loop.
+
+    A stage reached more than BOOT_STATS_WINDOW ms after setup is not marked, micros() wraps
+    after 71 minutes.  The boot console command prints the stages and the first ack logs them.
+**/
+#ifndef boot_stats_h
+#define boot_stats_h
+#include <stdint.h>
+#include <Arduino.h>
+
+/**
+    @brief ms after setup a stage is still marked
+    @param BOOT_STATS_WINDOW
+*/
+#define BOOT_STATS_WINDOW 3600000UL
+
+/**
+    @brief the stages, in the order they are normally reached
+*/
+enum boot_stage
+{
+    BOOT_SETUP,
+    BOOT_CONFIG,
+    BOOT_RADIO,
+    BOOT_READY,
+    BOOT_SENTENCE,
+    BOOT_FIX,
+    BOOT_SEND,
+    BOOT_ACK,
+    BOOT_STAGES,
+};
+
+/**
+    @brief the times of the stages
+*/
+struct boot_stats
+{
+    uint32_t at[BOOT_STAGES]; /*!< micros() when each stage was reached */
+    uint32_t setup_millis;    /*!< millis() when setup started, for BOOT_STATS_WINDOW */
+    uint8_t reached;          /*!< a bit for each stage that was reached */
+    uint8_t config_source;    /*!< the node_config_source of the settings */
+};
+
+static_assert(BOOT_STAGES <= 8, "the boot stages do not fit in reached");
+
+extern void boot_stats_begin(struct boot_stats *boot);
+extern bool boot_stats_mark(struct boot_stats *boot, uint8_t stage);
+extern bool boot_stats_reached(const struct boot_stats *boot, uint8_t stage);
+extern uint32_t boot_stats_elapsed(const struct boot_stats *boot, uint8_t stage);
+extern void boot_stats_print(const struct boot_stats *boot, Print &out);
+
+#endif
@@ -0,0 +1,52 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file console.h
+    @brief Line based command console on the usb serial port.
+
+    console_service is called from the loop, it takes whatever characters have arrived without
+    waiting, and when a line is complete it looks the first word up in the command table and
+    calls the handler with the rest of the line.  Each module that has something to report adds
+    one entry to the table in rfm69_gps.cpp.  The table is in flash, the names and help lines
+    are in the entries so that none of it is copied to ram at startup.
+**/
+#ifndef console_h
+#define console_h
+#include <stdint.h>
+#include <Arduino.h>
+
+/**
+    @brief the longest command line, longer lines are thrown away
+    @param CONSOLE_LINE_SIZE
+*/
+#define CONSOLE_LINE_SIZE 32
+/**
+    @brief the longest command name and help line with their nulls
+*/
+#define CONSOLE_NAME_SIZE 8
+#define CONSOLE_HELP_SIZE 72
+
+/**
+    @brief a console command handler
+
+    @param arguments the rest of the line after the command and the spaces, never NULL
+    @param out where to print the answer
+*/
+typedef void (*console_handler)(char *arguments, Print &out);
+
+/**
+    @brief one entry of the command table, the table is declared PROGMEM
+*/
+struct console_command
+{
+    char name[CONSOLE_NAME_SIZE];   /*!< the first word of the line */
+    console_handler handler;        /*!< called with the rest of the line */
+    char help[CONSOLE_HELP_SIZE];   /*!< one line for the help command */
+};
+
+extern void console_begin(const struct console_command *commands, uint8_t number_of_commands);
+extern void console_service(void);
+extern bool console_dispatch(char *line, Print &out);
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file event_log.h
+    @brief Deferred binary logging with compile time levels.
+
+    LOG(event, arguments...) puts a few bytes in a ram ring, the event id, the milliseconds
+    since the last record and the arguments, nothing is formatted and nothing waits.
+    log_service sends what fits into the usb serial buffer each pass of the loop, and
+    tools/log_decode turns the records back into text on the host.  The events and their text
+    are listed in log_events.def.
+
+    Events above LOG_LEVEL are removed by the compiler, the call is gone.  The arguments are
+    still evaluated, so they should not do anything but read a value.
+
+    On the wire each record is
+      | byte | value |
+      |:----:|:------|
+      | 0 | LOG_RECORD_START |
+      | 1 | length of the rest of the record |
+      | 2 | event id |
+      | 3.. | milliseconds since the previous record, then each argument, as zigzag varints |
+    The console text shares the port, it never contains LOG_RECORD_START so the decoder passes
+    it through.
+**/
+#ifndef event_log_h
+#define event_log_h
+#include <stdint.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/**
+    @brief the most detailed level compiled in, set it with -D LOG_LEVEL=LOG_LEVEL_DEBUG in
+    build_flags, LOG_LEVEL_NONE leaves out every record
+    @param LOG_LEVEL
+*/
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/**
+    @brief size of the ram ring, a power of 2 and no bigger than 256.  64 holds the boot records,
+    a debug build with a host that is slow to open the port can give it more
+    @param LOG_RING_SIZE
+*/
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64
+#endif
+/**
+    @brief the byte that starts a record, the ascii record separator
+    @param LOG_RECORD_START
+*/
+#define LOG_RECORD_START 0x1e
+/**
+    @brief the most arguments an event can have
+    @param LOG_MAX_ARGUMENTS
+*/
+#define LOG_MAX_ARGUMENTS 6
+
+enum log_event_id : uint8_t
+{
+#define LOG_EVENT(name, level, arguments, format) name,
+#include <log_events.def>
+#undef LOG_EVENT
+    LOG_EVENT_COUNT
+};
+
+constexpr uint8_t log_event_levels[] = {
+#define LOG_EVENT(name, level, arguments, format) level,
+#include <log_events.def>
+#undef LOG_EVENT
+};
+
+constexpr uint8_t log_event_arguments[] = {
+#define LOG_EVENT(name, level, arguments, format) arguments,
+#include <log_events.def>
+#undef LOG_EVENT
+};
+
+extern void log_write(uint8_t event, const int32_t *arguments, uint8_t number_of_arguments);
+extern void log_service(void);
+extern uint16_t log_dropped(void);
+
+/**
+    @brief write one record if its level is compiled in, use it through LOG
+*/
+template <log_event_id Event, typename... Arguments> static inline void log_record(Arguments... arguments)
+{
+    static_assert(sizeof...(Arguments) == log_event_arguments[Event], "wrong number of arguments for this log event");
+    static_assert(sizeof...(Arguments) <= LOG_MAX_ARGUMENTS, "too many arguments for a log event");
+    if constexpr (log_event_levels[Event] <= LOG_LEVEL)
+    {
+        // the extra 0 keeps the array from being empty
+        const int32_t values[] = {(int32_t)arguments..., 0};
+        log_write(Event, values, sizeof...(Arguments));
+    }
+}
+
+#define LOG(event, ...) log_record<event>(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,68 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file fix_batch.h
+    @brief Put several fixes in one radio packet, each one after the first as the change from the one before.
+
+    Every frame costs TX_QUEUE_FRAME_OVERHEAD bytes of preamble, header and crc, an ack frame of
+    the same again, and an ack wait.  A 25 byte position packet a second spends most of its air
+    time on those.  fix_batch_add puts the fixes the report policy lets through in a batch
+    packet, see position_packet.h, and queues it when it has FIX_BATCH_FIXES of them, when the
+    next fix does not fit or is of another date, or when fix_batch_service finds the first
+    fix has waited FIX_BATCH_MAX_LATENCY ms.
+
+    The batch is built in its own buffer, not in the transmit queue, so the telemetry and
+    history packets can still be queued while it fills.  The altitude and dop are not in a
+    batch packet.
+
+    fix_batch_complete counts the fixes in every acked frame, single or batched, so the batch
+    console command can show fixes delivered per second of air time either way.
+**/
+#ifndef fix_batch_h
+#define fix_batch_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <packet_builder.h>
+#include <position_packet.h>
+#include <tx_queue.h>
+
+/**
+    @brief what the batching has been through
+*/
+struct fix_batch_stats
+{
+    uint32_t fixes;     /*!< fixes put in a batch */
+    uint32_t delivered; /*!< fixes in acked frames, batched or not */
+    uint16_t frames;    /*!< batch packets queued */
+    uint16_t full;      /*!< of them, queued because they had FIX_BATCH_FIXES */
+    uint16_t timed_out; /*!< of them, queued because the first fix had waited too long */
+    uint16_t closed;    /*!< of them, queued because the next fix did not fit or was of another date */
+    uint16_t dropped;   /*!< fixes dropped because the transmit queue was full */
+};
+
+/**
+    @brief the batch being filled
+*/
+struct fix_batch
+{
+    uint8_t buffer[RH_RF69_MAX_MESSAGE_LEN]; /*!< the batch packet */
+    struct packet_builder builder;           /*!< the write cursor in buffer */
+    struct position_fix last;                /*!< the last fix in the batch, the next is the change from it */
+    uint8_t count;                           /*!< fixes in the batch, 0 when there is none */
+    uint8_t fixes;                           /*!< the batch is queued when it has this many */
+    uint16_t max_latency;                    /*!< the batch is queued when its first fix is this many ms old */
+    uint8_t to;                              /*!< the base station address */
+    uint32_t opened;                         /*!< millis() when the first fix went in */
+    uint32_t origin;                         /*!< micros() when the first fix came from the gps */
+    struct fix_batch_stats stats;            /*!< counters for the console */
+};
+
+extern void fix_batch_init(struct fix_batch *batch, uint8_t fixes, uint16_t max_latency);
+extern bool fix_batch_add(struct fix_batch *batch, struct tx_queue *queue, const char *call_sign,
+                          const struct position_fix *fix, uint8_t to, uint32_t origin);
+extern void fix_batch_service(struct fix_batch *batch, struct tx_queue *queue);
+extern void fix_batch_complete(struct fix_batch *batch, const struct tx_frame *frame, bool delivered);
+extern void fix_batch_print(const struct fix_batch *batch, const struct tx_queue *queue, Print &out);
+
+#endif
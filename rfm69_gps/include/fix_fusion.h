@@ -0,0 +1,106 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file fix_fusion.h
+    @brief Gather the RMC, GGA and GSA of one gps fix into one epoch.
+
+    The MT3333 sends the sentences of a fix one after the other, GGA, GSA and then RMC, all
+    with the same utc time except the GSA, which has none and goes with the fix it is sent in.
+    fix_fusion_add takes each sentence slot from gps_ingest_next and keeps it, nothing is
+    copied, until every sentence of the epoch is in.  fix_fusion_next then hands the epoch out
+    once, and fix_fusion_release gives the slots back to gps_ingest.
+
+    An epoch is finished when it has every sentence the last epoch had, or when a sentence
+    with a new time starts the next one.  So a gps that only sends RMC, or drops the GGA, costs
+    a fix interval of delay once and then the epochs finish at their last sentence again.
+    Epochs without an RMC are dropped, the position and date come from it.
+
+    Nothing is converted when the sentences arrive.  When an epoch is finished the few fields
+    of its GGA and GSA that are used, the altitude, satellites, hdop and fix type, are decoded
+    into the epoch right away, whether the fix is sent or not, and those two slots go back to
+    gps_ingest, so a finished epoch holds only its RMC.  The decoded bits tell which of them
+    were there.  The position is decoded from the RMC by the loop, and only for a fix it sends.
+
+    The epoch being gathered holds up to FIX_SENTENCE_COUNT slots, the finished one waiting for
+    the loop one more, and gps_ingest needs one to fill the next sentence in, so
+    GPS_SENTENCE_SLOTS has to be at least FIX_SENTENCE_COUNT + 2.
+**/
+#ifndef fix_fusion_h
+#define fix_fusion_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <gps_ingest.h>
+#include <position_packet.h>
+
+#define FIX_RMC 0
+#define FIX_GGA 1
+#define FIX_GSA 2
+#define FIX_SENTENCE_COUNT 3
+
+#define FIX_HAVE_RMC (1 << FIX_RMC)
+#define FIX_HAVE_GGA (1 << FIX_GGA)
+#define FIX_HAVE_GSA (1 << FIX_GSA)
+
+/**
+    @brief the fields of the GGA and GSA that were decoded when the epoch was finished
+*/
+#define FIX_DECODED_ALTITUDE 0x01
+#define FIX_DECODED_SATELLITES 0x02
+#define FIX_DECODED_HDOP 0x04
+
+static_assert(GPS_SENTENCE_SLOTS >= FIX_SENTENCE_COUNT + 2,
+              "the sentence slots cannot hold an epoch being gathered, a finished RMC and the next sentence");
+
+/**
+    @brief the sentences of one fix, the slots still belong to the epoch
+*/
+struct fix_epoch
+{
+    struct gps_sentence *sentences[FIX_SENTENCE_COUNT]; /*!< indexed by FIX_RMC, FIX_GGA, FIX_GSA, NULL if not in */
+    uint32_t time_of_day;                               /*!< utc 10 ms ticks of the epoch */
+    bool timed;                                         /*!< time_of_day is known, a GSA alone has no time */
+    uint8_t present;                                    /*!< FIX_HAVE_ bits of the sentences in */
+    uint8_t decoded;                                    /*!< FIX_DECODED_ bits, once the epoch is finished */
+    uint8_t fix_type;                                   /*!< the GSA fix type, 0 if there was none */
+    uint8_t satellites;                                 /*!< satellites used, from the GGA */
+    uint16_t hdop;                                      /*!< 0.01, from the GGA or else the GSA */
+    int32_t altitude;                                   /*!< decimeters above mean sea level */
+};
+
+/**
+    @brief what the fusion has been through
+*/
+struct fix_fusion_stats
+{
+    uint32_t epochs;    /*!< epochs handed out */
+    uint16_t partial;   /*!< epochs finished by the next one, with a sentence missing */
+    uint16_t no_rmc;    /*!< epochs dropped because they had no RMC */
+    uint16_t late;      /*!< sentences for an epoch that was already handed out */
+    uint16_t duplicate; /*!< second sentences of a kind in one epoch, GNGSA comes once per system */
+    uint16_t dropped;   /*!< finished epochs the loop did not take before the next one */
+};
+
+/**
+    @brief the epoch being gathered and the one waiting for the loop
+*/
+struct fix_fusion
+{
+    struct fix_epoch current;      /*!< the epoch being gathered */
+    struct fix_epoch ready;        /*!< a finished epoch, present is 0 when there is none */
+    bool current_done;             /*!< current has every expected sentence */
+    uint8_t expected;              /*!< FIX_HAVE_ bits an epoch needs to be finished */
+    uint32_t last_time;            /*!< utc time of the last epoch finished, for late sentences */
+    bool have_last;                /*!< last_time is known */
+    struct fix_fusion_stats stats; /*!< counters for the console */
+};
+
+extern void fix_fusion_init(struct fix_fusion *fusion, uint8_t expected);
+extern void fix_fusion_add(struct fix_fusion *fusion, struct gps_sentence *sentence);
+extern struct fix_epoch *fix_fusion_next(struct fix_fusion *fusion);
+extern void fix_fusion_release(struct fix_epoch *epoch);
+extern void fix_fusion_print(const struct fix_fusion *fusion, Print &out);
+
+extern void fix_epoch_quality(struct fix_epoch *epoch, struct position_fix *fix);
+
+#endif
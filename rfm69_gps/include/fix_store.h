@@ -0,0 +1,127 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file fix_store.h
+    @brief Keep the fixes the base station did not ack, and send them again when it answers.
+
+    When a position packet is given up on, its fix is packed in a POSITION_RECORD_LENGTH byte
+    record and kept in a small ring in ram.  When that is full the oldest record is moved to a
+    ring of slots in the eeprom, and when that is full the oldest slot is written over.  So the
+    newest fixes are kept, and the tracker can drive out of range for FIX_STORE_SLOTS fixes
+    without losing any.
+
+    The eeprom ring has no index cell, that one cell would wear out first.  Each slot is
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 0 | 2 | sequence number, 15 bits, the top bit is set once the record was delivered |
+      | 2 | POSITION_RECORD_LENGTH | the record |
+    and at boot the slot with the newest sequence number is the head, the waiting records are
+    the run of undelivered ones behind it.  Every slot is written once each time around the
+    ring.  The slot is written a byte per fix_store_service, the sequence number last, and the
+    delivered bit is set the same way, so the loop never waits for the eeprom.
+
+    Once any packet is acked again, fix_store_backfill puts the oldest records of one date in a
+    history packet, up to FIX_STORE_BATCH of them, when the transmit queue has nothing live to
+    send.  Only one history packet is on the queue at a time and they are at least
+    FIX_STORE_BACKFILL_INTERVAL ms apart, so the backlog never crowds out new fixes.  The
+    records leave the store when the history packet is acked.  A record whose delivered bit
+    was not set before a power loss is sent again after the boot, the base station sees it twice.
+
+    A batch packet, see fix_batch.h, that was not acked has each of its fixes stored the same way.
+**/
+#ifndef fix_store_h
+#define fix_store_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <position_packet.h>
+#include <tx_queue.h>
+
+/**
+    @brief records kept in ram before they are moved to the eeprom, one history packet and one
+    more, each is POSITION_RECORD_LENGTH bytes of ram
+    @param FIX_STORE_RAM_RECORDS
+*/
+#ifndef FIX_STORE_RAM_RECORDS
+#define FIX_STORE_RAM_RECORDS 4
+#endif
+/**
+    @brief ram records fix_store_service keeps free by moving records to the eeprom ahead of
+    time, a batch packet that was not acked puts all of its fixes in at once.  Set it to
+    FIX_BATCH_FIXES when batching, 0 only moves a record when a new one needs its place
+    @param FIX_STORE_RAM_SPARE
+*/
+#ifndef FIX_STORE_RAM_SPARE
+#define FIX_STORE_RAM_SPARE 0
+#endif
+/**
+    @brief the eeprom from here to FIX_STORE_EEPROM_END is the ring, the call sign and sync
+    words are below it
+    @param FIX_STORE_EEPROM_START
+*/
+#define FIX_STORE_EEPROM_START 128
+#ifndef FIX_STORE_EEPROM_END
+#if defined(E2END)
+#define FIX_STORE_EEPROM_END (E2END + 1)
+#else
+#define FIX_STORE_EEPROM_END 1024
+#endif
+#endif
+#define FIX_STORE_SLOT_SIZE (POSITION_RECORD_LENGTH + 2)
+#define FIX_STORE_SLOTS ((FIX_STORE_EEPROM_END - FIX_STORE_EEPROM_START) / FIX_STORE_SLOT_SIZE)
+/**
+    @brief records in one history packet, as many as fit in the biggest radio packet
+    @param FIX_STORE_BATCH
+*/
+#define FIX_STORE_BATCH ((RH_RF69_MAX_MESSAGE_LEN - POSITION_HISTORY_HEADER) / POSITION_HISTORY_ENTRY)
+/**
+    @brief the shortest time between two history packets in ms
+    @param FIX_STORE_BACKFILL_INTERVAL
+*/
+#define FIX_STORE_BACKFILL_INTERVAL 2000
+
+#define FIX_STORE_EMPTY 0xffff    /*!< the sequence number of a slot never written */
+#define FIX_STORE_DELIVERED 0x8000 /*!< set in the sequence number once the record was acked */
+
+/**
+    @brief what the store has been through
+*/
+struct fix_store_stats
+{
+    uint32_t stored;     /*!< fixes that were not acked live */
+    uint32_t backfilled; /*!< of them, fixes acked in a history packet */
+    uint16_t lost;       /*!< fixes written over or dropped because the store was full */
+    uint16_t spilled;    /*!< records moved from ram to the eeprom */
+    uint16_t frames;     /*!< history packets queued */
+};
+
+/**
+    @brief the ram ring, where the eeprom ring is, and the slot being written
+*/
+struct fix_store
+{
+    uint8_t ram[FIX_STORE_RAM_RECORDS][POSITION_RECORD_LENGTH]; /*!< the newest records */
+    uint8_t ram_tail;                       /*!< oldest record in ram */
+    uint8_t ram_count;                      /*!< records in ram */
+    uint8_t tail;                           /*!< oldest waiting eeprom slot */
+    uint8_t count;                          /*!< waiting eeprom slots, they are older than the ram ones */
+    uint8_t marked;                         /*!< slots from here to tail were delivered and need their bit set */
+    uint16_t sequence;                      /*!< sequence number of the next slot written */
+    uint8_t spill[FIX_STORE_SLOT_SIZE];     /*!< the slot being written */
+    uint8_t spill_slot;                     /*!< where it is going */
+    uint8_t spill_step;                     /*!< bytes of it written plus 1, 0 when there is nothing to write */
+    uint8_t in_flight;                      /*!< the oldest records, in the history packet on the queue */
+    bool link_up;                           /*!< the last packet finished was acked */
+    uint32_t backfill_time;                 /*!< millis() when the last history packet was queued */
+    struct fix_store_stats stats;           /*!< counters for the console */
+};
+
+extern void fix_store_begin(struct fix_store *store);
+extern void fix_store_put(struct fix_store *store, const struct position_fix *fix);
+extern void fix_store_complete(struct fix_store *store, const struct tx_frame *frame, bool delivered);
+extern bool fix_store_backfill(struct fix_store *store, struct tx_queue *queue, const char *call_sign, uint8_t to);
+extern void fix_store_service(struct fix_store *store);
+extern uint16_t fix_store_waiting(const struct fix_store *store);
+extern void fix_store_print(const struct fix_store *store, Print &out);
+
+#endif
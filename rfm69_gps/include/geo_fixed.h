@@ -0,0 +1,44 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file geo_fixed.h
+    @brief Integer only distance, bearing and unit helpers for positions in 1e-7 degrees.
+
+    The 32u4 has no floating point unit, so everything here is done with 32 bit integers.  The
+    earth is treated as flat around the first point, which is good to well under a percent for
+    the few kilometers a tracker moves between two reports.  Offsets are clamped to
+    GEO_MAX_OFFSET meters so nothing overflows, anything that far away is past every threshold.
+
+    nmea_parse_coordinate in nmea.h turns the NMEA text into the 1e-7 degrees used here.  The
+    bench geo suite checks every function against a double precision reference and times both.
+
+    Like position_packet.h this does not use anything from the arduino.
+**/
+#ifndef geo_fixed_h
+#define geo_fixed_h
+#include <stdint.h>
+
+/**
+    @brief the largest offset in meters that is worked out, bigger ones are clamped to this
+    @param GEO_MAX_OFFSET
+*/
+#define GEO_MAX_OFFSET 32000
+
+/**
+    @brief one in the Q15 fixed point format that geo_cos and geo_sin return
+    @param GEO_Q15_ONE
+*/
+#define GEO_Q15_ONE 32767
+
+extern int16_t geo_cos(uint16_t angle);
+extern int16_t geo_sin(uint16_t angle);
+extern void geo_offset(int32_t from_latitude, int32_t from_longitude, int32_t to_latitude, int32_t to_longitude,
+                       int32_t *east, int32_t *north);
+extern uint32_t geo_isqrt(uint32_t value);
+extern uint16_t geo_length(int32_t east, int32_t north);
+extern uint16_t geo_distance(int32_t from_latitude, int32_t from_longitude, int32_t to_latitude, int32_t to_longitude);
+extern uint16_t geo_bearing(int32_t east, int32_t north);
+extern uint16_t geo_knots_to_cms(uint16_t speed);
+
+#endif
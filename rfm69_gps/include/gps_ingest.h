@@ -0,0 +1,114 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file gps_ingest.h
+    @brief Non-blocking NMEA ingestion from the GPS uart.
+
+    Bytes from the gps receiver go into a fixed size ring buffer.  On the 32u4 the ring is filled
+    directly from the USART1 receive interrupt, on the other boards it is filled by polling GPSSerial.
+    gps_ingest_service() drains the ring into a small pool of sentence slots.  When a line feed
+    arrives the slot is marked ready and handed to the caller by pointer, so no copy of the
+    sentence is ever made.  The caller must give the slot back with gps_ingest_release().
+
+    Each character is run through the nmea tokenizer as it is stored, so a ready sentence has
+    already been split into fields and had its checksum checked.  Sentences with a bad or missing
+    checksum are dropped here and never reach the caller.
+
+    Writes to the gps do not wait for the uart either.  On the 32u4 gps_ingest_write copies the
+    string, gps_ingest_write_P only keeps the pointer to flash, and the USART1 data register empty
+    interrupt sends it a byte at a time.  One string goes at a time, a write while the last one
+    is still going out is refused and the caller tries again on its next pass.  On the other
+    boards the core's transmit buffer does the same and a write is always taken.
+**/
+#ifndef gps_ingest_h
+#define gps_ingest_h
+#include <stdint.h>
+#include <nmea.h>
+
+/**
+    @brief size of the receive ring buffer, must be a power of 2 and no bigger than 256
+    @param GPS_RING_BUFFER_SIZE
+*/
+#define GPS_RING_BUFFER_SIZE 64
+/**
+    @brief this is the size of a sentence slot, a NMEA sentence is at most 82 characters with
+    its CR LF, so the 80 kept and the null fit with a little to spare, each byte here is 5 of ram
+    @param GPS_RECEIVER_BUFFER_SIZE
+*/
+#define GPS_RECEIVER_BUFFER_SIZE 84
+/**
+    @brief number of sentence slots, fix_fusion holds the GGA, GSA and RMC of the fix being
+    gathered and the RMC of the one waiting for the loop while the next sentence fills the fifth
+    @param GPS_SENTENCE_SLOTS
+*/
+#define GPS_SENTENCE_SLOTS 5
+/**
+    @brief the longest string gps_ingest_write takes with its null, a sentence from flash can be
+    any length because it is sent from where it is
+    @param GPS_TX_BUFFER_SIZE
+*/
+#define GPS_TX_BUFFER_SIZE 48
+
+#define GPS_SLOT_FREE 0
+#define GPS_SLOT_FILLING 1
+#define GPS_SLOT_READY 2
+#define GPS_SLOT_IN_USE 3
+
+/**
+    @brief one assembled sentence, data is null terminated with the CR LF removed
+
+    The commas in data have been replaced by 0, use gps_sentence_field to get at a field.
+*/
+struct gps_sentence
+{
+    char data[GPS_RECEIVER_BUFFER_SIZE]; /*!< the sentence text */
+    uint8_t length;                      /*!< number of characters in data */
+    uint8_t state;                       /*!< one of the GPS_SLOT_ values */
+    uint8_t sequence;                    /*!< order the sentences were finished in, gps_ingest_next hands out the oldest */
+    uint32_t line_feed;                  /*!< micros() when the line feed came in, for the latency stats */
+    struct nmea_fields fields;           /*!< where each field starts */
+};
+
+/**
+    @brief counters kept by the ingestion layer
+*/
+struct gps_ingest_stats
+{
+    uint32_t bytes_received;   /*!< bytes taken out of the uart */
+    uint32_t sentences;        /*!< complete sentences handed off */
+    uint16_t dropped_bytes;    /*!< bytes lost because the ring buffer was full */
+    uint16_t overruns;         /*!< uart hardware overruns or framing errors */
+    uint16_t truncated;        /*!< sentences thrown away because they were too long */
+    uint16_t dropped_sentences; /*!< sentences lost because no slot was free */
+    uint16_t checksum_errors;  /*!< sentences with a bad or missing checksum */
+};
+
+/**
+    @brief get a field of a ready sentence
+
+    @param sentence the sentence from gps_ingest_next
+    @param index the field index, for example RMC_STATUS
+    @return the null terminated field, an empty string if the sentence is shorter
+*/
+static inline char *gps_sentence_field(struct gps_sentence *sentence, uint8_t index)
+{
+    if (index >= sentence->fields.count)
+    {
+        return sentence->data + sentence->length;
+    }
+    return sentence->data + sentence->fields.offset[index];
+}
+
+extern void gps_ingest_begin(uint32_t baud);
+extern void gps_ingest_set_baud(uint32_t baud);
+extern bool gps_ingest_write(const char *data);
+extern bool gps_ingest_write_P(const char *data);
+extern bool gps_ingest_writing(void);
+extern void gps_ingest_service(void);
+extern struct gps_sentence *gps_ingest_next(void);
+extern void gps_ingest_release(struct gps_sentence *sentence);
+extern bool gps_ingest_pending(void);
+extern void gps_ingest_get_stats(struct gps_ingest_stats *stats);
+
+#endif
@@ -0,0 +1,160 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file gps_link.h
+    @brief The gps uart baud rate, and PMTK commands that are sent until the gps acks them.
+
+    At boot the link looks for the gps, it tries each rate in turn, sends PMTK000 and waits for
+    any sentence with a good checksum.  If the gps is not at GPS_LINK_BAUD it is told to move
+    with PMTK251 and the uart follows, then PMTK000 has to be acked at the new rate.  If it is
+    not, the search starts again, and after GPS_LINK_SWITCH_TRIES the link stays at the rate the
+    gps answered at.  Once running, a stream of bytes without a single good sentence means the
+    gps is at some other rate, it was reset or lost its backup power, and the search starts again.
+
+    Commands are queued and sent one at a time.  Each one is sent again if its PMTK001 ack does
+    not come back in GPS_LINK_ACK_TIMEOUT ms, up to GPS_LINK_RETRIES times, so a command is
+    written once when the gps hears it, not three times blind.  Nothing here waits, it all
+    moves on in gps_link_service, the commands queued at boot go out once the rate is settled.
+**/
+#ifndef gps_link_h
+#define gps_link_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <gps_ingest.h>
+
+/**
+    @brief the rate the MT3333 comes up at with no backup power
+    @param GPS_LINK_DEFAULT_BAUD
+*/
+#define GPS_LINK_DEFAULT_BAUD 9600
+/**
+    @brief the rate the gps is moved to.  An RMC and a GGA every 100 ms need about 16000 baud,
+    38400 is the fastest rate the 8 MHz 32u4 uart makes to within 1 percent
+    @param GPS_LINK_BAUD
+*/
+#ifndef GPS_LINK_BAUD
+#define GPS_LINK_BAUD 38400
+#endif
+/**
+    @brief characters on the wire each fix, an RMC and a GGA and room for an ack, used to check
+    a fix interval fits the baud rate
+    @param GPS_LINK_BYTES_PER_FIX
+*/
+#define GPS_LINK_BYTES_PER_FIX 180
+/**
+    @brief commands that can wait for the gps, each costs 2 * GPS_LINK_MAX_ARGUMENTS + 5 bytes of ram.
+    The most the loop queues before the gps answers is the init sentences, a fix interval and the
+    power command that goes with it, and the next fix interval if the report policy changes it
+    again before the first was acked
+    @param GPS_LINK_QUEUE
+*/
+#define GPS_LINK_QUEUE 4
+/**
+    @brief the most numbers after the type of a command built at run time, each up to 65535,
+    the times and modes of PMTK220 and PMTK225 fit, a baud rate has to come from flash
+    @param GPS_LINK_MAX_ARGUMENTS
+*/
+#define GPS_LINK_MAX_ARGUMENTS 5
+/**
+    @brief the longest command built at run time with its checksum and line end,
+    $PMTK225,2,5000,25000,5000,25000*hh\r\n is about the longest one
+*/
+#define GPS_LINK_COMMAND_SIZE 48
+/**
+    @brief how long to wait for a PMTK001 ack in ms
+    @param GPS_LINK_ACK_TIMEOUT
+*/
+#define GPS_LINK_ACK_TIMEOUT 1000
+/**
+    @brief how many times a command is sent again when it is not acked
+    @param GPS_LINK_RETRIES
+*/
+#define GPS_LINK_RETRIES 2
+/**
+    @brief how long to listen at each rate for a good sentence in ms
+    @param GPS_LINK_PROBE_TIME
+*/
+#define GPS_LINK_PROBE_TIME 1500
+/**
+    @brief how many times the gps is told to move to GPS_LINK_BAUD before the link gives up
+    @param GPS_LINK_SWITCH_TRIES
+*/
+#define GPS_LINK_SWITCH_TRIES 2
+/**
+    @brief this many bytes in a row without a good sentence and the rate is searched for again
+    @param GPS_LINK_GARBAGE_BYTES
+*/
+#define GPS_LINK_GARBAGE_BYTES 600
+
+#define GPS_LINK_PROBE 0
+#define GPS_LINK_CONFIRM 1
+#define GPS_LINK_READY 2
+
+#define GPS_ACK_INVALID 0
+#define GPS_ACK_UNSUPPORTED 1
+#define GPS_ACK_FAILED 2
+#define GPS_ACK_SUCCEEDED 3
+
+/**
+    @brief a command waiting to be sent, either a sentence in flash or a type and numbers
+*/
+struct gps_link_command
+{
+    const char *sentence;                         /*!< the whole sentence in PROGMEM, NULL to build it */
+    uint16_t type;                                /*!< the PMTK packet type, the ack names it */
+    uint8_t number_of_arguments;                  /*!< numbers after the type */
+    uint16_t arguments[GPS_LINK_MAX_ARGUMENTS];   /*!< the numbers, when sentence is NULL */
+};
+
+/**
+    @brief what the link has been through
+*/
+struct gps_link_stats
+{
+    uint16_t acked;       /*!< commands the gps acked as done */
+    uint16_t rejected;    /*!< commands acked as invalid, unsupported or failed */
+    uint16_t resent;      /*!< sends after a missing ack */
+    uint16_t failed;      /*!< commands never acked */
+    uint16_t dropped;     /*!< commands refused because the queue was full */
+    uint16_t resyncs;     /*!< searches for the rate after the link was up */
+    uint16_t switch_failed; /*!< PMTK251 moves that were not confirmed */
+};
+
+/**
+    @brief the link state and the command queue
+*/
+struct gps_link
+{
+    uint8_t state;                                 /*!< one of the GPS_LINK_ states */
+    uint32_t baud;                                 /*!< the rate the uart is at */
+    uint32_t answered_baud;                        /*!< the rate the gps last answered at, 0 for none */
+    uint8_t candidate;                             /*!< the rate being tried, an index into the search list */
+    uint8_t switch_tries;                          /*!< PMTK251 moves since the search started */
+    bool answered;                                 /*!< a good sentence arrived at this rate */
+    uint32_t timer;                                /*!< millis() when the current wait started */
+    uint32_t good_bytes;                           /*!< bytes received up to the last good sentence */
+    struct gps_link_command commands[GPS_LINK_QUEUE]; /*!< the ring of commands, head is the one being sent */
+    uint8_t head;                                  /*!< index of the oldest command */
+    uint8_t count;                                 /*!< commands in the ring */
+    uint8_t attempts;                              /*!< sends of the head command, 0 if not sent yet */
+    struct gps_link_stats stats;                   /*!< counters for the console */
+};
+
+extern void gps_link_begin(struct gps_link *link);
+extern bool gps_link_send_P(struct gps_link *link, const char *sentence, uint16_t type);
+extern bool gps_link_send(struct gps_link *link, uint16_t type, const uint16_t *arguments, uint8_t number_of_arguments);
+extern void gps_link_sentence(struct gps_link *link, struct gps_sentence *sentence);
+extern void gps_link_service(struct gps_link *link);
+extern bool gps_link_idle(const struct gps_link *link);
+extern void gps_link_print(const struct gps_link *link, Print &out);
+
+/**
+    @brief queue a command from pmtk.h, for example gps_link_send<pmtk_test>(&link)
+*/
+template <typename Command> static inline bool gps_link_send(struct gps_link *link)
+{
+    return gps_link_send_P(link, Command::sentence.text, Command::type);
+}
+
+#endif
@@ -0,0 +1,114 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file latency_stats.h
+    @brief Where the time goes between the end of an RMC sentence and the ack of its packet.
+
+    The loop takes a micros() stamp at each stage boundary and hands the difference to
+    latency_stats_record, which only adds one to a histogram bucket, so it can stay in the
+    field build.  The stages are
+      | stage | from | to |
+      |:------|:-----|:---|
+      | LATENCY_RECEIVE | line feed in the uart interrupt | the loop picks the sentence up |
+      | LATENCY_PARSE | picked up | fix decoded and the report decision made |
+      | LATENCY_BUILD | report decision | packet built and on the transmit queue |
+      | LATENCY_AIR | on the queue | ack, the queue wait, air time and retries |
+      | LATENCY_TOTAL | line feed | ack |
+    The buckets are powers of 2, bucket 0 is under 2^LATENCY_BUCKET_SHIFT us and each bucket
+    after it is twice as wide, the last one holds everything longer.  micros() moves in steps
+    of 8 us on the 8 MHz 32u4, the first bucket covers that.
+    A bucket is one byte.  When one would pass 255 every bucket of its histogram is halved,
+    which keeps the percentiles and lets the recent samples count for more.  The sample count
+    and the longest sample are kept in full.
+
+    The tries each packet needed and the rssi of the acks are counted as well.  The console
+    latency command prints it all, and latency_telemetry_encode packs a summary into a packet
+    for the base station.
+**/
+#ifndef latency_stats_h
+#define latency_stats_h
+#include <stdint.h>
+#include <Arduino.h>
+
+#define LATENCY_RECEIVE 0
+#define LATENCY_PARSE 1
+#define LATENCY_BUILD 2
+#define LATENCY_AIR 3
+#define LATENCY_TOTAL 4
+#define LATENCY_STAGE_COUNT 5
+
+/**
+    @brief number of histogram buckets of each stage, with 16 the last one starts at 2^19 us,
+    half a second
+    @param LATENCY_BUCKETS
+*/
+#define LATENCY_BUCKETS 16
+/**
+    @brief bucket 0 is everything under 2^LATENCY_BUCKET_SHIFT microseconds
+    @param LATENCY_BUCKET_SHIFT
+*/
+#define LATENCY_BUCKET_SHIFT 5
+/**
+    @brief tries counted one by one, the last bucket is this many or more
+    @param LATENCY_ATTEMPT_BUCKETS
+*/
+#define LATENCY_ATTEMPT_BUCKETS 4
+/**
+    @brief ack rssi buckets, LATENCY_RSSI_STEP dB wide from LATENCY_RSSI_FLOOR up
+    @param LATENCY_RSSI_BUCKETS
+*/
+#define LATENCY_RSSI_BUCKETS 8
+#define LATENCY_RSSI_FLOOR -100
+#define LATENCY_RSSI_STEP 10
+
+/**
+    @brief first byte of a telemetry packet, the top bit is set like the position packet so
+    it is never taken for an ascii packet
+*/
+#define LATENCY_TELEMETRY_MAGIC 0xC0
+#define LATENCY_TELEMETRY_VERSION 1
+/**
+    @brief the telemetry packet
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 0  | 1 | LATENCY_TELEMETRY_MAGIC or'ed with the version |
+      | 1  | 6 | call sign |
+      | 7  | 6 per stage | samples (2), median bucket (1), 90th percentile bucket (1), max in ms (2) |
+      | 37 | 2 per bucket | packets acked after 1, 2, 3, 4 or more tries |
+      | 45 | 2 | packets never acked |
+      | 47 | 1 | median ack rssi bucket |
+    All multi byte values are little endian and stop at their largest value instead of wrapping.
+*/
+#define LATENCY_TELEMETRY_LENGTH (7 + 6 * LATENCY_STAGE_COUNT + 2 * LATENCY_ATTEMPT_BUCKETS + 3)
+
+/**
+    @brief the histogram of one stage
+*/
+struct latency_stage
+{
+    uint8_t buckets[LATENCY_BUCKETS];  /*!< samples in each power of 2 bucket, halved when one is full */
+    uint32_t count;                    /*!< samples recorded */
+    uint32_t max;                      /*!< longest sample in microseconds */
+};
+
+/**
+    @brief the latency, retry and ack rssi counters
+*/
+struct latency_stats
+{
+    struct latency_stage stages[LATENCY_STAGE_COUNT]; /*!< one histogram per stage */
+    uint16_t attempts[LATENCY_ATTEMPT_BUCKETS];       /*!< acked packets by the tries they took */
+    uint16_t failed;                                  /*!< packets never acked */
+    uint8_t rssi[LATENCY_RSSI_BUCKETS];               /*!< acks by rssi, halved when one is full */
+};
+
+extern void latency_stats_reset(struct latency_stats *stats);
+extern void latency_stats_record(struct latency_stats *stats, uint8_t stage, uint32_t microseconds);
+extern void latency_stats_delivery(struct latency_stats *stats, bool delivered, uint8_t attempts, int16_t rssi);
+extern uint8_t latency_stats_percentile(const struct latency_stage *stage, uint8_t percent);
+extern void latency_stats_print(const struct latency_stats *stats, Print &out);
+extern uint8_t latency_telemetry_encode(const struct latency_stats *stats, const char *call_sign, uint8_t *buffer,
+                                        uint8_t buffer_size);
+
+#endif
@@ -0,0 +1,150 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file link_adapter.h
+    @brief Pick the bit rate and transmit power from how well the base station is heard.
+
+    A fixed GFSK_Rb250Fd250 at +20 dBm is too slow and too loud for a tracker next to the
+    base station, and too fast for one at the edge of range.  The adapter steps through a
+    table of profiles, the first is the slowest and loudest and each one after it is faster or
+    quieter.  Profile LINK_ADAPT_HOME is used after a reset.
+
+    The RSSI of the acks says how much the path loses.  The path loses the same both ways,
+    so the tracker can work out what its own frames arrive at the base station with, for
+    any profile:
+        margin = ack rssi + profile power - LINK_ADAPT_BASE_POWER - profile sensitivity
+    After LINK_ADAPT_UP_FRAMES frames in a row that were acked on the first try, it moves up
+    to the fastest profile that has LINK_ADAPT_MARGIN dB of margin.  A frame that was not
+    acked, one that took more than two tries, or a margin under half of LINK_ADAPT_MARGIN
+    moves it down to the fastest slower profile that has the margin, or home.
+
+    Both ends have to change together, so the tracker asks first, on the profile in use:
+      | offset | length | contents |
+      |:------:|:------:|:---------|
+      | 0  | 1 | LINK_PROFILE_MAGIC or'ed with the version |
+      | 1  | 1 | the profile index to change to |
+    The base station acks it on the old profile and then listens to that tracker on the new
+    one, the tracker changes when the ack is in.  When the ack is lost, the tracker cannot
+    know whether the base station changed.  It then sends the request once more on the new
+    profile, and goes back to the old one if that is not acked either.  If either end
+    hears nothing from the other for LINK_ADAPT_SILENCE ms, it goes back to LINK_ADAPT_HOME,
+    so the two always meet again.
+**/
+#ifndef link_adapter_h
+#define link_adapter_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <tx_queue.h>
+
+/**
+    @brief the request packet
+*/
+#define LINK_PROFILE_MAGIC 0xF0
+#define LINK_PROFILE_VERSION 1
+#define LINK_PROFILE_LENGTH 2
+
+/**
+    @brief profiles in the table, and the index that means none
+*/
+#define LINK_PROFILE_COUNT 9
+#define LINK_PROFILE_NONE 0xff
+
+/**
+    @brief the profile after a reset and after a silence, the slowest and loudest
+    @param LINK_ADAPT_HOME
+*/
+#define LINK_ADAPT_HOME 0
+/**
+    @brief dB over the sensitivity a profile needs to be moved up to
+    @param LINK_ADAPT_MARGIN
+*/
+#ifndef LINK_ADAPT_MARGIN
+#define LINK_ADAPT_MARGIN 10
+#endif
+/**
+    @brief frames acked on the first try in a row before moving up
+    @param LINK_ADAPT_UP_FRAMES
+*/
+#ifndef LINK_ADAPT_UP_FRAMES
+#define LINK_ADAPT_UP_FRAMES 4
+#endif
+/**
+    @brief ms without an ack before going home, the base station has to use the same
+    @param LINK_ADAPT_SILENCE
+*/
+#ifndef LINK_ADAPT_SILENCE
+#define LINK_ADAPT_SILENCE 60000
+#endif
+/**
+    @brief dBm the base station sends its acks with
+    @param LINK_ADAPT_BASE_POWER
+*/
+#ifndef LINK_ADAPT_BASE_POWER
+#define LINK_ADAPT_BASE_POWER 20
+#endif
+
+/**
+    @brief one modem and power setting
+*/
+struct link_profile
+{
+    uint8_t modem;       /*!< RH_RF69::ModemConfigChoice */
+    int8_t power;        /*!< dBm */
+    int8_t sensitivity;  /*!< dBm the base station needs at this bit rate */
+    uint8_t current;     /*!< mA while sending at this power */
+    uint32_t bit_rate;   /*!< bits a second */
+};
+
+/**
+    @brief what the adapter has done
+*/
+struct link_adapter_stats
+{
+    uint16_t requests;  /*!< requests sent */
+    uint16_t up;        /*!< changes to a faster or quieter profile */
+    uint16_t down;      /*!< changes to a slower or louder profile */
+    uint16_t probes;    /*!< requests sent again on the new profile after a lost ack */
+    uint16_t refused;   /*!< requests given up on */
+    uint16_t silences;  /*!< times it went home after LINK_ADAPT_SILENCE */
+};
+
+/**
+    @brief called to put a profile on the radio
+
+    @param context the context given to link_adapter_init
+    @param profile the profile
+*/
+typedef void (*link_apply_callback)(void *context, const struct link_profile *profile);
+
+/**
+    @brief the adapter of one tracker
+*/
+struct link_adapter
+{
+    struct tx_queue *queue;      /*!< the queue the requests go on, its bit_rate is kept up to date */
+    link_apply_callback apply;   /*!< puts a profile on the radio */
+    void *context;               /*!< handed to apply */
+    uint8_t profile;             /*!< the profile in use */
+    uint8_t want;                /*!< the profile to ask for, LINK_PROFILE_NONE if none */
+    uint8_t requested;           /*!< the profile asked for and not acked yet, LINK_PROFILE_NONE if none */
+    uint8_t probe_from;          /*!< the profile to go back to if the probe is not acked */
+    bool probing;                /*!< the request is being sent again on the new profile */
+    uint8_t streak;              /*!< frames in a row acked on the first try */
+    int16_t rssi;                /*!< average ack rssi, dBm times 4 */
+    bool have_rssi;              /*!< rssi has a value */
+    uint32_t last_ack;           /*!< millis() of the last ack */
+    struct link_adapter_stats stats; /*!< counters for the console */
+};
+
+extern void link_adapter_init(struct link_adapter *adapter, struct tx_queue *queue, link_apply_callback apply,
+                              void *context);
+extern void link_adapter_profile(uint8_t index, struct link_profile *profile);
+extern int16_t link_adapter_margin(const struct link_adapter *adapter, uint8_t index);
+extern void link_adapter_complete(struct link_adapter *adapter, const struct tx_frame *frame, bool delivered,
+                                  uint8_t attempts);
+extern bool link_adapter_service(struct link_adapter *adapter, uint8_t to);
+extern bool link_profile_decode(const uint8_t *buffer, uint8_t length, uint8_t *index);
+extern void link_adapter_print(const struct link_adapter *adapter, Print &out);
+
+#endif
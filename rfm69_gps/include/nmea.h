@@ -0,0 +1,140 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file nmea.h
+    @brief Field indexes of the NMEA sentences we use and the single pass tokenizer.
+
+    The index is the position of the token after the sentence has been split on the commas.
+    Empty fields are kept, so the indexes are the same for a void fix as for a valid one.
+    //   0     1         2   3       4    5       6   7    8      9
+    // $GPRMC,094330.000,A,3113.3156,N,12121.2686,E,0.51,193.93,171210,,,A*68<CR><LF>
+    //   0     1         2         3 4          5 6 7  8    9    10 11   12
+    // $GPGGA,140500.000,3546.7760,N,07838.2920,W,1,09,0.92,96.3,M,-33.7,M,,*65<CR><LF>
+    //   0    1 2 3                       15   16   17
+    // $GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79*05<CR><LF>
+**/
+#ifndef nmea_h
+#define nmea_h
+#include <stdint.h>
+
+#define RMC_HEADER 0
+#define RMC_TIME 1
+#define RMC_STATUS 2
+#define RMC_LATITUDE 3
+#define RMC_N_S_INDICATOR 4
+#define RMC_LONGITUDE 5
+#define RMC_E_W_INDICATOR 6
+#define RMC_SPEED_OVER_GROUND 7
+#define RMC_COURSE_OVER_GROUND 8
+#define RMC_DATE 9
+
+#define GGA_TIME 1
+#define GGA_QUALITY 6
+#define GGA_SATELLITES 7
+#define GGA_HDOP 8
+#define GGA_ALTITUDE 9
+
+#define GSA_FIX_TYPE 2
+#define GSA_PDOP 15
+#define GSA_HDOP 16
+#define GSA_VDOP 17
+
+/**
+    @brief the most fields recorded for one sentence, GSA has 18
+    @param NMEA_MAX_FIELDS
+*/
+#define NMEA_MAX_FIELDS 18
+
+#define NMEA_STATE_BODY 0           /*!< between the $ and the *, the checksum is being computed */
+#define NMEA_STATE_CHECKSUM_HIGH 1  /*!< the next character is the first checksum digit */
+#define NMEA_STATE_CHECKSUM_LOW 2   /*!< the next character is the second checksum digit */
+#define NMEA_STATE_DONE 3           /*!< both checksum digits have been read */
+#define NMEA_STATE_ERROR 4          /*!< something other than a hex digit followed the * */
+
+/**
+    @brief the tokenizer state for one sentence
+
+    The fields are kept as offsets into the sentence buffer so the structure is small and the
+    sentence is never copied.
+*/
+struct nmea_fields
+{
+    uint8_t count;                   /*!< number of fields seen so far */
+    uint8_t offset[NMEA_MAX_FIELDS]; /*!< start of each field in the sentence buffer */
+    uint8_t checksum;                /*!< running xor of the characters between the $ and the * */
+    uint8_t received_checksum;       /*!< the value of the *hh digits */
+    uint8_t state;                   /*!< one of the NMEA_STATE_ values */
+};
+
+extern void nmea_fields_start(struct nmea_fields *fields);
+extern bool nmea_fields_valid(const struct nmea_fields *fields);
+extern uint32_t nmea_parse_decimal(const char *text, uint8_t fraction_digits, bool *present);
+extern uint32_t nmea_time_of_day(const char *text);
+extern int32_t nmea_parse_coordinate(const char *text, const char *hemisphere, bool *present);
+
+static inline uint8_t nmea_hex_value(char value)
+{
+    /**
+        @brief convert an ascii hex digit to its value
+
+        @param value the character
+        @return 0 to 15, or 0xff if it is not a hex digit
+    */
+    if (value >= '0' && value <= '9')
+        return value - '0';
+    if (value >= 'A' && value <= 'F')
+        return value - 'A' + 10;
+    if (value >= 'a' && value <= 'f')
+        return value - 'a' + 10;
+    return 0xff;
+}
+
+static inline char nmea_fields_feed(struct nmea_fields *fields, char gps_char, uint8_t position)
+/**@brief tokenize one character
+ *
+ * @param fields the tokenizer state
+ * @param gps_char the character received
+ * @param position where the character will be stored in the sentence buffer
+ * @return the character to store, a comma or the * comes back as 0
+ */
+{
+    uint8_t digit;
+    switch (fields->state)
+    {
+    case NMEA_STATE_BODY:
+        if (gps_char == '*')
+        {
+            fields->state = NMEA_STATE_CHECKSUM_HIGH;
+            return 0;
+        }
+        fields->checksum ^= gps_char;
+        if (gps_char == ',')
+        {
+            // fields past the end of the table are still split, they just are not indexed
+            if (fields->count < NMEA_MAX_FIELDS)
+            {
+                fields->offset[fields->count++] = position + 1;
+            }
+            return 0;
+        }
+        return gps_char;
+    case NMEA_STATE_CHECKSUM_HIGH:
+    case NMEA_STATE_CHECKSUM_LOW:
+        digit = nmea_hex_value(gps_char);
+        if (digit == 0xff)
+        {
+            fields->state = NMEA_STATE_ERROR;
+            return gps_char;
+        }
+        fields->received_checksum = (fields->received_checksum << 4) | digit;
+        fields->state++;
+        return gps_char;
+    default:
+        // nothing may follow the checksum
+        fields->state = NMEA_STATE_ERROR;
+        return gps_char;
+    }
+}
+
+#endif
@@ -0,0 +1,113 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file node_config.h
+    @brief The settings of a tracker, in one block of the eeprom with a crc.
+
+    The block is at NODE_CONFIG_EEPROM_START, between the old single bytes and the ring of
+    fix_store.h, and is read with one EEPROM.get at boot:
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 0  | 1 | NODE_CONFIG_MAGIC |
+      | 1  | 1 | NODE_CONFIG_VERSION |
+      | 2  | 2 | the sync words |
+      | 4  | 4 | the frequency in kHz, little endian |
+      | 8  | 6 | the call sign, padded with spaces |
+      | 14 | 1 | this tracker's address |
+      | 15 | 1 | the base station's address |
+      | 16 | 1 | the time slot, 0xff takes it from the address |
+      | 17 | 1 | the link profile, the bit rate and power, see link_adapter.h |
+      | 18 | 2 | the gps fix interval while moving in ms |
+      | 20 | 2 | the gps fix interval while standing still in ms |
+      | 22 | 2 | the shortest time between reports outside a burst in seconds |
+      | 24 | 2 | the heartbeat, the longest time without a report in seconds |
+      | 26 | 2 | crc 16 ccitt of bytes 0 to 25 |
+    A block with the wrong magic, version or crc is not used.  Version 1 ended at the link
+    profile with its crc in bytes 18 and 19.  A good version 1 block keeps its settings, gets
+    the default intervals and is written once as version 2.  The trackers built before it
+    kept the call sign in bytes 0 to 5, the sync words in 6 and 7 and the slot in 8.  If those
+    hold a call sign they are moved into a new block, which is written once, so the next boot
+    reads the block alone.  If they do not, the defaults are used and nothing is written, their
+    call sign is the placeholder N0CALL, so an erased or garbled eeprom never puts a garbage
+    call sign on the air.
+
+    The config console command prints the block, config call <sign> writes a new call sign
+    and config reset erases the block so the next boot starts over from the old bytes.
+**/
+#ifndef node_config_h
+#define node_config_h
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+#include <position_packet.h>
+#include <fix_store.h>
+
+/**
+    @brief where the block starts in the eeprom
+    @param NODE_CONFIG_EEPROM_START
+*/
+#define NODE_CONFIG_EEPROM_START 16
+/**
+    @brief the first two bytes of a block, the version goes up when the layout changes
+*/
+#define NODE_CONFIG_MAGIC 0xC6
+#define NODE_CONFIG_VERSION 2
+/**
+    @brief the bytes of a version 1 block before its crc
+*/
+#define NODE_CONFIG_VERSION_1_LENGTH 18
+/**
+    @brief the bytes of the old layout
+*/
+#define NODE_CONFIG_LEGACY_CALL_SIGN 0
+#define NODE_CONFIG_LEGACY_SYNC_WORDS 6
+#define NODE_CONFIG_LEGACY_SLOT 8
+/**
+    @brief where the settings came from
+*/
+enum node_config_source
+{
+    NODE_CONFIG_FROM_BLOCK,    /*!< a good block */
+    NODE_CONFIG_FROM_LEGACY,   /*!< the old bytes, moved into a new block */
+    NODE_CONFIG_FROM_DEFAULTS, /*!< nothing usable in the eeprom */
+    NODE_CONFIG_FROM_VERSION_1, /*!< a good block of version 1, moved into a new block */
+};
+
+/**
+    @brief the block, every field is on its own alignment so it has the same layout on the
+    avr and on the native build
+*/
+struct node_config
+{
+    uint8_t magic;                     /*!< NODE_CONFIG_MAGIC */
+    uint8_t version;                   /*!< NODE_CONFIG_VERSION */
+    uint8_t sync_words[2];             /*!< the network, all the boards of one have to match */
+    uint32_t frequency;                /*!< kHz */
+    char call_sign[CALL_SIGN_LENGTH];  /*!< padded with spaces, not null terminated */
+    uint8_t address;                   /*!< this tracker */
+    uint8_t base_address;              /*!< where the fixes are sent */
+    uint8_t slot;                      /*!< the time slot, 0xff takes it from the address */
+    uint8_t profile;                   /*!< the link profile when the link adapter is off */
+    uint16_t moving_fix_interval;      /*!< ms, see report_policy.h */
+    uint16_t parked_fix_interval;      /*!< ms */
+    uint16_t min_interval;             /*!< seconds */
+    uint16_t heartbeat;                /*!< seconds */
+    uint16_t crc;                      /*!< of everything before it */
+};
+
+static_assert(sizeof(struct node_config) == 28, "the node config block has padding");
+static_assert(offsetof(struct node_config, moving_fix_interval) == NODE_CONFIG_VERSION_1_LENGTH,
+              "the fields of version 1 have moved");
+static_assert(NODE_CONFIG_LEGACY_SLOT < NODE_CONFIG_EEPROM_START, "the config block is over the old bytes");
+static_assert(NODE_CONFIG_EEPROM_START + sizeof(struct node_config) <= FIX_STORE_EEPROM_START,
+              "the config block runs into the fix store");
+
+extern uint8_t node_config_load(struct node_config *config, const struct node_config *defaults);
+extern void node_config_save(struct node_config *config);
+extern void node_config_erase(void);
+extern bool node_config_set_call_sign(struct node_config *config, const char *call_sign);
+extern uint16_t node_config_crc(const uint8_t *data, uint8_t length);
+extern void node_config_print(const struct node_config *config, uint8_t source, Print &out);
+
+#endif
@@ -0,0 +1,38 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file packet_builder.h
+    @brief Append data to a fixed size radio packet through a write cursor.
+
+    Every append knows where the end of the packet is, so building a packet is linear in its
+    length, and nothing is ever written past the end of the buffer.  Once an append does not fit
+    the builder is marked as overflowed, later appends do nothing, and packet_builder_finish
+    returns 0 so a cut off packet is never sent.
+**/
+#ifndef packet_builder_h
+#define packet_builder_h
+#include <stdint.h>
+
+/**
+    @brief the state of a packet being built
+*/
+struct packet_builder
+{
+    uint8_t *buffer;   /*!< start of the packet */
+    uint8_t capacity;  /*!< size of buffer */
+    uint8_t length;    /*!< the write cursor, bytes used so far */
+    bool overflow;     /*!< set when an append did not fit */
+};
+
+extern void packet_builder_start(struct packet_builder *builder, uint8_t *buffer, uint8_t capacity);
+extern bool packet_builder_append(struct packet_builder *builder, const void *data, uint8_t length);
+extern bool packet_builder_append_string(struct packet_builder *builder, const char *text);
+extern bool packet_builder_append_char(struct packet_builder *builder, char value);
+extern bool packet_builder_append_decimal(struct packet_builder *builder, uint32_t value);
+extern bool packet_builder_append_le(struct packet_builder *builder, uint32_t value, uint8_t size);
+extern bool packet_builder_append_varint(struct packet_builder *builder, uint32_t value);
+extern bool packet_builder_append_zigzag(struct packet_builder *builder, int32_t value);
+extern uint8_t packet_builder_finish(struct packet_builder *builder);
+
+#endif
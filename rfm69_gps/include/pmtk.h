@@ -0,0 +1,173 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file pmtk.h
+    @brief PMTK command sentences built by the compiler and kept in flash.
+
+    A command is a type, pmtk_command<type, arguments...>, and its sentence member is the whole
+    "$PMTKttt,a,b*hh\r\n" with the checksum worked out by the compiler.  The sentence is placed
+    in flash with PROGMEM, so there is no copy in ram and nothing to work out at boot, send it
+    with write_gps_P.
+
+    The commands with limits on their arguments have their own templates that check them, so a
+    fix interval the gps does not take is a compile error, not a command the gps ignores.
+
+    Needs -std=gnu++17, see platformio.ini.
+**/
+#ifndef pmtk_h
+#define pmtk_h
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+
+/**
+    @brief the text of a sentence, a struct so a constexpr function can return it
+*/
+template <size_t Length> struct pmtk_text
+{
+    char text[Length + 1]; /*!< the sentence, null terminated */
+};
+
+constexpr uint8_t pmtk_digits(uint32_t value)
+{
+    return value < 10 ? 1 : 1 + pmtk_digits(value / 10);
+}
+
+constexpr char pmtk_hex(uint8_t value)
+{
+    return value < 10 ? '0' + value : 'A' + (value - 10);
+}
+
+/**
+    @brief the length of a sentence, $PMTKttt, the arguments, *hh and CR LF
+*/
+template <uint32_t... Arguments> constexpr size_t pmtk_length()
+{
+    return 8 + (0 + ... + (1 + pmtk_digits(Arguments))) + 5;
+}
+
+template <size_t Length> constexpr size_t pmtk_put_number(pmtk_text<Length> &sentence, size_t position, uint32_t value)
+{
+    size_t end = position + pmtk_digits(value);
+    size_t index = end;
+    do
+    {
+        sentence.text[--index] = '0' + value % 10;
+        value /= 10;
+    } while (index > position);
+    return end;
+}
+
+/**
+    @brief build a sentence, the compiler runs this, it is never in the program
+*/
+template <uint16_t Type, uint32_t... Arguments> constexpr pmtk_text<pmtk_length<Arguments...>()> pmtk_build()
+{
+    pmtk_text<pmtk_length<Arguments...>()> sentence{};
+    // the extra 0 keeps the array from being empty when there are no arguments
+    const uint32_t arguments[] = {Arguments..., 0};
+    size_t position = 0;
+    uint8_t checksum = 0;
+
+    sentence.text[position++] = '$';
+    sentence.text[position++] = 'P';
+    sentence.text[position++] = 'M';
+    sentence.text[position++] = 'T';
+    sentence.text[position++] = 'K';
+    sentence.text[position++] = '0' + Type / 100 % 10;
+    sentence.text[position++] = '0' + Type / 10 % 10;
+    sentence.text[position++] = '0' + Type % 10;
+    for (size_t index = 0; index < sizeof...(Arguments); index++)
+    {
+        sentence.text[position++] = ',';
+        position = pmtk_put_number(sentence, position, arguments[index]);
+    }
+    // the checksum covers everything between the $ and the *
+    for (size_t index = 1; index < position; index++)
+    {
+        checksum ^= (uint8_t)sentence.text[index];
+    }
+    sentence.text[position++] = '*';
+    sentence.text[position++] = pmtk_hex(checksum >> 4);
+    sentence.text[position++] = pmtk_hex(checksum & 0x0f);
+    sentence.text[position++] = '\r';
+    sentence.text[position++] = '\n';
+    sentence.text[position] = 0;
+    return sentence;
+}
+
+/**
+    @brief a PMTK command with fixed arguments
+
+    @param Type the packet type, 0 to 999
+    @param Arguments the numbers after the type
+*/
+template <uint16_t Type, uint32_t... Arguments> struct pmtk_command
+{
+    static_assert(Type < 1000, "a PMTK packet type has three digits");
+    static constexpr pmtk_text<pmtk_length<Arguments...>()> sentence PROGMEM = pmtk_build<Type, Arguments...>();
+    static constexpr size_t length = pmtk_length<Arguments...>();
+    static constexpr uint16_t type = Type; /*!< the PMTK001 ack names this type */
+};
+
+/**
+    @brief PMTK314, how often each NMEA sentence is sent, in fixes, 0 turns it off
+*/
+template <uint8_t Gll, uint8_t Rmc, uint8_t Vtg, uint8_t Gga, uint8_t Gsa, uint8_t Gsv>
+struct pmtk_nmea_output : pmtk_command<314, Gll, Rmc, Vtg, Gga, Gsa, Gsv, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0>
+{
+    static_assert(Gll <= 5 && Rmc <= 5 && Vtg <= 5 && Gga <= 5 && Gsa <= 5 && Gsv <= 5,
+                  "the MT3333 sends a sentence at most once every 5 fixes");
+};
+
+/**
+    @brief PMTK220, the fix interval in milliseconds
+*/
+template <uint32_t Milliseconds> struct pmtk_fix_interval : pmtk_command<220, Milliseconds>
+{
+    static_assert(Milliseconds >= 100 && Milliseconds <= 10000, "the MT3333 fix interval is 100 to 10000 ms");
+};
+
+/**
+    @brief PMTK225, periodic power saving.  Mode 1 is backup and mode 2 is standby, the gps
+    runs for Run ms and then sleeps for Sleep ms, the second pair is used when there is no fix
+*/
+template <uint8_t Mode, uint32_t Run, uint32_t Sleep, uint32_t SecondRun, uint32_t SecondSleep>
+struct pmtk_periodic : pmtk_command<225, Mode, Run, Sleep, SecondRun, SecondSleep>
+{
+    static_assert(Mode == 1 || Mode == 2, "periodic mode 1 is backup, 2 is standby");
+    static_assert(Run >= 1000 && Sleep >= 1000 && SecondRun >= 1000 && SecondSleep >= 1000 &&
+                      Run <= 518400000UL && Sleep <= 518400000UL && SecondRun <= 518400000UL &&
+                      SecondSleep <= 518400000UL,
+                  "the MT3333 periodic run and sleep times are 1 second to 6 days");
+};
+
+/**
+    @brief PMTK251, the baud rate of the gps uart, it is kept while the gps has backup power
+*/
+template <uint32_t Baud> struct pmtk_baud_rate : pmtk_command<251, Baud>
+{
+    static_assert(Baud == 4800 || Baud == 9600 || Baud == 14400 || Baud == 19200 || Baud == 38400 ||
+                      Baud == 57600 || Baud == 115200,
+                  "the MT3333 takes 4800, 9600, 14400, 19200, 38400, 57600 or 115200 baud");
+};
+
+typedef pmtk_command<0> pmtk_test;               /*!< does nothing but ack, wakes the gps from standby */
+typedef pmtk_command<161, 0> pmtk_standby;       /*!< standby until the next byte arrives */
+typedef pmtk_command<225, 0> pmtk_normal_power;  /*!< leave the periodic mode */
+
+constexpr bool pmtk_equal(const char *first, const char *second)
+{
+    return *first == *second && (*first == 0 || pmtk_equal(first + 1, second + 1));
+}
+
+// these are the sentences that were written out by hand before, with their checksums
+static_assert(pmtk_equal(pmtk_fix_interval<10000>::sentence.text, "$PMTK220,10000*2F\r\n"),
+              "the PMTK checksum is wrong");
+static_assert(pmtk_equal(pmtk_nmea_output<0, 1, 0, 0, 0, 0>::sentence.text,
+                         "$PMTK314,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*29\r\n"),
+              "the PMTK checksum is wrong");
+static_assert(pmtk_equal(pmtk_test::sentence.text, "$PMTK000*32\r\n"), "the PMTK checksum is wrong");
+
+#endif
@@ -0,0 +1,138 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file position_packet.h
+    @brief Binary wire format for a position report.
+
+    This file and position_packet.cpp do not use anything from the arduino, so the receiver on
+    linux can compile the same encode and decode functions.
+
+    All multi byte values are sent little endian.
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 0  | 1 | POSITION_PACKET_MAGIC or'ed with the version |
+      | 1  | 6 | call sign, padded with spaces |
+      | 7  | 1 | flags, POSITION_FLAG_ values |
+      | 8  | 4 | latitude, signed, 1e-7 degrees, north is positive |
+      | 12 | 4 | longitude, signed, 1e-7 degrees, east is positive |
+      | 16 | 3 | utc time of day in units of 10 milliseconds |
+      | 19 | 2 | date, (year - 2000) << 9 , month << 5, day |
+      | 21 | 2 | speed over ground, 0.01 knots |
+      | 23 | 2 | course over ground, 0.01 degrees |
+
+    Version 2 is sent when the fix has a GGA or GSA behind it, it is version 1 with
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 25 | 3 | altitude above mean sea level, signed, decimeters |
+      | 28 | 1 | satellites used |
+      | 29 | 2 | horizontal dilution of precision, 0.01 |
+    added to the end.  POSITION_FLAG_ALTITUDE_VALID and POSITION_FLAG_DOP_VALID say which of
+    them mean anything.  A fix from an RMC alone still goes as version 1.
+
+    A history packet carries fixes that were not acked when they were live, fix_store.h sends
+    them again once the base station answers
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 0  | 1 | POSITION_HISTORY_MAGIC or'ed with the version |
+      | 1  | 6 | call sign |
+      | 7  | 2 | date of every fix in the packet |
+      | 9  | 1 | number of fixes |
+      | 10 | 16 each | flags, latitude, longitude, time of day, speed and course as in version 1 |
+    The fixes are oldest first.  A stored record is the 16 bytes of a fix with its date after it.
+
+    A batch packet carries several live fixes of one date, fix_batch.h fills it
+      | offset | size | value |
+      |:------:|:----:|:------|
+      | 0  | 1 | POSITION_BATCH_MAGIC or'ed with the version |
+      | 1  | 6 | call sign |
+      | 7  | 2 | date of every fix in the packet |
+      | 9  | 1 | number of fixes |
+      | 10 | 16 | the first fix as in a history packet |
+      | 26 | 6 to 21 each | flags, then the change from the fix before of latitude, longitude, time of day, speed and course |
+    The changes are varints, seven bits a byte low bits first with the top bit set on every
+    byte but the last.  The time of day only goes forward and is sent as it is, the others are
+    zigzag encoded first, 0 -1 1 -2 2 become 0 1 2 3 4, so a small change either way is one
+    byte.  A fix a second at motorway speed takes about 9 bytes instead of 25.
+
+    The first byte always has the top bit set, a legacy ascii packet always starts with a
+    printable call sign, so the receiver can tell the two apart.
+**/
+#ifndef position_packet_h
+#define position_packet_h
+#include <stdint.h>
+
+#define POSITION_PACKET_MAGIC 0xB0
+#define POSITION_PACKET_VERSION 1
+#define POSITION_PACKET_LENGTH 25
+#define POSITION_PACKET_QUALITY_VERSION 2
+#define POSITION_PACKET_QUALITY_LENGTH 31
+#define CALL_SIGN_LENGTH 6
+#define POSITION_HISTORY_MAGIC 0xD0
+#define POSITION_HISTORY_VERSION 1
+#define POSITION_HISTORY_HEADER 10
+#define POSITION_HISTORY_ENTRY 16
+#define POSITION_RECORD_LENGTH (POSITION_HISTORY_ENTRY + 2)
+#define POSITION_BATCH_MAGIC 0xE0
+#define POSITION_BATCH_VERSION 1
+#define POSITION_BATCH_HEADER 10
+#define POSITION_BATCH_COUNT 9
+#define POSITION_BATCH_MAX_DELTA 21
+
+#define POSITION_FLAG_VALID 0x01        /*!< the receiver had a fix, status A */
+#define POSITION_FLAG_SPEED_VALID 0x02  /*!< speed over ground was present */
+#define POSITION_FLAG_COURSE_VALID 0x04 /*!< course over ground was present */
+#define POSITION_FLAG_ALTITUDE_VALID 0x08 /*!< altitude from a GGA with a fix */
+#define POSITION_FLAG_DOP_VALID 0x10    /*!< satellites and hdop from a GGA or GSA */
+
+struct packet_builder;
+
+/**
+    @brief a decoded position report
+*/
+struct position_fix
+{
+    char call_sign[CALL_SIGN_LENGTH]; /*!< not null terminated */
+    uint8_t flags;                    /*!< POSITION_FLAG_ values */
+    int32_t latitude;                 /*!< 1e-7 degrees, north is positive */
+    int32_t longitude;                /*!< 1e-7 degrees, east is positive */
+    uint32_t time_of_day;             /*!< utc, 10 milliseconds since midnight */
+    uint16_t date;                    /*!< (year - 2000) << 9 | month << 5 | day */
+    uint16_t speed;                   /*!< 0.01 knots */
+    uint16_t course;                  /*!< 0.01 degrees */
+    int32_t altitude;                 /*!< decimeters above mean sea level, version 2 */
+    uint8_t satellites;               /*!< satellites used, version 2 */
+    uint16_t hdop;                    /*!< horizontal dilution of precision, 0.01, version 2 */
+};
+
+extern bool position_fix_from_rmc(char *const *tokens, uint8_t number_of_tokens, const char *call_sign,
+                                  struct position_fix *fix);
+extern uint8_t position_packet_encode(const struct position_fix *fix, uint8_t *buffer, uint8_t buffer_size);
+extern bool position_packet_decode(const uint8_t *buffer, uint8_t length, struct position_fix *fix);
+extern void position_record_pack(const struct position_fix *fix, uint8_t *record);
+extern void position_record_unpack(const uint8_t *record, struct position_fix *fix);
+extern uint16_t position_record_date(const uint8_t *record);
+extern uint8_t position_history_encode(const char *call_sign, const uint8_t *records, uint8_t count, uint8_t *buffer,
+                                       uint8_t buffer_size);
+extern uint8_t position_history_count(const uint8_t *buffer, uint8_t length);
+extern bool position_history_decode(const uint8_t *buffer, uint8_t length, uint8_t index, struct position_fix *fix);
+extern bool position_batch_start(struct packet_builder *builder, const char *call_sign, const struct position_fix *fix);
+extern bool position_batch_append(struct packet_builder *builder, const struct position_fix *previous,
+                                  const struct position_fix *fix);
+
+/**
+    @brief walks through the fixes of a batch packet, each one is worked out from the one before
+*/
+struct position_batch_reader
+{
+    const uint8_t *buffer; /*!< the packet */
+    uint8_t length;        /*!< its length */
+    uint8_t position;      /*!< the next byte to read */
+    uint8_t left;          /*!< fixes not read yet */
+};
+
+extern bool position_batch_first(struct position_batch_reader *reader, const uint8_t *buffer, uint8_t length,
+                                 struct position_fix *fix);
+extern bool position_batch_next(struct position_batch_reader *reader, struct position_fix *fix);
+
+#endif
@@ -0,0 +1,100 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file power_manager.h
+    @brief Duty cycling of the radio and the mcu, and a time and charge account of every part.
+
+    power_manager_service is called at the top of every pass of the loop.  It puts the radio to
+    sleep as soon as the transmit queue has nothing left to send or wait for, RH_RF69::send wakes
+    it again.  power_manager_sleep is called at the bottom of the loop, it stops the mcu until
+    the next interrupt when there is nothing to do.  The uart receive, the radio and the timer
+    interrupts all wake it, so nothing is missed.
+
+    With POWER_DEEP_SLEEP defined the 32u4 is powered down on the watchdog between gps
+    sentences instead, and woken a little before the next one is due.  That also stops the usb
+    serial port, so it is only for trackers that run on a battery with nothing plugged in.
+
+    The gps is switched by the caller, it tells the manager which state it is in for the
+    account.  The account multiplies the time in each state by the typical current of that
+    state, so it is an estimate, good for comparing settings, not a meter.
+**/
+#ifndef power_manager_h
+#define power_manager_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <RHGenericDriver.h>
+#include <tx_queue.h>
+
+// #define POWER_DEEP_SLEEP 1
+
+#define POWER_MCU_ACTIVE 0
+#define POWER_MCU_SLEEP 1
+#define POWER_RADIO_SLEEP 2
+#define POWER_RADIO_IDLE 3
+#define POWER_RADIO_RX 4
+#define POWER_RADIO_TX 5
+#define POWER_GPS_ON 6
+#define POWER_GPS_STANDBY 7
+#define POWER_GPS_PERIODIC 8
+#define POWER_STATE_COUNT 9
+
+/**
+    @brief typical supply current of each state in microamps at 3.3 volts, from the 32u4,
+    RFM69HCW and CD-PA1616D data sheets.  The periodic gps current is worked out from the run and
+    sleep times given to power_manager_set_periodic.
+*/
+#define POWER_CURRENT_MCU_ACTIVE 8000
+#define POWER_CURRENT_MCU_SLEEP 2500
+#define POWER_CURRENT_RADIO_SLEEP 1
+#define POWER_CURRENT_RADIO_IDLE 1250
+#define POWER_CURRENT_RADIO_RX 16000
+#define POWER_CURRENT_RADIO_TX 130000
+#define POWER_CURRENT_GPS_ON 25000
+#define POWER_CURRENT_GPS_STANDBY 1000
+
+/**
+    @brief the mcu is only powered down when the next sentence is at least this far away, in ms
+    @param POWER_DEEP_SLEEP_MIN
+*/
+#define POWER_DEEP_SLEEP_MIN 100
+/**
+    @brief the mcu wakes this many ms plus an eighth of the wait before the next sentence is
+    due.  The watchdog clock is only good to about 10 percent.
+    @param POWER_DEEP_SLEEP_GUARD
+*/
+#define POWER_DEEP_SLEEP_GUARD 50
+
+/**
+    @brief the power account and the sleep schedule
+*/
+struct power_manager
+{
+    RHGenericDriver *radio;                   /*!< the radio that is put to sleep */
+    struct tx_queue *queue;                   /*!< the radio only sleeps when this is idle */
+    uint8_t gps_state;                        /*!< POWER_GPS_ON, POWER_GPS_STANDBY or POWER_GPS_PERIODIC */
+    uint32_t gps_periodic_current;            /*!< average current of the periodic mode in microamps */
+    uint32_t radio_tx_current;                /*!< current while sending in microamps, it follows the transmit power */
+    uint32_t last_update;                     /*!< micros() of the last account update */
+    uint32_t asleep;                          /*!< microseconds the mcu slept since the last update */
+    uint32_t powered_down;                    /*!< microseconds of asleep that micros() did not count */
+    uint8_t radio_state;                      /*!< the radio state since the last update */
+    uint32_t next_sentence;                   /*!< millis() when the next gps sentence is expected */
+    uint32_t time[POWER_STATE_COUNT];         /*!< milliseconds spent in each state */
+    uint16_t time_fraction[POWER_STATE_COUNT]; /*!< microseconds not yet added to time */
+    uint32_t charge;                          /*!< millicoulombs (milliamp seconds) used */
+    uint32_t charge_fraction;                 /*!< microamp milliseconds not yet added to charge */
+    uint32_t radio_sleeps;                    /*!< times the radio was put to sleep */
+};
+
+extern void power_manager_init(struct power_manager *manager, RHGenericDriver *radio, struct tx_queue *queue);
+extern void power_manager_service(struct power_manager *manager);
+extern void power_manager_set_gps(struct power_manager *manager, uint8_t state);
+extern void power_manager_set_periodic(struct power_manager *manager, uint32_t run, uint32_t sleep);
+extern void power_manager_set_tx_current(struct power_manager *manager, uint32_t current);
+extern void power_manager_expect_sentence(struct power_manager *manager, uint32_t milliseconds);
+extern void power_manager_sleep(struct power_manager *manager);
+extern void power_manager_reset(struct power_manager *manager);
+extern void power_manager_print(const struct power_manager *manager, Print &out);
+
+#endif
@@ -0,0 +1,86 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file ram_arena.h
+    @brief One static scratch buffer for the steps of the loop, and how much ram the stack has left.
+
+    The 32u4 has 2560 bytes of ram for the globals and the stack.  Some steps of the loop need
+    a buffer only while they run, and they run one after another, never inside each other:
+      | user | needs it | for |
+      |:-----|:---------|:----|
+      | RAM_ARENA_TOKENS | from the RMC being split to its packet being built | the field pointers |
+      | RAM_ARENA_HISTORY | while fix_store_backfill builds a history packet | the records read from the store |
+      | RAM_ARENA_GPS_COMMAND | while gps_link writes a command | the text of the command |
+    They share union ram_arena_space, which the compiler sizes for the biggest of them, in
+    place of a global or a stack buffer each.  A step takes the arena when it starts and gives
+    it back when it is done.  If it is already taken, ram_arena_take returns NULL and counts
+    it, so a change that makes two of them overlap shows up on the mem console command instead
+    of corrupting the other one.
+
+    The stack grows down from the top of ram towards the globals.  The first thing setup does is
+    ram_arena_paint, which fills everything between the end of the globals and a little under
+    its own stack frame with RAM_ARENA_PAINT.  ram_stack_unused counts how much of it the stack
+    has never written over.  That is the least free ram there has been since setup started.
+    ram_free is what is free right now.
+**/
+#ifndef ram_arena_h
+#define ram_arena_h
+#include <stdint.h>
+#include <Arduino.h>
+#include <nmea.h>
+#include <fix_store.h>
+#include <gps_link.h>
+
+/**
+    @brief the byte the free ram is painted with at the start of setup
+*/
+#define RAM_ARENA_PAINT 0xC5
+/**
+    @brief bytes under the stack frame of ram_arena_paint that are not painted, more than its
+    own frame and the return address
+    @param RAM_ARENA_PAINT_GUARD
+*/
+#define RAM_ARENA_PAINT_GUARD 32
+
+/**
+    @brief who has the arena
+*/
+enum ram_arena_user
+{
+    RAM_ARENA_NONE,
+    RAM_ARENA_TOKENS,
+    RAM_ARENA_HISTORY,
+    RAM_ARENA_GPS_COMMAND,
+};
+
+/**
+    @brief what each user keeps in the arena
+*/
+union ram_arena_space
+{
+    char *tokens[NMEA_MAX_FIELDS];                            /*!< RAM_ARENA_TOKENS */
+    uint8_t history[FIX_STORE_BATCH][POSITION_RECORD_LENGTH]; /*!< RAM_ARENA_HISTORY */
+    char gps_command[GPS_LINK_COMMAND_SIZE];                  /*!< RAM_ARENA_GPS_COMMAND */
+};
+
+/**
+    @brief how the arena has been used
+*/
+struct ram_arena_stats
+{
+    uint16_t takes;    /*!< times it was taken */
+    uint16_t busy;     /*!< times it was already taken, each is a bug */
+    uint8_t last_busy; /*!< the user that found it taken last */
+};
+
+extern void ram_arena_paint(void);
+extern union ram_arena_space *ram_arena_take(uint8_t user);
+extern void ram_arena_release(uint8_t user);
+extern uint8_t ram_arena_holder(void);
+extern const struct ram_arena_stats *ram_arena_stats(void);
+extern uint16_t ram_free(void);
+extern uint16_t ram_stack_unused(void);
+extern void ram_arena_print(Print &out);
+
+#endif
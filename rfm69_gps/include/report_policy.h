@@ -0,0 +1,90 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file report_policy.h
+    @brief Decide which fixes are worth sending.
+
+    The base station can dead reckon from the last report, it knows where the tracker was, how
+    fast it was going and which way.  A fix is only sent when it tells the base something it
+    could not have worked out by itself:
+      - the tracker is more than distance meters from where the last report says it should be
+      - the course turned by more than course_change, or the speed changed by more than
+        speed_change.  These start a burst, the next burst_length fixes are all sent so the base
+        sees the whole turn.
+      - nothing was sent for heartbeat seconds, so the base knows the tracker is still alive
+      - the gps gained or lost its fix
+    Apart from a burst nothing is sent more often than every min_interval seconds.
+
+    The policy also picks the gps fix interval.  Once the tracker has been standing still for
+    parked_fixes fixes the gps is slowed down to parked_fix_interval, the first fix that moves
+    puts it back to moving_fix_interval.
+
+    The times come from the utc time in the fixes, so the policy does not need a clock.
+**/
+#ifndef report_policy_h
+#define report_policy_h
+#include <stdint.h>
+#include <position_packet.h>
+
+#define REPORT_REASON_NONE 0      /*!< suppressed, the base already knows */
+#define REPORT_REASON_FIRST 1     /*!< the first fix after start up */
+#define REPORT_REASON_STATUS 2    /*!< the fix became valid or was lost */
+#define REPORT_REASON_HEARTBEAT 3 /*!< nothing was sent for too long */
+#define REPORT_REASON_DISTANCE 4  /*!< too far from the dead reckoned position */
+#define REPORT_REASON_COURSE 5    /*!< the course changed */
+#define REPORT_REASON_SPEED 6     /*!< the speed changed */
+#define REPORT_REASON_BURST 7     /*!< sent because a turn or speed change is in progress */
+#define REPORT_REASON_COUNT 8
+
+/**
+    @brief the thresholds, report_policy_init fills in the defaults below
+*/
+struct report_policy_config
+{
+    uint16_t distance;            /*!< meters from the dead reckoned position */
+    uint16_t course_change;       /*!< 0.01 degrees */
+    uint16_t speed_change;        /*!< 0.01 knots */
+    uint16_t moving_speed;        /*!< 0.01 knots, slower than this is standing still and the course is noise */
+    uint16_t heartbeat;           /*!< seconds, the longest time without a report */
+    uint16_t min_interval;        /*!< seconds, the shortest time between reports outside a burst */
+    uint8_t burst_length;         /*!< fixes sent in a row after a turn or speed change */
+    uint8_t parked_fixes;         /*!< fixes standing still before the gps is slowed down */
+    uint16_t moving_fix_interval; /*!< gps fix interval in milliseconds while moving */
+    uint16_t parked_fix_interval; /*!< gps fix interval in milliseconds while standing still */
+};
+
+#define REPORT_DEFAULT_DISTANCE 50
+#define REPORT_DEFAULT_COURSE_CHANGE 2500
+#define REPORT_DEFAULT_SPEED_CHANGE 500
+#define REPORT_DEFAULT_MOVING_SPEED 150
+#define REPORT_DEFAULT_HEARTBEAT 300
+#define REPORT_DEFAULT_MIN_INTERVAL 5
+#define REPORT_DEFAULT_BURST_LENGTH 3
+#define REPORT_DEFAULT_PARKED_FIXES 10
+// set with -D REPORT_DEFAULT_MOVING_FIX_INTERVAL=100 for 10 fixes a second while moving, the gps
+// link rate has to keep up, rfm69_gps.cpp checks it
+#ifndef REPORT_DEFAULT_MOVING_FIX_INTERVAL
+#define REPORT_DEFAULT_MOVING_FIX_INTERVAL 1000
+#endif
+#define REPORT_DEFAULT_PARKED_FIX_INTERVAL 10000
+
+/**
+    @brief the state of the policy
+*/
+struct report_policy
+{
+    struct report_policy_config config;       /*!< the thresholds */
+    struct position_fix last;                 /*!< the last fix that was reported */
+    bool have_last;                           /*!< false until the first report */
+    uint8_t burst_left;                       /*!< fixes still to send in the current burst */
+    uint8_t parked_count;                     /*!< fixes in a row standing still */
+    uint16_t fix_interval;                    /*!< the fix interval the gps should be using */
+    uint32_t suppressed;                      /*!< fixes that were not sent */
+    uint16_t reasons[REPORT_REASON_COUNT];    /*!< reports sent, by REPORT_REASON_ */
+};
+
+extern void report_policy_init(struct report_policy *policy);
+extern uint8_t report_policy_check(struct report_policy *policy, const struct position_fix *fix);
+
+#endif
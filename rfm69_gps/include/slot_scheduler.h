@@ -0,0 +1,106 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file slot_scheduler.h
+    @brief Time slots for the transmitters of one network, from the gps utc time.
+
+    Every tracker of a network has the same frequency and sync words, and every gps makes its
+    fix at the top of the same utc second, so trackers that send as soon as a fix is in all
+    send together and collide.  The scheduler splits each SLOT_FRAME_LENGTH ms of utc time in
+    slots and gives each tracker one, and it is the tx_queue gate, so a frame, and every retry
+    of it, is only sent when it and its ack fit in the tracker's slot less SLOT_GUARD ms at
+    each end.
+
+    The time base is the utc time of each valid RMC, taken at the micros() of its line feed
+    less SLOT_GPS_DELAY.  Every tracker with the same gps and sentences has about the same
+    delay, so the part of it that is not known cancels out.  With the gps PPS output wired
+    to SLOT_PPS_PIN the edge of a whole utc second is used instead, which is good to a few
+    microseconds.  Between fixes the local clock runs on, corrected by the rate it was
+    measured to run at over at least SLOT_RATE_SPAN ms, the 32u4's resonator can be off by
+    a few tenths of a percent.  After SLOT_HOLDOVER ms without a fix, or before the first
+    one, the gate is open and the tracker sends as it did without slots.
+**/
+#ifndef slot_scheduler_h
+#define slot_scheduler_h
+#include <stdint.h>
+#include <Arduino.h>
+
+/**
+    @brief ms of utc time the slots repeat in, it has to divide a day
+    @param SLOT_FRAME_LENGTH
+*/
+#ifndef SLOT_FRAME_LENGTH
+#define SLOT_FRAME_LENGTH 1000
+#endif
+/**
+    @brief ms kept clear at each end of a slot for the clock error of the trackers
+    @param SLOT_GUARD
+*/
+#ifndef SLOT_GUARD
+#define SLOT_GUARD 5
+#endif
+/**
+    @brief ms from the utc second to the line feed of its RMC, the same for every tracker of a
+    network so it only matters against the PPS ones
+    @param SLOT_GPS_DELAY
+*/
+#ifndef SLOT_GPS_DELAY
+#define SLOT_GPS_DELAY 0
+#endif
+/**
+    @brief the shortest time in ms the clock rate is measured over, shorter ones are mostly
+    the jitter of the line feed
+    @param SLOT_RATE_SPAN
+*/
+#define SLOT_RATE_SPAN 16000
+/**
+    @brief the most the local clock is believed to be off, in parts per million
+    @param SLOT_MAX_PPM
+*/
+#define SLOT_MAX_PPM 10000
+/**
+    @brief ms the slots are kept without a new utc time
+    @param SLOT_HOLDOVER
+*/
+#define SLOT_HOLDOVER 120000
+
+/**
+    @brief how well the time base is doing
+*/
+struct slot_stats
+{
+    uint32_t syncs;       /*!< utc times taken */
+    uint32_t pps_syncs;   /*!< of them, from the PPS edge */
+    int32_t last_error;   /*!< us the last sync moved the slot edge, how far the clock had run off */
+    uint32_t worst_error; /*!< the biggest move */
+};
+
+/**
+    @brief the slot of this tracker and the time base
+*/
+struct slot_scheduler
+{
+    uint8_t slot;                 /*!< this tracker's slot */
+    uint8_t slots;                /*!< slots in a frame */
+    bool synced;                  /*!< there is a time base */
+    uint32_t sync_micros;         /*!< micros() of the last utc time */
+    uint32_t sync_phase;          /*!< where in the frame that was, ms */
+    uint32_t anchor_micros;       /*!< micros() of the start of the rate measurement */
+    uint32_t anchor_time;         /*!< utc ms of the day then */
+    bool anchored;                /*!< the rate measurement has a start */
+    bool rate_known;              /*!< ppm has been measured */
+    int32_t ppm;                  /*!< how fast the local clock runs, parts per million */
+    volatile uint32_t pps_micros; /*!< micros() of the last PPS edge */
+    volatile bool pps_seen;       /*!< a PPS edge came in since the last sync */
+    struct slot_stats stats;      /*!< counters for the console */
+};
+
+extern void slot_scheduler_init(struct slot_scheduler *scheduler, uint8_t slot, uint8_t slots);
+extern void slot_scheduler_sync(struct slot_scheduler *scheduler, uint32_t time_of_day, uint32_t line_feed);
+extern void slot_scheduler_pps(struct slot_scheduler *scheduler);
+extern uint16_t slot_scheduler_wait(struct slot_scheduler *scheduler, uint16_t duration);
+extern uint16_t slot_scheduler_gate(void *scheduler, uint16_t duration);
+extern void slot_scheduler_print(const struct slot_scheduler *scheduler, Print &out);
+
+#endif
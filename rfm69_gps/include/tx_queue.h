@@ -0,0 +1,148 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file tx_queue.h
+    @brief Fixed size transmit queue with non-blocking reliable delivery.
+
+    This does the same job as RHReliableDatagram::sendtoWait, using the same headers, sequence
+    numbers and ack format so the base station does not change, but it never waits.  Each call
+    to tx_queue_service moves the state machine on as far as it can without blocking:
+        idle -> hold -> sending -> waiting for the ack -> (backoff -> hold -> sending) -> idle
+    A missing ack is retried after a randomized, growing backoff, so two nodes that collided do
+    not collide again on the retry.  With a gate set, each send is held until the gate says the
+    channel is ours, see slot_scheduler.h, without one the hold step passes straight through.
+**/
+#ifndef tx_queue_h
+#define tx_queue_h
+#include <stdint.h>
+#include <RHGenericDriver.h>
+#include <RH_RF69.h>
+
+/**
+    @brief number of frames that can wait to be sent, each costs RH_RF69_MAX_MESSAGE_LEN + 10 bytes of ram
+    @param TX_QUEUE_CAPACITY
+*/
+#define TX_QUEUE_CAPACITY 3
+/**
+    @brief how many times a frame is resent when no ack comes back
+    @param TX_QUEUE_DEFAULT_RETRIES
+*/
+#define TX_QUEUE_DEFAULT_RETRIES 3
+/**
+    @brief how long to wait for an ack, in milliseconds
+    @param TX_QUEUE_DEFAULT_ACK_TIMEOUT
+*/
+#define TX_QUEUE_DEFAULT_ACK_TIMEOUT 200
+/**
+    @brief the most a retry is held back, the backoff is random between 0 and this times the attempt
+    @param TX_QUEUE_DEFAULT_BACKOFF
+*/
+#define TX_QUEUE_DEFAULT_BACKOFF 100
+/**
+    @brief bits a second on the air, GFSK_Rb250Fd250 is what RH_RF69::init sets
+    @param TX_QUEUE_DEFAULT_BIT_RATE
+*/
+#define TX_QUEUE_DEFAULT_BIT_RATE 250000
+/**
+    @brief bytes on the air around each payload, preamble 4, sync words 2, length 1,
+    RadioHead header 4 and crc 2
+    @param TX_QUEUE_FRAME_OVERHEAD
+*/
+#define TX_QUEUE_FRAME_OVERHEAD 13
+
+#define TX_STATE_IDLE 0
+#define TX_STATE_SENDING 1
+#define TX_STATE_WAIT_ACK 2
+#define TX_STATE_BACKOFF 3
+#define TX_STATE_HOLD 4
+
+/**
+    @brief a frame waiting to be sent
+*/
+struct tx_frame
+{
+    uint8_t to;                            /*!< destination address */
+    uint8_t length;                        /*!< payload length */
+    uint32_t committed;                    /*!< micros() when the frame was committed, its age is taken from it */
+    uint32_t origin;                       /*!< micros() when the data in the frame came in, see tx_queue_commit_from */
+    uint8_t data[RH_RF69_MAX_MESSAGE_LEN]; /*!< the payload */
+};
+
+/**
+    @brief delivery statistics, all times in milliseconds
+*/
+struct tx_stats
+{
+    uint32_t queued;          /*!< frames committed to the queue */
+    uint32_t delivered;       /*!< frames that were acked */
+    uint32_t failed;          /*!< frames given up on after the last retry */
+    uint32_t dropped;         /*!< frames refused because the queue was full */
+    uint32_t retries;         /*!< resends after a missing ack */
+    uint32_t latency_total;   /*!< sum of queue to ack latency of the delivered frames */
+    uint16_t latency_min;     /*!< fastest queue to ack latency */
+    uint16_t latency_max;     /*!< slowest queue to ack latency */
+    int16_t last_ack_rssi;    /*!< rssi of the last ack in dBm */
+    uint32_t air_bits;        /*!< bits put on the air by every send and the acks that came back */
+    uint32_t held;            /*!< sends the gate held back */
+};
+
+struct tx_queue;
+
+/**
+    @brief called when a frame has been delivered or given up on
+
+    @param queue the queue the frame was on
+    @param frame the frame, it is only valid during the call
+    @param delivered true if an ack came back
+    @param attempts how many times the frame was sent
+*/
+typedef void (*tx_complete_callback)(struct tx_queue *queue, const struct tx_frame *frame, bool delivered,
+                                     uint8_t attempts);
+
+/**
+    @brief asked before every send if the channel may be used now
+
+    @param context the gate_context of the queue
+    @param duration ms the frame and its ack will have the channel
+    @return 0 to send now, or the ms to hold the frame before asking again
+*/
+typedef uint16_t (*tx_gate_callback)(void *context, uint16_t duration);
+
+/**
+    @brief one transmit queue and its state machine, there is usually one per radio
+*/
+struct tx_queue
+{
+    RHGenericDriver *driver;                  /*!< the radio */
+    uint8_t this_address;                     /*!< our node address */
+    uint8_t retries;                          /*!< resends after the first try */
+    uint16_t ack_timeout;                     /*!< how long to wait for an ack */
+    uint16_t backoff;                         /*!< backoff step for the retries */
+    uint32_t bit_rate;                        /*!< bits a second of the modem setting, for the air time */
+    struct tx_frame frames[TX_QUEUE_CAPACITY]; /*!< the ring of frames, head is the one being sent */
+    uint8_t head;                             /*!< index of the oldest frame */
+    uint8_t count;                            /*!< frames in the ring */
+    uint8_t state;                            /*!< one of the TX_STATE_ values */
+    uint8_t attempt;                          /*!< sends of the head frame so far */
+    uint8_t sequence;                         /*!< header id of the head frame */
+    uint32_t timer_start;                     /*!< millis() when the current wait started */
+    uint16_t timer_length;                    /*!< length of the current wait */
+    uint32_t sent_at;                         /*!< millis() of the last send of the head frame */
+    tx_complete_callback on_complete;         /*!< optional, called when a frame is finished */
+    tx_gate_callback gate;                    /*!< optional, holds each send until it returns 0 */
+    void *gate_context;                       /*!< handed to gate */
+    struct tx_stats stats;                    /*!< delivery statistics */
+};
+
+extern void tx_queue_init(struct tx_queue *queue, RHGenericDriver *driver, uint8_t this_address);
+extern void tx_queue_set_retries(struct tx_queue *queue, uint8_t retries, uint16_t ack_timeout, uint16_t backoff);
+extern uint8_t *tx_queue_reserve(struct tx_queue *queue);
+extern bool tx_queue_commit(struct tx_queue *queue, uint8_t length, uint8_t to);
+extern bool tx_queue_commit_from(struct tx_queue *queue, uint8_t length, uint8_t to, uint32_t origin);
+extern bool tx_queue_push(struct tx_queue *queue, const uint8_t *data, uint8_t length, uint8_t to);
+extern void tx_queue_service(struct tx_queue *queue);
+extern bool tx_queue_idle(const struct tx_queue *queue);
+extern uint32_t tx_queue_airtime(const struct tx_queue *queue);
+
+#endif
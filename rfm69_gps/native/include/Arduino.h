@@ -0,0 +1,131 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file Arduino.h
+    @brief Linux stand-in for the parts of the arduino core the firmware uses.
+
+    Only used by the [env:native] build.  Time is virtual, millis() and micros() return a clock
+    that only moves when delay() is called or the harness calls native_advance_micros(), so runs
+    are repeatable and never sleep.
+**/
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 3
+#define FALLING 2
+#define CHANGE 1
+#define DEC 10
+#define HEX 16
+
+#define F_CPU 8000000UL
+#define PROGMEM
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define strncmp_P strncmp
+#define strcmp_P strcmp
+#define digitalPinToInterrupt(pin) (pin)
+
+extern unsigned long millis(void);
+extern unsigned long micros(void);
+extern void delay(unsigned long ms);
+extern void delayMicroseconds(unsigned int us);
+extern void pinMode(uint8_t pin, uint8_t mode);
+extern void digitalWrite(uint8_t pin, uint8_t value);
+extern int digitalRead(uint8_t pin);
+extern void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+extern long random(long howbig);
+extern long random(long howsmall, long howbig);
+extern void randomSeed(unsigned long seed);
+extern void noInterrupts(void);
+extern void interrupts(void);
+
+// native only, used by the benchmark and simulation harness
+extern void native_set_micros(uint64_t now);
+extern void native_advance_micros(uint64_t delta);
+extern uint64_t native_micros64(void);
+extern uint8_t native_pin_state(uint8_t pin);
+extern unsigned long native_random_state(void);
+extern void native_set_random_state(unsigned long state);
+
+/**
+    @brief the subset of the arduino Print class the firmware uses
+*/
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t value) = 0;
+    size_t write(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *text) { return write(text); }
+    size_t print(const __FlashStringHelper *text) { return write((const char *)text); }
+    size_t print(char value) { return write((uint8_t)value); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t println(void) { return write("\r\n"); }
+    template <typename T> size_t println(T value) { return print(value) + println(); }
+    template <typename T> size_t println(T value, int base) { return print(value, base) + println(); }
+};
+
+/**
+    @brief a serial port.  What the firmware writes goes to output, what it reads comes from native_feed
+*/
+class HardwareSerial : public Print
+{
+public:
+    HardwareSerial() : baud_rate(0), output(NULL), tx_room(64) {}
+    void begin(unsigned long baud) { baud_rate = baud; }
+    void end(void) { baud_rate = 0; }
+    int available(void) { return (int)receive.size(); }
+    int peek(void) { return receive.empty() ? -1 : receive.front(); }
+    int read(void);
+    int availableForWrite(void) { return tx_room; }
+    void flush(void) {}
+    operator bool() { return true; }
+    using Print::write;
+    size_t write(uint8_t value);
+    // native only
+    void native_feed(const uint8_t *data, size_t length) { receive.insert(receive.end(), data, data + length); }
+    void native_clear(void) { receive.clear(); }
+    void native_set_output(FILE *file) { output = file; }
+    void native_set_tx_room(int room) { tx_room = room; }
+    unsigned long native_baud(void) { return baud_rate; }
+private:
+    unsigned long baud_rate;
+    FILE *output;
+    int tx_room;
+    std::deque<uint8_t> receive;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
@@ -0,0 +1,55 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file EEPROM.h
+    @brief Linux stand-in for the arduino EEPROM library, 1024 bytes like the 32u4.
+**/
+#ifndef EEPROM_h
+#define EEPROM_h
+#include <Arduino.h>
+
+#define NATIVE_EEPROM_SIZE 1024
+
+class EEPROMClass
+{
+public:
+    EEPROMClass() { memset(cells, 0xff, sizeof(cells)); writes = 0; }
+    uint8_t read(int address) { return cells[address % NATIVE_EEPROM_SIZE]; }
+    void write(int address, uint8_t value) { cells[address % NATIVE_EEPROM_SIZE] = value; writes++; }
+    void update(int address, uint8_t value)
+    {
+        if (read(address) != value)
+        {
+            write(address, value);
+        }
+    }
+    template <typename T> T &get(int address, T &value)
+    {
+        uint8_t *bytes = (uint8_t *)&value;
+        for (size_t index = 0; index < sizeof(T); index++)
+        {
+            bytes[index] = read(address + index);
+        }
+        return value;
+    }
+    template <typename T> const T &put(int address, const T &value)
+    {
+        const uint8_t *bytes = (const uint8_t *)&value;
+        for (size_t index = 0; index < sizeof(T); index++)
+        {
+            update(address + index, bytes[index]);
+        }
+        return value;
+    }
+    uint16_t length(void) { return NATIVE_EEPROM_SIZE; }
+    // native only, the number of cell writes, used to look at wear
+    uint32_t native_writes(void) { return writes; }
+private:
+    uint8_t cells[NATIVE_EEPROM_SIZE];
+    uint32_t writes;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,74 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file RHGenericDriver.h
+    @brief Linux stand-in for the RadioHead driver base class, same method names as RadioHead 1.122.
+**/
+#ifndef RHGenericDriver_h
+#define RHGenericDriver_h
+#include <RadioHead.h>
+
+class RHGenericDriver
+{
+public:
+    typedef enum
+    {
+        RHModeInitialising = 0,
+        RHModeSleep,
+        RHModeIdle,
+        RHModeTx,
+        RHModeRx,
+        RHModeCad
+    } RHMode;
+
+    RHGenericDriver();
+    virtual ~RHGenericDriver() {}
+    virtual bool init(void) { return true; }
+    virtual bool available(void) = 0;
+    virtual bool recv(uint8_t *buf, uint8_t *len) = 0;
+    virtual bool send(const uint8_t *data, uint8_t len) = 0;
+    virtual uint8_t maxMessageLength(void) = 0;
+    virtual bool waitPacketSent(void);
+    virtual bool waitAvailableTimeout(uint16_t timeout);
+    virtual void setThisAddress(uint8_t address) { _thisAddress = address; }
+    virtual void setHeaderTo(uint8_t to) { _txHeaderTo = to; }
+    virtual void setHeaderFrom(uint8_t from) { _txHeaderFrom = from; }
+    virtual void setHeaderId(uint8_t id) { _txHeaderId = id; }
+    virtual void setHeaderFlags(uint8_t set, uint8_t clear = RH_FLAGS_APPLICATION_SPECIFIC)
+    {
+        _txHeaderFlags &= ~clear;
+        _txHeaderFlags |= set;
+    }
+    virtual uint8_t headerTo(void) { return _rxHeaderTo; }
+    virtual uint8_t headerFrom(void) { return _rxHeaderFrom; }
+    virtual uint8_t headerId(void) { return _rxHeaderId; }
+    virtual uint8_t headerFlags(void) { return _rxHeaderFlags; }
+    virtual int16_t lastRssi(void) { return _lastRssi; }
+    virtual RHMode mode(void) { return _mode; }
+    virtual void setMode(RHMode mode) { _mode = mode; }
+    virtual bool sleep(void) { _mode = RHModeSleep; return true; }
+    virtual void setPromiscuous(bool promiscuous) { _promiscuous = promiscuous; }
+    uint16_t rxBad(void) { return _rxBad; }
+    uint16_t rxGood(void) { return _rxGood; }
+    uint16_t txGood(void) { return _txGood; }
+
+protected:
+    volatile RHMode _mode;
+    uint8_t _thisAddress;
+    bool _promiscuous;
+    volatile uint8_t _rxHeaderTo;
+    volatile uint8_t _rxHeaderFrom;
+    volatile uint8_t _rxHeaderId;
+    volatile uint8_t _rxHeaderFlags;
+    uint8_t _txHeaderTo;
+    uint8_t _txHeaderFrom;
+    uint8_t _txHeaderId;
+    uint8_t _txHeaderFlags;
+    volatile int16_t _lastRssi;
+    volatile uint16_t _rxBad;
+    volatile uint16_t _rxGood;
+    volatile uint16_t _txGood;
+};
+
+#endif
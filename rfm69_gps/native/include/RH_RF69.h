@@ -0,0 +1,103 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file RH_RF69.h
+    @brief Linux stand-in for the RadioHead RF69 driver.
+
+    Sent frames are kept in a list the harness can look at, and frames for this node can be
+    queued with native_inject.  With native_auto_ack set every addressed frame is acked at once,
+    the way a base station in range would.
+**/
+#ifndef RH_RF69_h
+#define RH_RF69_h
+#include <RHGenericDriver.h>
+#include <deque>
+#include <vector>
+
+#define RH_RF69_MAX_ENCRYPTABLE_PAYLOAD_LEN 64
+#define RH_RF69_HEADER_LEN 4
+#define RH_RF69_MAX_MESSAGE_LEN (RH_RF69_MAX_ENCRYPTABLE_PAYLOAD_LEN - RH_RF69_HEADER_LEN - 1)
+
+/**
+    @brief a frame as seen on the air
+*/
+struct native_rf69_frame
+{
+    uint8_t to;
+    uint8_t from;
+    uint8_t id;
+    uint8_t flags;
+    int16_t rssi;
+    std::vector<uint8_t> payload;
+};
+
+class RH_RF69 : public RHGenericDriver
+{
+public:
+    typedef enum
+    {
+        FSK_Rb2Fd5 = 0,
+        FSK_Rb2_4Fd4_8,
+        FSK_Rb4_8Fd9_6,
+        FSK_Rb9_6Fd19_2,
+        FSK_Rb19_2Fd38_4,
+        FSK_Rb38_4Fd76_8,
+        FSK_Rb57_6Fd120,
+        FSK_Rb125Fd125,
+        FSK_Rb250Fd250,
+        FSK_Rb55555Fd50,
+
+        GFSK_Rb2Fd5,
+        GFSK_Rb2_4Fd4_8,
+        GFSK_Rb4_8Fd9_6,
+        GFSK_Rb9_6Fd19_2,
+        GFSK_Rb19_2Fd38_4,
+        GFSK_Rb38_4Fd76_8,
+        GFSK_Rb57_6Fd120,
+        GFSK_Rb125Fd125,
+        GFSK_Rb250Fd250,
+        GFSK_Rb55555Fd50,
+
+        OOK_Rb1Bw1,
+        OOK_Rb1_2Bw75,
+        OOK_Rb2_4Bw4_8,
+        OOK_Rb4_8Bw9_6,
+        OOK_Rb9_6Bw19_2,
+        OOK_Rb19_2Bw38_4,
+        OOK_Rb32Bw64,
+    } ModemConfigChoice;
+
+    RH_RF69(uint8_t slaveSelectPin = 10, uint8_t interruptPin = 2);
+    virtual bool init(void);
+    virtual bool available(void);
+    virtual bool recv(uint8_t *buf, uint8_t *len);
+    virtual bool send(const uint8_t *data, uint8_t len);
+    virtual uint8_t maxMessageLength(void) { return RH_RF69_MAX_MESSAGE_LEN; }
+    virtual bool sleep(void);
+    virtual RHMode mode(void);
+    bool setFrequency(float centre, float afcPullInRange = 0.05);
+    void setTxPower(int8_t power, bool ishighpowermodule = true);
+    bool setModemConfig(ModemConfigChoice index);
+    void setSyncWords(const uint8_t *syncWords = NULL, uint8_t len = 0);
+    void setEncryptionKey(uint8_t *key = NULL) { (void)key; }
+    void setModeIdle(void) { _mode = RHModeIdle; }
+    void setModeRx(void) { _mode = RHModeRx; }
+    void setModeTx(void) { _mode = RHModeTx; }
+    int8_t temperatureRead(void) { return 25; }
+    int8_t rssiRead(void) { return -100; }
+
+    // native only
+    void native_inject(const native_rf69_frame &frame) { native_received.push_back(frame); }
+    bool native_auto_ack;
+    int16_t native_ack_rssi;
+    float native_frequency;
+    int8_t native_power;
+    ModemConfigChoice native_modem_config;
+    uint8_t native_sync_words[4];
+    uint8_t native_sync_length;
+    std::vector<native_rf69_frame> native_sent;
+    std::deque<native_rf69_frame> native_received;
+};
+
+#endif
@@ -0,0 +1,19 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file RadioHead.h
+    @brief Linux stand-in for the RadioHead common definitions.
+**/
+#ifndef RadioHead_h
+#define RadioHead_h
+#include <Arduino.h>
+
+#define RH_BROADCAST_ADDRESS 0xff
+#define RH_FLAGS_RESERVED 0xf0
+#define RH_FLAGS_APPLICATION_SPECIFIC 0x0f
+#define RH_FLAGS_NONE 0
+#define RH_FLAGS_ACK 0x80
+#define RH_FLAGS_RETRY 0x40
+
+#endif
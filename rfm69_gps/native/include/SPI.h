@@ -0,0 +1,11 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file SPI.h
+    @brief Linux stand-in, the native radio does not use a spi bus.
+**/
+#ifndef SPI_h
+#define SPI_h
+#include <Arduino.h>
+#endif
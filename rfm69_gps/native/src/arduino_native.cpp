@@ -0,0 +1,186 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  arduino_native.cpp
+    @author Ralph Blach
+    @brief Linux implementation of the arduino stand-in, only used by the [env:native] build.
+**/
+#include <Arduino.h>
+#include <EEPROM.h>
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+EEPROMClass EEPROM;
+
+static uint64_t virtual_micros = 0;   /*!< the virtual clock */
+static uint8_t pin_states[64];        /*!< last value written to each pin */
+static unsigned long random_state = 1; /*!< random(), 1 before randomSeed like avr-libc */
+
+unsigned long millis(void)
+{
+    return (unsigned long)(virtual_micros / 1000);
+}
+
+unsigned long micros(void)
+{
+    return (unsigned long)virtual_micros;
+}
+
+void delay(unsigned long ms)
+{
+    virtual_micros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    virtual_micros += us;
+}
+
+void native_set_micros(uint64_t now)
+{
+    virtual_micros = now;
+}
+
+void native_advance_micros(uint64_t delta)
+{
+    virtual_micros += delta;
+}
+
+uint64_t native_micros64(void)
+{
+    return virtual_micros;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    pin_states[pin % sizeof(pin_states)] = value;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin_states[pin % sizeof(pin_states)];
+}
+
+uint8_t native_pin_state(uint8_t pin)
+{
+    return pin_states[pin % sizeof(pin_states)];
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode)
+{
+    (void)interrupt;
+    (void)handler;
+    (void)mode;
+}
+
+void randomSeed(unsigned long seed)
+{
+    random_state = seed ? seed : 1;
+}
+
+long random(long howbig)
+{
+    if (howbig <= 0)
+    {
+        return 0;
+    }
+    // the same linear congruential generator on every host so runs repeat
+    random_state = random_state * 1103515245UL + 12345UL;
+    return (long)((random_state >> 16) % (unsigned long)howbig);
+}
+
+unsigned long native_random_state(void)
+{
+    return random_state;
+}
+
+void native_set_random_state(unsigned long state)
+{
+    // a simulation of several trackers gives each its own random()
+    random_state = state;
+}
+
+long random(long howsmall, long howbig)
+{
+    if (howsmall >= howbig)
+    {
+        return howsmall;
+    }
+    return howsmall + random(howbig - howsmall);
+}
+
+void noInterrupts(void)
+{
+}
+
+void interrupts(void)
+{
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t count = 0;
+    while (size--)
+    {
+        count += write(*buffer++);
+    }
+    return count;
+}
+
+size_t Print::print(long value, int base)
+{
+    if (value < 0 && base == DEC)
+    {
+        return print('-') + print((unsigned long)-value, base);
+    }
+    return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    char text[sizeof(unsigned long) * 8 + 1];
+    char *cursor = text + sizeof(text) - 1;
+    *cursor = 0;
+    do
+    {
+        unsigned digit = value % base;
+        *--cursor = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while (value);
+    return write(cursor);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return write(text);
+}
+
+int HardwareSerial::read(void)
+{
+    int value;
+    if (receive.empty())
+    {
+        return -1;
+    }
+    value = receive.front();
+    receive.pop_front();
+    return value;
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    if (output != NULL)
+    {
+        fputc(value, output);
+    }
+    return 1;
+}
@@ -0,0 +1,169 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  radiohead_native.cpp
+    @author Ralph Blach
+    @brief Linux implementation of the RadioHead stand-in, only used by the [env:native] build.
+**/
+#include <RH_RF69.h>
+
+RHGenericDriver::RHGenericDriver()
+    : _mode(RHModeInitialising), _thisAddress(RH_BROADCAST_ADDRESS), _promiscuous(false), _rxHeaderTo(0),
+      _rxHeaderFrom(0), _rxHeaderId(0), _rxHeaderFlags(0), _txHeaderTo(RH_BROADCAST_ADDRESS),
+      _txHeaderFrom(RH_BROADCAST_ADDRESS), _txHeaderId(0), _txHeaderFlags(0), _lastRssi(0), _rxBad(0), _rxGood(0),
+      _txGood(0)
+{
+}
+
+bool RHGenericDriver::waitPacketSent(void)
+{
+    while (_mode == RHModeTx)
+    {
+        available();
+    }
+    return true;
+}
+
+bool RHGenericDriver::waitAvailableTimeout(uint16_t timeout)
+{
+    unsigned long start = millis();
+    while ((millis() - start) < timeout)
+    {
+        if (available())
+        {
+            return true;
+        }
+        delay(1);
+    }
+    return false;
+}
+
+RH_RF69::RH_RF69(uint8_t slaveSelectPin, uint8_t interruptPin)
+    : native_auto_ack(true), native_ack_rssi(-60), native_frequency(434.0), native_power(13),
+      native_modem_config(GFSK_Rb250Fd250), native_sync_length(2)
+{
+    (void)slaveSelectPin;
+    (void)interruptPin;
+    native_sync_words[0] = 0x2d;
+    native_sync_words[1] = 0xd4;
+}
+
+bool RH_RF69::init(void)
+{
+    _mode = RHModeIdle;
+    return true;
+}
+
+bool RH_RF69::available(void)
+{
+    // the stand-in finishes a transmission as soon as anybody looks
+    if (_mode == RHModeTx)
+    {
+        _mode = RHModeIdle;
+    }
+    if (native_received.empty() || _mode == RHModeSleep)
+    {
+        return false;
+    }
+    _mode = RHModeRx;
+    return true;
+}
+
+bool RH_RF69::recv(uint8_t *buf, uint8_t *len)
+{
+    if (!available())
+    {
+        return false;
+    }
+    native_rf69_frame &frame = native_received.front();
+    uint8_t length = frame.payload.size() < *len ? (uint8_t)frame.payload.size() : *len;
+    memcpy(buf, frame.payload.data(), length);
+    *len = length;
+    _rxHeaderTo = frame.to;
+    _rxHeaderFrom = frame.from;
+    _rxHeaderId = frame.id;
+    _rxHeaderFlags = frame.flags;
+    _lastRssi = frame.rssi;
+    native_received.pop_front();
+    _rxGood++;
+    return true;
+}
+
+bool RH_RF69::send(const uint8_t *data, uint8_t len)
+{
+    native_rf69_frame frame;
+    if (len > RH_RF69_MAX_MESSAGE_LEN)
+    {
+        return false;
+    }
+    frame.to = _txHeaderTo;
+    frame.from = _txHeaderFrom;
+    frame.id = _txHeaderId;
+    frame.flags = _txHeaderFlags;
+    frame.rssi = 0;
+    frame.payload.assign(data, data + len);
+    native_sent.push_back(frame);
+    if (native_auto_ack && frame.to != RH_BROADCAST_ADDRESS && !(frame.flags & RH_FLAGS_ACK))
+    {
+        native_rf69_frame ack;
+        ack.to = frame.from;
+        ack.from = frame.to;
+        ack.id = frame.id;
+        ack.flags = RH_FLAGS_ACK;
+        ack.rssi = native_ack_rssi;
+        ack.payload.push_back('!');
+        native_received.push_back(ack);
+    }
+    _mode = RHModeTx;
+    _txGood++;
+    return true;
+}
+
+RHGenericDriver::RHMode RH_RF69::mode(void)
+{
+    // the stand-in has no airtime, a frame is sent as soon as anybody asks
+    if (_mode == RHModeTx)
+    {
+        _mode = RHModeIdle;
+    }
+    return _mode;
+}
+
+bool RH_RF69::sleep(void)
+{
+    _mode = RHModeSleep;
+    return true;
+}
+
+bool RH_RF69::setFrequency(float centre, float afcPullInRange)
+{
+    (void)afcPullInRange;
+    native_frequency = centre;
+    return true;
+}
+
+void RH_RF69::setTxPower(int8_t power, bool ishighpowermodule)
+{
+    (void)ishighpowermodule;
+    native_power = power;
+}
+
+bool RH_RF69::setModemConfig(ModemConfigChoice index)
+{
+    native_modem_config = index;
+    return true;
+}
+
+void RH_RF69::setSyncWords(const uint8_t *syncWords, uint8_t len)
+{
+    if (len > sizeof(native_sync_words))
+    {
+        len = sizeof(native_sync_words);
+    }
+    if (syncWords != NULL)
+    {
+        memcpy(native_sync_words, syncWords, len);
+    }
+    native_sync_length = len;
+}
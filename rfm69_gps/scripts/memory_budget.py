@@ -0,0 +1,138 @@
+# Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+# for the entire text
+"""Ram and flash budget of the firmware.
+
+After the elf is linked, every symbol in ram is listed with its section and size, from
+avr-nm --size-sort -S, and so are the biggest in flash.  The totals of avr-size are checked
+against custom_ram_budget and custom_flash_budget from platformio.ini, and if either is over
+its budget the build fails.  The ram budget is the ram of the chip less what the stack needs.
+ram_stack_unused in include/ram_arena.h shows how much of that reserve the stack has really
+used on a board.
+
+    pio run -e feather32u4              lists the symbols, fails if a budget is exceeded
+    pio run -e feather32u4 -t budget    the same on the elf that is already built
+
+It runs on its own too, on any elf, with the nm and size of its toolchain:
+
+    python3 scripts/memory_budget.py .pio/build/feather32u4/firmware.elf --ram 2176 --flash 28672
+"""
+import argparse
+import subprocess
+import sys
+
+# the sections that take ram, and the ones that are written to flash.  .data is in both, its
+# first values are copied from flash at startup
+RAM_SECTIONS = (".data", ".bss", ".noinit")
+FLASH_SECTIONS = (".text", ".data", ".rodata")
+# nm symbol types that are in ram, and in flash, and the section each is in
+RAM_TYPES = "bBdD"
+FLASH_TYPES = "tTrRdD"
+SECTIONS = {"b": ".bss", "d": ".data", "t": ".text", "r": ".rodata"}
+
+
+def section_sizes(elf, size_tool):
+    """the size of each section, from size -A"""
+    sizes = {}
+    output = subprocess.run([size_tool, "-A", elf], check=True, capture_output=True, text=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def symbols(elf, nm_tool):
+    """(size, type, name) of every symbol that has a size, from nm"""
+    found = []
+    output = subprocess.run([nm_tool, "-S", "-C", "--size-sort", elf], check=True, capture_output=True,
+                            text=True).stdout
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4:
+            found.append((int(fields[1], 16), fields[2], fields[3]))
+    return found
+
+
+def usage(elf, size_tool):
+    """bytes of ram and flash the elf takes"""
+    sizes = section_sizes(elf, size_tool)
+    return (sum(sizes.get(name, 0) for name in RAM_SECTIONS),
+            sum(sizes.get(name, 0) for name in FLASH_SECTIONS))
+
+
+def print_symbols(elf, nm_tool, count, ram, flash):
+    """every symbol in ram and the count biggest in flash, 0 for all, with their section and
+    their part of the budget"""
+    found = symbols(elf, nm_tool)
+    for title, types, budget, limit in (("ram", RAM_TYPES, ram, 0), ("flash", FLASH_TYPES, flash, count)):
+        biggest = sorted((symbol for symbol in found if symbol[1] in types), reverse=True)
+        if limit:
+            biggest = biggest[:limit]
+        print("%s by symbol:" % title)
+        for size, kind, name in biggest:
+            print("  %6d %5.1f%%  %-7s %s" % (size, 100.0 * size / budget if budget else 0,
+                                             SECTIONS[kind.lower()], name))
+
+
+def check(elf, size_tool, ram_budget, flash_budget):
+    """print the use against the budgets, false if one is over"""
+    ram, flash = usage(elf, size_tool)
+    good = True
+    for title, used, budget in (("ram", ram, ram_budget), ("flash", flash, flash_budget)):
+        if budget <= 0:
+            continue
+        print("%-5s %6d of %6d bytes, %5.1f%%, %d left" % (title, used, budget, 100.0 * used / budget,
+                                                           budget - used))
+        if used > budget:
+            print("%s budget exceeded by %d bytes" % (title, used - budget))
+            good = False
+    return good
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf")
+    parser.add_argument("--ram", type=int, default=0, help="ram budget in bytes, 0 for none")
+    parser.add_argument("--flash", type=int, default=0, help="flash budget in bytes, 0 for none")
+    parser.add_argument("--symbols", type=int, default=20, help="flash symbols to list, 0 for all")
+    parser.add_argument("--nm", default="nm")
+    parser.add_argument("--size", default="size")
+    arguments = parser.parse_args()
+    print_symbols(arguments.elf, arguments.nm, arguments.symbols, arguments.ram, arguments.flash)
+    return 0 if check(arguments.elf, arguments.size, arguments.ram, arguments.flash) else 1
+
+
+def platformio():
+    """hook the check onto the elf, and add the budget target"""
+    Import("env")  # noqa: F821, this is an scons script when platformio runs it
+    environment = env  # noqa: F821
+    elf = "$BUILD_DIR/${PROGNAME}.elf"
+    ram_budget = int(environment.GetProjectOption("custom_ram_budget", "0"))
+    flash_budget = int(environment.GetProjectOption("custom_flash_budget", "0"))
+    count = int(environment.GetProjectOption("custom_budget_symbols", "20"))
+    # avr-gcc lives next to avr-nm and avr-size
+    compiler = environment.subst("$CC")
+    nm_tool = compiler[:-3] + "nm" if compiler.endswith("gcc") else "nm"
+    size_tool = compiler[:-3] + "size" if compiler.endswith("gcc") else "size"
+
+    def report(path):
+        print_symbols(path, nm_tool, count, ram_budget, flash_budget)
+        return 0 if check(path, size_tool, ram_budget, flash_budget) else 1
+
+    def link_action(target, source, env):
+        # after the link the elf is the target
+        return report(str(target[0]))
+
+    def target_action(target, source, env):
+        # for the budget target it is the source
+        return report(str(source[0]))
+
+    environment.AddPostAction(elf, link_action)
+    environment.AddCustomTarget(name="budget", dependencies=elf, actions=[target_action],
+                                title="Memory budget", description="ram and flash use by symbol against the budget")
+
+
+if __name__ == "__main__":
+    sys.exit(main())
+else:
+    platformio()
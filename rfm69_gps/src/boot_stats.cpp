@@ -0,0 +1,98 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  boot_stats.cpp
+    @author Ralph Blach
+    @brief The times of the boot stages and the time to first transmit.
+**/
+#include <Arduino.h>
+#include <boot_stats.h>
+
+/**
+    @brief the names of the stages for the console, in flash
+*/
+static const char stage_names[BOOT_STAGES][10] PROGMEM = {
+    "setup", "config", "radio", "ready", "sentence", "fix", "send", "ack",
+};
+
+void boot_stats_begin(struct boot_stats *boot)
+/**@brief start over, setup is reached now
+ *
+ * @param boot the times
+ * @return Nothing
+ */
+{
+    memset(boot, 0, sizeof(*boot));
+    boot->setup_millis = millis();
+    boot->at[BOOT_SETUP] = micros();
+    boot->reached = 1 << BOOT_SETUP;
+}
+
+bool boot_stats_mark(struct boot_stats *boot, uint8_t stage)
+/**@brief a stage is reached, only the first time counts
+ *
+ * @param boot the times
+ * @param stage a boot_stage
+ * @return true if this was the first time
+ */
+{
+    if ((boot->reached & (1 << stage)) != 0 || millis() - boot->setup_millis >= BOOT_STATS_WINDOW)
+    {
+        return false;
+    }
+    boot->at[stage] = micros();
+    boot->reached |= 1 << stage;
+    return true;
+}
+
+bool boot_stats_reached(const struct boot_stats *boot, uint8_t stage)
+/**@brief has a stage been reached
+ *
+ * @param boot the times
+ * @param stage a boot_stage
+ * @return true if it has
+ */
+{
+    return (boot->reached & (1 << stage)) != 0;
+}
+
+uint32_t boot_stats_elapsed(const struct boot_stats *boot, uint8_t stage)
+/**@brief the time from the start of setup to a stage
+ *
+ * @param boot the times
+ * @param stage a boot_stage
+ * @return us, 0 if it was not reached
+ */
+{
+    return boot_stats_reached(boot, stage) ? boot->at[stage] - boot->at[BOOT_SETUP] : 0;
+}
+
+void boot_stats_print(const struct boot_stats *boot, Print &out)
+/**@brief print the time of each stage from the start of setup, for the boot console command
+ *
+ * @param boot the times
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    char name[sizeof(stage_names[0])];
+    out.print(F("reset to setup "));
+    out.print(boot->at[BOOT_SETUP] / 1000.0, 3);
+    out.println(F(" ms"));
+    for (uint8_t stage = BOOT_CONFIG; stage < BOOT_STAGES; stage++)
+    {
+        memcpy_P(name, stage_names[stage], sizeof(name));
+        out.print(name);
+        out.print(' ');
+        if (boot_stats_reached(boot, stage))
+        {
+            out.print(boot_stats_elapsed(boot, stage) / 1000.0, 3);
+            out.println(F(" ms"));
+        }
+        else
+        {
+            out.println(F("not yet"));
+        }
+    }
+}
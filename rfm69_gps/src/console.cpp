@@ -0,0 +1,129 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  console.cpp
+    @author Ralph Blach
+    @brief Non-blocking line assembly and command dispatch for the serial console.
+**/
+#include <Arduino.h>
+#include <console.h>
+
+static const struct console_command *command_table = NULL; /*!< the commands in flash, set by console_begin */
+static uint8_t command_count = 0;
+static char line_buffer[CONSOLE_LINE_SIZE]; /*!< the line being typed */
+static uint8_t line_length = 0;
+static bool line_overflow = false; /*!< the current line is too long and is being skipped */
+
+void console_begin(const struct console_command *commands, uint8_t number_of_commands)
+/**@brief set the command table, Serial must already have been started
+ *
+ * @param commands the table, in flash
+ * @param number_of_commands the number of entries
+ * @return Nothing
+ */
+{
+    command_table = commands;
+    command_count = number_of_commands;
+    line_length = 0;
+    line_overflow = false;
+}
+
+static void print_help(Print &out)
+{
+    uint8_t index;
+    for (index = 0; index < command_count; index++)
+    {
+        out.print((const __FlashStringHelper *)command_table[index].name);
+        out.print(F(" - "));
+        out.println((const __FlashStringHelper *)command_table[index].help);
+    }
+}
+
+bool console_dispatch(char *line, Print &out)
+/**@brief run one command line
+ *
+ * help is always there and lists the table.
+ * @param line the null terminated line without the line end, it is modified
+ * @param out where the handler prints
+ * @return false if the command was not found
+ */
+{
+    char *arguments = line;
+    console_handler handler;
+    uint8_t index;
+
+    while (*arguments == ' ')
+    {
+        arguments++;
+    }
+    line = arguments;
+    if (*line == 0)
+    {
+        return true;
+    }
+    while (*arguments != 0 && *arguments != ' ')
+    {
+        arguments++;
+    }
+    if (*arguments != 0)
+    {
+        *arguments++ = 0;
+        while (*arguments == ' ')
+        {
+            arguments++;
+        }
+    }
+    for (index = 0; index < command_count; index++)
+    {
+        if (strcmp_P(line, command_table[index].name) == 0)
+        {
+            memcpy_P(&handler, &command_table[index].handler, sizeof(handler));
+            handler(arguments, out);
+            return true;
+        }
+    }
+    if (strcmp_P(line, PSTR("help")) == 0)
+    {
+        print_help(out);
+        return true;
+    }
+    out.print(F("unknown command "));
+    out.println(line);
+    print_help(out);
+    return false;
+}
+
+void console_service(void)
+{
+    /**
+        @brief take the characters that have arrived, never waits
+
+        A line ends with a carriage return or a line feed, either works with a terminal.
+
+        @return Nothing
+    */
+    int value;
+    while (Serial.available() > 0)
+    {
+        value = Serial.read();
+        if (value == '\r' || value == '\n')
+        {
+            line_buffer[line_length] = 0;
+            if (!line_overflow && line_length != 0)
+            {
+                console_dispatch(line_buffer, Serial);
+            }
+            line_length = 0;
+            line_overflow = false;
+        }
+        else if (line_length < CONSOLE_LINE_SIZE - 1)
+        {
+            line_buffer[line_length++] = (char)value;
+        }
+        else
+        {
+            line_overflow = true;
+        }
+    }
+}
@@ -0,0 +1,138 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  event_log.cpp
+    @author Ralph Blach
+    @brief The ram ring behind LOG and its drain to the usb serial port.
+
+    Records are only written from the loop, never from an interrupt, so the ring needs no locking.
+**/
+#include <Arduino.h>
+#include <event_log.h>
+
+#if (LOG_RING_SIZE & (LOG_RING_SIZE - 1)) != 0 || LOG_RING_SIZE > 256
+#error "LOG_RING_SIZE must be a power of 2 and no bigger than 256"
+#endif
+
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+/**
+    @brief start, length, id, and a 5 byte varint for the time and each argument
+*/
+#define LOG_MAX_RECORD (3 + 5 * (LOG_MAX_ARGUMENTS + 1))
+
+static uint8_t log_ring[LOG_RING_SIZE]; /*!< framed records waiting for the serial port */
+static uint8_t log_head = 0;            /*!< next write position */
+static uint8_t log_tail = 0;            /*!< next byte to send */
+static uint16_t log_lost = 0;           /*!< records dropped since the last LOG_DROPPED */
+static uint16_t log_lost_total = 0;     /*!< records dropped since boot */
+static uint32_t log_last_time = 0;      /*!< millis() of the last record written */
+
+static uint8_t put_varint(uint8_t *buffer, uint32_t value)
+{
+    /**
+        @brief seven bits a byte, low bits first, the top bit says another byte follows
+
+        @return the number of bytes written
+    */
+    uint8_t length = 0;
+    while (value >= 0x80)
+    {
+        buffer[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t)value;
+    return length;
+}
+
+static bool put_record(uint8_t event, const int32_t *arguments, uint8_t number_of_arguments)
+{
+    uint8_t record[LOG_MAX_RECORD];
+    uint8_t length = 3;
+    uint8_t index;
+    uint8_t room = (uint8_t)((log_tail - log_head - 1) & LOG_RING_MASK);
+    uint32_t now = millis();
+
+    record[0] = LOG_RECORD_START;
+    record[2] = event;
+    length += put_varint(record + length, now - log_last_time);
+    for (index = 0; index < number_of_arguments; index++)
+    {
+        // zigzag, so a small negative number like an rssi is a small varint too
+        length += put_varint(record + length, ((uint32_t)arguments[index] << 1) ^ (uint32_t)(arguments[index] >> 31));
+    }
+    record[1] = length - 2;
+    if (length > room)
+    {
+        return false;
+    }
+    for (index = 0; index < length; index++)
+    {
+        log_ring[log_head] = record[index];
+        log_head = (log_head + 1) & LOG_RING_MASK;
+    }
+    log_last_time = now;
+    return true;
+}
+
+void log_write(uint8_t event, const int32_t *arguments, uint8_t number_of_arguments)
+/**@brief put a record in the ring, call it through LOG so the level and arguments are checked
+ *
+ * If the ring is full the record is counted and thrown away, and a LOG_DROPPED record goes in
+ * as soon as there is room.
+ * @param event the event id
+ * @param arguments the arguments
+ * @param number_of_arguments the number of arguments
+ * @return Nothing
+ */
+{
+    int32_t lost;
+    if (log_lost != 0)
+    {
+        lost = log_lost;
+        if (!put_record(LOG_DROPPED, &lost, 1))
+        {
+            log_lost++;
+            log_lost_total++;
+            return;
+        }
+        log_lost = 0;
+    }
+    if (!put_record(event, arguments, number_of_arguments))
+    {
+        log_lost++;
+        log_lost_total++;
+    }
+}
+
+void log_service(void)
+{
+    /**
+        @brief send as much of the ring as the usb serial port takes without waiting
+
+        @return Nothing
+    */
+    int room = Serial.availableForWrite();
+    uint8_t length;
+    while (room > 0 && log_tail != log_head)
+    {
+        // the bytes up to the end of the ring or the head, whichever comes first
+        length = log_head > log_tail ? log_head - log_tail : LOG_RING_SIZE - log_tail;
+        if (length > room)
+        {
+            length = (uint8_t)room;
+        }
+        Serial.write(log_ring + log_tail, length);
+        log_tail = (log_tail + length) & LOG_RING_MASK;
+        room -= length;
+    }
+}
+
+uint16_t log_dropped(void)
+/**@brief records lost because the ring was full
+ *
+ * @return the number since boot
+ */
+{
+    return log_lost_total;
+}
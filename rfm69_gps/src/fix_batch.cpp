@@ -0,0 +1,170 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  fix_batch.cpp
+    @author Ralph Blach
+    @brief Several delta encoded fixes in one radio packet.
+**/
+#include <Arduino.h>
+#include <event_log.h>
+#include <fix_batch.h>
+
+void fix_batch_init(struct fix_batch *batch, uint8_t fixes, uint16_t max_latency)
+/**@brief start with an empty batch
+ *
+ * @param batch the batch
+ * @param fixes the batch is queued when it has this many fixes
+ * @param max_latency the batch is queued when its first fix is this many ms old
+ * @return Nothing
+ */
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->fixes = fixes;
+    batch->max_latency = max_latency;
+}
+
+static bool flush(struct fix_batch *batch, struct tx_queue *queue)
+{
+    /**
+        @brief queue the batch, it is kept if the queue is full
+    */
+    uint8_t *buffer = tx_queue_reserve(queue);
+    uint8_t length = packet_builder_finish(&batch->builder);
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    memcpy(buffer, batch->buffer, length);
+    if (!tx_queue_commit_from(queue, length, batch->to, batch->origin))
+    {
+        return false;
+    }
+    LOG(LOG_BATCH, batch->count, length);
+    batch->count = 0;
+    batch->stats.frames++;
+    return true;
+}
+
+bool fix_batch_add(struct fix_batch *batch, struct tx_queue *queue, const char *call_sign,
+                   const struct position_fix *fix, uint8_t to, uint32_t origin)
+/**@brief put a fix in the batch, the batch is queued once it is full
+ *
+ * @param batch the batch
+ * @param queue the transmit queue
+ * @param call_sign the call sign, CALL_SIGN_LENGTH characters
+ * @param fix the fix
+ * @param to the base station address
+ * @param origin micros() when the fix came from the gps, the batch keeps the one of its first fix
+ * @return false if the fix was dropped, the last batch could not be queued to make room for it
+ */
+{
+    if (batch->count != 0 && !position_batch_append(&batch->builder, &batch->last, fix))
+    {
+        // another date, a time that went back, or no room, this fix starts the next one
+        if (!flush(batch, queue))
+        {
+            batch->stats.dropped++;
+            return false;
+        }
+        batch->stats.closed++;
+    }
+    if (batch->count == 0)
+    {
+        packet_builder_start(&batch->builder, batch->buffer, RH_RF69_MAX_MESSAGE_LEN);
+        position_batch_start(&batch->builder, call_sign, fix);
+        batch->to = to;
+        batch->opened = millis();
+        batch->origin = origin;
+    }
+    batch->last = *fix;
+    batch->count++;
+    batch->stats.fixes++;
+    if (batch->count >= batch->fixes && flush(batch, queue))
+    {
+        batch->stats.full++;
+    }
+    return true;
+}
+
+void fix_batch_service(struct fix_batch *batch, struct tx_queue *queue)
+/**@brief queue a batch that has waited long enough, call it on every pass of the loop
+ *
+ * @param batch the batch
+ * @param queue the transmit queue
+ * @return Nothing
+ */
+{
+    // a full batch is only still here if the queue was full when it filled
+    bool full = batch->count >= batch->fixes;
+    if (batch->count == 0 || (!full && (uint32_t)(millis() - batch->opened) < batch->max_latency) ||
+        !flush(batch, queue))
+    {
+        return;
+    }
+    if (full)
+    {
+        batch->stats.full++;
+    }
+    else
+    {
+        batch->stats.timed_out++;
+    }
+}
+
+void fix_batch_complete(struct fix_batch *batch, const struct tx_frame *frame, bool delivered)
+/**@brief count the fixes of a finished frame, from the transmit queue on_complete callback
+ *
+ * @param batch the batch
+ * @param frame the frame
+ * @param delivered true if it was acked
+ * @return Nothing
+ */
+{
+    if (!delivered || frame->length < POSITION_BATCH_HEADER)
+    {
+        return;
+    }
+    if (frame->data[0] == (POSITION_BATCH_MAGIC | POSITION_BATCH_VERSION))
+    {
+        batch->stats.delivered += frame->data[9];
+    }
+    else if ((frame->data[0] & 0xf0) == POSITION_PACKET_MAGIC)
+    {
+        batch->stats.delivered++;
+    }
+}
+
+void fix_batch_print(const struct fix_batch *batch, const struct tx_queue *queue, Print &out)
+/**@brief print the counters and the fixes per second of air time, for the batch console command
+ *
+ * @param batch the batch
+ * @param queue the transmit queue, for the air time
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    uint32_t airtime = tx_queue_airtime(queue);
+    out.print(F("fixes "));
+    out.print(batch->stats.fixes);
+    out.print(F(" in "));
+    out.print(batch->stats.frames);
+    out.print(F(" batches, "));
+    out.print(batch->count);
+    out.println(F(" waiting"));
+    out.print(F("full "));
+    out.print(batch->stats.full);
+    out.print(F(" timed out "));
+    out.print(batch->stats.timed_out);
+    out.print(F(" closed "));
+    out.print(batch->stats.closed);
+    out.print(F(" dropped "));
+    out.println(batch->stats.dropped);
+    out.print(F("delivered "));
+    out.print(batch->stats.delivered);
+    out.print(F(" fixes in "));
+    out.print(airtime);
+    out.print(F(" ms on the air, "));
+    out.print(airtime != 0 ? batch->stats.delivered * 1000 / airtime : 0);
+    out.println(F(" fixes per air second"));
+}
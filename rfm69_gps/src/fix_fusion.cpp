@@ -0,0 +1,288 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  fix_fusion.cpp
+    @author Ralph Blach
+    @brief Gather the sentences of one fix, and decode the GGA and GSA fields it is sent with.
+**/
+#include <Arduino.h>
+#include <nmea.h>
+#include <fix_fusion.h>
+
+void fix_fusion_init(struct fix_fusion *fusion, uint8_t expected)
+/**@brief start with no epoch
+ *
+ * @param fusion the fusion state
+ * @param expected FIX_HAVE_ bits of the sentences the gps was told to send
+ * @return Nothing
+ */
+{
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->expected = expected | FIX_HAVE_RMC;
+}
+
+static uint8_t sentence_kind(const struct gps_sentence *sentence)
+{
+    /**
+        @brief which of the sentences this is, any talker, $GPRMC and $GNRMC are both RMC
+
+        @return FIX_RMC, FIX_GGA, FIX_GSA or FIX_SENTENCE_COUNT for anything else
+    */
+    const char *name = sentence->data + 3;
+    if (sentence->length < 6)
+    {
+        return FIX_SENTENCE_COUNT;
+    }
+    if (strncmp_P(name, PSTR("RMC"), 3) == 0)
+    {
+        return FIX_RMC;
+    }
+    if (strncmp_P(name, PSTR("GGA"), 3) == 0)
+    {
+        return FIX_GGA;
+    }
+    if (strncmp_P(name, PSTR("GSA"), 3) == 0)
+    {
+        return FIX_GSA;
+    }
+    return FIX_SENTENCE_COUNT;
+}
+
+static void release_slots(struct fix_epoch *epoch)
+{
+    uint8_t index;
+    for (index = 0; index < FIX_SENTENCE_COUNT; index++)
+    {
+        if (epoch->sentences[index] != NULL)
+        {
+            gps_ingest_release(epoch->sentences[index]);
+        }
+    }
+    memset(epoch, 0, sizeof(*epoch));
+}
+
+static char *field(struct fix_epoch *epoch, uint8_t kind, uint8_t index)
+{
+    /**
+        @brief a field of one of the sentences, NULL if the sentence is not in or the field is empty
+    */
+    char *text;
+    if (epoch->sentences[kind] == NULL)
+    {
+        return NULL;
+    }
+    text = gps_sentence_field(epoch->sentences[kind], index);
+    return text[0] != 0 ? text : NULL;
+}
+
+static void decode_quality(struct fix_epoch *epoch)
+{
+    /**
+        @brief decode the fields of the GGA and GSA that are used and give their slots back, so
+        a finished epoch waits for the loop in one slot, its RMC
+
+        This is done for every finished epoch, also the ones that are not sent.  Waiting for
+        the loop to ask would keep three slots per epoch instead of one, and it is a few
+        fields, the sentences are not split again.
+    */
+    char *text = field(epoch, FIX_GSA, GSA_FIX_TYPE);
+    char *quality = field(epoch, FIX_GGA, GGA_QUALITY);
+    bool present;
+    uint32_t value;
+
+    epoch->fix_type = text != NULL && text[0] >= '1' && text[0] <= '3' ? text[0] - '0' : 0;
+    text = field(epoch, FIX_GGA, GGA_ALTITUDE);
+    if (text != NULL && quality != NULL && quality[0] != '0' && epoch->fix_type != 2)
+    {
+        epoch->altitude = text[0] == '-' ? -(int32_t)nmea_parse_decimal(text + 1, 1, &present)
+                                         : (int32_t)nmea_parse_decimal(text, 1, &present);
+        epoch->decoded |= FIX_DECODED_ALTITUDE;
+    }
+    text = field(epoch, FIX_GGA, GGA_SATELLITES);
+    if (text != NULL)
+    {
+        epoch->satellites = (uint8_t)nmea_parse_decimal(text, 0, &present);
+        epoch->decoded |= FIX_DECODED_SATELLITES;
+    }
+    if ((text = field(epoch, FIX_GGA, GGA_HDOP)) != NULL || (text = field(epoch, FIX_GSA, GSA_HDOP)) != NULL)
+    {
+        value = nmea_parse_decimal(text, 2, &present);
+        epoch->hdop = value > 0xffff ? 0xffff : (uint16_t)value;
+        epoch->decoded |= FIX_DECODED_HDOP;
+    }
+    for (uint8_t kind = FIX_GGA; kind <= FIX_GSA; kind++)
+    {
+        if (epoch->sentences[kind] != NULL)
+        {
+            gps_ingest_release(epoch->sentences[kind]);
+            epoch->sentences[kind] = NULL;
+        }
+    }
+}
+
+static void close_current(struct fix_fusion *fusion)
+{
+    /**
+        @brief the current epoch is over, it becomes the ready one if it has an RMC
+    */
+    struct fix_epoch *current = &fusion->current;
+    if (!fusion->current_done)
+    {
+        // the gps did not send everything it used to, do not wait for it next time
+        fusion->stats.partial++;
+        fusion->expected = current->present | FIX_HAVE_RMC;
+    }
+    fusion->last_time = current->time_of_day;
+    fusion->have_last = current->timed;
+    fusion->current_done = false;
+    if ((current->present & FIX_HAVE_RMC) == 0)
+    {
+        fusion->stats.no_rmc++;
+        release_slots(current);
+        return;
+    }
+    if (fusion->ready.present != 0)
+    {
+        fusion->stats.dropped++;
+        release_slots(&fusion->ready);
+    }
+    decode_quality(current);
+    fusion->ready = *current;
+    fusion->stats.epochs++;
+    memset(current, 0, sizeof(*current));
+}
+
+void fix_fusion_add(struct fix_fusion *fusion, struct gps_sentence *sentence)
+/**@brief take a sentence from gps_ingest_next, the fusion releases it
+ *
+ * Sentences that are not RMC, GGA or GSA are released straight away.
+ * @param fusion the fusion state
+ * @param sentence the sentence, it belongs to the fusion from now on
+ * @return Nothing
+ */
+{
+    struct fix_epoch *current = &fusion->current;
+    uint8_t kind = sentence_kind(sentence);
+    uint32_t time_of_day = 0;
+    bool timed = false;
+
+    if (kind == FIX_SENTENCE_COUNT)
+    {
+        gps_ingest_release(sentence);
+        return;
+    }
+    if (kind != FIX_GSA)
+    {
+        // the RMC and GGA time fields are in the same place
+        time_of_day = nmea_time_of_day(gps_sentence_field(sentence, RMC_TIME));
+        timed = true;
+    }
+    if (fusion->current_done ||
+        (timed && current->present != 0 && current->timed && current->time_of_day != time_of_day))
+    {
+        close_current(fusion);
+    }
+    if (timed && current->present == 0 && fusion->have_last && time_of_day == fusion->last_time)
+    {
+        // it came after its epoch was finished, wait for it from now on
+        fusion->stats.late++;
+        fusion->expected |= 1 << kind;
+        gps_ingest_release(sentence);
+        return;
+    }
+    if ((current->present & (1 << kind)) != 0)
+    {
+        fusion->stats.duplicate++;
+        gps_ingest_release(sentence);
+        return;
+    }
+    current->sentences[kind] = sentence;
+    current->present |= 1 << kind;
+    if (timed && !current->timed)
+    {
+        current->time_of_day = time_of_day;
+        current->timed = true;
+    }
+    if ((current->present & fusion->expected) == fusion->expected)
+    {
+        fusion->current_done = true;
+    }
+}
+
+struct fix_epoch *fix_fusion_next(struct fix_fusion *fusion)
+/**@brief get the next finished epoch, each one is handed out once
+ *
+ * @param fusion the fusion state
+ * @return the epoch, it has an RMC, or NULL if none is finished.  Give it back with
+ *         fix_fusion_release before the next sentence is added
+ */
+{
+    if (fusion->ready.present == 0 && fusion->current_done)
+    {
+        close_current(fusion);
+    }
+    return fusion->ready.present != 0 ? &fusion->ready : NULL;
+}
+
+void fix_fusion_release(struct fix_epoch *epoch)
+/**@brief give the sentence slot of an epoch back to gps_ingest
+ *
+ * @param epoch the epoch from fix_fusion_next
+ * @return Nothing
+ */
+{
+    release_slots(epoch);
+}
+
+void fix_epoch_quality(struct fix_epoch *epoch, struct position_fix *fix)
+/**@brief fill in the version 2 fields of a fix from the GGA and GSA
+ *
+ * Call it only for a fix that is being sent as a binary packet.
+ * @param epoch the epoch
+ * @param fix the fix from position_fix_from_rmc
+ * @return Nothing
+ */
+{
+    if ((fix->flags & POSITION_FLAG_VALID) == 0)
+    {
+        return;
+    }
+    if ((epoch->decoded & FIX_DECODED_ALTITUDE) != 0)
+    {
+        fix->altitude = epoch->altitude;
+        fix->flags |= POSITION_FLAG_ALTITUDE_VALID;
+    }
+    if ((epoch->decoded & (FIX_DECODED_SATELLITES | FIX_DECODED_HDOP)) == (FIX_DECODED_SATELLITES | FIX_DECODED_HDOP))
+    {
+        fix->satellites = epoch->satellites;
+        fix->hdop = epoch->hdop;
+        fix->flags |= POSITION_FLAG_DOP_VALID;
+    }
+}
+
+void fix_fusion_print(const struct fix_fusion *fusion, Print &out)
+/**@brief print the counters, for the fix console command
+ *
+ * @param fusion the fusion state
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    out.print(F("epochs "));
+    out.print(fusion->stats.epochs);
+    out.print(F(", waiting for"));
+    out.print((fusion->expected & FIX_HAVE_RMC) ? F(" RMC") : F(""));
+    out.print((fusion->expected & FIX_HAVE_GGA) ? F(" GGA") : F(""));
+    out.println((fusion->expected & FIX_HAVE_GSA) ? F(" GSA") : F(""));
+    out.print(F("partial "));
+    out.print(fusion->stats.partial);
+    out.print(F(" no rmc "));
+    out.print(fusion->stats.no_rmc);
+    out.print(F(" late "));
+    out.print(fusion->stats.late);
+    out.print(F(" duplicate "));
+    out.print(fusion->stats.duplicate);
+    out.print(F(" dropped "));
+    out.println(fusion->stats.dropped);
+}
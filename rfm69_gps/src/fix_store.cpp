@@ -0,0 +1,389 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  fix_store.cpp
+    @author Ralph Blach
+    @brief The ram and eeprom rings of fixes that were not acked, and the history packets.
+**/
+#include <Arduino.h>
+#include <EEPROM.h>
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#endif
+#include <event_log.h>
+#include <fix_store.h>
+#include <ram_arena.h>
+
+static_assert(FIX_STORE_SLOTS >= 2 && FIX_STORE_SLOTS <= 255, "the eeprom ring needs 2 to 255 slots");
+static_assert(FIX_STORE_BATCH >= 1, "a history packet has to hold a record");
+static_assert(FIX_STORE_RAM_SPARE <= FIX_STORE_RAM_RECORDS, "the ram spare is more than the ram records");
+
+static uint8_t next_slot(uint8_t slot)
+{
+    return slot + 1 < FIX_STORE_SLOTS ? slot + 1 : 0;
+}
+
+static uint16_t slot_address(uint8_t slot)
+{
+    return FIX_STORE_EEPROM_START + (uint16_t)slot * FIX_STORE_SLOT_SIZE;
+}
+
+static uint16_t read_sequence(uint8_t slot)
+{
+    uint16_t address = slot_address(slot);
+    return EEPROM.read(address) | (uint16_t)EEPROM.read(address + 1) << 8;
+}
+
+static bool newer(uint16_t sequence, uint16_t than)
+{
+    // 15 bit serial number arithmetic, the ring is far shorter than half of the range
+    return sequence != than && ((sequence - than) & 0x7fff) < 0x4000;
+}
+
+void fix_store_begin(struct fix_store *store)
+/**@brief find the records left in the eeprom from before the boot
+ *
+ * @param store the store
+ * @return Nothing
+ */
+{
+    uint16_t sequence;
+    uint16_t newest_sequence = 0;
+    uint8_t newest = FIX_STORE_SLOTS;
+    uint8_t slot;
+
+    memset(store, 0, sizeof(*store));
+    store->link_up = true;
+    for (slot = 0; slot < FIX_STORE_SLOTS; slot++)
+    {
+        sequence = read_sequence(slot);
+        if (sequence == FIX_STORE_EMPTY)
+        {
+            continue;
+        }
+        sequence &= ~FIX_STORE_DELIVERED;
+        if (newest == FIX_STORE_SLOTS || newer(sequence, newest_sequence))
+        {
+            newest = slot;
+            newest_sequence = sequence;
+        }
+    }
+    if (newest == FIX_STORE_SLOTS)
+    {
+        return;
+    }
+    store->sequence = (newest_sequence + 1) % 0x7fff;
+    // the waiting records are the run of undelivered ones that ends at the newest
+    slot = newest;
+    sequence = newest_sequence;
+    while (store->count < FIX_STORE_SLOTS && read_sequence(slot) == sequence)
+    {
+        store->count++;
+        slot = slot == 0 ? FIX_STORE_SLOTS - 1 : slot - 1;
+        sequence = (sequence + 0x7fff - 1) % 0x7fff;
+    }
+    store->tail = (next_slot(newest) + FIX_STORE_SLOTS - store->count) % FIX_STORE_SLOTS;
+    store->marked = store->tail;
+    LOG(LOG_STORE_LOADED, store->count);
+}
+
+static void spill(struct fix_store *store)
+{
+    /**
+        @brief start moving the oldest ram record to the next eeprom slot, writing over the
+        oldest slot when the ring is full
+    */
+    uint8_t slot = (store->tail + store->count) % FIX_STORE_SLOTS;
+    if (store->count == FIX_STORE_SLOTS)
+    {
+        store->tail = next_slot(store->tail);
+        store->count--;
+        store->marked = store->tail;
+        store->stats.lost++;
+        if (store->in_flight != 0)
+        {
+            store->in_flight--;
+        }
+    }
+    else if (store->marked != store->tail && store->marked == slot)
+    {
+        // it was delivered and is written over, it does not need its bit set first
+        store->marked = next_slot(store->marked);
+    }
+    store->spill[0] = (uint8_t)store->sequence;
+    store->spill[1] = (uint8_t)(store->sequence >> 8);
+    memcpy(store->spill + 2, store->ram[store->ram_tail], POSITION_RECORD_LENGTH);
+    store->spill_slot = slot;
+    store->spill_step = 1;
+    store->sequence = (store->sequence + 1) % 0x7fff;
+    store->count++;
+    store->ram_tail = (store->ram_tail + 1) % FIX_STORE_RAM_RECORDS;
+    store->ram_count--;
+}
+
+void fix_store_put(struct fix_store *store, const struct position_fix *fix)
+/**@brief keep a fix that was not acked
+ *
+ * @param store the store
+ * @param fix the fix
+ * @return Nothing
+ */
+{
+    if (store->ram_count == FIX_STORE_RAM_RECORDS)
+    {
+        if (store->spill_step != 0)
+        {
+            // the eeprom is still busy with the last one, a fix a second never gets here
+            store->stats.lost++;
+            return;
+        }
+        spill(store);
+    }
+    position_record_pack(fix, store->ram[(store->ram_tail + store->ram_count) % FIX_STORE_RAM_RECORDS]);
+    store->ram_count++;
+    store->stats.stored++;
+    LOG(LOG_FIX_STORED, store->ram_count, store->count);
+}
+
+static void copy_record(const struct fix_store *store, uint8_t index, uint8_t *out)
+{
+    /**
+        @brief copy a waiting record, 0 is the oldest
+    */
+    uint8_t slot;
+    uint16_t address;
+    uint8_t offset;
+    if (index >= store->count)
+    {
+        memcpy(out, store->ram[(store->ram_tail + index - store->count) % FIX_STORE_RAM_RECORDS],
+               POSITION_RECORD_LENGTH);
+        return;
+    }
+    slot = (store->tail + index) % FIX_STORE_SLOTS;
+    if (store->spill_step != 0 && slot == store->spill_slot)
+    {
+        memcpy(out, store->spill + 2, POSITION_RECORD_LENGTH);
+        return;
+    }
+    address = slot_address(slot) + 2;
+    for (offset = 0; offset < POSITION_RECORD_LENGTH; offset++)
+    {
+        out[offset] = EEPROM.read(address + offset);
+    }
+}
+
+static void delivered(struct fix_store *store, uint8_t number)
+{
+    /**
+        @brief drop the oldest records, the eeprom slots get their delivered bit in fix_store_service
+    */
+    store->stats.backfilled += number;
+    while (number != 0 && store->count != 0)
+    {
+        store->tail = next_slot(store->tail);
+        store->count--;
+        number--;
+    }
+    if (number > store->ram_count)
+    {
+        number = store->ram_count;
+    }
+    store->ram_tail = (store->ram_tail + number) % FIX_STORE_RAM_RECORDS;
+    store->ram_count -= number;
+}
+
+void fix_store_complete(struct fix_store *store, const struct tx_frame *frame, bool delivered_frame)
+/**@brief look at every finished frame, from the transmit queue on_complete callback
+ *
+ * A position or batch packet that was not acked is stored, an acked history packet takes its
+ * records out of the store, and any ack starts the backfill.
+ * @param store the store
+ * @param frame the frame
+ * @param delivered_frame true if it was acked
+ * @return Nothing
+ */
+{
+    struct position_fix fix;
+    struct position_batch_reader reader;
+    bool history = frame->length != 0 && frame->data[0] == (POSITION_HISTORY_MAGIC | POSITION_HISTORY_VERSION);
+
+    store->link_up = delivered_frame;
+    if (history)
+    {
+        if (delivered_frame)
+        {
+            delivered(store, store->in_flight);
+        }
+        store->in_flight = 0;
+        return;
+    }
+    if (delivered_frame)
+    {
+        return;
+    }
+    // a report that there is no fix is old news by the time it could be sent again
+    if (position_batch_first(&reader, frame->data, frame->length, &fix))
+    {
+        do
+        {
+            if ((fix.flags & POSITION_FLAG_VALID) != 0)
+            {
+                fix_store_put(store, &fix);
+            }
+        } while (position_batch_next(&reader, &fix));
+    }
+    else if (position_packet_decode(frame->data, frame->length, &fix) && (fix.flags & POSITION_FLAG_VALID) != 0)
+    {
+        fix_store_put(store, &fix);
+    }
+}
+
+bool fix_store_backfill(struct fix_store *store, struct tx_queue *queue, const char *call_sign, uint8_t to)
+/**@brief queue a history packet if the base station is answering and nothing live is waiting
+ *
+ * Call it when the loop has nothing new to send.
+ * @param store the store
+ * @param queue the transmit queue
+ * @param call_sign the call sign, CALL_SIGN_LENGTH characters
+ * @param to the base station address
+ * @return true if a history packet was queued
+ */
+{
+    union ram_arena_space *arena;
+    uint8_t *buffer;
+    uint16_t waiting = fix_store_waiting(store);
+    uint16_t date;
+    uint8_t length;
+    uint8_t number = 0;
+
+    if (waiting == 0 || !store->link_up || store->in_flight != 0 || !tx_queue_idle(queue) ||
+        (uint32_t)(millis() - store->backfill_time) < FIX_STORE_BACKFILL_INTERVAL)
+    {
+        return false;
+    }
+    buffer = tx_queue_reserve(queue);
+    // the records are only needed until the packet is built
+    arena = ram_arena_take(RAM_ARENA_HISTORY);
+    if (buffer == NULL || arena == NULL)
+    {
+        ram_arena_release(RAM_ARENA_HISTORY);
+        return false;
+    }
+    copy_record(store, 0, arena->history[0]);
+    date = position_record_date(arena->history[0]);
+    for (number = 1; number < FIX_STORE_BATCH && number < waiting; number++)
+    {
+        copy_record(store, number, arena->history[number]);
+        if (position_record_date(arena->history[number]) != date)
+        {
+            break;
+        }
+    }
+    length = position_history_encode(call_sign, arena->history[0], number, buffer, RH_RF69_MAX_MESSAGE_LEN);
+    ram_arena_release(RAM_ARENA_HISTORY);
+    if (!tx_queue_commit(queue, length, to))
+    {
+        return false;
+    }
+    store->in_flight = number;
+    store->backfill_time = millis();
+    store->stats.frames++;
+    LOG(LOG_BACKFILL, number, waiting);
+    return true;
+}
+
+void fix_store_service(struct fix_store *store)
+/**@brief write at most one eeprom byte, call it on every pass of the loop
+ *
+ * An eeprom byte takes 3.3 ms to write on the 32u4, nothing is written while the last one is
+ * still going.
+ * @param store the store
+ * @return Nothing
+ */
+{
+    uint16_t address;
+    uint8_t step = store->spill_step;
+#if defined(__AVR__)
+    if (!eeprom_is_ready())
+    {
+        return;
+    }
+#endif
+    if (step == 0 && store->ram_count > FIX_STORE_RAM_RECORDS - FIX_STORE_RAM_SPARE)
+    {
+        // make room for the fixes of a batch packet before they come
+        spill(store);
+        step = store->spill_step;
+    }
+    if (step == 0)
+    {
+        if (store->marked != store->tail)
+        {
+            address = slot_address(store->marked) + 1;
+            EEPROM.update(address, EEPROM.read(address) | (FIX_STORE_DELIVERED >> 8));
+            store->marked = next_slot(store->marked);
+        }
+        return;
+    }
+    address = slot_address(store->spill_slot);
+    // the old sequence number is spoiled first and the new one goes in last, a slot cut off
+    // by a power loss is never taken for a good one
+    if (step == 1)
+    {
+        EEPROM.update(address + 1, 0xff);
+    }
+    else if (step < FIX_STORE_SLOT_SIZE)
+    {
+        EEPROM.update(address + step, store->spill[step]);
+    }
+    else if (step == FIX_STORE_SLOT_SIZE)
+    {
+        EEPROM.update(address, store->spill[0]);
+    }
+    else
+    {
+        EEPROM.update(address + 1, store->spill[1]);
+        store->spill_step = 0;
+        store->stats.spilled++;
+        return;
+    }
+    store->spill_step++;
+}
+
+uint16_t fix_store_waiting(const struct fix_store *store)
+/**@brief the number of fixes waiting to be sent again
+ *
+ * @param store the store
+ * @return the records in ram and in the eeprom
+ */
+{
+    return store->count + store->ram_count;
+}
+
+void fix_store_print(const struct fix_store *store, Print &out)
+/**@brief print the counters, for the store console command
+ *
+ * @param store the store
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    out.print(F("waiting "));
+    out.print(store->ram_count);
+    out.print(F(" in ram, "));
+    out.print(store->count);
+    out.print(F(" of "));
+    out.print(FIX_STORE_SLOTS);
+    out.println(store->link_up ? F(" in eeprom, link up") : F(" in eeprom, link down"));
+    out.print(F("stored "));
+    out.print(store->stats.stored);
+    out.print(F(" backfilled "));
+    out.print(store->stats.backfilled);
+    out.print(F(" lost "));
+    out.print(store->stats.lost);
+    out.print(F(" spilled "));
+    out.print(store->stats.spilled);
+    out.print(F(" history packets "));
+    out.println(store->stats.frames);
+}
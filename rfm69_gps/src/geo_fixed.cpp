@@ -0,0 +1,268 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  geo_fixed.cpp
+    @author Ralph Blach
+    @brief Flat earth offsets, lengths, bearings and a cosine and arctangent table, all in integers.
+**/
+#include <geo_fixed.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define GEO_TABLE_READ(entry) ((int16_t)pgm_read_word(&(entry)))
+#else
+#define PROGMEM
+#define GEO_TABLE_READ(entry) (entry)
+#endif
+
+/**
+    @brief cos of 0 to 90 degrees in 5 degree steps, Q15.  Linear interpolation between the
+    entries is within 0.001 of the real value.
+*/
+static const int16_t cos_table[19] PROGMEM = {32767, 32642, 32269, 31650, 30791, 29697, 28377,
+                                              26841, 25101, 23170, 21062, 18794, 16384, 13848,
+                                              11207, 8481,  5690,  2856,  0};
+
+/**
+    @brief atan of 0 to 1 in 1/32 steps, in 0.01 degrees.  Linear interpolation between the
+    entries is within 0.01 degrees of the real value.
+*/
+static const int16_t atan_table[33] PROGMEM = {0,    179,  358,  536,  713,  888,  1062, 1234, 1404,
+                                               1571, 1735, 1897, 2056, 2211, 2363, 2511, 2657, 2798,
+                                               2936, 3070, 3201, 3327, 3451, 3571, 3687, 3800, 3909,
+                                               4016, 4119, 4218, 4315, 4409, 4500};
+
+/**
+    @brief 1e-7 degrees of latitude are 0.011132 meters, this is 57 / 5120
+*/
+#define METERS_PER_UNIT_NUMERATOR 57
+#define METERS_PER_UNIT_DENOMINATOR 5120
+
+int16_t geo_cos(uint16_t angle)
+/**@brief cosine of an angle
+ *
+ * @param angle the angle in 0.01 degrees, the same unit as the course in a position_fix
+ * @return the cosine in Q15, GEO_Q15_ONE is 1.0
+ */
+{
+    uint16_t index;
+    uint16_t fraction;
+    int16_t low;
+    int16_t high;
+    bool negative = false;
+
+    angle = angle % 36000;
+    if (angle > 18000)
+    {
+        angle = 36000 - angle;
+    }
+    if (angle > 9000)
+    {
+        angle = 18000 - angle;
+        negative = true;
+    }
+    index = angle / 500;
+    fraction = angle % 500;
+    low = GEO_TABLE_READ(cos_table[index]);
+    if (fraction != 0)
+    {
+        high = GEO_TABLE_READ(cos_table[index + 1]);
+        low = (int16_t)(low + ((int32_t)(high - low) * fraction) / 500);
+    }
+    return negative ? -low : low;
+}
+
+int16_t geo_sin(uint16_t angle)
+/**@brief sine of an angle
+ *
+ * @param angle the angle in 0.01 degrees
+ * @return the sine in Q15
+ */
+{
+    // sin(a) = cos(a - 90) = cos(a + 270)
+    return geo_cos((uint16_t)((angle % 36000) + 27000));
+}
+
+static int32_t clamp(int32_t value, int32_t limit)
+{
+    if (value > limit)
+    {
+        return limit;
+    }
+    if (value < -limit)
+    {
+        return -limit;
+    }
+    return value;
+}
+
+void geo_offset(int32_t from_latitude, int32_t from_longitude, int32_t to_latitude, int32_t to_longitude,
+                int32_t *east, int32_t *north)
+/**@brief how far one position is from another
+ *
+ * @param from_latitude the start, 1e-7 degrees
+ * @param from_longitude the start, 1e-7 degrees
+ * @param to_latitude the end, 1e-7 degrees
+ * @param to_longitude the end, 1e-7 degrees
+ * @param east the offset to the east in meters, west is negative, clamped to GEO_MAX_OFFSET
+ * @param north the offset to the north in meters, south is negative, clamped to GEO_MAX_OFFSET
+ * @return Nothing
+ */
+{
+    int32_t latitude_delta;
+    int32_t half_longitude_delta;
+    int32_t equator_meters;
+    int16_t scale;
+    uint16_t middle_latitude;
+
+    latitude_delta = clamp(to_latitude - from_latitude,
+                           (int32_t)GEO_MAX_OFFSET * METERS_PER_UNIT_DENOMINATOR / METERS_PER_UNIT_NUMERATOR);
+    *north = latitude_delta * METERS_PER_UNIT_NUMERATOR / METERS_PER_UNIT_DENOMINATOR;
+
+    // the longitudes are halved first so the difference fits in 32 bits, and it is taken the
+    // short way round across the date line
+    half_longitude_delta = to_longitude / 2 - from_longitude / 2;
+    if (half_longitude_delta > 900000000L)
+    {
+        half_longitude_delta -= 1800000000L;
+    }
+    else if (half_longitude_delta < -900000000L)
+    {
+        half_longitude_delta += 1800000000L;
+    }
+    // 3.7e7 * 57 still fits in 32 bits, that is 7.4 degrees or 820 km at the equator
+    half_longitude_delta = clamp(half_longitude_delta, 37000000L);
+    equator_meters = half_longitude_delta * METERS_PER_UNIT_NUMERATOR / (METERS_PER_UNIT_DENOMINATOR / 2);
+
+    // a degree of longitude shrinks with the cosine of the latitude
+    middle_latitude = (uint16_t)(((from_latitude / 2 + to_latitude / 2) / 100000L) + 36000L);
+    scale = geo_cos(middle_latitude);
+    if (equator_meters < 65536L && equator_meters > -65536L)
+    {
+        *east = clamp((equator_meters * scale) >> 15, GEO_MAX_OFFSET);
+    }
+    else
+    {
+        *east = clamp(((equator_meters >> 4) * scale) >> 11, GEO_MAX_OFFSET);
+    }
+}
+
+uint32_t geo_isqrt(uint32_t value)
+/**@brief integer square root, rounded down
+ *
+ * @param value the number
+ * @return the largest root whose square is not more than value
+ */
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+uint16_t geo_length(int32_t east, int32_t north)
+/**@brief length of an offset
+ *
+ * @param east meters, it is clamped to GEO_MAX_OFFSET
+ * @param north meters, it is clamped to GEO_MAX_OFFSET
+ * @return the length in meters
+ */
+{
+    east = clamp(east, GEO_MAX_OFFSET);
+    north = clamp(north, GEO_MAX_OFFSET);
+    // two squares of 32000 are 2.05e9, that still fits in an unsigned 32 bit value
+    return (uint16_t)geo_isqrt((uint32_t)(east * east) + (uint32_t)(north * north));
+}
+
+uint16_t geo_distance(int32_t from_latitude, int32_t from_longitude, int32_t to_latitude, int32_t to_longitude)
+/**@brief distance between two positions
+ *
+ * @param from_latitude the start, 1e-7 degrees
+ * @param from_longitude the start, 1e-7 degrees
+ * @param to_latitude the end, 1e-7 degrees
+ * @param to_longitude the end, 1e-7 degrees
+ * @return the distance in meters, GEO_MAX_OFFSET or a little more for anything further
+ */
+{
+    int32_t east;
+    int32_t north;
+    geo_offset(from_latitude, from_longitude, to_latitude, to_longitude, &east, &north);
+    return geo_length(east, north);
+}
+
+uint16_t geo_bearing(int32_t east, int32_t north)
+/**@brief the direction of an offset, clockwise from north like the RMC course
+ *
+ * @param east the offset to the east, any unit
+ * @param north the offset to the north, the same unit
+ * @return the bearing in 0.01 degrees, 0 to 35999, 0 for no offset
+ */
+{
+    uint32_t x = east < 0 ? -(uint32_t)east : (uint32_t)east;
+    uint32_t y = north < 0 ? -(uint32_t)north : (uint32_t)north;
+    uint32_t small = x < y ? x : y;
+    uint32_t big = x < y ? y : x;
+    uint16_t ratio;
+    uint8_t index;
+    int32_t angle;
+
+    if (big == 0)
+    {
+        return 0;
+    }
+    // small / big in 1/8192, the top 5 bits pick the table entry and the low 8 interpolate
+    while (big > 0x3ffffUL)
+    {
+        small >>= 1;
+        big >>= 1;
+    }
+    ratio = (uint16_t)(((small << 13) + big / 2) / big);
+    index = ratio >> 8;
+    angle = GEO_TABLE_READ(atan_table[index]);
+    if (index < 32)
+    {
+        angle += ((GEO_TABLE_READ(atan_table[index + 1]) - angle) * (ratio & 0xff) + 128) >> 8;
+    }
+    // atan(east / north) is the angle from north, it was worked out the other way up if east was bigger
+    if (x > y)
+    {
+        angle = 9000 - angle;
+    }
+    if (north < 0)
+    {
+        angle = 18000 - angle;
+    }
+    if (east < 0 && angle != 0)
+    {
+        angle = 36000 - angle;
+    }
+    return (uint16_t)angle;
+}
+
+uint16_t geo_knots_to_cms(uint16_t speed)
+/**@brief convert a speed from the RMC to centimeters a second
+ *
+ * @param speed the speed in 0.01 knots, as in a position_fix
+ * @return the speed in cm/s, rounded
+ */
+{
+    // a knot is 1852 m an hour, 0.01 knots is 1852 / 3600 cm/s
+    return (uint16_t)(((uint32_t)speed * 1852 + 1800) / 3600);
+}
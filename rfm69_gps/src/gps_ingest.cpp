@@ -0,0 +1,452 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  gps_ingest.cpp
+    @author Ralph Blach
+    @brief Interrupt driven ring buffer and sentence assembly for the gps receiver.
+
+    On the Feather 32u4 this file owns USART1.  Serial1 must not be used anywhere else on that
+    board, because the core's HardwareSerial would install its own USART1_RX_vect.
+**/
+#include <Arduino.h>
+#include <gps_ingest.h>
+
+#if defined(__AVR_ATmega32U4__)
+#include <avr/interrupt.h>
+#define GPS_INGEST_USART_ISR 1
+#else
+/**
+    @brief the serial port polled on boards where we do not own the uart interrupt
+    @param GPSSerial
+*/
+#define GPSSerial Serial1
+#endif
+
+#if (GPS_RING_BUFFER_SIZE & (GPS_RING_BUFFER_SIZE - 1)) != 0 || GPS_RING_BUFFER_SIZE > 256
+#error "GPS_RING_BUFFER_SIZE must be a power of 2 and no bigger than 256"
+#endif
+
+#define GPS_RING_MASK (GPS_RING_BUFFER_SIZE - 1)
+/**
+    @brief line feed times kept for the loop, the ring cannot hold more line feeds than this
+*/
+#define GPS_LINE_TIMES 8
+#define GPS_LINE_MASK (GPS_LINE_TIMES - 1)
+
+// the ring is written by the interrupt and read by the loop.  head and tail are single bytes
+// so they are read and written atomically on the AVR.
+static volatile uint8_t ring_buffer[GPS_RING_BUFFER_SIZE]; /*!< raw bytes from the gps */
+static volatile uint8_t ring_head = 0;                     /*!< next write position, owned by the producer */
+static volatile uint8_t ring_tail = 0;                     /*!< next read position, owned by the consumer */
+static volatile uint16_t ring_dropped_bytes = 0;
+static volatile uint16_t ring_overruns = 0;
+static volatile uint32_t line_times[GPS_LINE_TIMES]; /*!< micros() of each line feed in the ring, in order */
+static volatile uint8_t line_head = 0;               /*!< next line time to write, owned by the producer */
+static uint8_t line_tail = 0;                        /*!< next line time to read, owned by the consumer */
+static uint32_t line_feed_time = 0;                  /*!< micros() of the line feed being assembled */
+
+#if defined(GPS_INGEST_USART_ISR)
+// the string being written is only touched by the loop while tx_busy is false
+static char tx_text[GPS_TX_BUFFER_SIZE];       /*!< a copy of the string from gps_ingest_write */
+static const char *tx_flash = NULL;            /*!< the string from gps_ingest_write_P, NULL for tx_text */
+static uint8_t tx_next = 0;                    /*!< next byte of tx_text to send */
+static volatile bool tx_busy = false;          /*!< the interrupt is sending a string */
+#endif
+
+static struct gps_sentence sentence_slots[GPS_SENTENCE_SLOTS]; /*!< the assembled sentences */
+static struct gps_sentence *filling_slot = NULL; /*!< slot currently being assembled, NULL while waiting for a $ */
+static uint8_t next_sequence = 0;                /*!< sequence of the next sentence to be finished */
+static struct gps_ingest_stats ingest_stats;
+
+static inline void ring_put(uint8_t value)
+{
+    /**
+        @brief put one byte in the ring, called from the receive interrupt
+
+        @param value the byte received
+        @return Nothing
+    */
+    uint8_t next_head = (ring_head + 1) & GPS_RING_MASK;
+    if (next_head == ring_tail)
+    {
+        ring_dropped_bytes++;
+        return;
+    }
+    ring_buffer[ring_head] = value;
+    ring_head = next_head;
+    if (value == '\n')
+    {
+        // the time the sentence really ended, not when the loop got round to it
+        line_times[line_head] = micros();
+        line_head = (line_head + 1) & GPS_LINE_MASK;
+    }
+}
+
+#if defined(GPS_INGEST_USART_ISR)
+ISR(USART1_RX_vect)
+{
+    // the error flags must be read before UDR1, reading UDR1 clears them
+    uint8_t status = UCSR1A;
+    uint8_t value = UDR1;
+    if (status & (_BV(DOR1) | _BV(FE1)))
+    {
+        ring_overruns++;
+    }
+    ring_put(value);
+}
+
+ISR(USART1_UDRE_vect)
+{
+    // the data register has room for the next byte, the interrupt goes off at the null
+    char value = tx_flash != NULL ? (char)pgm_read_byte(tx_flash++) : tx_text[tx_next++];
+    if (value == 0)
+    {
+        UCSR1B &= ~_BV(UDRIE1);
+        tx_busy = false;
+        return;
+    }
+    UDR1 = value;
+}
+#endif
+
+static void start_uart(uint32_t baud)
+{
+    /**
+        @brief program the uart for a rate and empty the ring, bytes from before are at the old
+        rate.  The sentence being assembled goes too, the finished ones are kept
+
+        @param baud the baud rate
+        @return Nothing
+    */
+#if defined(GPS_INGEST_USART_ISR)
+    // same calculation as the arduino core, double speed mode gives the smallest error at 8 MHz
+    uint16_t baud_setting = (F_CPU / 4 / baud - 1) / 2;
+    // the receive interrupt is off until the ring is empty, a string being written was for the
+    // old rate and is dropped
+    UCSR1B = 0;
+    tx_busy = false;
+    UCSR1A = _BV(U2X1);
+    UBRR1H = baud_setting >> 8;
+    UBRR1L = baud_setting;
+    UCSR1C = _BV(UCSZ11) | _BV(UCSZ10); // 8 data bits, no parity, 1 stop bit
+#else
+    GPSSerial.begin(baud);
+#endif
+    ring_head = ring_tail = 0;
+    line_head = line_tail = 0;
+    if (filling_slot != NULL)
+    {
+        filling_slot->state = GPS_SLOT_FREE;
+        filling_slot = NULL;
+    }
+#if defined(GPS_INGEST_USART_ISR)
+    UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+#endif
+}
+
+void gps_ingest_begin(uint32_t baud)
+{
+    /**
+        @brief set up the gps uart and clear the ingestion state
+
+        @param baud the baud rate of the gps receiver, 9600 is the default for the Ultimate GPS
+        @return Nothing
+    */
+    uint8_t index;
+    start_uart(baud);
+    next_sequence = 0;
+    for (index = 0; index < GPS_SENTENCE_SLOTS; index++)
+    {
+        sentence_slots[index].state = GPS_SLOT_FREE;
+        sentence_slots[index].length = 0;
+    }
+}
+
+void gps_ingest_set_baud(uint32_t baud)
+{
+    /**
+        @brief move the uart to another rate, for the baud rate search and switch
+
+        Unlike gps_ingest_begin the finished sentences are kept, fix_fusion may be holding some.
+        @param baud the new baud rate
+        @return Nothing
+    */
+    start_uart(baud);
+}
+
+bool gps_ingest_write(const char *data)
+/**@brief start writing a null terminated string to the gps uart, never waits
+ *
+ * @param data the string to write, it is copied
+ * @return false if the last string is still being written or this one is longer than
+ *         GPS_TX_BUFFER_SIZE, nothing is written then
+ */
+{
+#if defined(GPS_INGEST_USART_ISR)
+    if (tx_busy || strlen(data) >= GPS_TX_BUFFER_SIZE)
+    {
+        return false;
+    }
+    strcpy(tx_text, data);
+    tx_flash = NULL;
+    tx_next = 0;
+    tx_busy = true;
+    UCSR1B |= _BV(UDRIE1);
+#else
+    GPSSerial.write(data);
+#endif
+    return true;
+}
+
+bool gps_ingest_write_P(const char *data)
+/**@brief start writing a null terminated string that is in flash to the gps uart, never waits
+ *
+ * @param data the string to write, in PROGMEM
+ * @return false if the last string is still being written, nothing is written then
+ */
+{
+#if defined(GPS_INGEST_USART_ISR)
+    if (tx_busy)
+    {
+        return false;
+    }
+    tx_flash = data;
+    tx_busy = true;
+    UCSR1B |= _BV(UDRIE1);
+#else
+    char value;
+    while ((value = (char)pgm_read_byte(data++)) != 0)
+    {
+        GPSSerial.write(value);
+    }
+#endif
+    return true;
+}
+
+bool gps_ingest_writing(void)
+/**@brief check if a string is still going out, the uart must keep its rate and the clock
+ *
+ * The last byte is still in the shift register for a character time after this is false.
+ * @return true until the interrupt has put the last byte in the data register
+ */
+{
+#if defined(GPS_INGEST_USART_ISR)
+    return tx_busy;
+#else
+    return false;
+#endif
+}
+
+static struct gps_sentence *claim_free_slot(void)
+{
+    /**
+        @brief find a free sentence slot and mark it as filling
+
+        @return a pointer to the slot or NULL if all slots are busy
+    */
+    uint8_t index;
+    for (index = 0; index < GPS_SENTENCE_SLOTS; index++)
+    {
+        if (sentence_slots[index].state == GPS_SLOT_FREE)
+        {
+            sentence_slots[index].state = GPS_SLOT_FILLING;
+            sentence_slots[index].length = 0;
+            return &sentence_slots[index];
+        }
+    }
+    return NULL;
+}
+
+static void assemble(char gps_char)
+{
+    /**
+        @brief the sentence assembly state machine, one call per byte
+
+        A $ always starts a new sentence, so a sentence with a lost line feed is thrown away
+        instead of being glued to the next one.  Carriage returns are ignored and a line feed
+        finishes the sentence.
+
+        @param gps_char the character received from the gps
+        @return Nothing
+    */
+    if (gps_char == '$')
+    {
+        if (filling_slot == NULL)
+        {
+            filling_slot = claim_free_slot();
+            if (filling_slot == NULL)
+            {
+                ingest_stats.dropped_sentences++;
+                return;
+            }
+        }
+        else if (filling_slot->length != 0)
+        {
+            ingest_stats.truncated++;
+        }
+        filling_slot->length = 0;
+        filling_slot->data[filling_slot->length++] = gps_char;
+        nmea_fields_start(&filling_slot->fields);
+        return;
+    }
+    // nothing to do until we see the start of a sentence
+    if (filling_slot == NULL || gps_char == '\r')
+    {
+        return;
+    }
+    if (gps_char == '\n')
+    {
+        filling_slot->data[filling_slot->length] = 0;
+        // a corrupted sentence is thrown away here, before it can cost a radio transmission
+        if (nmea_fields_valid(&filling_slot->fields))
+        {
+            filling_slot->state = GPS_SLOT_READY;
+            filling_slot->sequence = next_sequence++;
+            filling_slot->line_feed = line_feed_time;
+            ingest_stats.sentences++;
+        }
+        else
+        {
+            filling_slot->state = GPS_SLOT_FREE;
+            ingest_stats.checksum_errors++;
+        }
+        filling_slot = NULL;
+        return;
+    }
+    // make sure we never have a data overun, leave room for the null.  Buffer overflows are nasty.
+    if (filling_slot->length < GPS_RECEIVER_BUFFER_SIZE - 1)
+    {
+        filling_slot->data[filling_slot->length] =
+            nmea_fields_feed(&filling_slot->fields, gps_char, filling_slot->length);
+        filling_slot->length++;
+    }
+    else
+    {
+        ingest_stats.truncated++;
+        filling_slot->state = GPS_SLOT_FREE;
+        filling_slot = NULL;
+    }
+}
+
+void gps_ingest_service(void)
+{
+    /**
+        @brief move the received bytes into sentence slots
+
+        This never waits, it only processes what has already arrived.  Call it from loop() as
+        often as possible.
+
+        @return Nothing
+    */
+    uint8_t tail;
+#if !defined(GPS_INGEST_USART_ISR)
+    while (GPSSerial.available())
+    {
+        ring_put(GPSSerial.read());
+    }
+#endif
+    tail = ring_tail;
+    while (tail != ring_head)
+    {
+        if (ring_buffer[tail] == '\n')
+        {
+            line_feed_time = line_times[line_tail];
+            line_tail = (line_tail + 1) & GPS_LINE_MASK;
+        }
+        assemble((char)ring_buffer[tail]);
+        tail = (tail + 1) & GPS_RING_MASK;
+        ingest_stats.bytes_received++;
+        // hand the space back to the producer straight away
+        ring_tail = tail;
+    }
+}
+
+bool gps_ingest_pending(void)
+{
+    /**
+        @brief check if there is anything for the loop to do
+
+        It only reads, so it can be called with interrupts off just before the mcu goes to sleep.
+
+        @return true if bytes are waiting in the ring or a complete sentence is ready
+    */
+    uint8_t index;
+#if defined(GPS_INGEST_USART_ISR)
+    if (ring_head != ring_tail)
+    {
+        return true;
+    }
+#else
+    if (ring_head != ring_tail || GPSSerial.available())
+    {
+        return true;
+    }
+#endif
+    for (index = 0; index < GPS_SENTENCE_SLOTS; index++)
+    {
+        if (sentence_slots[index].state == GPS_SLOT_READY)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct gps_sentence *gps_ingest_next(void)
+{
+    /**
+        @brief get the oldest complete sentence
+
+        The slot stays owned by the caller, and the data may be modified in place, until it is
+        given back with gps_ingest_release.  A new sentence fills the lowest free slot, which
+        can be below an older ready one while fix_fusion holds slots, so the oldest is found
+        by its sequence and not by where it is.
+
+        @return a pointer to the sentence or NULL if none is ready
+    */
+    struct gps_sentence *oldest = NULL;
+    uint8_t age;
+    uint8_t oldest_age = 0;
+    for (uint8_t index = 0; index < GPS_SENTENCE_SLOTS; index++)
+    {
+        // the age is right across the wrap, there are never 256 sentences ready
+        age = (uint8_t)(next_sequence - sentence_slots[index].sequence);
+        if (sentence_slots[index].state == GPS_SLOT_READY && (oldest == NULL || age > oldest_age))
+        {
+            oldest = &sentence_slots[index];
+            oldest_age = age;
+        }
+    }
+    if (oldest != NULL)
+    {
+        oldest->state = GPS_SLOT_IN_USE;
+    }
+    return oldest;
+}
+
+void gps_ingest_release(struct gps_sentence *sentence)
+/**@brief give a sentence slot back to the ingestion layer
+ *
+ * @param sentence the pointer returned by gps_ingest_next
+ * @return Nothing
+ */
+{
+    sentence->length = 0;
+    sentence->state = GPS_SLOT_FREE;
+}
+
+void gps_ingest_get_stats(struct gps_ingest_stats *stats)
+/**@brief copy the ingestion counters
+ *
+ * @param stats where the counters are copied to
+ * @return Nothing
+ */
+{
+    *stats = ingest_stats;
+    // the interrupt updates these, so they are read with interrupts off
+    noInterrupts();
+    stats->dropped_bytes = ring_dropped_bytes;
+    stats->overruns = ring_overruns;
+    interrupts();
+}
@@ -0,0 +1,420 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  gps_link.cpp
+    @author Ralph Blach
+    @brief Baud rate search and switch, and the acked PMTK command queue.
+**/
+#include <Arduino.h>
+#include <packet_builder.h>
+#include <pmtk.h>
+#include <event_log.h>
+#include <gps_link.h>
+#include <ram_arena.h>
+
+/**
+    @brief how long the gps gets to finish sending and move after PMTK251, in ms
+*/
+#define GPS_LINK_SWITCH_TIME 50
+
+#if defined(__AVR__) || defined(NATIVE_BUILD)
+// the avr uart runs in double speed mode, see gps_ingest_set_baud
+static_assert((F_CPU / 8 / ((F_CPU / 4 / GPS_LINK_BAUD - 1) / 2 + 1)) * 100 / GPS_LINK_BAUD >= 98 &&
+                  (F_CPU / 8 / ((F_CPU / 4 / GPS_LINK_BAUD - 1) / 2 + 1)) * 100 / GPS_LINK_BAUD <= 102,
+              "the uart cannot make GPS_LINK_BAUD to within 2 percent at this clock");
+#endif
+static_assert(GPS_LINK_COMMAND_SIZE <= GPS_TX_BUFFER_SIZE, "a command built at run time does not fit the gps uart");
+
+/**
+    @brief the rates tried, in order, the one we want first because the gps keeps it on backup power
+*/
+static const uint32_t search_rates[] PROGMEM = {GPS_LINK_BAUD, GPS_LINK_DEFAULT_BAUD, 115200, 57600, 38400, 19200, 4800};
+#define SEARCH_RATES (sizeof(search_rates) / sizeof(search_rates[0]))
+
+static uint32_t bytes_received(void)
+{
+    struct gps_ingest_stats stats;
+    gps_ingest_get_stats(&stats);
+    return stats.bytes_received;
+}
+
+static char hex_digit(uint8_t value)
+{
+    return value < 10 ? '0' + value : 'A' + (value - 10);
+}
+
+static bool expired(const struct gps_link *link, uint32_t length)
+{
+    return (uint32_t)(millis() - link->timer) >= length;
+}
+
+static void start_rate(struct gps_link *link, uint32_t baud)
+{
+    /**
+        @brief move the uart to a rate and ask the gps for an ack there, the sentences that are
+        already in are kept.  The write is always taken, moving the uart drops anything unsent
+    */
+    gps_ingest_set_baud(baud);
+    link->baud = baud;
+    link->answered = false;
+    link->timer = millis();
+    link->good_bytes = bytes_received();
+    gps_ingest_write_P(pmtk_test::sentence.text);
+}
+
+static void start_search(struct gps_link *link)
+{
+    link->state = GPS_LINK_PROBE;
+    link->candidate = 0;
+    link->switch_tries = 0;
+    start_rate(link, pgm_read_dword(&search_rates[0]));
+}
+
+static void ready(struct gps_link *link)
+{
+    link->state = GPS_LINK_READY;
+    // the head command goes again at the new rate
+    link->attempts = 0;
+    link->good_bytes = bytes_received();
+    LOG(LOG_GPS_BAUD, link->baud);
+}
+
+void gps_link_begin(struct gps_link *link)
+/**@brief set up gps_ingest and start the search for the gps, commands can be queued straight away
+ *
+ * @param link the link
+ * @return Nothing
+ */
+{
+    memset(link, 0, sizeof(*link));
+    gps_ingest_begin(pgm_read_dword(&search_rates[0]));
+    start_search(link);
+}
+
+static bool queue(struct gps_link *link, const char *sentence, uint16_t type, const uint16_t *arguments,
+                  uint8_t number_of_arguments)
+{
+    struct gps_link_command *command;
+    if (link->count >= GPS_LINK_QUEUE || number_of_arguments > GPS_LINK_MAX_ARGUMENTS)
+    {
+        link->stats.dropped++;
+        return false;
+    }
+    command = &link->commands[(link->head + link->count) % GPS_LINK_QUEUE];
+    command->sentence = sentence;
+    command->type = type;
+    command->number_of_arguments = number_of_arguments;
+    if (arguments != NULL)
+    {
+        memcpy(command->arguments, arguments, number_of_arguments * sizeof(arguments[0]));
+    }
+    link->count++;
+    return true;
+}
+
+bool gps_link_send_P(struct gps_link *link, const char *sentence, uint16_t type)
+/**@brief queue a sentence that is in flash, use the gps_link_send<Command> template
+ *
+ * @param link the link
+ * @param sentence the whole sentence in PROGMEM
+ * @param type its PMTK type, the ack is matched on it
+ * @return false if the queue is full
+ */
+{
+    return queue(link, sentence, type, NULL, 0);
+}
+
+bool gps_link_send(struct gps_link *link, uint16_t type, const uint16_t *arguments, uint8_t number_of_arguments)
+/**@brief queue a command that is built when it is sent, for arguments only known at run time
+ *
+ * @param link the link
+ * @param type the PMTK packet type, 220 for the fix interval
+ * @param arguments the numbers that follow the type, each one after a comma
+ * @param number_of_arguments the number of arguments, at most GPS_LINK_MAX_ARGUMENTS
+ * @return false if the queue is full
+ */
+{
+    return queue(link, NULL, type, arguments, number_of_arguments);
+}
+
+static bool write_command(const struct gps_link_command *command)
+{
+    /**
+        @brief send a command, a sentence from flash as it is, the others built with the checksum
+
+        @return false if the uart is still writing the last one, it is sent on a later pass
+    */
+    union ram_arena_space *arena;
+    char *text;
+    struct packet_builder builder;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum = 0;
+
+    if (gps_ingest_writing())
+    {
+        return false;
+    }
+    if (command->sentence != NULL)
+    {
+        gps_ingest_write_P(command->sentence);
+        LOG(LOG_GPS_COMMAND, strlen_P(command->sentence), command->type);
+        return true;
+    }
+    // the command is built in the arena, it is only needed until it is written
+    arena = ram_arena_take(RAM_ARENA_GPS_COMMAND);
+    if (arena == NULL)
+    {
+        return false;
+    }
+    text = arena->gps_command;
+    packet_builder_start(&builder, (uint8_t *)text, GPS_LINK_COMMAND_SIZE - 6);
+    packet_builder_append_string(&builder, "$PMTK");
+    // the type is always three digits, $PMTK000 is the test command
+    packet_builder_append_char(&builder, '0' + command->type / 100 % 10);
+    packet_builder_append_char(&builder, '0' + command->type / 10 % 10);
+    packet_builder_append_char(&builder, '0' + command->type % 10);
+    for (index = 0; index < command->number_of_arguments; index++)
+    {
+        packet_builder_append_char(&builder, ',');
+        packet_builder_append_decimal(&builder, command->arguments[index]);
+    }
+    length = packet_builder_finish(&builder);
+    if (length == 0)
+    {
+        ram_arena_release(RAM_ARENA_GPS_COMMAND);
+        return true;
+    }
+    // the checksum covers everything between the $ and the *
+    for (index = 1; index < length; index++)
+    {
+        checksum ^= (uint8_t)text[index];
+    }
+    text[length++] = '*';
+    text[length++] = hex_digit(checksum >> 4);
+    text[length++] = hex_digit(checksum & 0x0f);
+    text[length++] = '\r';
+    text[length++] = '\n';
+    text[length] = 0;
+    gps_ingest_write(text);
+    ram_arena_release(RAM_ARENA_GPS_COMMAND);
+    LOG(LOG_GPS_COMMAND, length, command->type);
+    return true;
+}
+
+static void finish_command(struct gps_link *link)
+{
+    link->head = (link->head + 1) % GPS_LINK_QUEUE;
+    link->count--;
+    link->attempts = 0;
+}
+
+static uint16_t field_number(struct gps_sentence *sentence, uint8_t index)
+{
+    const char *field = gps_sentence_field(sentence, index);
+    uint16_t value = 0;
+    while (*field >= '0' && *field <= '9')
+    {
+        value = value * 10 + (*field++ - '0');
+    }
+    return value;
+}
+
+void gps_link_sentence(struct gps_link *link, struct gps_sentence *sentence)
+/**@brief look at every sentence from gps_ingest_next, it proves the rate and may be an ack
+ *
+ * @param link the link
+ * @param sentence the sentence, it is only read
+ * @return Nothing
+ */
+{
+    uint16_t type;
+    uint8_t flag;
+
+    link->answered = true;
+    link->answered_baud = link->baud;
+    link->good_bytes = bytes_received();
+    // $PMTK001,type,flag
+    if (strcmp_P(sentence->data, PSTR("$PMTK001")) != 0)
+    {
+        return;
+    }
+    type = field_number(sentence, 1);
+    flag = (uint8_t)field_number(sentence, 2);
+    if (link->state != GPS_LINK_READY || link->count == 0 || link->attempts == 0 ||
+        link->commands[link->head].type != type)
+    {
+        // the ack of a search PMTK000, or of a command that was already given up on
+        return;
+    }
+    LOG(LOG_GPS_ACK, type, flag);
+    if (flag == GPS_ACK_SUCCEEDED)
+    {
+        link->stats.acked++;
+    }
+    else
+    {
+        link->stats.rejected++;
+    }
+    finish_command(link);
+}
+
+static void service_commands(struct gps_link *link)
+{
+    /**
+        @brief send the head command, or send it again if the ack is late
+    */
+    if (link->count == 0 || (link->attempts != 0 && !expired(link, GPS_LINK_ACK_TIMEOUT)))
+    {
+        return;
+    }
+    if (link->attempts > GPS_LINK_RETRIES)
+    {
+        link->stats.failed++;
+        LOG(LOG_GPS_NO_ACK, link->commands[link->head].type);
+        finish_command(link);
+        if (link->count == 0)
+        {
+            return;
+        }
+    }
+    if (!write_command(&link->commands[link->head]))
+    {
+        return;
+    }
+    if (link->attempts != 0)
+    {
+        link->stats.resent++;
+    }
+    link->attempts++;
+    link->timer = millis();
+}
+
+void gps_link_service(struct gps_link *link)
+/**@brief move the search on, send the commands and watch for a lost rate, never waits
+ *
+ * Call it on every pass of the loop, each sentence from gps_ingest_next has to be given
+ * to gps_link_sentence as well.
+ * @param link the link
+ * @return Nothing
+ */
+{
+    uint32_t rate;
+    switch (link->state)
+    {
+    case GPS_LINK_PROBE:
+        if (link->answered)
+        {
+            if (link->baud == GPS_LINK_BAUD || link->switch_tries >= GPS_LINK_SWITCH_TRIES)
+            {
+                ready(link);
+                break;
+            }
+            // the gps moves without an ack at the old rate, the PMTK000 at the new one confirms it
+            if (!gps_ingest_write_P(pmtk_baud_rate<GPS_LINK_BAUD>::sentence.text))
+            {
+                break;
+            }
+            link->switch_tries++;
+            link->state = GPS_LINK_CONFIRM;
+            link->answered = false;
+            link->timer = millis();
+            break;
+        }
+        if (!expired(link, GPS_LINK_PROBE_TIME))
+        {
+            break;
+        }
+        // the next rate that has not been tried, the first one may be in the list twice
+        do
+        {
+            link->candidate++;
+            rate = link->candidate < SEARCH_RATES ? pgm_read_dword(&search_rates[link->candidate]) : 0;
+        } while (rate == GPS_LINK_BAUD && link->candidate > 0);
+        if (link->candidate >= SEARCH_RATES)
+        {
+            // nothing answered, the gps may be off, stay where it was last heard or at its default
+            start_rate(link, link->answered_baud != 0 ? link->answered_baud : GPS_LINK_DEFAULT_BAUD);
+            ready(link);
+            break;
+        }
+        start_rate(link, rate);
+        break;
+    case GPS_LINK_CONFIRM:
+        if (link->baud != GPS_LINK_BAUD)
+        {
+            // the PMTK251 has to be on the wire before the uart changes, the time starts once
+            // the interrupt has sent it
+            if (gps_ingest_writing())
+            {
+                link->timer = millis();
+            }
+            else if (expired(link, GPS_LINK_SWITCH_TIME))
+            {
+                start_rate(link, GPS_LINK_BAUD);
+            }
+            break;
+        }
+        if (link->answered)
+        {
+            ready(link);
+            break;
+        }
+        if (expired(link, GPS_LINK_PROBE_TIME))
+        {
+            link->stats.switch_failed++;
+            link->state = GPS_LINK_PROBE;
+            link->candidate = 0;
+            start_rate(link, pgm_read_dword(&search_rates[0]));
+        }
+        break;
+    default:
+        if (bytes_received() - link->good_bytes > GPS_LINK_GARBAGE_BYTES)
+        {
+            link->stats.resyncs++;
+            LOG(LOG_GPS_RESYNC, link->baud);
+            start_search(link);
+            break;
+        }
+        service_commands(link);
+        break;
+    }
+}
+
+bool gps_link_idle(const struct gps_link *link)
+/**@brief check if the rate is settled and every command has been acked or given up on
+ *
+ * @param link the link
+ * @return true if there is nothing left to do
+ */
+{
+    return link->state == GPS_LINK_READY && link->count == 0;
+}
+
+void gps_link_print(const struct gps_link *link, Print &out)
+/**@brief print the rate and the counters, for the gps console command
+ *
+ * @param link the link
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    out.print(F("gps link "));
+    out.print(link->baud);
+    out.println(link->state == GPS_LINK_READY ? F(" baud") : F(" baud, searching"));
+    out.print(F("acked "));
+    out.print(link->stats.acked);
+    out.print(F(" rejected "));
+    out.print(link->stats.rejected);
+    out.print(F(" resent "));
+    out.print(link->stats.resent);
+    out.print(F(" failed "));
+    out.print(link->stats.failed);
+    out.print(F(" dropped "));
+    out.println(link->stats.dropped);
+    out.print(F("resyncs "));
+    out.print(link->stats.resyncs);
+    out.print(F(" rate switches failed "));
+    out.println(link->stats.switch_failed);
+}
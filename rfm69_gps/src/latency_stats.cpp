@@ -0,0 +1,274 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  latency_stats.cpp
+    @author Ralph Blach
+    @brief Stage latency histograms, tries and ack rssi, and their console and telemetry forms.
+**/
+#include <Arduino.h>
+#include <packet_builder.h>
+#include <position_packet.h>
+#include <latency_stats.h>
+
+void latency_stats_reset(struct latency_stats *stats)
+/**@brief zero every counter
+ *
+ * @param stats the counters
+ * @return Nothing
+ */
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+static void count(uint16_t *counter)
+{
+    // a counter that sticks at the top is still right about the shape of the histogram
+    if (*counter != 0xffff)
+    {
+        (*counter)++;
+    }
+}
+
+static void count_bucket(uint8_t *buckets, uint8_t number_of_buckets, uint8_t index)
+{
+    /**
+        @brief add one to a histogram bucket, a full one halves the whole histogram first so
+        the percentiles keep their place and lean to the recent samples
+    */
+    if (buckets[index] == 0xff)
+    {
+        for (uint8_t other = 0; other < number_of_buckets; other++)
+        {
+            // rounded up, a bucket with samples in it keeps one
+            buckets[other] = (uint8_t)((buckets[other] + 1) >> 1);
+        }
+    }
+    buckets[index]++;
+}
+
+static uint8_t bucket(uint32_t microseconds)
+{
+    /**
+        @brief the power of 2 bucket of a time, a shift loop, there is no divide on the avr
+    */
+    uint8_t index = 0;
+    microseconds >>= LATENCY_BUCKET_SHIFT;
+    while (microseconds != 0 && index < LATENCY_BUCKETS - 1)
+    {
+        microseconds >>= 1;
+        index++;
+    }
+    return index;
+}
+
+void latency_stats_record(struct latency_stats *stats, uint8_t stage, uint32_t microseconds)
+/**@brief add one sample to the histogram of a stage
+ *
+ * @param stats the counters
+ * @param stage one of the LATENCY_ stages
+ * @param microseconds the time the stage took
+ * @return Nothing
+ */
+{
+    struct latency_stage *histogram = &stats->stages[stage];
+    count_bucket(histogram->buckets, LATENCY_BUCKETS, bucket(microseconds));
+    histogram->count++;
+    if (microseconds > histogram->max)
+    {
+        histogram->max = microseconds;
+    }
+}
+
+void latency_stats_delivery(struct latency_stats *stats, bool delivered, uint8_t attempts, int16_t rssi)
+/**@brief count how a packet went
+ *
+ * @param stats the counters
+ * @param delivered true if the packet was acked
+ * @param attempts the times it was sent
+ * @param rssi the rssi of the ack in dBm, only used when it was delivered
+ * @return Nothing
+ */
+{
+    int16_t index;
+    if (!delivered)
+    {
+        count(&stats->failed);
+        return;
+    }
+    index = attempts > LATENCY_ATTEMPT_BUCKETS ? LATENCY_ATTEMPT_BUCKETS - 1 : attempts - 1;
+    count(&stats->attempts[index < 0 ? 0 : index]);
+    index = (rssi - LATENCY_RSSI_FLOOR) / LATENCY_RSSI_STEP;
+    if (rssi < LATENCY_RSSI_FLOOR)
+    {
+        index = 0;
+    }
+    if (index >= LATENCY_RSSI_BUCKETS)
+    {
+        index = LATENCY_RSSI_BUCKETS - 1;
+    }
+    count_bucket(stats->rssi, LATENCY_RSSI_BUCKETS, (uint8_t)index);
+}
+
+static uint8_t percentile(const uint8_t *buckets, uint8_t number_of_buckets, uint8_t percent)
+{
+    /**
+        @brief the first bucket where the running total reaches percent of all the samples
+
+        @return the bucket index, 0 when there are no samples
+    */
+    uint32_t total = 0;
+    uint32_t running = 0;
+    uint8_t index;
+    for (index = 0; index < number_of_buckets; index++)
+    {
+        total += buckets[index];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    for (index = 0; index < number_of_buckets - 1; index++)
+    {
+        running += buckets[index];
+        if (running * 100 >= total * percent)
+        {
+            break;
+        }
+    }
+    return index;
+}
+
+uint8_t latency_stats_percentile(const struct latency_stage *stage, uint8_t percent)
+/**@brief the bucket a percentile of a stage falls in
+ *
+ * @param stage the stage histogram
+ * @param percent the percentile, 50 is the median
+ * @return the bucket index, the time is under 2^(index + LATENCY_BUCKET_SHIFT) us
+ */
+{
+    return percentile(stage->buckets, LATENCY_BUCKETS, percent);
+}
+
+static void print_bound(Print &out, uint8_t index)
+{
+    /**
+        @brief print the top of a bucket, in us up to 64 ms and in ms after that
+    */
+    uint8_t shift = index + LATENCY_BUCKET_SHIFT;
+    if (index == LATENCY_BUCKETS - 1)
+    {
+        out.print(F(">"));
+        shift--;
+    }
+    else
+    {
+        out.print(F("<"));
+    }
+    if (shift <= 16)
+    {
+        out.print(1UL << shift);
+        out.print(F(" us"));
+        return;
+    }
+    out.print((1UL << shift) / 1000);
+    out.print(F(" ms"));
+}
+
+void latency_stats_print(const struct latency_stats *stats, Print &out)
+/**@brief print the histograms, for the latency console command
+ *
+ * Only the buckets with samples in them are printed.
+ * @param stats the counters
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    static const char names[LATENCY_STAGE_COUNT][8] PROGMEM = {"receive", "parse", "build", "air", "total"};
+    const struct latency_stage *stage;
+    uint8_t index;
+    uint8_t bucket_index;
+
+    for (index = 0; index < LATENCY_STAGE_COUNT; index++)
+    {
+        stage = &stats->stages[index];
+        out.print((const __FlashStringHelper *)names[index]);
+        out.print(F(" "));
+        out.print(stage->count);
+        out.print(F(" samples, median "));
+        print_bound(out, latency_stats_percentile(stage, 50));
+        out.print(F(", 90% "));
+        print_bound(out, latency_stats_percentile(stage, 90));
+        out.print(F(", max "));
+        out.print(stage->max);
+        out.println(F(" us"));
+        for (bucket_index = 0; bucket_index < LATENCY_BUCKETS; bucket_index++)
+        {
+            if (stage->buckets[bucket_index] == 0)
+            {
+                continue;
+            }
+            out.print(F("  "));
+            print_bound(out, bucket_index);
+            out.print(F(" "));
+            out.println(stage->buckets[bucket_index]);
+        }
+    }
+    out.print(F("tries"));
+    for (index = 0; index < LATENCY_ATTEMPT_BUCKETS; index++)
+    {
+        out.print(F(" "));
+        out.print(stats->attempts[index]);
+    }
+    out.print(F(", failed "));
+    out.println(stats->failed);
+    out.print(F("ack rssi from "));
+    out.print(LATENCY_RSSI_FLOOR);
+    out.print(F(" dBm"));
+    for (index = 0; index < LATENCY_RSSI_BUCKETS; index++)
+    {
+        out.print(F(" "));
+        out.print(stats->rssi[index]);
+    }
+    out.println();
+}
+
+static uint16_t clamp16(uint32_t value)
+{
+    return value > 0xffff ? 0xffff : (uint16_t)value;
+}
+
+uint8_t latency_telemetry_encode(const struct latency_stats *stats, const char *call_sign, uint8_t *buffer,
+                                 uint8_t buffer_size)
+/**@brief pack a summary of the counters in a telemetry packet, the format is in latency_stats.h
+ *
+ * @param stats the counters
+ * @param call_sign the call sign, CALL_SIGN_LENGTH characters
+ * @param buffer where the packet is written
+ * @param buffer_size the size of buffer
+ * @return the length of the packet, or 0 if the buffer is too small
+ */
+{
+    struct packet_builder builder;
+    const struct latency_stage *stage;
+    uint8_t index;
+
+    packet_builder_start(&builder, buffer, buffer_size);
+    packet_builder_append_char(&builder, LATENCY_TELEMETRY_MAGIC | LATENCY_TELEMETRY_VERSION);
+    packet_builder_append(&builder, call_sign, CALL_SIGN_LENGTH);
+    for (index = 0; index < LATENCY_STAGE_COUNT; index++)
+    {
+        stage = &stats->stages[index];
+        packet_builder_append_le(&builder, clamp16(stage->count), 2);
+        packet_builder_append_char(&builder, latency_stats_percentile(stage, 50));
+        packet_builder_append_char(&builder, latency_stats_percentile(stage, 90));
+        packet_builder_append_le(&builder, clamp16(stage->max / 1000), 2);
+    }
+    for (index = 0; index < LATENCY_ATTEMPT_BUCKETS; index++)
+    {
+        packet_builder_append_le(&builder, stats->attempts[index], 2);
+    }
+    packet_builder_append_le(&builder, stats->failed, 2);
+    packet_builder_append_char(&builder, percentile(stats->rssi, LATENCY_RSSI_BUCKETS, 50));
+    return packet_builder_finish(&builder);
+}
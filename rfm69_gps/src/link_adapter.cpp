@@ -0,0 +1,298 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  link_adapter.cpp
+    @author Ralph Blach
+    @brief The profile table, the up and down rules and the change request of the link adapter.
+**/
+#include <Arduino.h>
+#include <RH_RF69.h>
+#include <event_log.h>
+#include <link_adapter.h>
+
+/**
+    @brief slowest and loudest first.  The sensitivities are read off the RFM69HCW data sheet
+    curves and the currents are its typical ones, LINK_ADAPT_MARGIN covers what they are off by
+*/
+static const struct link_profile profiles[LINK_PROFILE_COUNT] PROGMEM = {
+    {RH_RF69::GFSK_Rb9_6Fd19_2, 20, -110, 130, 9600},
+    {RH_RF69::GFSK_Rb19_2Fd38_4, 20, -106, 130, 19200},
+    {RH_RF69::GFSK_Rb38_4Fd76_8, 20, -103, 130, 38400},
+    {RH_RF69::GFSK_Rb57_6Fd120, 20, -101, 130, 57600},
+    {RH_RF69::GFSK_Rb125Fd125, 20, -97, 130, 125000},
+    {RH_RF69::GFSK_Rb250Fd250, 20, -94, 130, 250000},
+    {RH_RF69::GFSK_Rb250Fd250, 13, -94, 45, 250000},
+    {RH_RF69::GFSK_Rb250Fd250, 7, -94, 33, 250000},
+    {RH_RF69::GFSK_Rb250Fd250, 2, -94, 22, 250000},
+};
+
+static_assert(LINK_ADAPT_HOME < LINK_PROFILE_COUNT, "the home profile is not in the table");
+
+void link_adapter_profile(uint8_t index, struct link_profile *profile)
+/**@brief copy a profile out of flash
+ *
+ * @param index the profile, less than LINK_PROFILE_COUNT
+ * @param profile where to put it
+ * @return Nothing
+ */
+{
+    memcpy_P(profile, &profiles[index], sizeof(*profile));
+}
+
+static void apply(struct link_adapter *adapter, uint8_t index)
+{
+    /**
+        @brief put a profile on the radio, the queue times its exchanges with the new bit rate
+    */
+    struct link_profile profile;
+    link_adapter_profile(index, &profile);
+    adapter->profile = index;
+    adapter->streak = 0;
+    adapter->queue->bit_rate = profile.bit_rate;
+    if (adapter->apply != NULL)
+    {
+        adapter->apply(adapter->context, &profile);
+    }
+    LOG(LOG_LINK_PROFILE, index, profile.bit_rate / 100, profile.power);
+}
+
+void link_adapter_init(struct link_adapter *adapter, struct tx_queue *queue, link_apply_callback apply_profile,
+                       void *context)
+/**@brief start on the home profile
+ *
+ * @param adapter the adapter
+ * @param queue the transmit queue, it has to be initialized
+ * @param apply_profile puts a profile on the radio
+ * @param context handed to apply_profile
+ * @return Nothing
+ */
+{
+    memset(adapter, 0, sizeof(*adapter));
+    adapter->queue = queue;
+    adapter->apply = apply_profile;
+    adapter->context = context;
+    adapter->want = LINK_PROFILE_NONE;
+    adapter->requested = LINK_PROFILE_NONE;
+    adapter->last_ack = millis();
+    apply(adapter, LINK_ADAPT_HOME);
+}
+
+int16_t link_adapter_margin(const struct link_adapter *adapter, uint8_t index)
+/**@brief how far over the base station's sensitivity a frame would arrive on a profile
+ *
+ * @param adapter the adapter
+ * @param index the profile
+ * @return the margin in dB, from the average ack rssi
+ */
+{
+    struct link_profile profile;
+    link_adapter_profile(index, &profile);
+    return adapter->rssi / 4 + profile.power - LINK_ADAPT_BASE_POWER - profile.sensitivity;
+}
+
+static uint8_t fastest_below(const struct link_adapter *adapter, uint8_t index)
+{
+    /**
+        @brief the fastest profile under index that has the margin, or home
+    */
+    while (index > LINK_ADAPT_HOME)
+    {
+        index--;
+        if (adapter->have_rssi && link_adapter_margin(adapter, index) >= LINK_ADAPT_MARGIN)
+        {
+            break;
+        }
+    }
+    return index;
+}
+
+static bool is_request(const struct tx_frame *frame)
+{
+    return frame->length == LINK_PROFILE_LENGTH && frame->data[0] == (LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION);
+}
+
+void link_adapter_complete(struct link_adapter *adapter, const struct tx_frame *frame, bool delivered,
+                           uint8_t attempts)
+/**@brief look at every finished frame, from the transmit queue on_complete callback
+ *
+ * @param adapter the adapter
+ * @param frame the frame
+ * @param delivered true if it was acked
+ * @param attempts how many times it was sent
+ * @return Nothing
+ */
+{
+    int16_t rssi = adapter->queue->stats.last_ack_rssi;
+    uint8_t index;
+
+    if (delivered)
+    {
+        adapter->last_ack = millis();
+        adapter->rssi = adapter->have_rssi ? adapter->rssi + (rssi * 4 - adapter->rssi) / 4 : rssi * 4;
+        adapter->have_rssi = true;
+    }
+    if (is_request(frame))
+    {
+        index = frame->data[1];
+        if (delivered)
+        {
+            // the base station has changed, and so do we
+            if (index > (adapter->probing ? adapter->probe_from : adapter->profile))
+            {
+                adapter->stats.up++;
+            }
+            else
+            {
+                adapter->stats.down++;
+            }
+            apply(adapter, index);
+            adapter->probing = false;
+        }
+        else if (!adapter->probing)
+        {
+            // the ack may be the only thing that was lost, ask again where the base would be
+            adapter->probing = true;
+            adapter->probe_from = adapter->profile;
+            adapter->want = index;
+            adapter->stats.probes++;
+            apply(adapter, index);
+        }
+        else
+        {
+            adapter->probing = false;
+            adapter->stats.refused++;
+            apply(adapter, adapter->probe_from);
+        }
+        adapter->requested = LINK_PROFILE_NONE;
+        return;
+    }
+    // a frame sent before a change, or during a probe, says nothing about the profile in use
+    if (adapter->requested != LINK_PROFILE_NONE || adapter->probing)
+    {
+        return;
+    }
+    adapter->want = LINK_PROFILE_NONE;
+    if (!delivered || attempts > 2 || link_adapter_margin(adapter, adapter->profile) < LINK_ADAPT_MARGIN / 2)
+    {
+        adapter->streak = 0;
+        if (adapter->profile != LINK_ADAPT_HOME)
+        {
+            adapter->want = fastest_below(adapter, adapter->profile);
+        }
+        return;
+    }
+    if (attempts == 1 && adapter->streak < 255)
+    {
+        adapter->streak++;
+    }
+    else if (attempts != 1)
+    {
+        adapter->streak = 0;
+    }
+    if (adapter->streak >= LINK_ADAPT_UP_FRAMES)
+    {
+        index = fastest_below(adapter, LINK_PROFILE_COUNT);
+        if (index > adapter->profile)
+        {
+            adapter->want = index;
+        }
+    }
+}
+
+bool link_adapter_service(struct link_adapter *adapter, uint8_t to)
+/**@brief go home after a silence, and queue a change request when one is wanted
+ *
+ * Call it on every pass of the loop, the request only goes when the queue is idle.
+ * @param adapter the adapter
+ * @param to the base station address
+ * @return true if a request was queued
+ */
+{
+    uint8_t *buffer;
+
+    if ((uint32_t)(millis() - adapter->last_ack) > LINK_ADAPT_SILENCE)
+    {
+        adapter->last_ack = millis();
+        if (adapter->profile != LINK_ADAPT_HOME)
+        {
+            // the base station has gone home by now too
+            adapter->stats.silences++;
+            adapter->probing = false;
+            adapter->want = LINK_PROFILE_NONE;
+            apply(adapter, LINK_ADAPT_HOME);
+        }
+    }
+    if (adapter->want == LINK_PROFILE_NONE || adapter->requested != LINK_PROFILE_NONE ||
+        !tx_queue_idle(adapter->queue))
+    {
+        return false;
+    }
+    buffer = tx_queue_reserve(adapter->queue);
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    buffer[0] = LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION;
+    buffer[1] = adapter->want;
+    if (!tx_queue_commit(adapter->queue, LINK_PROFILE_LENGTH, to))
+    {
+        return false;
+    }
+    adapter->requested = adapter->want;
+    adapter->want = LINK_PROFILE_NONE;
+    adapter->stats.requests++;
+    return true;
+}
+
+bool link_profile_decode(const uint8_t *buffer, uint8_t length, uint8_t *index)
+/**@brief read a change request, for the base station
+ *
+ * @param buffer the packet
+ * @param length its length
+ * @param index the profile asked for
+ * @return true if it is a request for a profile in the table
+ */
+{
+    if (length != LINK_PROFILE_LENGTH || buffer[0] != (LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION) ||
+        buffer[1] >= LINK_PROFILE_COUNT)
+    {
+        return false;
+    }
+    *index = buffer[1];
+    return true;
+}
+
+void link_adapter_print(const struct link_adapter *adapter, Print &out)
+/**@brief print the profile and the counters, for the link console command
+ *
+ * @param adapter the adapter
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    struct link_profile profile;
+    link_adapter_profile(adapter->profile, &profile);
+    out.print(F("profile "));
+    out.print(adapter->profile);
+    out.print(F(", "));
+    out.print(profile.bit_rate);
+    out.print(F(" bps at "));
+    out.print(profile.power);
+    out.print(F(" dBm, ack rssi "));
+    out.print(adapter->rssi / 4);
+    out.print(F(" margin "));
+    out.println(link_adapter_margin(adapter, adapter->profile));
+    out.print(F("requests "));
+    out.print(adapter->stats.requests);
+    out.print(F(" up "));
+    out.print(adapter->stats.up);
+    out.print(F(" down "));
+    out.print(adapter->stats.down);
+    out.print(F(" probes "));
+    out.print(adapter->stats.probes);
+    out.print(F(" refused "));
+    out.print(adapter->stats.refused);
+    out.print(F(" silences "));
+    out.println(adapter->stats.silences);
+}
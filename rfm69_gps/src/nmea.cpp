@@ -0,0 +1,138 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  nmea.cpp
+    @author Ralph Blach
+    @brief Single pass NMEA tokenizer with the checksum check done on the way.
+
+    nmea_fields_feed is called once for every character after the $.  It works out the xor
+    checksum, turns every comma into a 0 so each field is a null terminated string, and records
+    where each field starts.  It lives in nmea.h so it is inlined into the per byte loops.  Consecutive commas give empty fields, they are not skipped.  When
+    the line feed arrives the sentence has already been split and checked, nothing is scanned again.
+**/
+#include <nmea.h>
+
+void nmea_fields_start(struct nmea_fields *fields)
+/**@brief start a new sentence, call this when the $ is stored at position 0
+ *
+ * The $ is part of field 0, so field 0 is $GPRMC, the same as parse_gps_data always gave.
+ * @param fields the tokenizer state
+ * @return Nothing
+ */
+{
+    fields->count = 1;
+    fields->offset[0] = 0;
+    fields->checksum = 0;
+    fields->received_checksum = 0;
+    fields->state = NMEA_STATE_BODY;
+}
+
+bool nmea_fields_valid(const struct nmea_fields *fields)
+/**@brief check a finished sentence
+ *
+ * @param fields the tokenizer state after the last character
+ * @return true if the sentence had a *hh checksum and it matched
+ */
+{
+    return fields->state == NMEA_STATE_DONE && fields->checksum == fields->received_checksum;
+}
+
+uint32_t nmea_parse_decimal(const char *text, uint8_t fraction_digits, bool *present)
+/**@brief convert a decimal field to an integer scaled by 10 ^ fraction_digits
+ *
+ * "0.51" with 2 fraction digits is 51.  Extra fraction digits are dropped, missing ones are
+ * filled with zeros.
+ * @param text the null terminated field
+ * @param fraction_digits the number of digits to keep after the decimal point
+ * @param present set to false if the field was empty
+ * @return the scaled value
+ */
+{
+    uint32_t value = 0;
+    bool in_fraction = false;
+    *present = (text[0] != 0);
+    for (; *text; text++)
+    {
+        if (*text == '.')
+        {
+            in_fraction = true;
+            continue;
+        }
+        if (*text < '0' || *text > '9')
+        {
+            break;
+        }
+        if (in_fraction)
+        {
+            if (fraction_digits == 0)
+            {
+                continue;
+            }
+            fraction_digits--;
+        }
+        value = value * 10 + (*text - '0');
+    }
+    while (fraction_digits--)
+    {
+        value *= 10;
+    }
+    return value;
+}
+
+uint32_t nmea_time_of_day(const char *text)
+/**@brief convert a hhmmss.ss utc time field to 10 millisecond ticks since midnight
+ *
+ * @param text the null terminated field
+ * @return the time, 0 for an empty field
+ */
+{
+    bool present;
+    uint32_t value = nmea_parse_decimal(text, 2, &present);
+    return (value / 1000000UL) * 360000UL + (value / 10000 % 100) * 6000UL + value % 10000;
+}
+
+int32_t nmea_parse_coordinate(const char *text, const char *hemisphere, bool *present)
+/**@brief convert a ddmm.mmmm or dddmm.mmmm coordinate to 1e-7 degrees in one pass
+ *
+ * The minutes are kept to 1e-5, the digit after that rounds them, so the MT3333's four
+ * digits are converted to within half a unit.  No floating point is used.
+ * @param text the null terminated coordinate field
+ * @param hemisphere the N S E W field, S and W are negative
+ * @param present set to false if the field was empty
+ * @return the coordinate in 1e-7 degrees
+ */
+{
+    uint32_t whole = 0;
+    uint32_t fraction = 0;
+    uint8_t digits = 0;
+    int32_t result;
+
+    *present = (text[0] != 0);
+    for (; *text >= '0' && *text <= '9'; text++)
+    {
+        whole = whole * 10 + (*text - '0');
+    }
+    if (*text == '.')
+    {
+        for (text++; *text >= '0' && *text <= '9' && digits < 6; text++, digits++)
+        {
+            if (digits < 5)
+            {
+                fraction = fraction * 10 + (*text - '0');
+            }
+            else if (*text >= '5')
+            {
+                fraction++;
+            }
+        }
+    }
+    for (; digits < 5; digits++)
+    {
+        fraction *= 10;
+    }
+    // minutes scaled by 1e5, and 1e-5 minutes to 1e-7 degrees is * 100 / 60, rounded
+    fraction += (whole % 100) * 100000UL;
+    result = (int32_t)((whole / 100) * 10000000UL + (fraction * 5 + 1) / 3);
+    return hemisphere[0] == 'S' || hemisphere[0] == 'W' ? -result : result;
+}
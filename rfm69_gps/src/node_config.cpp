@@ -0,0 +1,239 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  node_config.cpp
+    @author Ralph Blach
+    @brief The settings block in the eeprom, its crc and the move from the old single bytes.
+**/
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <event_log.h>
+#include <node_config.h>
+
+static bool call_sign_valid(const char *call_sign)
+{
+    /**
+        @brief letters and digits padded with spaces, with a letter and a digit in it like every
+        call sign, an erased eeprom is all 0xff and fails
+    */
+    bool letter = false;
+    bool digit = false;
+    bool padding = false;
+    for (uint8_t index = 0; index < CALL_SIGN_LENGTH; index++)
+    {
+        char value = call_sign[index];
+        if (value == ' ' && index != 0)
+        {
+            padding = true;
+        }
+        else if (padding)
+        {
+            return false;
+        }
+        else if ((value >= 'A' && value <= 'Z') || (value >= 'a' && value <= 'z'))
+        {
+            letter = true;
+        }
+        else if (value >= '0' && value <= '9')
+        {
+            digit = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return letter && digit;
+}
+
+uint16_t node_config_crc(const uint8_t *data, uint8_t length)
+/**@brief crc 16 ccitt, polynomial 0x1021 from 0xffff, a bit at a time, it only runs at boot
+ *
+ * @param data the bytes
+ * @param length how many
+ * @return the crc
+ */
+{
+    uint16_t crc = 0xffff;
+    while (length-- != 0)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (uint16_t)(crc << 1) ^ 0x1021 : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static bool block_valid(const struct node_config *config)
+{
+    return config->magic == NODE_CONFIG_MAGIC && config->version == NODE_CONFIG_VERSION &&
+           config->crc == node_config_crc((const uint8_t *)config, offsetof(struct node_config, crc));
+}
+
+static bool version_1_valid(const struct node_config *config)
+{
+    /**
+        @brief a version 1 block, its crc is where the moving fix interval is now
+    */
+    return config->magic == NODE_CONFIG_MAGIC && config->version == 1 &&
+           config->moving_fix_interval == node_config_crc((const uint8_t *)config, NODE_CONFIG_VERSION_1_LENGTH);
+}
+
+uint8_t node_config_load(struct node_config *config, const struct node_config *defaults)
+/**@brief read the block, or make one from a version 1 block or the old bytes, or use the defaults
+ *
+ * Moving a version 1 block or the old bytes writes the block, a few tens of ms once in the
+ * life of the tracker.
+ * @param config where to put the settings
+ * @param defaults the settings of a tracker with nothing in the eeprom, in flash
+ * @return a node_config_source
+ */
+{
+    uint8_t legacy[NODE_CONFIG_LEGACY_SLOT + 1];
+
+    EEPROM.get(NODE_CONFIG_EEPROM_START, *config);
+    if (block_valid(config))
+    {
+        LOG(LOG_CONFIG, NODE_CONFIG_FROM_BLOCK, config->version);
+        return NODE_CONFIG_FROM_BLOCK;
+    }
+    if (version_1_valid(config))
+    {
+        // the settings it had and the defaults of the fields added since
+        memcpy_P((uint8_t *)config + NODE_CONFIG_VERSION_1_LENGTH, (const uint8_t *)defaults + NODE_CONFIG_VERSION_1_LENGTH,
+                 sizeof(*config) - NODE_CONFIG_VERSION_1_LENGTH);
+        node_config_save(config);
+        LOG(LOG_CONFIG, NODE_CONFIG_FROM_VERSION_1, config->version);
+        return NODE_CONFIG_FROM_VERSION_1;
+    }
+    memcpy_P(config, defaults, sizeof(*config));
+    EEPROM.get(NODE_CONFIG_LEGACY_CALL_SIGN, legacy);
+    if (!call_sign_valid((const char *)&legacy[NODE_CONFIG_LEGACY_CALL_SIGN]))
+    {
+        LOG(LOG_CONFIG, NODE_CONFIG_FROM_DEFAULTS, config->version);
+        return NODE_CONFIG_FROM_DEFAULTS;
+    }
+    memcpy(config->call_sign, &legacy[NODE_CONFIG_LEGACY_CALL_SIGN], CALL_SIGN_LENGTH);
+    // the radio takes no 0 sync byte, and an erased pair is the default network
+    if (legacy[NODE_CONFIG_LEGACY_SYNC_WORDS] != 0 && legacy[NODE_CONFIG_LEGACY_SYNC_WORDS + 1] != 0 &&
+        (legacy[NODE_CONFIG_LEGACY_SYNC_WORDS] != 0xff || legacy[NODE_CONFIG_LEGACY_SYNC_WORDS + 1] != 0xff))
+    {
+        config->sync_words[0] = legacy[NODE_CONFIG_LEGACY_SYNC_WORDS];
+        config->sync_words[1] = legacy[NODE_CONFIG_LEGACY_SYNC_WORDS + 1];
+    }
+    config->slot = legacy[NODE_CONFIG_LEGACY_SLOT];
+    node_config_save(config);
+    LOG(LOG_CONFIG, NODE_CONFIG_FROM_LEGACY, config->version);
+    return NODE_CONFIG_FROM_LEGACY;
+}
+
+void node_config_save(struct node_config *config)
+/**@brief stamp the block and write it, only the bytes that changed are written
+ *
+ * It waits for the eeprom, 3.4 ms a byte, so it is only for the boot and the console.
+ * @param config the settings, its magic, version and crc are set
+ * @return Nothing
+ */
+{
+    config->magic = NODE_CONFIG_MAGIC;
+    config->version = NODE_CONFIG_VERSION;
+    config->crc = node_config_crc((const uint8_t *)config, offsetof(struct node_config, crc));
+    EEPROM.put(NODE_CONFIG_EEPROM_START, *config);
+}
+
+void node_config_erase(void)
+/**@brief spoil the magic of the block, the next boot loads the old bytes or the defaults
+ *
+ * @return Nothing
+ */
+{
+    EEPROM.update(NODE_CONFIG_EEPROM_START, 0xff);
+}
+
+bool node_config_set_call_sign(struct node_config *config, const char *call_sign)
+/**@brief put a new call sign in the settings, the caller saves them
+ *
+ * @param config the settings
+ * @param call_sign null terminated, up to CALL_SIGN_LENGTH characters
+ * @return false if it is not a call sign, the settings are not changed
+ */
+{
+    char padded[CALL_SIGN_LENGTH];
+    uint8_t index = 0;
+    while (index < CALL_SIGN_LENGTH && call_sign[index] != 0)
+    {
+        padded[index] = call_sign[index];
+        index++;
+    }
+    if (call_sign[index] != 0)
+    {
+        return false;
+    }
+    while (index < CALL_SIGN_LENGTH)
+    {
+        padded[index++] = ' ';
+    }
+    if (!call_sign_valid(padded))
+    {
+        return false;
+    }
+    memcpy(config->call_sign, padded, CALL_SIGN_LENGTH);
+    return true;
+}
+
+void node_config_print(const struct node_config *config, uint8_t source, Print &out)
+/**@brief print the settings, for the config console command
+ *
+ * @param config the settings
+ * @param source the node_config_source they were loaded from
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    out.print(F("config from "));
+    if (source == NODE_CONFIG_FROM_BLOCK)
+    {
+        out.print(F("the block"));
+    }
+    else if (source == NODE_CONFIG_FROM_LEGACY)
+    {
+        out.print(F("the old bytes"));
+    }
+    else if (source == NODE_CONFIG_FROM_VERSION_1)
+    {
+        out.print(F("a version 1 block"));
+    }
+    else
+    {
+        out.print(F("the defaults"));
+    }
+    out.print(F(", version "));
+    out.println(config->version);
+    out.print(F("call "));
+    out.write((const uint8_t *)config->call_sign, CALL_SIGN_LENGTH);
+    out.print(F(" address "));
+    out.print(config->address);
+    out.print(F(" base "));
+    out.print(config->base_address);
+    out.print(F(" slot "));
+    out.println(config->slot);
+    out.print(config->frequency);
+    out.print(F(" kHz, sync 0x"));
+    out.print(config->sync_words[0], HEX);
+    out.print(F(" 0x"));
+    out.print(config->sync_words[1], HEX);
+    out.print(F(", link profile "));
+    out.println(config->profile);
+    out.print(F("fix every "));
+    out.print(config->moving_fix_interval);
+    out.print(F(" ms moving, "));
+    out.print(config->parked_fix_interval);
+    out.print(F(" ms parked, a report every "));
+    out.print(config->min_interval);
+    out.print(F(" to "));
+    out.print(config->heartbeat);
+    out.println(F(" s"));
+}
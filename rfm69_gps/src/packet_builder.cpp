@@ -0,0 +1,181 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  packet_builder.cpp
+    @author Ralph Blach
+    @brief Bounds checked, cursor based packet assembly.
+**/
+#include <string.h>
+#include <packet_builder.h>
+
+void packet_builder_start(struct packet_builder *builder, uint8_t *buffer, uint8_t capacity)
+/**@brief start an empty packet
+ *
+ * @param builder the builder state
+ * @param buffer where the packet is written
+ * @param capacity the size of buffer, RH_RF69_MAX_MESSAGE_LEN for a radio packet
+ * @return Nothing
+ */
+{
+    builder->buffer = buffer;
+    builder->capacity = capacity;
+    builder->length = 0;
+    builder->overflow = false;
+}
+
+bool packet_builder_append(struct packet_builder *builder, const void *data, uint8_t length)
+/**@brief append raw bytes at the cursor
+ *
+ * @param builder the builder state
+ * @param data the bytes to append
+ * @param length the number of bytes
+ * @return false if the bytes did not fit, nothing is written in that case
+ */
+{
+    if (builder->overflow || length > builder->capacity - builder->length)
+    {
+        builder->overflow = true;
+        return false;
+    }
+    memcpy(builder->buffer + builder->length, data, length);
+    builder->length += length;
+    return true;
+}
+
+bool packet_builder_append_string(struct packet_builder *builder, const char *text)
+/**@brief append a null terminated string, without the null
+ *
+ * The string is copied as it is scanned, so it is only read once.
+ * @param builder the builder state
+ * @param text the string to append
+ * @return false if the string did not fit
+ */
+{
+    uint8_t *cursor = builder->buffer + builder->length;
+    uint8_t *end = builder->buffer + builder->capacity;
+    if (builder->overflow)
+    {
+        return false;
+    }
+    while (*text)
+    {
+        if (cursor == end)
+        {
+            builder->overflow = true;
+            return false;
+        }
+        *cursor++ = *text++;
+    }
+    builder->length = (uint8_t)(cursor - builder->buffer);
+    return true;
+}
+
+bool packet_builder_append_char(struct packet_builder *builder, char value)
+/**@brief append one character
+ *
+ * @param builder the builder state
+ * @param value the character
+ * @return false if it did not fit
+ */
+{
+    if (builder->overflow || builder->length == builder->capacity)
+    {
+        builder->overflow = true;
+        return false;
+    }
+    builder->buffer[builder->length++] = (uint8_t)value;
+    return true;
+}
+
+bool packet_builder_append_decimal(struct packet_builder *builder, uint32_t value)
+/**@brief append an unsigned number as decimal digits, without leading zeros
+ *
+ * @param builder the builder state
+ * @param value the number
+ * @return false if the digits did not fit
+ */
+{
+    char digits[10];
+    uint8_t count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    if (builder->overflow || count > builder->capacity - builder->length)
+    {
+        builder->overflow = true;
+        return false;
+    }
+    while (count)
+    {
+        builder->buffer[builder->length++] = (uint8_t)digits[--count];
+    }
+    return true;
+}
+
+bool packet_builder_append_le(struct packet_builder *builder, uint32_t value, uint8_t size)
+/**@brief append the low size bytes of value, least significant byte first
+ *
+ * @param builder the builder state
+ * @param value the value to append
+ * @param size the number of bytes, 1 to 4
+ * @return false if it did not fit
+ */
+{
+    uint8_t *cursor;
+    if (builder->overflow || size > builder->capacity - builder->length)
+    {
+        builder->overflow = true;
+        return false;
+    }
+    cursor = builder->buffer + builder->length;
+    builder->length += size;
+    while (size--)
+    {
+        *cursor++ = (uint8_t)value;
+        value >>= 8;
+    }
+    return true;
+}
+
+bool packet_builder_append_varint(struct packet_builder *builder, uint32_t value)
+/**@brief append a varint, seven bits a byte, low bits first, the top bit says another byte follows
+ *
+ * @param builder the builder state
+ * @param value the value to append, under 128 takes one byte
+ * @return false if it did not fit
+ */
+{
+    uint8_t bytes[5];
+    uint8_t size = 0;
+    while (value >= 0x80)
+    {
+        bytes[size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = (uint8_t)value;
+    return packet_builder_append(builder, bytes, size);
+}
+
+bool packet_builder_append_zigzag(struct packet_builder *builder, int32_t value)
+/**@brief append a signed varint, zigzag first so a small negative number is short too
+ *
+ * @param builder the builder state
+ * @param value the value to append, -64 to 63 takes one byte
+ * @return false if it did not fit
+ */
+{
+    return packet_builder_append_varint(builder, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+uint8_t packet_builder_finish(struct packet_builder *builder)
+/**@brief get the length of the finished packet
+ *
+ * @param builder the builder state
+ * @return the packet length, 0 if any append overflowed
+ */
+{
+    return builder->overflow ? 0 : builder->length;
+}
@@ -0,0 +1,422 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  position_packet.cpp
+    @author Ralph Blach
+    @brief Convert a parsed RMC sentence to a position_fix and encode it for the radio.
+
+    The altitude and dop of version 2 are filled in by fix_fusion.cpp from the GGA and GSA.
+
+    Only integer arithmetic is used, the 32u4 has no floating point hardware.
+**/
+#include <string.h>
+#include <nmea.h>
+#include <position_packet.h>
+#include <packet_builder.h>
+
+bool position_fix_from_rmc(char *const *tokens, uint8_t number_of_tokens, const char *call_sign,
+                           struct position_fix *fix)
+/**@brief fill in a position_fix from the tokens of a RMC sentence
+ *
+ * @param tokens the tokens from parse_gps_data
+ * @param number_of_tokens the number of tokens from parse_gps_data
+ * @param call_sign the 6 character call sign
+ * @param fix where the result is placed
+ * @return true if the sentence had enough fields, false otherwise
+ */
+{
+    bool present;
+    uint32_t value;
+    memset(fix, 0, sizeof(*fix));
+    memcpy(fix->call_sign, call_sign, CALL_SIGN_LENGTH);
+    if (number_of_tokens <= RMC_DATE)
+    {
+        return false;
+    }
+    // hhmmss.ss in hundredths of a second
+    fix->time_of_day = nmea_time_of_day(tokens[RMC_TIME]);
+    // ddmmyy
+    value = nmea_parse_decimal(tokens[RMC_DATE], 0, &present);
+    fix->date = (uint16_t)(((value % 100) << 9) | ((value / 100 % 100) << 5) | (value / 10000));
+    if (tokens[RMC_STATUS][0] != 'A')
+    {
+        return true;
+    }
+    fix->flags |= POSITION_FLAG_VALID;
+    fix->latitude = nmea_parse_coordinate(tokens[RMC_LATITUDE], tokens[RMC_N_S_INDICATOR], &present);
+    fix->longitude = nmea_parse_coordinate(tokens[RMC_LONGITUDE], tokens[RMC_E_W_INDICATOR], &present);
+    fix->speed = (uint16_t)nmea_parse_decimal(tokens[RMC_SPEED_OVER_GROUND], 2, &present);
+    if (present)
+    {
+        fix->flags |= POSITION_FLAG_SPEED_VALID;
+    }
+    fix->course = (uint16_t)nmea_parse_decimal(tokens[RMC_COURSE_OVER_GROUND], 2, &present);
+    if (present)
+    {
+        fix->flags |= POSITION_FLAG_COURSE_VALID;
+    }
+    return true;
+}
+
+static uint32_t get_le(const uint8_t *buffer, uint8_t size)
+{
+    uint32_t value = 0;
+    while (size--)
+    {
+        value = (value << 8) | buffer[size];
+    }
+    return value;
+}
+
+uint8_t position_packet_encode(const struct position_fix *fix, uint8_t *buffer, uint8_t buffer_size)
+/**@brief encode a position_fix in the wire format
+ *
+ * @param fix the position to encode
+ * @param buffer where the packet is written
+ * @param buffer_size the size of buffer
+ * @return the length of the packet, or 0 if the buffer is too small
+ */
+{
+    struct packet_builder builder;
+    bool quality = (fix->flags & (POSITION_FLAG_ALTITUDE_VALID | POSITION_FLAG_DOP_VALID)) != 0;
+    packet_builder_start(&builder, buffer, buffer_size);
+    packet_builder_append_char(&builder,
+                               POSITION_PACKET_MAGIC | (quality ? POSITION_PACKET_QUALITY_VERSION : POSITION_PACKET_VERSION));
+    packet_builder_append(&builder, fix->call_sign, CALL_SIGN_LENGTH);
+    packet_builder_append_char(&builder, fix->flags);
+    packet_builder_append_le(&builder, (uint32_t)fix->latitude, 4);
+    packet_builder_append_le(&builder, (uint32_t)fix->longitude, 4);
+    packet_builder_append_le(&builder, fix->time_of_day, 3);
+    packet_builder_append_le(&builder, fix->date, 2);
+    packet_builder_append_le(&builder, fix->speed, 2);
+    packet_builder_append_le(&builder, fix->course, 2);
+    if (quality)
+    {
+        packet_builder_append_le(&builder, (uint32_t)fix->altitude, 3);
+        packet_builder_append_char(&builder, fix->satellites);
+        packet_builder_append_le(&builder, fix->hdop, 2);
+    }
+    return packet_builder_finish(&builder);
+}
+
+bool position_packet_decode(const uint8_t *buffer, uint8_t length, struct position_fix *fix)
+/**@brief decode a packet produced by position_packet_encode
+ *
+ * @param buffer the received packet
+ * @param length the length of the received packet
+ * @param fix where the decoded position is placed
+ * @return false if this is not a position packet of a version we know
+ */
+{
+    uint32_t altitude;
+    bool quality = length >= POSITION_PACKET_QUALITY_LENGTH &&
+                   buffer[0] == (POSITION_PACKET_MAGIC | POSITION_PACKET_QUALITY_VERSION);
+    if (!quality && (length < POSITION_PACKET_LENGTH || buffer[0] != (POSITION_PACKET_MAGIC | POSITION_PACKET_VERSION)))
+    {
+        return false;
+    }
+    memcpy(fix->call_sign, buffer + 1, CALL_SIGN_LENGTH);
+    fix->flags = buffer[7];
+    fix->latitude = (int32_t)get_le(buffer + 8, 4);
+    fix->longitude = (int32_t)get_le(buffer + 12, 4);
+    fix->time_of_day = get_le(buffer + 16, 3);
+    fix->date = (uint16_t)get_le(buffer + 19, 2);
+    fix->speed = (uint16_t)get_le(buffer + 21, 2);
+    fix->course = (uint16_t)get_le(buffer + 23, 2);
+    fix->altitude = 0;
+    fix->satellites = 0;
+    fix->hdop = 0;
+    if (quality)
+    {
+        // sign extend the 24 bit altitude
+        altitude = get_le(buffer + 25, 3);
+        fix->altitude = (int32_t)(altitude ^ 0x800000UL) - 0x800000L;
+        fix->satellites = buffer[28];
+        fix->hdop = (uint16_t)get_le(buffer + 29, 2);
+    }
+    return true;
+}
+
+static void put_le(uint8_t *buffer, uint32_t value, uint8_t size)
+{
+    while (size--)
+    {
+        *buffer++ = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+void position_record_pack(const struct position_fix *fix, uint8_t *record)
+/**@brief pack a fix in the POSITION_RECORD_LENGTH bytes it is stored in
+ *
+ * The altitude and dop of version 2 are not kept.
+ * @param fix the fix
+ * @param record where the POSITION_RECORD_LENGTH bytes are written
+ * @return Nothing
+ */
+{
+    record[0] = fix->flags & (POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID);
+    put_le(record + 1, (uint32_t)fix->latitude, 4);
+    put_le(record + 5, (uint32_t)fix->longitude, 4);
+    put_le(record + 9, fix->time_of_day, 3);
+    put_le(record + 12, fix->speed, 2);
+    put_le(record + 14, fix->course, 2);
+    put_le(record + 16, fix->date, 2);
+}
+
+static void unpack_entry(const uint8_t *entry, uint16_t date, struct position_fix *fix)
+{
+    fix->flags = entry[0];
+    fix->latitude = (int32_t)get_le(entry + 1, 4);
+    fix->longitude = (int32_t)get_le(entry + 5, 4);
+    fix->time_of_day = get_le(entry + 9, 3);
+    fix->speed = (uint16_t)get_le(entry + 12, 2);
+    fix->course = (uint16_t)get_le(entry + 14, 2);
+    fix->date = date;
+    fix->altitude = 0;
+    fix->satellites = 0;
+    fix->hdop = 0;
+}
+
+void position_record_unpack(const uint8_t *record, struct position_fix *fix)
+/**@brief turn a stored record back into a fix, the call sign is left as it is
+ *
+ * @param record the POSITION_RECORD_LENGTH bytes from position_record_pack
+ * @param fix where the fix is put
+ * @return Nothing
+ */
+{
+    unpack_entry(record, position_record_date(record), fix);
+}
+
+uint16_t position_record_date(const uint8_t *record)
+/**@brief the date of a stored record, fixes of one date go in one history packet
+ *
+ * @param record the stored record
+ * @return the date, (year - 2000) << 9 | month << 5 | day
+ */
+{
+    return (uint16_t)get_le(record + POSITION_HISTORY_ENTRY, 2);
+}
+
+uint8_t position_history_encode(const char *call_sign, const uint8_t *records, uint8_t count, uint8_t *buffer,
+                                uint8_t buffer_size)
+/**@brief encode stored records of one date in a history packet
+ *
+ * @param call_sign the 6 character call sign
+ * @param records count records of POSITION_RECORD_LENGTH bytes one after the other, all with the date of the first
+ * @param count the number of records
+ * @param buffer where the packet is written
+ * @param buffer_size the size of buffer
+ * @return the length of the packet, or 0 if the buffer is too small
+ */
+{
+    struct packet_builder builder;
+    uint8_t index;
+    packet_builder_start(&builder, buffer, buffer_size);
+    packet_builder_append_char(&builder, POSITION_HISTORY_MAGIC | POSITION_HISTORY_VERSION);
+    packet_builder_append(&builder, call_sign, CALL_SIGN_LENGTH);
+    packet_builder_append_le(&builder, position_record_date(records), 2);
+    packet_builder_append_char(&builder, count);
+    for (index = 0; index < count; index++)
+    {
+        packet_builder_append(&builder, records + index * POSITION_RECORD_LENGTH, POSITION_HISTORY_ENTRY);
+    }
+    return packet_builder_finish(&builder);
+}
+
+uint8_t position_history_count(const uint8_t *buffer, uint8_t length)
+/**@brief check a history packet
+ *
+ * @param buffer the received packet
+ * @param length the length of the received packet
+ * @return the number of fixes in it, 0 if it is not a whole history packet
+ */
+{
+    if (length < POSITION_HISTORY_HEADER || buffer[0] != (POSITION_HISTORY_MAGIC | POSITION_HISTORY_VERSION) ||
+        length < POSITION_HISTORY_HEADER + buffer[9] * POSITION_HISTORY_ENTRY)
+    {
+        return 0;
+    }
+    return buffer[9];
+}
+
+bool position_history_decode(const uint8_t *buffer, uint8_t length, uint8_t index, struct position_fix *fix)
+/**@brief decode one fix of a history packet
+ *
+ * @param buffer the received packet
+ * @param length the length of the received packet
+ * @param index which fix, 0 is the oldest
+ * @param fix where the fix is put
+ * @return false if it is not a history packet or it has fewer fixes
+ */
+{
+    if (index >= position_history_count(buffer, length))
+    {
+        return false;
+    }
+    memcpy(fix->call_sign, buffer + 1, CALL_SIGN_LENGTH);
+    unpack_entry(buffer + POSITION_HISTORY_HEADER + index * POSITION_HISTORY_ENTRY, (uint16_t)get_le(buffer + 7, 2),
+                 fix);
+    return true;
+}
+
+static void append_entry(struct packet_builder *builder, const struct position_fix *fix)
+{
+    packet_builder_append_char(builder, fix->flags & (POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID |
+                                                      POSITION_FLAG_COURSE_VALID));
+    packet_builder_append_le(builder, (uint32_t)fix->latitude, 4);
+    packet_builder_append_le(builder, (uint32_t)fix->longitude, 4);
+    packet_builder_append_le(builder, fix->time_of_day, 3);
+    packet_builder_append_le(builder, fix->speed, 2);
+    packet_builder_append_le(builder, fix->course, 2);
+}
+
+bool position_batch_start(struct packet_builder *builder, const char *call_sign, const struct position_fix *fix)
+/**@brief start a batch packet with its first fix
+ *
+ * position_batch_append counts the fixes in the header, so the packet has to start at the
+ * start of the buffer.
+ * @param builder a builder straight from packet_builder_start, nothing appended yet
+ * @param call_sign the 6 character call sign
+ * @param fix the first fix, its date is the date of the whole packet
+ * @return false if it did not fit or the builder was not empty
+ */
+{
+    if (builder->length != 0)
+    {
+        return false;
+    }
+    packet_builder_append_char(builder, POSITION_BATCH_MAGIC | POSITION_BATCH_VERSION);
+    packet_builder_append(builder, call_sign, CALL_SIGN_LENGTH);
+    packet_builder_append_le(builder, fix->date, 2);
+    packet_builder_append_char(builder, 1);
+    append_entry(builder, fix);
+    return !builder->overflow;
+}
+
+bool position_batch_append(struct packet_builder *builder, const struct position_fix *previous,
+                           const struct position_fix *fix)
+/**@brief add a fix to a batch packet as the change from the one before
+ *
+ * Nothing is added, and the builder can still be finished, if the fix does not fit, is of
+ * another date, or is older than the one before.  Start a new packet for it then.
+ * @param builder the builder of the packet from position_batch_start
+ * @param previous the last fix in the packet
+ * @param fix the fix to add
+ * @return false if it was not added
+ */
+{
+    uint8_t bytes[POSITION_BATCH_MAX_DELTA];
+    struct packet_builder entry;
+
+    if (builder->overflow || fix->date != previous->date || fix->time_of_day < previous->time_of_day ||
+        builder->buffer[POSITION_BATCH_COUNT] == 0xff)
+    {
+        return false;
+    }
+    packet_builder_start(&entry, bytes, sizeof(bytes));
+    packet_builder_append_char(&entry, fix->flags & (POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID |
+                                                     POSITION_FLAG_COURSE_VALID));
+    // subtracted unsigned, a jump across the date line would overflow an int32_t
+    packet_builder_append_zigzag(&entry, (int32_t)((uint32_t)fix->latitude - (uint32_t)previous->latitude));
+    packet_builder_append_zigzag(&entry, (int32_t)((uint32_t)fix->longitude - (uint32_t)previous->longitude));
+    packet_builder_append_varint(&entry, fix->time_of_day - previous->time_of_day);
+    packet_builder_append_zigzag(&entry, (int32_t)fix->speed - previous->speed);
+    packet_builder_append_zigzag(&entry, (int32_t)fix->course - previous->course);
+    if (entry.length > builder->capacity - builder->length)
+    {
+        return false;
+    }
+    packet_builder_append(builder, bytes, entry.length);
+    builder->buffer[POSITION_BATCH_COUNT]++;
+    return true;
+}
+
+static bool get_varint(struct position_batch_reader *reader, uint32_t *value)
+{
+    uint8_t shift = 0;
+    uint8_t byte;
+    *value = 0;
+    while (reader->position < reader->length && shift < 35)
+    {
+        byte = reader->buffer[reader->position++];
+        *value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static bool get_zigzag(struct position_batch_reader *reader, int32_t *value)
+{
+    uint32_t raw;
+    if (!get_varint(reader, &raw))
+    {
+        return false;
+    }
+    *value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+    return true;
+}
+
+bool position_batch_first(struct position_batch_reader *reader, const uint8_t *buffer, uint8_t length,
+                          struct position_fix *fix)
+/**@brief decode the first fix of a batch packet
+ *
+ * @param reader the reader, set up here
+ * @param buffer the received packet
+ * @param length the length of the received packet
+ * @param fix where the fix is put, position_batch_next works from it
+ * @return false if this is not a batch packet
+ */
+{
+    if (length < POSITION_BATCH_HEADER + POSITION_HISTORY_ENTRY ||
+        buffer[0] != (POSITION_BATCH_MAGIC | POSITION_BATCH_VERSION) || buffer[POSITION_BATCH_COUNT] == 0)
+    {
+        return false;
+    }
+    memcpy(fix->call_sign, buffer + 1, CALL_SIGN_LENGTH);
+    unpack_entry(buffer + POSITION_BATCH_HEADER, (uint16_t)get_le(buffer + 7, 2), fix);
+    reader->buffer = buffer;
+    reader->length = length;
+    reader->position = POSITION_BATCH_HEADER + POSITION_HISTORY_ENTRY;
+    reader->left = buffer[POSITION_BATCH_COUNT] - 1;
+    return true;
+}
+
+bool position_batch_next(struct position_batch_reader *reader, struct position_fix *fix)
+/**@brief decode the next fix of a batch packet
+ *
+ * @param reader the reader from position_batch_first
+ * @param fix the fix before, it is changed to the next one
+ * @return false when there are no more, or the packet is cut short
+ */
+{
+    int32_t latitude;
+    int32_t longitude;
+    uint32_t time;
+    int32_t speed;
+    int32_t course;
+    if (reader->left == 0 || reader->position >= reader->length)
+    {
+        return false;
+    }
+    fix->flags = reader->buffer[reader->position++];
+    if (!get_zigzag(reader, &latitude) || !get_zigzag(reader, &longitude) || !get_varint(reader, &time) ||
+        !get_zigzag(reader, &speed) || !get_zigzag(reader, &course))
+    {
+        reader->left = 0;
+        return false;
+    }
+    fix->latitude = (int32_t)((uint32_t)fix->latitude + (uint32_t)latitude);
+    fix->longitude = (int32_t)((uint32_t)fix->longitude + (uint32_t)longitude);
+    fix->time_of_day += time;
+    fix->speed = (uint16_t)(fix->speed + speed);
+    fix->course = (uint16_t)(fix->course + course);
+    reader->left--;
+    return true;
+}
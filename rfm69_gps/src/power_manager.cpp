@@ -0,0 +1,361 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  power_manager.cpp
+    @author Ralph Blach
+    @brief Radio and mcu sleep, and the time in state and charge account.
+**/
+#include <Arduino.h>
+#include <gps_ingest.h>
+#include <power_manager.h>
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#if defined(POWER_DEEP_SLEEP)
+#include <avr/wdt.h>
+// the arduino core counts millis in here, it is moved on by hand after a power down
+extern volatile unsigned long timer0_millis;
+#endif
+#endif
+
+/**
+    @brief microamp milliseconds in a millicoulomb
+*/
+#define CHARGE_UNIT 1000000UL
+
+void power_manager_init(struct power_manager *manager, RHGenericDriver *radio, struct tx_queue *queue)
+/**@brief start the account, the gps is taken to be on
+ *
+ * @param manager the power manager
+ * @param radio the radio driver, it must already have been initialized
+ * @param queue the transmit queue of that radio
+ * @return Nothing
+ */
+{
+    memset(manager, 0, sizeof(*manager));
+    manager->radio = radio;
+    manager->queue = queue;
+    manager->gps_state = POWER_GPS_ON;
+    manager->gps_periodic_current = POWER_CURRENT_GPS_ON;
+    manager->radio_tx_current = POWER_CURRENT_RADIO_TX;
+    manager->radio_state = POWER_RADIO_IDLE;
+    manager->last_update = micros();
+    manager->next_sentence = millis();
+}
+
+void power_manager_reset(struct power_manager *manager)
+/**@brief zero the account, the states and the schedule are kept
+ *
+ * @param manager the power manager
+ * @return Nothing
+ */
+{
+    memset(manager->time, 0, sizeof(manager->time));
+    memset(manager->time_fraction, 0, sizeof(manager->time_fraction));
+    manager->charge = 0;
+    manager->charge_fraction = 0;
+    manager->radio_sleeps = 0;
+    manager->asleep = 0;
+    manager->powered_down = 0;
+    manager->last_update = micros();
+}
+
+static uint32_t state_current(const struct power_manager *manager, uint8_t state)
+{
+    switch (state)
+    {
+    case POWER_MCU_ACTIVE:
+        return POWER_CURRENT_MCU_ACTIVE;
+    case POWER_MCU_SLEEP:
+        return POWER_CURRENT_MCU_SLEEP;
+    case POWER_RADIO_SLEEP:
+        return POWER_CURRENT_RADIO_SLEEP;
+    case POWER_RADIO_IDLE:
+        return POWER_CURRENT_RADIO_IDLE;
+    case POWER_RADIO_RX:
+        return POWER_CURRENT_RADIO_RX;
+    case POWER_RADIO_TX:
+        return manager->radio_tx_current;
+    case POWER_GPS_ON:
+        return POWER_CURRENT_GPS_ON;
+    case POWER_GPS_STANDBY:
+        return POWER_CURRENT_GPS_STANDBY;
+    case POWER_GPS_PERIODIC:
+        return manager->gps_periodic_current;
+    default:
+        return 0;
+    }
+}
+
+static uint8_t radio_state(struct power_manager *manager)
+{
+    switch (manager->radio->mode())
+    {
+    case RHGenericDriver::RHModeSleep:
+        return POWER_RADIO_SLEEP;
+    case RHGenericDriver::RHModeTx:
+        return POWER_RADIO_TX;
+    case RHGenericDriver::RHModeRx:
+    case RHGenericDriver::RHModeCad:
+        return POWER_RADIO_RX;
+    default:
+        return POWER_RADIO_IDLE;
+    }
+}
+
+static void add_time(struct power_manager *manager, uint8_t state, uint32_t microseconds)
+{
+    /**
+        @brief account for time spent in a state
+
+        Whole milliseconds go on the time of the state and are charged at its current, the
+        rest waits in time_fraction for the next call.
+    */
+    uint32_t total = manager->time_fraction[state] + microseconds;
+    uint32_t milliseconds = total / 1000;
+    manager->time_fraction[state] = (uint16_t)(total % 1000);
+    if (milliseconds == 0)
+    {
+        return;
+    }
+    manager->time[state] += milliseconds;
+    manager->charge_fraction += state_current(manager, state) * milliseconds;
+    if (manager->charge_fraction >= CHARGE_UNIT)
+    {
+        manager->charge += manager->charge_fraction / CHARGE_UNIT;
+        manager->charge_fraction %= CHARGE_UNIT;
+    }
+}
+
+static void update(struct power_manager *manager)
+{
+    /**
+        @brief charge the time since the last update to the states the parts were in
+
+        The radio state is sampled at every update and held until the next one, so a short
+        transmission between two updates can be missed, the account is only as fine as the loop.
+    */
+    uint32_t now = micros();
+    uint32_t elapsed = now - manager->last_update + manager->powered_down;
+    uint32_t asleep = manager->asleep < elapsed ? manager->asleep : elapsed;
+
+    manager->last_update = now;
+    add_time(manager, POWER_MCU_SLEEP, asleep);
+    add_time(manager, POWER_MCU_ACTIVE, elapsed - asleep);
+    add_time(manager, manager->radio_state, elapsed);
+    add_time(manager, manager->gps_state, elapsed);
+    manager->asleep = 0;
+    manager->powered_down = 0;
+    manager->radio_state = radio_state(manager);
+}
+
+void power_manager_service(struct power_manager *manager)
+/**@brief update the account and put the radio to sleep if it has nothing to do
+ *
+ * @param manager the power manager
+ * @return Nothing
+ */
+{
+    update(manager);
+    // a new frame held for its slot does not need the receiver either, send wakes the radio.
+    // A held retry keeps listening for the late ack of the last try
+    if (manager->radio_state != POWER_RADIO_SLEEP &&
+        (tx_queue_idle(manager->queue) || (manager->queue->state == TX_STATE_HOLD && manager->queue->attempt == 0)))
+    {
+        manager->radio->sleep();
+        manager->radio_sleeps++;
+        manager->radio_state = radio_state(manager);
+    }
+}
+
+void power_manager_set_gps(struct power_manager *manager, uint8_t state)
+/**@brief tell the account the gps changed state
+ *
+ * @param manager the power manager
+ * @param state POWER_GPS_ON, POWER_GPS_STANDBY or POWER_GPS_PERIODIC
+ * @return Nothing
+ */
+{
+    update(manager);
+    manager->gps_state = state;
+}
+
+void power_manager_set_periodic(struct power_manager *manager, uint32_t run, uint32_t sleep)
+/**@brief work out the average current of the gps periodic mode
+ *
+ * @param manager the power manager
+ * @param run the milliseconds the gps runs each period
+ * @param sleep the milliseconds the gps is in standby each period
+ * @return Nothing
+ */
+{
+    // in tenths of a second so a long period does not overflow
+    run /= 100;
+    sleep /= 100;
+    if (run + sleep == 0)
+    {
+        manager->gps_periodic_current = POWER_CURRENT_GPS_ON;
+        return;
+    }
+    manager->gps_periodic_current =
+        (POWER_CURRENT_GPS_ON * run + POWER_CURRENT_GPS_STANDBY * sleep) / (run + sleep);
+}
+
+void power_manager_set_tx_current(struct power_manager *manager, uint32_t current)
+/**@brief tell the account the transmit power changed
+ *
+ * @param manager the power manager
+ * @param current the supply current while sending in microamps, POWER_CURRENT_RADIO_TX at +20 dBm
+ * @return Nothing
+ */
+{
+    update(manager);
+    manager->radio_tx_current = current;
+}
+
+void power_manager_expect_sentence(struct power_manager *manager, uint32_t milliseconds)
+/**@brief say when the gps will next send something
+ *
+ * @param manager the power manager
+ * @param milliseconds how long from now, the fix interval after a sentence arrived or the
+ *        time left in standby
+ * @return Nothing
+ */
+{
+    manager->next_sentence = millis() + milliseconds;
+}
+
+#if defined(__AVR__) && defined(POWER_DEEP_SLEEP)
+ISR(WDT_vect)
+{
+    // only here to wake the mcu, the watchdog is turned off after the wake up
+}
+
+static uint16_t power_down(uint16_t milliseconds)
+{
+    /**
+        @brief power the mcu down on the watchdog
+
+        @param milliseconds the longest time to sleep, at least 15
+        @return the milliseconds slept, the longest watchdog period that fits
+    */
+    static const uint16_t periods[] = {15, 30, 60, 120, 250, 500, 1000, 2000, 4000, 8000};
+    uint8_t prescale = sizeof(periods) / sizeof(periods[0]) - 1;
+    while (prescale > 0 && periods[prescale] > milliseconds)
+    {
+        prescale--;
+    }
+    noInterrupts();
+    wdt_reset();
+    MCUSR &= ~_BV(WDRF);
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = _BV(WDIE) | (prescale & 0x07) | ((prescale & 0x08) ? _BV(WDP3) : 0);
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+    wdt_disable();
+    noInterrupts();
+    timer0_millis += periods[prescale];
+    interrupts();
+    return periods[prescale];
+}
+#endif
+
+void power_manager_sleep(struct power_manager *manager)
+/**@brief stop the mcu until there is something to do
+ *
+ * Call it at the end of the loop.  It returns straight away if the gps has sent anything that
+ * has not been looked at.
+ * @param manager the power manager
+ * @return Nothing
+ */
+{
+    update(manager);
+#if defined(__AVR__)
+    uint32_t start;
+#if defined(POWER_DEEP_SLEEP)
+    int32_t remaining = (int32_t)(manager->next_sentence - millis());
+    uint32_t slept = 0;
+    // power down stops the uart, a command to the gps would be cut off
+    if (manager->radio_state == POWER_RADIO_SLEEP && tx_queue_idle(manager->queue) && !gps_ingest_pending() &&
+        !gps_ingest_writing())
+    {
+        remaining -= remaining / 8 + POWER_DEEP_SLEEP_GUARD;
+        if (remaining >= POWER_DEEP_SLEEP_MIN)
+        {
+            while ((int32_t)slept + 15 <= remaining)
+            {
+                slept += power_down((uint16_t)((remaining - slept) > 8000 ? 8000 : (remaining - slept)));
+            }
+            manager->asleep += slept * 1000;
+            manager->powered_down += slept * 1000;
+            return;
+        }
+    }
+#endif
+    noInterrupts();
+    if (gps_ingest_pending())
+    {
+        interrupts();
+        return;
+    }
+    start = micros();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    // the instruction after sei always runs, so an interrupt cannot slip in before the sleep
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+    manager->asleep += micros() - start;
+#endif
+}
+
+static void print_state(Print &out, const __FlashStringHelper *name, uint32_t time, uint32_t total)
+{
+    out.print(name);
+    out.print(time);
+    out.print(F(" ms "));
+    out.print(total >= 100 ? time / (total / 100) : 0);
+    out.println(F("%"));
+}
+
+void power_manager_print(const struct power_manager *manager, Print &out)
+/**@brief print the account, for the power console command
+ *
+ * @param manager the power manager
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    uint32_t total = manager->time[POWER_MCU_ACTIVE] + manager->time[POWER_MCU_SLEEP];
+    uint32_t frames = manager->queue->stats.queued;
+    uint32_t seconds = total / 1000;
+
+    print_state(out, F("mcu active "), manager->time[POWER_MCU_ACTIVE], total);
+    print_state(out, F("mcu sleep "), manager->time[POWER_MCU_SLEEP], total);
+    print_state(out, F("radio sleep "), manager->time[POWER_RADIO_SLEEP], total);
+    print_state(out, F("radio idle "), manager->time[POWER_RADIO_IDLE], total);
+    print_state(out, F("radio rx "), manager->time[POWER_RADIO_RX], total);
+    print_state(out, F("radio tx "), manager->time[POWER_RADIO_TX], total);
+    print_state(out, F("gps on "), manager->time[POWER_GPS_ON], total);
+    print_state(out, F("gps standby "), manager->time[POWER_GPS_STANDBY], total);
+    print_state(out, F("gps periodic "), manager->time[POWER_GPS_PERIODIC], total);
+    out.print(F("radio sleeps "));
+    out.println(manager->radio_sleeps);
+    out.print(F("charge "));
+    out.print(manager->charge);
+    out.print(F(" mC, "));
+    // mC a second is mA, split so it does not overflow
+    out.print(seconds != 0 ? manager->charge / seconds * 1000 + manager->charge % seconds * 1000 / seconds : 0);
+    out.println(F(" uA average"));
+    out.print(F("per packet "));
+    // the same split, charge is in mC and this prints uC
+    out.print(frames != 0 ? manager->charge / frames * 1000 + manager->charge % frames * 1000 / frames : 0);
+    out.print(F(" uC, "));
+    out.print(frames);
+    out.println(F(" packets"));
+}
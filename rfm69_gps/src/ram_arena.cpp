@@ -0,0 +1,147 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  ram_arena.cpp
+    @author Ralph Blach
+    @brief The shared scratch buffer, the stack paint and the free ram counts.
+**/
+#include <Arduino.h>
+#include <event_log.h>
+#include <ram_arena.h>
+
+static union ram_arena_space arena;          /*!< the scratch buffer */
+static uint8_t holder = RAM_ARENA_NONE;      /*!< who has it */
+static struct ram_arena_stats stats;         /*!< counters for the console */
+
+#if defined(__AVR__)
+extern uint8_t _end;          /*!< the end of the globals, from the linker */
+extern uint8_t __stack;       /*!< the top of ram */
+extern uint8_t __heap_start;
+extern char *__brkval;        /*!< the top of the heap, NULL if malloc was never called */
+#endif
+
+void ram_arena_paint(void)
+/**@brief fill the free ram between the globals and the stack with RAM_ARENA_PAINT, the first
+ * thing setup does
+ *
+ * It stops RAM_ARENA_PAINT_GUARD bytes under its own stack frame, so what main and setup have
+ * on the stack is not written over, and the stack below setup is all that is measured.
+ * @return Nothing
+ */
+{
+#if defined(__AVR__)
+    uint8_t top;
+    uint8_t *position = __brkval != NULL ? (uint8_t *)__brkval : &__heap_start;
+    while (position < &top - RAM_ARENA_PAINT_GUARD)
+    {
+        *position++ = RAM_ARENA_PAINT;
+    }
+#endif
+}
+
+union ram_arena_space *ram_arena_take(uint8_t user)
+/**@brief take the arena for a step of the loop
+ *
+ * @param user a ram_arena_user
+ * @return the arena, or NULL if another user has it
+ */
+{
+    if (holder != RAM_ARENA_NONE)
+    {
+        stats.busy++;
+        stats.last_busy = user;
+        LOG(LOG_ARENA_BUSY, user, holder);
+        return NULL;
+    }
+    holder = user;
+    stats.takes++;
+    return &arena;
+}
+
+void ram_arena_release(uint8_t user)
+/**@brief give the arena back
+ *
+ * @param user the user that took it, nothing happens if it is not the holder
+ * @return Nothing
+ */
+{
+    if (holder == user)
+    {
+        holder = RAM_ARENA_NONE;
+    }
+}
+
+uint8_t ram_arena_holder(void)
+/**@brief who has the arena
+ *
+ * @return a ram_arena_user, RAM_ARENA_NONE if it is free
+ */
+{
+    return holder;
+}
+
+const struct ram_arena_stats *ram_arena_stats(void)
+/**@brief the counters
+ *
+ * @return the counters
+ */
+{
+    return &stats;
+}
+
+uint16_t ram_free(void)
+/**@brief the ram between the globals or the heap and the stack pointer
+ *
+ * @return bytes, 0 on the native build
+ */
+{
+#if defined(__AVR__)
+    uint8_t top;
+    return (uint16_t)(&top - (__brkval != NULL ? (uint8_t *)__brkval : &__heap_start));
+#else
+    return 0;
+#endif
+}
+
+uint16_t ram_stack_unused(void)
+/**@brief the painted ram the stack has never written over, the low water mark of ram_free
+ *
+ * It reads up from the globals until the first byte that is not RAM_ARENA_PAINT, a few
+ * hundred microseconds, so it is for the console and not for every pass of the loop.
+ * @return bytes, 0 on the native build
+ */
+{
+#if defined(__AVR__)
+    const uint8_t *position = __brkval != NULL ? (const uint8_t *)__brkval : &_end;
+    const uint8_t *start = position;
+    while (position <= &__stack && *position == RAM_ARENA_PAINT)
+    {
+        position++;
+    }
+    return (uint16_t)(position - start);
+#else
+    return 0;
+#endif
+}
+
+void ram_arena_print(Print &out)
+/**@brief print the free ram and the arena, for the mem console command
+ *
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    out.print(F("ram free "));
+    out.print(ram_free());
+    out.print(F(", never used by the stack "));
+    out.println(ram_stack_unused());
+    out.print(F("arena "));
+    out.print(sizeof(arena));
+    out.print(F(" bytes, taken "));
+    out.print(stats.takes);
+    out.print(F(" busy "));
+    out.print(stats.busy);
+    out.print(F(" last by "));
+    out.println(stats.last_busy);
+}
@@ -0,0 +1,206 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  report_policy.cpp
+    @author Ralph Blach
+    @brief Dead reckoning report suppression and the gps fix interval.
+**/
+#include <string.h>
+#include <geo_fixed.h>
+#include <report_policy.h>
+
+/**
+    @brief 10 millisecond units in a day, the time of day in a fix wraps at this
+*/
+#define TICKS_PER_DAY 8640000UL
+/**
+    @brief 10 millisecond units in a second
+*/
+#define TICKS_PER_SECOND 100UL
+/**
+    @brief the longest time that is dead reckoned, 10 minutes in 10 millisecond units
+*/
+#define MAX_RECKONING_TICKS 60000UL
+
+void report_policy_init(struct report_policy *policy)
+/**@brief set up the policy with the default thresholds, the next fix is always sent
+ *
+ * @param policy the policy
+ * @return Nothing
+ */
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->config.distance = REPORT_DEFAULT_DISTANCE;
+    policy->config.course_change = REPORT_DEFAULT_COURSE_CHANGE;
+    policy->config.speed_change = REPORT_DEFAULT_SPEED_CHANGE;
+    policy->config.moving_speed = REPORT_DEFAULT_MOVING_SPEED;
+    policy->config.heartbeat = REPORT_DEFAULT_HEARTBEAT;
+    policy->config.min_interval = REPORT_DEFAULT_MIN_INTERVAL;
+    policy->config.burst_length = REPORT_DEFAULT_BURST_LENGTH;
+    policy->config.parked_fixes = REPORT_DEFAULT_PARKED_FIXES;
+    policy->config.moving_fix_interval = REPORT_DEFAULT_MOVING_FIX_INTERVAL;
+    policy->config.parked_fix_interval = REPORT_DEFAULT_PARKED_FIX_INTERVAL;
+    // start slow, the same rate the tracker always used, the first fix that moves speeds it up
+    policy->fix_interval = REPORT_DEFAULT_PARKED_FIX_INTERVAL;
+}
+
+static bool moving(const struct report_policy *policy, const struct position_fix *fix)
+{
+    return (fix->flags & POSITION_FLAG_SPEED_VALID) && fix->speed >= policy->config.moving_speed;
+}
+
+static uint16_t course_difference(uint16_t first, uint16_t second)
+{
+    /**
+        @brief the smaller angle between two courses, in 0.01 degrees
+    */
+    uint16_t difference = first > second ? first - second : second - first;
+    return difference > 18000 ? 36000 - difference : difference;
+}
+
+static uint16_t reckoning_error(const struct report_policy *policy, const struct position_fix *fix, uint32_t elapsed)
+{
+    /**
+        @brief how far the fix is from where the base thinks the tracker is
+
+        The base moves the last report along its course at its speed for the elapsed time.
+
+        @param elapsed 10 millisecond units since the last report
+        @return the distance in meters
+    */
+    const struct position_fix *last = &policy->last;
+    int32_t east;
+    int32_t north;
+    uint32_t speed;
+    uint32_t travelled;
+
+    geo_offset(last->latitude, last->longitude, fix->latitude, fix->longitude, &east, &north);
+    if (moving(policy, last) && (last->flags & POSITION_FLAG_COURSE_VALID))
+    {
+        if (elapsed > MAX_RECKONING_TICKS)
+        {
+            elapsed = MAX_RECKONING_TICKS;
+        }
+        // 0.01 knots to millimeters a second, times tenths of a second gives 0.1 millimeters.
+        // the largest speed times 6000 tenths still fits in 32 bits
+        speed = (uint32_t)last->speed * 5144 / 1000;
+        travelled = speed * (elapsed / 10) / 10000;
+        if (travelled > GEO_MAX_OFFSET)
+        {
+            travelled = GEO_MAX_OFFSET;
+        }
+        east -= ((int32_t)travelled * geo_sin(last->course)) >> 15;
+        north -= ((int32_t)travelled * geo_cos(last->course)) >> 15;
+    }
+    return geo_length(east, north);
+}
+
+static void update_fix_interval(struct report_policy *policy, const struct position_fix *fix)
+{
+    /**
+        @brief slow the gps down when the tracker is parked, speed it up when it moves
+    */
+    if (!(fix->flags & POSITION_FLAG_VALID))
+    {
+        // without a fix there is nothing to say about moving
+        return;
+    }
+    if (moving(policy, fix))
+    {
+        policy->parked_count = 0;
+        policy->fix_interval = policy->config.moving_fix_interval;
+        return;
+    }
+    if (policy->parked_count < policy->config.parked_fixes)
+    {
+        policy->parked_count++;
+        return;
+    }
+    policy->fix_interval = policy->config.parked_fix_interval;
+}
+
+static uint8_t decide(struct report_policy *policy, const struct position_fix *fix)
+{
+    /**
+        @brief work out why a fix has to be sent
+
+        @return one of the REPORT_REASON_ values
+    */
+    const struct position_fix *last = &policy->last;
+    uint32_t elapsed;
+    bool valid = fix->flags & POSITION_FLAG_VALID;
+
+    if (!policy->have_last)
+    {
+        return REPORT_REASON_FIRST;
+    }
+    if (valid != (bool)(last->flags & POSITION_FLAG_VALID))
+    {
+        return REPORT_REASON_STATUS;
+    }
+    elapsed = (fix->time_of_day + TICKS_PER_DAY - last->time_of_day) % TICKS_PER_DAY;
+    if (elapsed >= (uint32_t)policy->config.heartbeat * TICKS_PER_SECOND)
+    {
+        return REPORT_REASON_HEARTBEAT;
+    }
+    if (!valid)
+    {
+        // a void fix has no position to compare, the heartbeat is enough
+        return REPORT_REASON_NONE;
+    }
+    if (policy->burst_left > 0)
+    {
+        policy->burst_left--;
+        return REPORT_REASON_BURST;
+    }
+    if (moving(policy, fix) && moving(policy, last) && (fix->flags & last->flags & POSITION_FLAG_COURSE_VALID) &&
+        course_difference(fix->course, last->course) >= policy->config.course_change)
+    {
+        return REPORT_REASON_COURSE;
+    }
+    if ((fix->flags & last->flags & POSITION_FLAG_SPEED_VALID) &&
+        (fix->speed > last->speed ? fix->speed - last->speed : last->speed - fix->speed) >=
+            policy->config.speed_change)
+    {
+        return REPORT_REASON_SPEED;
+    }
+    if (elapsed < (uint32_t)policy->config.min_interval * TICKS_PER_SECOND)
+    {
+        return REPORT_REASON_NONE;
+    }
+    if (reckoning_error(policy, fix, elapsed) >= policy->config.distance)
+    {
+        return REPORT_REASON_DISTANCE;
+    }
+    return REPORT_REASON_NONE;
+}
+
+uint8_t report_policy_check(struct report_policy *policy, const struct position_fix *fix)
+/**@brief decide if a fix is sent
+ *
+ * When the answer is yes the fix becomes the last report, so only call this when the fix
+ * really will be queued.  policy->fix_interval is updated on every call.
+ * @param policy the policy
+ * @param fix the new fix
+ * @return REPORT_REASON_NONE to drop the fix, otherwise the reason it has to be sent
+ */
+{
+    uint8_t reason = decide(policy, fix);
+
+    update_fix_interval(policy, fix);
+    if (reason == REPORT_REASON_NONE)
+    {
+        policy->suppressed++;
+        return reason;
+    }
+    if (reason == REPORT_REASON_COURSE || reason == REPORT_REASON_SPEED)
+    {
+        // this fix is the first of the burst
+        policy->burst_left = policy->config.burst_length > 0 ? policy->config.burst_length - 1 : 0;
+    }
+    policy->reasons[reason]++;
+    policy->last = *fix;
+    policy->have_last = true;
+    return reason;
+}
@@ -11,66 +11,158 @@ for the entire text*/
        The command spec for the MT3333 is at https://microchip.ua/simcom/GNSS/Application%20Notes/MT3333%20Platform%20NMEA%20Message%20Specification%20V1.07.pdf
        
 
-    @note the i2c has the following setup bytes 0 through 5 have the call sign. if the call sign is shorter put spaces
-          bytes 6 and 7 have the network sync words.
-      byte offset 0  1  2  3  4    5    6    7
-                  g  x  8  a  b    c    0xaa 0xbb
+    @note the settings are in a block with a crc at byte 16 of the eeprom, see node_config.h.
+          Older trackers had bytes 0 through 5 for the call sign. if the call sign is shorter put spaces
+          bytes 6 and 7 have the network sync words.  Byte 8 is the time slot, 0xff, an erased
+          cell, takes the slot from MY_ADDRESS, see slot_scheduler.h.  The first boot moves them
+          into the block
+      byte offset 0  1  2  3  4    5    6    7    8
+                  g  x  8  a  b    c    0xaa 0xbb 0xff
+          bytes 128 to the end are the ring of fixes that were not acked, see fix_store.h
 **/
 #include <EEPROM.h>
 #include <SPI.h>
 #include <RH_RF69.h>
-#include <RHReliableDatagram.h>
-#define DEBUG 1
-#ifdef DEBUG
-  #define DEBUG_WRITE(x)     Serial.write(x)
-  #define DEBUG_PRINT(x)     Serial.print (x)
-  #define DEBUG_PRINTDEC(x)     Serial.print (x, DEC)
-  #define DEBUG_PRINTHEX(x)     Serial.print (x, HEX)
-  #define DEBUG_PRINTLN(x)  Serial.println (x)
-#else
-  #define DEBUG_WRITE(x) 
-  #define DEBUG_PRINT(x)
-  #define DEBUG_PRINTDEC(x)
-  #define DEBUG_PRINTHEX(x)
-  #define DEBUG_PRINTLN(x)
-#endif 
+#include <gps_ingest.h>
+#include <gps_link.h>
+#include <fix_fusion.h>
+#include <fix_store.h>
+#include <fix_batch.h>
+#include <slot_scheduler.h>
+#include <link_adapter.h>
+#include <nmea.h>
+#include <position_packet.h>
+#include <packet_builder.h>
+#include <tx_queue.h>
+#include <report_policy.h>
+#include <power_manager.h>
+#include <console.h>
+#include <pmtk.h>
+#include <board_profile.h>
+#include <latency_stats.h>
+#include <ram_arena.h>
+#include <node_config.h>
+#include <boot_stats.h>
+// the debug output goes through the binary event log, set LOG_LEVEL in build_flags to change
+// how much of it is compiled in, see event_log.h and log_events.def
+#include <event_log.h>
 
 // function headers
 int parse_gps_data(char *const, char **const);
-void write_gps(const char *data, const u32 retrys);
 u8 calculate_checksum(const char *, u32);
 u8 bin_to_hex(u8 value);
-void blink(byte PIN, byte DELAY_MS, byte loops) ;
-#define RMC_HEADER 0
-#define RMC_TIME 1
-#define RMC_STATUS 2
-#define RMC_LATITUDE 3
-#define RMC_E_W_INDICATOR 4
-#define RMC_LONGITUDE 5
-#define RMC_N_S_INDICATOR 6
-#define RMC_SPEED_OVER_GROUND 7
-#define RMC_COURSE_OVER_GROUND 8
-#define RMC_DATE 9
+bool gps_set_fix_interval(uint16_t milliseconds);
 
 /**
-    @brief  create a name for the gpsSerial port
-    @param GPSSerial
+    @brief this is the number of array entries for the tokenizer.  you can have 15 tokens
+    @param ARRAY_SIZE
 */
-#define GPSSerial Serial1
+#define ARRAY_SIZE 15
 /**
-    @brief this is the size of the data buffer where the data from the MK3339 will be placed.
-    @param GPS_RECEIVER_BUFFER_SIZE
+    @brief define this to send the old comma separated ascii packet instead of the binary position packet
+    @param POSITION_PACKET_LEGACY_ASCII
 */
-#define GPS_RECEIVER_BUFFER_SIZE 100
+// #define POSITION_PACKET_LEGACY_ASCII 1
+
 /**
-    @brief this is the number of array entries for the tokenizer.  you can have 15 tokens
-    @param ARRAY_SIZE
+    @brief what the gps does while the tracker is parked
+    - GPS_POWER_ALWAYS_ON it keeps tracking at the parked fix interval
+    - GPS_POWER_STANDBY it is put in standby (PMTK161) after each report and woken
+      GPS_WAKE_MARGIN ms before the next heartbeat is due, a move is only seen after it wakes
+    - GPS_POWER_PERIODIC it runs its own periodic standby mode (PMTK225), GPS_PERIODIC_RUN ms
+      on and GPS_PERIODIC_SLEEP ms in standby
+    @param GPS_POWER_MODE
+*/
+#define GPS_POWER_ALWAYS_ON 0
+#define GPS_POWER_STANDBY 1
+#define GPS_POWER_PERIODIC 2
+#define GPS_POWER_MODE GPS_POWER_ALWAYS_ON
+#define GPS_WAKE_MARGIN 30000
+#define GPS_PERIODIC_RUN 5000
+#define GPS_PERIODIC_SLEEP 25000
+
+/**
+    @brief seconds between latency telemetry packets to the base station, 0 sends none, the
+    latency console command shows the same numbers
+    @param LATENCY_TELEMETRY_INTERVAL
+*/
+#define LATENCY_TELEMETRY_INTERVAL 0
+
+/**
+    @brief set to 0 to leave the GSA out of each fix, the hdop then comes from the GGA alone and
+    the link has room for 10 fixes a second at 38400 baud
+    @param GPS_SEND_GSA
+*/
+#ifndef GPS_SEND_GSA
+#define GPS_SEND_GSA 1
+#endif
+/**
+    @brief characters on the wire each fix, the GSA of a 3D fix is about 70 more
+    @param GPS_BYTES_PER_FIX
+*/
+#define GPS_BYTES_PER_FIX (GPS_LINK_BYTES_PER_FIX + GPS_SEND_GSA * 70)
+
+// set the oupout to be RMC and GGA, and GSA unless it is turned off.  fix_fusion puts the
+// sentences of each fix together.  The sentence and its checksum are made by the compiler and
+// kept in flash, pmtk.h checks it against the one that used to be written out here
+//                          GLL RMC VTG GGA GSA           GSV
+typedef pmtk_nmea_output<0, 1, 0, 1, GPS_SEND_GSA, 0> gps_init_data;
+
+// 10 bits a character on the wire, the sentences of the fastest fix have to fit in the link
+// with half of it to spare for the acks and the odd long sentence
+static_assert((uint32_t)GPS_BYTES_PER_FIX * 10 * 1000 / REPORT_DEFAULT_MOVING_FIX_INTERVAL <= GPS_LINK_BAUD / 2,
+              "the gps link is too slow for the moving fix interval, raise GPS_LINK_BAUD or set GPS_SEND_GSA to 0");
+
+/**
+    @brief fixes in one batch packet, 0 sends each fix in its own packet.  A batch only holds
+    the position, time, speed and course, not the altitude and dop, see fix_batch.h.  Set
+    FIX_STORE_RAM_SPARE to the same number so a batch that is not acked can be stored
+    @param FIX_BATCH_FIXES
+*/
+#ifndef FIX_BATCH_FIXES
+#define FIX_BATCH_FIXES 0
+#endif
+/**
+    @brief ms the first fix of a batch waits at most before the batch is sent without the rest
+    @param FIX_BATCH_MAX_LATENCY
+*/
+#ifndef FIX_BATCH_MAX_LATENCY
+#define FIX_BATCH_MAX_LATENCY 5000
+#endif
+
+#if FIX_BATCH_FIXES > 0 && defined(POSITION_PACKET_LEGACY_ASCII)
+#error "the ascii packet cannot be batched, set FIX_BATCH_FIXES to 0"
+#endif
+
+/**
+    @brief time slots in each SLOT_FRAME_LENGTH ms of utc time, 0 sends whenever a packet is
+    ready.  Every tracker of the network needs the same number and its own slot, see
+    slot_scheduler.h
+    @param SLOT_COUNT
+*/
+#ifndef SLOT_COUNT
+#define SLOT_COUNT 0
+#endif
+/**
+    @brief define it as the pin the gps PPS output is wired to, for a time base to the
+    microsecond, the pin has to have an interrupt
+    @param SLOT_PPS_PIN
 */
-#define ARRAY_SIZE 15
+
+/**
+    @brief set to 1 to move the bit rate and the transmit power with the ack rssi and the
+    retries, the base station has to answer the change requests, see link_adapter.h.  With 0
+    the radio stays on the link profile of the settings, RF69_LINK_PROFILE by default
+    @param LINK_ADAPT
+*/
+#ifndef LINK_ADAPT
+#define LINK_ADAPT 0
+#endif
 
 /************ Radio Setup ***************/
 /**
-    @brief radio frequency
+    @brief radio frequency, the addresses and the link profile below are the defaults of a
+    tracker with no settings in the eeprom, see node_config.h
     @param RF69_FREQ
 */
 // Change to 434.0 or other frequency, must match RX's freq!
@@ -84,67 +176,310 @@ void blink(byte PIN, byte DELAY_MS, byte loops) ;
 #define DEST_ADDRESS   0x01
 // change addresses for each client board, any number :)
 #define MY_ADDRESS     0x02
+/**
+    @brief the link profile when LINK_ADAPT is 0, 5 is GFSK_Rb250Fd250 at +20 dBm
+    @param RF69_LINK_PROFILE
+*/
+#define RF69_LINK_PROFILE 5
+/**
+    @brief the radio reset, the pin is held high RFM69_RESET_PULSE us and the radio is ready
+    RFM69_RESET_READY us after it goes low again, from the RFM69HCW data sheet
+*/
+#define RFM69_RESET_PULSE 100
+#define RFM69_RESET_READY 5000
 
+// Singleton instance of the radio driver
+RH_RF69 rf69(board::rfm69_cs, board::rfm69_int); /*!< Singleton instance of the radio driver */
 
-#if defined (__AVR_ATmega32U4__) // Feather 32u4 w/Radio
-#define RFM69_CS      8
-#define RFM69_INT     7
-#define RFM69_RST     4
-#define LED           13
-#endif
+static_assert(ARRAY_SIZE <= NMEA_MAX_FIELDS, "the tokens of the RMC do not fit in the ram arena");
 
-#if defined(ADAFRUIT_FEATHER_M0) // Feather M0 w/Radio
-#define RFM69_CS      8
-#define RFM69_INT     3
-#define RFM69_RST     4
-#define LED           13
-#endif
 
-#if defined (__AVR_ATmega328P__)  // Feather 328P w/wing
-#define RFM69_INT     3  // 
-#define RFM69_CS      4  //
-#define RFM69_RST     2  // "A"
-#define LED           13
-#endif
+// this is my ham call sign, and this is necessary for 433 mhz, in the US.  If you are not a ham radio operator
+// in the United States, you cannot use the 433 Mhz radio and you cannot use my call sign.  If you are outside the US,
+// you need to know the rules in your country.
+// the following data structures do not need to be reallocated every time
+//                                           0123456
 
-#if defined(ESP8266)    // ESP8266 feather w/wing
-#define RFM69_CS      2    // "E"
-#define RFM69_IRQ     15   // "B"
-#define RFM69_RST     16   // "D"
-#define LED           0
+char call_sign[CALL_SIGN_LENGTH]; /*!< the call sign read from the eeprom */
+
+/**
+    @brief the settings of a tracker with nothing in the eeprom, in flash
+*/
+static const struct node_config config_defaults PROGMEM = {
+    NODE_CONFIG_MAGIC, NODE_CONFIG_VERSION, {0x2d, 0xd4}, (uint32_t)(RF69_FREQ * 1000),
+    {'N', '0', 'C', 'A', 'L', 'L'}, MY_ADDRESS, DEST_ADDRESS, 0xff, RF69_LINK_PROFILE,
+    REPORT_DEFAULT_MOVING_FIX_INTERVAL, REPORT_DEFAULT_PARKED_FIX_INTERVAL, REPORT_DEFAULT_MIN_INTERVAL,
+    REPORT_DEFAULT_HEARTBEAT, 0,
+};
+
+static_assert(RF69_LINK_PROFILE < LINK_PROFILE_COUNT, "the link profile is not in the table");
+
+struct tx_queue transmit_queue; /*!< packets waiting for the base station, they are built in place */
+uint32_t led_off_time = 0;      /*!< millis() when the no ack led goes off, 0 if it is off */
+struct report_policy report_policy; /*!< decides which fixes are sent and how often the gps makes one */
+uint16_t gps_fix_interval = 0;      /*!< the fix interval last queued for the gps in milliseconds, 0 for none */
+struct power_manager power;         /*!< radio and mcu sleep, and the power account */
+uint32_t gps_wake_time = 0;         /*!< millis() when the gps comes out of standby */
+struct latency_stats latency;       /*!< stage timings from the gps line feed to the ack */
+uint32_t telemetry_time = 0;        /*!< millis() when the last telemetry packet was queued */
+struct gps_link gps_link;           /*!< the gps uart rate and the acked command queue */
+uint16_t gps_resyncs = 0;           /*!< link resyncs the gps has been set up again after */
+struct fix_fusion fix_fusion;       /*!< the RMC, GGA and GSA of the fix being gathered */
+struct fix_store fix_store;         /*!< fixes that were not acked, sent again when the base answers */
+struct fix_batch fix_batch;         /*!< fixes waiting to go out together, and the fixes delivered */
+struct slot_scheduler slot_scheduler; /*!< this tracker's time slot, the gate of the transmit queue */
+struct link_adapter link_adapter;   /*!< the bit rate and power, from the acks */
+struct node_config node_config;     /*!< the call sign, addresses and radio settings from the eeprom */
+struct boot_stats boot;             /*!< the boot stages and the time to first transmit */
+
+static void power_command(char *arguments, Print &out)
+{
+    /**
+        @brief the power console command, power prints the account and power reset zeroes it
+    */
+    if (strcmp_P(arguments, PSTR("reset")) == 0)
+    {
+        power_manager_reset(&power);
+        out.println(F("power account reset"));
+        return;
+    }
+    power_manager_print(&power, out);
+}
+
+static void gps_command(char *arguments, Print &out)
+{
+    /**
+        @brief the gps console command, prints the link rate and the command counters
+    */
+    gps_link_print(&gps_link, out);
+}
+
+static void fix_command(char *arguments, Print &out)
+{
+    /**
+        @brief the fix console command, prints how the sentences of each fix came together
+    */
+    fix_fusion_print(&fix_fusion, out);
+}
+
+static void store_command(char *arguments, Print &out)
+{
+    /**
+        @brief the store console command, prints the fixes waiting to be sent again
+    */
+    fix_store_print(&fix_store, out);
+}
+
+static void batch_command(char *arguments, Print &out)
+{
+    /**
+        @brief the batch console command, prints the batches and the fixes sent per second of air time
+    */
+    fix_batch_print(&fix_batch, &transmit_queue, out);
+}
+
+static void slot_command(char *arguments, Print &out)
+{
+    /**
+        @brief the slot console command, prints the slot, the time base and the sends held for it
+    */
+    slot_scheduler_print(&slot_scheduler, out);
+    out.print(F("held "));
+    out.println(transmit_queue.stats.held);
+}
+
+static void link_command(char *arguments, Print &out)
+{
+    /**
+        @brief the link console command, prints the profile in use and the changes
+    */
+#if LINK_ADAPT
+    link_adapter_print(&link_adapter, out);
+#else
+    out.println(F("link adaptation is off, build with LINK_ADAPT 1"));
 #endif
+}
 
-#if defined(ESP32)    // ESP32 feather w/wing
-#define RFM69_RST     13   // same as LED
-#define RFM69_CS      33   // "B"
-#define RFM69_INT     27   // "A"
-#define LED           13
+static void latency_command(char *arguments, Print &out)
+{
+    /**
+        @brief the latency console command, latency prints the histograms and latency reset zeroes them
+    */
+    if (strcmp_P(arguments, PSTR("reset")) == 0)
+    {
+        latency_stats_reset(&latency);
+        out.println(F("latency reset"));
+        return;
+    }
+    latency_stats_print(&latency, out);
+}
+
+static void mem_command(char *arguments, Print &out)
+{
+    /**
+        @brief the mem console command, prints the free ram, the stack low water mark and the arena
+    */
+    ram_arena_print(out);
+}
+
+static void boot_command(char *arguments, Print &out)
+{
+    /**
+        @brief the boot console command, prints the time of each boot stage from the start of setup
+    */
+    boot_stats_print(&boot, out);
+}
+
+static void config_command(char *arguments, Print &out)
+{
+    /**
+        @brief the config console command, config prints the settings, config call <sign> writes
+        a new call sign and config reset erases the block, both take effect at the next boot
+    */
+    if (strncmp_P(arguments, PSTR("call "), 5) == 0)
+    {
+        if (!node_config_set_call_sign(&node_config, arguments + 5))
+        {
+            out.println(F("not a call sign"));
+            return;
+        }
+        node_config_save(&node_config);
+    }
+    else if (strcmp_P(arguments, PSTR("reset")) == 0)
+    {
+        node_config_erase();
+        out.println(F("config erased"));
+        return;
+    }
+    node_config_print(&node_config, boot.config_source, out);
+}
+
+/**
+    @brief the serial console commands, in flash
+*/
+static const struct console_command console_commands[] PROGMEM = {
+    {"power", power_command, "time and charge in each power state, power reset zeroes it"},
+    {"latency", latency_command, "time from gps line feed to ack by stage, latency reset zeroes it"},
+    {"gps", gps_command, "gps link baud rate and the commands acked, resent and failed"},
+    {"fix", fix_command, "fixes put together from RMC, GGA and GSA, and the sentences missed"},
+    {"store", store_command, "fixes that were not acked and are waiting to be sent again"},
+    {"batch", batch_command, "fixes per batch packet and fixes delivered per second of air time"},
+    {"slot", slot_command, "the time slot, how well the clock follows the gps and the sends held"},
+    {"link", link_command, "the bit rate and power in use, the ack rssi and the profile changes"},
+    {"mem", mem_command, "free ram now, ram the stack has never used, and the scratch arena"},
+    {"boot", boot_command, "ms from the start of setup to the radio, the first fix, send and ack"},
+    {"config", config_command, "the settings in the eeprom, config call <sign> or config reset"},
+};
+
+/**
+    @brief how long the led stays on when a packet was not acked
+    @param NO_ACK_LED_TIME
+*/
+#define NO_ACK_LED_TIME 499
+/**
+    @brief the radio noise samples random() is seeded from, and the us between them, the
+    rssi register is measured again every few us in receive
+    @param RANDOM_SEED_SAMPLES
+    @param RANDOM_SEED_SPACING
+*/
+#define RANDOM_SEED_SAMPLES 16
+#define RANDOM_SEED_SPACING 50
+
+#if defined(SLOT_PPS_PIN)
+static void pps_edge(void)
+{
+    /**
+        @brief the PPS interrupt, the edge is the start of a utc second
+    */
+    slot_scheduler_pps(&slot_scheduler);
+}
 #endif
 
-// Singleton instance of the radio driver
-RH_RF69 rf69(RFM69_CS, RFM69_INT); /*!< Singleton instance of the radio driver */
+static bool fix_interval_usable(uint16_t milliseconds)
+{
+    /**
+        @brief the MT3333 takes 100 to 10000 ms, and the sentences of each fix have to fit in
+        half of the link, as the static_assert checks for the default
+    */
+    return milliseconds >= 100 && milliseconds <= 10000 &&
+           (uint32_t)GPS_BYTES_PER_FIX * 10 * 1000 / milliseconds <= GPS_LINK_BAUD / 2;
+}
 
-// Class to manage message delivery and receipt, using the driver declared above
-RHReliableDatagram rf69_manager(rf69, MY_ADDRESS);  /*!< Class to manage message delivery and receipt, using the driver declared above */
+static void seed_random(void)
+{
+    /**
+        @brief seed random() once at boot, the retry backoff of the transmit queue draws from it
 
-// Dont put these on the stack, they only need to be allocated once.
-uint8_t reply_buffer[RH_RF69_MAX_MESSAGE_LEN]; /*!< the reply buffer */
-const char comma = ',';
-char *gps_parsed_data[ARRAY_SIZE]; /*!< array where the parsed gps to be transmitted is placed  */
+        Without a seed every tracker starts random() from the same state, so trackers that boot
+        together and collide draw the same backoff and collide again on every retry.  The low
+        bits of the rssi of the idle channel and the time each sample is taken are noise, and
+        the address is mixed in so two trackers differ even when the noise does not.
+    */
+    uint32_t seed = node_config.address;
 
+    rf69.setModeRx();
+    for (uint8_t index = 0; index < RANDOM_SEED_SAMPLES; index++)
+    {
+        delayMicroseconds(RANDOM_SEED_SPACING);
+        seed = (seed << 5 | seed >> 27) ^ (uint8_t)rf69.rssiRead() ^ micros();
+    }
+    rf69.setModeIdle();
+    randomSeed(seed);
+}
 
-// this is my ham call sign, and this is necessary for 433 mhz, in the US.  If you are not a ham radio operator
-// in the United States, you cannot use the 433 Mhz radio and you cannot use my call sign.  If you are outside the US,
-// you need to know the rules in your country.
-// the following data structures do not need to be reallocated every time
-//                                           0123456
+static void apply_link_profile(void *context, const struct link_profile *profile)
+{
+    /**
+        @brief setup or the link adapter picked a profile, put it on the radio
+    */
+    rf69.setModemConfig((RH_RF69::ModemConfigChoice)profile->modem);
+    rf69.setTxPower(profile->power, true);
+    power_manager_set_tx_current(&power, profile->current * 1000UL);
+}
 
-char radiopacket[RH_RF69_MAX_MESSAGE_LEN] = "xxxxxx,";  /*!< packet to be transmitted */
+static void transmit_complete(struct tx_queue *queue, const struct tx_frame *frame, bool delivered, uint8_t attempts)
+{
+    /**
+        @brief called by the transmit queue when a packet is finished
 
-char gps_data[GPS_RECEIVER_BUFFER_SIZE]; /*!< buffer to contain the received packet */
-/**@def gps_data
-Where the ack packet will go
-*/
+        A lost packet turns the led on, the loop turns it off again, so nothing ever waits.
+    */
+    uint32_t now = micros();
+
+    LOG(LOG_TX_DONE, delivered, attempts, (uint32_t)(now - frame->committed) / 1000, queue->stats.last_ack_rssi);
+    latency_stats_delivery(&latency, delivered, attempts, queue->stats.last_ack_rssi);
+    // a lost fix is kept, and an ack lets the kept ones go again
+    fix_store_complete(&fix_store, frame, delivered);
+    fix_batch_complete(&fix_batch, frame, delivered);
+    // a frame can be sent and acked in one service of the queue, before the loop sees it went
+    boot_stats_mark(&boot, BOOT_SEND);
+    if (delivered && boot_stats_mark(&boot, BOOT_ACK))
+    {
+        LOG(LOG_BOOT_TIME, boot_stats_elapsed(&boot, BOOT_READY) / 1000, boot_stats_elapsed(&boot, BOOT_FIX) / 1000,
+            boot_stats_elapsed(&boot, BOOT_SEND) / 1000, boot_stats_elapsed(&boot, BOOT_ACK) / 1000);
+    }
+#if LINK_ADAPT
+    link_adapter_complete(&link_adapter, frame, delivered, attempts);
+#endif
+    // the telemetry, history and link packets are not live reports, they only count for the
+    // radio.  A batch is timed from its first fix
+    if (delivered && frame->data[0] != (LATENCY_TELEMETRY_MAGIC | LATENCY_TELEMETRY_VERSION) &&
+        frame->data[0] != (POSITION_HISTORY_MAGIC | POSITION_HISTORY_VERSION) &&
+        frame->data[0] != (LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION))
+    {
+        latency_stats_record(&latency, LATENCY_AIR, now - frame->committed);
+        latency_stats_record(&latency, LATENCY_TOTAL, now - frame->origin);
+    }
+    if (!delivered)
+    {
+        digitalWrite(board::led, HIGH);
+        led_off_time = millis() + NO_ACK_LED_TIME;
+        if (led_off_time == 0)
+        {
+            led_off_time = 1;
+        }
+    }
+}
 
 void rfm_69_setup()
 {
@@ -152,10 +487,13 @@ void rfm_69_setup()
         @brief This is the setup program for the Arduino
 
         This program sets only
+        - Resets the radio first, and sets it up last once it has had RFM69_RESET_READY us
         - Sets up the debug serial port 115200
-        - Sets up the GPS serial port to 9600 baud
-        - output GMRC packets
-        - only output once every 10 seconds
+        - Loads the call sign, the network and the addresses from the eeprom, see node_config.h
+        - Starts the search for the GPS, it is moved from 9600 to GPS_LINK_BAUD by the loop
+        - output GPRMC, GPGGA and GPGSA sentences, the loop puts each fix together from them
+        - start with one fix every 10 seconds, the report policy changes this as the tracker moves
+        - Times each step in boot, the loop adds the first fix, send and ack, see boot_stats.h
 
         @return Nothing
     */
@@ -180,88 +518,123 @@ void rfm_69_setup()
     // 4 - Output once every four position fixes
     // 5 - Output once every five position fixes 
     
-    // const char gps_init_data[] = "$PMTK314,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*29\r\n";
-    // set the oupout to be RMC
-    //                                     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8
-    const char gps_init_data[] = "$PMTK314,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*29\r\n";
-    // set the the gps to only transmit once every 10 seconds.
-    const char gps_update_rate[] = "$PMTK220,10000*2F\r\n";
-    // the sync words for the radio the default are 0x2d and 0xd4
-    u8 syncwords []= {0x2d, 0xd4};
-    //uint8_t syncwords[2] ;
-    //int sync_word_index = 0;
-    // 9600 baud is the default rate for the Ultimate GPS
-    GPSSerial.begin(9600);
-    int index = 0;
-    //char written;
-    u8 checksum;
-    
-#if defined (DEBUG)
-    Serial.begin(115200);
-    while (!Serial) {
-        delay(1);    // wait until serial console is open, remove if not tethered to computer
-    }
+    // gps_init_data at the top sets the output to be RMC, GGA and GSA
+#if !LINK_ADAPT
+    struct link_profile profile;
 #endif
-    //read the call sign from the eeprom. bytes 0 through 5
-    while (index < 6 )
-    {
-      radiopacket[index] = EEPROM.read(index);
-      DEBUG_PRINT("read ");DEBUG_PRINT(radiopacket[index]);DEBUG_PRINT("from addr=");DEBUG_PRINT(index);DEBUG_PRINT("\n");
-      index++;
-    }
-    radiopacket[index++]=',';
-    radiopacket[index++]=0;
-    // set the index to location 6 to read the sync words bytes 6 and 7
-    index = 6; 
-    syncwords[0] =  EEPROM.read(index);
-    DEBUG_PRINT("read 0x");DEBUG_PRINTHEX(syncwords[0]);DEBUG_PRINT(" from addr=");DEBUG_PRINT(index);DEBUG_PRINT("\n");
-    index = 7;
-    syncwords[1] =  EEPROM.read(index);
-    DEBUG_PRINT("read 0x");DEBUG_PRINTHEX(syncwords[1]);DEBUG_PRINT(" from addr=");DEBUG_PRINT(index);DEBUG_PRINT("\n");
+    uint32_t reset_time;
+    uint32_t waited;
+
+    // the stack low water mark of the mem command is measured from here
+    ram_arena_paint();
+    boot_stats_begin(&boot);
+    // manual reset the radio first, it comes up while the rest is set up
+    pinMode(board::led, OUTPUT);
+    pinMode(board::rfm69_rst, OUTPUT);
+    digitalWrite(board::rfm69_rst, HIGH);
+    delayMicroseconds(RFM69_RESET_PULSE);
+    digitalWrite(board::rfm69_rst, LOW);
+    reset_time = micros();
+
+    // 9600 baud is the default rate for the Ultimate GPS, the link finds it and moves it to
+    // GPS_LINK_BAUD while the loop runs, the commands below wait in its queue until then
+    gps_link_begin(&gps_link);
+    fix_fusion_init(&fix_fusion, GPS_SEND_GSA ? FIX_HAVE_GGA | FIX_HAVE_GSA : FIX_HAVE_GGA);
     
-    // calculate the checksome of the gps data
-    checksum = calculate_checksum(gps_init_data, strlen(gps_init_data));
-    DEBUG_PRINT("checksum = "); DEBUG_PRINTHEX(checksum); DEBUG_PRINT("\n");
-    // only send GPRMC  packets
-    write_gps(gps_init_data, 3);
+    // the console and the log are on the usb serial port.  Nothing waits for a host to open it,
+    // the log is kept in ram until there is room to send it.
+    Serial.begin(115200);
+    LOG(LOG_BOOT);
+    // the call sign, the network and the addresses, in one block with a crc
+    boot.config_source = node_config_load(&node_config, &config_defaults);
+    memcpy(call_sign, node_config.call_sign, CALL_SIGN_LENGTH);
+    boot_stats_mark(&boot, BOOT_CONFIG);
+    LOG(LOG_CALL_SIGN, call_sign[0], call_sign[1], call_sign[2], call_sign[3], call_sign[4], call_sign[5]);
+    LOG(LOG_SYNC_WORDS, node_config.sync_words[0], node_config.sync_words[1]);
+    // an erased slot takes it from the address
+    slot_scheduler_init(&slot_scheduler, node_config.slot != 0xff ? node_config.slot : node_config.address,
+                        SLOT_COUNT);
+    // the fixes that were still waiting for the base station when the power went
+    fix_store_begin(&fix_store);
+    fix_batch_init(&fix_batch, FIX_BATCH_FIXES, FIX_BATCH_MAX_LATENCY);
     
-    // initial the GPS radio to only send updates once every 10 seconds
-    write_gps(gps_update_rate, 3);
+    // only send GPRMC, GPGGA and GPGSA sentences
+    gps_link_send<gps_init_data>(&gps_link);
     
-    pinMode(LED, OUTPUT);
-    pinMode(RFM69_RST, OUTPUT);
-    digitalWrite(RFM69_RST, LOW);
-
-    DEBUG_PRINTLN("Feather Addressed RFM69 TX Test!");
-    DEBUG_PRINTLN();
-
-    // manual reset the radio
-    digitalWrite(RFM69_RST, HIGH);
-    delay(10);
-    digitalWrite(RFM69_RST, LOW);
-    delay(10);
+    // the gps starts with the parked fix interval, once every 10 seconds by default.  An
+    // interval in the settings that the gps or its link cannot keep up with is not used
+    report_policy_init(&report_policy);
+    if (fix_interval_usable(node_config.moving_fix_interval))
+    {
+        report_policy.config.moving_fix_interval = node_config.moving_fix_interval;
+    }
+    if (fix_interval_usable(node_config.parked_fix_interval))
+    {
+        report_policy.config.parked_fix_interval = node_config.parked_fix_interval;
+        report_policy.fix_interval = node_config.parked_fix_interval;
+    }
+    if (node_config.heartbeat != 0 && node_config.min_interval <= node_config.heartbeat)
+    {
+        report_policy.config.min_interval = node_config.min_interval;
+        report_policy.config.heartbeat = node_config.heartbeat;
+    }
+    gps_set_fix_interval(report_policy.fix_interval);
 
-    if (!rf69_manager.init()) {
-        DEBUG_PRINTLN("RFM69 radio init failed");
-        while (1);
+    // only what is left of the radio's start up time is waited for
+    waited = micros() - reset_time;
+    if (waited < RFM69_RESET_READY)
+    {
+        delayMicroseconds(RFM69_RESET_READY - waited);
+    }
+    // the transmit queue does the acks and retries, RHReliableDatagram would only cost its
+    // 256 byte table of the last id from each address
+    if (!rf69.init()) {
+        LOG(LOG_RADIO_INIT_FAILED);
+        while (1) {
+            // keep sending the log so the failure can be seen
+            log_service();
+        }
     }
-    DEBUG_PRINTLN("RFM69 radio init OK!");
+    // the driver drops frames that are not for this address
+    rf69.setThisAddress(node_config.address);
     // Defaults after init are 434.0MHz, modulation GFSK_Rb250Fd250, +13dbM (for low power module)
     // No encryption
-    if (!rf69.setFrequency(RF69_FREQ)) {
-        DEBUG_PRINTLN("setFrequency failed");
+    if (!rf69.setFrequency(node_config.frequency / 1000.0)) {
+        LOG(LOG_SET_FREQUENCY_FAILED);
     }
 
     // If you are using a high power RF69 eg RFM69HW, you *must* set a Tx power with the
-    // ishighpowermodule flag set like this:
-    rf69.setTxPower(20, true);    // range from 14-20 for power, 2nd arg must be true for 69HCW
-    rf69.setSyncWords(syncwords, 2);  //set the network,  This must match for all board and this is the default
+    // ishighpowermodule flag set like this, the link profiles do
+    rf69.setSyncWords(node_config.sync_words, 2);  //set the network,  This must match for all board
+    // on the frequency, before the queue draws its first backoff
+    seed_random();
 
-    pinMode(LED, OUTPUT);
+    // the queue sends and waits for acks itself
+    tx_queue_init(&transmit_queue, &rf69, node_config.address);
+    transmit_queue.on_complete = transmit_complete;
+#if SLOT_COUNT > 0
+    transmit_queue.gate = slot_scheduler_gate;
+    transmit_queue.gate_context = &slot_scheduler;
+#if defined(SLOT_PPS_PIN)
+    pinMode(SLOT_PPS_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(SLOT_PPS_PIN), pps_edge, RISING);
+#endif
+#endif
+    power_manager_init(&power, &rf69, &transmit_queue);
+#if LINK_ADAPT
+    // the slowest and loudest profile, the base station starts every tracker on it
+    link_adapter_init(&link_adapter, &transmit_queue, apply_link_profile, NULL);
+#else
+    link_adapter_profile(node_config.profile < LINK_PROFILE_COUNT ? node_config.profile : RF69_LINK_PROFILE,
+                         &profile);
+    transmit_queue.bit_rate = profile.bit_rate;
+    apply_link_profile(NULL, &profile);
+#endif
+    boot_stats_mark(&boot, BOOT_RADIO);
+    console_begin(console_commands, sizeof(console_commands) / sizeof(console_commands[0]));
 
-    DEBUG_PRINT("RFM69 radio @");  DEBUG_PRINT((int)RF69_FREQ);  DEBUG_PRINTLN(" MHz");
-    
-    
+    LOG(LOG_RADIO_READY, node_config.frequency / 1000, node_config.address);
+    boot_stats_mark(&boot, BOOT_READY);
 }
 
 
@@ -272,110 +645,266 @@ void rfm_69_loop() {
         This program receives the data from the gps receiver,parses it, and sends it to Node 2 on the
         network.  Because this is running on the Ham band, it does not encrpt.
 
+        It never waits for the gps.  If no complete sentence has arrived yet it returns straight away,
+        so the arduino loop keeps running while the uart interrupt fills the ring buffer.
+        It never waits for the radio either, packets are built straight into the transmit queue
+        and the queue sends them and waits for the acks a step at a time.
+
+        Not every fix is sent, the report policy drops the ones the base station can dead reckon,
+        and it slows the gps down while the tracker is parked.
+
+        Each pass starts by sleeping the mcu until an interrupt, unless the gps has already sent
+        something, and the radio is asleep whenever the transmit queue is idle.
+
         @return Nothing
     */
-    char gps_char;
+    struct gps_sentence *sentence;
+    struct fix_epoch *epoch;
     uint8_t number_of_tokens;
-    uint16_t index;
-    uint16_t gps_char_index = 0;
-    uint8_t reply_buffer_len = 0 ; //this might be modified by the transmit program
-    // terminate the radio packet with a 0,  after it has been used once it will have data after the #
-    // this saves the slow auto intilaizaton of the packet ever time
-    radiopacket[7] = 0;
-    // set the gps data to zero befor receive.
-    memset(gps_data, 0, sizeof(gps_data));
-    reply_buffer_len = sizeof(reply_buffer);
-
-    while (1)
-    {
-        // Read the serial data from the serial port attached to the software serial port.
-         
-        if (GPSSerial.available())
+    uint8_t packet_length;
+#if FIX_BATCH_FIXES == 0 || LATENCY_TELEMETRY_INTERVAL > 0
+    uint8_t *radiopacket;
+#endif
+    char **gps_parsed_data;
+    union ram_arena_space *arena;
+    uint8_t reason;
+    struct position_fix fix;
+    uint32_t line_feed;
+    uint32_t picked_up;
+    uint32_t decided;
+#if defined(POSITION_PACKET_LEGACY_ASCII)
+    uint8_t index;
+    struct packet_builder builder;
+#endif
+
+    power_manager_sleep(&power);
+    power_manager_service(&power);
+    console_service();
+    log_service();
+    fix_store_service(&fix_store);
+    gps_ingest_service();
+    gps_link_service(&gps_link);
+    if (gps_link.stats.resyncs != gps_resyncs)
+    {
+        // a gps that lost its rate was reset and lost its settings with it
+        gps_resyncs = gps_link.stats.resyncs;
+        gps_link_send<gps_init_data>(&gps_link);
+        // if the queue is full the loop sends the interval on the next fix
+        gps_fix_interval = 0;
+        gps_set_fix_interval(report_policy.fix_interval);
+    }
+#if FIX_BATCH_FIXES > 0
+    fix_batch_service(&fix_batch, &transmit_queue);
+#endif
+#if LINK_ADAPT
+    link_adapter_service(&link_adapter, node_config.base_address);
+#endif
+    tx_queue_service(&transmit_queue);
+    if (transmit_queue.stats.air_bits != 0)
+    {
+        boot_stats_mark(&boot, BOOT_SEND);
+    }
+    if (power.gps_state == POWER_GPS_STANDBY && (int32_t)(millis() - gps_wake_time) >= 0)
+    {
+        // any byte wakes the gps, the test command gets an ack back and nothing else
+        gps_link_send<pmtk_test>(&gps_link);
+        LOG(LOG_GPS_WAKE);
+        power_manager_set_gps(&power, POWER_GPS_ON);
+        power_manager_expect_sentence(&power, report_policy.fix_interval);
+    }
+    if (led_off_time != 0 && (int32_t)(millis() - led_off_time) >= 0)
+    {
+        digitalWrite(board::led, LOW);
+        led_off_time = 0;
+    }
+#if LATENCY_TELEMETRY_INTERVAL > 0
+    if ((uint32_t)(millis() - telemetry_time) >= LATENCY_TELEMETRY_INTERVAL * 1000UL)
+    {
+        radiopacket = tx_queue_reserve(&transmit_queue);
+        if (radiopacket != NULL)
         {
-            // DEBUG_PRINT("start gps read");
-            gps_char = GPSSerial.read();
-            // if it is a carriage return character continue
-           
-            if (gps_char == 13)
-            {
-                // DEBUG_PRINTLN("carriage returnx");
-                continue;
-            }
-
-            // if it is a line feed, stop we have the packet
-            if (gps_char == 10)
-            {
-                // DEBUG_PRINTLN("line feed");DEBUG_PRINTLN(gps_data);
-                // this is a GxRMC packet.  Not 0 ascii 0 in a RMC packet means no or invalid fix
-                if (strncmp(gps_data+3, "RMC", 3) != 0)
-                {
-                    gps_char_index = 0;  // reset the index to 0 because we did not get the expected packet
-                    DEBUG_PRINTLN("Got a continue");
-                    continue;
-                }
-                else
-                    DEBUG_PRINTLN("Got a break");
-                    break;
-            }
-            // make sure we never have a data overun.  Buffer overflows are nasty.
-            if (gps_char_index < GPS_RECEIVER_BUFFER_SIZE - 3)
-                gps_data[gps_char_index++] = gps_char;
-            else
-                gps_data[gps_char_index] = gps_char;
+            telemetry_time = millis();
+            packet_length = latency_telemetry_encode(&latency, call_sign, radiopacket, RH_RF69_MAX_MESSAGE_LEN);
+            tx_queue_commit(&transmit_queue, packet_length, node_config.base_address);
         }
     }
-    gps_data[gps_char_index++] = 0; //make the gps data null terminated
-    DEBUG_PRINT("Nema sentence = ");DEBUG_PRINTLN(gps_data);
-    // now parse the data into a array of character pointers.
-    number_of_tokens = parse_gps_data(gps_data, gps_parsed_data);
-#if defined(DEBUG)
-    for (index = 0; index < number_of_tokens; index++)
+#endif
+    sentence = gps_ingest_next();
+    if (sentence != NULL)
+    {
+        // every good sentence shows the link rate is right, and the acks are picked out here
+        gps_link_sentence(&gps_link, sentence);
+        boot_stats_mark(&boot, BOOT_SENTENCE);
+        // the RMC, GGA and GSA of a fix are kept until the last of them is in, the rest are let go
+        fix_fusion_add(&fix_fusion, sentence);
+    }
+    epoch = fix_fusion_next(&fix_fusion);
+    if (epoch == NULL)
+    {
+        // nothing new to send, fixes the base station missed can go now
+        fix_store_backfill(&fix_store, &transmit_queue, call_sign, node_config.base_address);
+        return;
+    }
+    // this is a GxRMC packet.  Not 0 ascii 0 in a RMC packet means no or invalid fix.  The few
+    // GGA and GSA fields that are used were decoded when the epoch was finished
+    sentence = epoch->sentences[FIX_RMC];
+    picked_up = micros();
+    line_feed = sentence->line_feed;
+    latency_stats_record(&latency, LATENCY_RECEIVE, picked_up - line_feed);
+#if FIX_BATCH_FIXES == 0
+    radiopacket = tx_queue_reserve(&transmit_queue);
+    if (radiopacket == NULL)
+    {
+        LOG(LOG_QUEUE_FULL, transmit_queue.stats.dropped);
+        fix_fusion_release(epoch);
+        return;
+    }
+#endif
+    // the sentence was split and its checksum checked as it arrived, just point at the fields.
+    // the tokens point into the sentence slot, so it is not released until the packet is built,
+    // and they are in the arena until then too
+    arena = ram_arena_take(RAM_ARENA_TOKENS);
+    if (arena == NULL)
+    {
+        fix_fusion_release(epoch);
+        return;
+    }
+    gps_parsed_data = arena->tokens;
+    number_of_tokens = sentence->fields.count < ARRAY_SIZE ? sentence->fields.count : ARRAY_SIZE;
+    for (uint8_t token = 0; token < number_of_tokens; token++)
+    {
+        gps_parsed_data[token] = gps_sentence_field(sentence, token);
+    }
+    LOG(LOG_RMC, number_of_tokens > RMC_STATUS ? gps_parsed_data[RMC_STATUS][0] : '?', number_of_tokens,
+        sentence->length);
+    LOG(LOG_FIX_EPOCH, epoch->present, fix_fusion.stats.partial);
+    // the legacy packet is decoded as well, the policy works on numbers not text
+    if (!position_fix_from_rmc(gps_parsed_data, number_of_tokens, call_sign, &fix))
+    {
+        LOG(LOG_SHORT_RMC, number_of_tokens);
+        ram_arena_release(RAM_ARENA_TOKENS);
+        fix_fusion_release(epoch);
+        return;
+    }
+    if ((fix.flags & POSITION_FLAG_VALID) != 0)
     {
-        if (gps_parsed_data[index] == NULL)
+        boot_stats_mark(&boot, BOOT_FIX);
+#if SLOT_COUNT > 0
+        // every valid fix moves the slots back on to utc
+        slot_scheduler_sync(&slot_scheduler, fix.time_of_day, line_feed);
+#endif
+    }
+    reason = report_policy_check(&report_policy, &fix);
+    decided = micros();
+    latency_stats_record(&latency, LATENCY_PARSE, decided - picked_up);
+    // a command the full gps link queue did not take is tried again on the next fix
+    if (report_policy.fix_interval != gps_fix_interval && gps_set_fix_interval(report_policy.fix_interval))
+    {
+#if GPS_POWER_MODE == GPS_POWER_PERIODIC
+        if (report_policy.fix_interval == report_policy.config.parked_fix_interval)
         {
-            break;
+            typedef pmtk_periodic<2, GPS_PERIODIC_RUN, GPS_PERIODIC_SLEEP, GPS_PERIODIC_RUN, GPS_PERIODIC_SLEEP>
+                periodic;
+            gps_link_send<periodic>(&gps_link);
+            power_manager_set_periodic(&power, GPS_PERIODIC_RUN, GPS_PERIODIC_SLEEP);
+            power_manager_set_gps(&power, POWER_GPS_PERIODIC);
+            LOG(LOG_GPS_PERIODIC, 1);
+        }
+        else if (power.gps_state == POWER_GPS_PERIODIC)
+        {
+            gps_link_send<pmtk_normal_power>(&gps_link);
+            power_manager_set_gps(&power, POWER_GPS_ON);
+            LOG(LOG_GPS_PERIODIC, 0);
         }
-        DEBUG_PRINT("Gps data="); DEBUG_PRINTLN(gps_parsed_data[index]);
-
-    }
 #endif
+    }
+    // the gps sends one RMC per fix, the mcu can sleep until the next one
+    power_manager_expect_sentence(&power, report_policy.fix_interval);
+    if (reason == REPORT_REASON_NONE)
+    {
+        LOG(LOG_SUPPRESSED, report_policy.suppressed);
+        ram_arena_release(RAM_ARENA_TOKENS);
+        fix_fusion_release(epoch);
+        return;
+    }
+    // the fix interval commands above wait on the gps uart, they are not part of the build time
+    decided = micros();
+#if defined(POSITION_PACKET_LEGACY_ASCII)
     // a little explantion here, gps_parsed data[2] is a pointer to a c string.
     // this string will always contain either an singe C string, "A" or "V".  If the string contains
     // and A, then the gps data is valid. One could use a strcmp but pointer[0] is faster
     //   0     1         2   3       4    5       6   7    8      9
     // $GPRMC,094330.000,A,3113.3156,N,12121.2686,E,0.51,193.93,171210,,,A*68<CR><LF>
+    // the builder keeps a cursor at the end of the packet, so each append only touches the new
+    // bytes and can never run past RH_RF69_MAX_MESSAGE_LEN
+    packet_builder_start(&builder, radiopacket, RH_RF69_MAX_MESSAGE_LEN);
+    packet_builder_append(&builder, call_sign, CALL_SIGN_LENGTH);
+    packet_builder_append_char(&builder, ',');
     if (gps_parsed_data[RMC_STATUS][0] == 'A')
     {   
       // indexes 1, 2,3,4,5,6 have the gps data
         for (index = RMC_TIME; index < RMC_SPEED_OVER_GROUND; index++)
         {
-            strcat(radiopacket, gps_parsed_data[index]);
+            packet_builder_append_string(&builder, gps_parsed_data[index]);
             // do not put the comma after the last data
-            strcat(radiopacket,",");
-            
+            packet_builder_append_char(&builder, ',');
         }
-        strcat(radiopacket, gps_parsed_data[RMC_DATE]);
+        packet_builder_append_string(&builder, gps_parsed_data[RMC_DATE]);
     }
     else
     { 
       // put on a message that the data is bad
-      strcat(radiopacket,"V,");
+      packet_builder_append_string(&builder, "V,");
         for (index = 0; index < 3; index++)
         {
-            strcat(radiopacket, gps_parsed_data[index]);
+            packet_builder_append_string(&builder, gps_parsed_data[index]);
         }
     }
-    // Send a message to the DESTINATION!
-    DEBUG_PRINT("radio packet="); DEBUG_PRINTLN(radiopacket);
-
-    if (rf69_manager.sendtoWait((uint8_t *)radiopacket, strlen(radiopacket), DEST_ADDRESS)) {
-        // Now wait for a reply from the server
-        reply_buffer_len = sizeof(reply_buffer);
-        
-    } else {
-        DEBUG_PRINTLN("Sending failed (no ack)");
-        blink(LED, 499, 1);
+    packet_length = packet_builder_finish(&builder);
+#elif FIX_BATCH_FIXES > 0
+    // the fix goes in the batch, which is queued when it is full or its first fix is too old
+    packet_length = 0;
+#else
+    // the binary packet, 25 bytes no matter how many digits the gps sends, 31 with the
+    // altitude and dop of the GGA and GSA
+    fix_epoch_quality(epoch, &fix);
+    packet_length = position_packet_encode(&fix, radiopacket, RH_RF69_MAX_MESSAGE_LEN);
+#endif
+    LOG(LOG_REPORT, reason, packet_length);
+    ram_arena_release(RAM_ARENA_TOKENS);
+    fix_fusion_release(epoch);
+#if FIX_BATCH_FIXES > 0
+    if (!fix_batch_add(&fix_batch, &transmit_queue, call_sign, &fix, node_config.base_address, line_feed))
+    {
+        LOG(LOG_QUEUE_FULL, transmit_queue.stats.dropped);
+        return;
+    }
+#else
+    // Send a message to the DESTINATION!  A zero length packet is thrown away by the queue
+    if (!tx_queue_commit_from(&transmit_queue, packet_length, node_config.base_address, line_feed))
+    {
+        LOG(LOG_PACKET_TOO_LONG, packet_length);
+        return;
     }
+#endif
+    latency_stats_record(&latency, LATENCY_BUILD, micros() - decided);
+    tx_queue_service(&transmit_queue);
+    if (transmit_queue.stats.air_bits != 0)
+    {
+        boot_stats_mark(&boot, BOOT_SEND);
+    }
+#if GPS_POWER_MODE == GPS_POWER_STANDBY
+    if (report_policy.fix_interval == report_policy.config.parked_fix_interval &&
+        (u32)report_policy.config.heartbeat * 1000 > GPS_WAKE_MARGIN)
+    {
+        // parked, nothing needs to be sent before the heartbeat
+        gps_link_send<pmtk_standby>(&gps_link);
+        gps_wake_time = millis() + (u32)report_policy.config.heartbeat * 1000 - GPS_WAKE_MARGIN;
+        LOG(LOG_GPS_STANDBY, gps_wake_time - millis());
+        power_manager_set_gps(&power, POWER_GPS_STANDBY);
+        power_manager_expect_sentence(&power, gps_wake_time - millis());
+    }
+#endif
 }
 
 // the char *const says the pointer cannot be changed, but the data can
@@ -388,6 +917,7 @@ int parse_gps_data(char *const gps_raw_data, char **const array_pointers)
     Nemas    =  $GPRMC,023936.000,A,1111.1234,N,12345.4321,W,0.54,243.41,180419,,,A*74
 
     The commans in the string will be set to 0, breaking the string in to multiple strings.
+    Two commas in a row give an empty string, so a field is always at the same index.
     Each entry on char ** const array_pointer will point to the start of the data of each string.
     The address of each string is just he starting address of the gps_raw_data + index of beginnig of
     each string\n
@@ -401,8 +931,8 @@ int parse_gps_data(char *const gps_raw_data, char **const array_pointers)
        |:-------------------:|:-----------------------------:|
        |Nema sentence name      |0| $GxRMC, depends on the the type of fix. P=gps only,  N=gps add glosnoss
        |utc_time                |1|
-       |lattitude               |2|
-       |status                  |3|
+       |status                  |2|
+       |lattitude               |3|
        |n/s indicator           |4|
        |logitude                |5|
        |e/w indicator           |6|
@@ -419,59 +949,62 @@ int parse_gps_data(char *const gps_raw_data, char **const array_pointers)
                the pointer is a const, whilst the data is not
     @param array_pointers  an array of character pointers which will contain the address of the tokens
 
-    @return always 0
+    @return the number of tokens, 0 if the *hh checksum is missing or does not match
 */
 {
-    unsigned char array_pointer_index = 0;  // the sub index tracks the pointer into the array of pointers
-    //char comma = ',';
-    unsigned char index;
-    u16 length_of_raw_data = strlen(gps_raw_data);
-    array_pointers[array_pointer_index++] = gps_raw_data;
-    for (index = 0; index < length_of_raw_data; index++)
-    {
-        if (gps_raw_data[index] == comma)
-        {
-            // if the current is a comma, and the next is anything not a comma,
-            // then put the address of the next character in the array_pointers and increment
-            // the index
-            if (gps_raw_data[index + 1] != comma)
-            {
-                array_pointers[array_pointer_index++] = gps_raw_data + index + 1;
-            }
-            // replace the comma with a 0 zero so token is null terminate.
-            // this will handle multile commans and make sure all commas are set to zero
-            gps_raw_data[index] = 0;
-            // make sure we dont exceed the array of pointer size.
-            if (array_pointer_index >= ARRAY_SIZE)
-            {
-                break;
-            }
-        }
+    struct nmea_fields fields;
+    uint8_t index;
+    uint8_t number_of_tokens;
+    nmea_fields_start(&fields);
+    // one pass, the tokenizer replaces the commas with zeros, records where each field starts
+    // and works out the checksum as it goes.  field 0 starts at the $ so index 0 is skipped.
+    for (index = 1; gps_raw_data[index] != 0 && index < 255; index++)
+    {
+        gps_raw_data[index] = nmea_fields_feed(&fields, gps_raw_data[index], index);
+    }
+    if (!nmea_fields_valid(&fields))
+    {
+        return 0;
     }
-    // return the number of tokens that we have parsed, that is the array_pointer_index
-    return array_pointer_index;
+    // make sure we dont exceed the array of pointer size.
+    number_of_tokens = fields.count < ARRAY_SIZE ? fields.count : ARRAY_SIZE;
+    for (index = 0; index < number_of_tokens; index++)
+    {
+        array_pointers[index] = gps_raw_data + fields.offset[index];
+    }
+    return number_of_tokens;
 }
-void write_gps(const char *data, const u32 retrys)
-/**@brief this writes a data the gps serial port
- * 
- * @param data a pointer to the data to be written to the serial port
- * @param retrys the number of times to retry the command 
- * 
- * I would send the command atleast 4 times to make sure the gps module get the command
- * 
+bool gps_set_fix_interval(uint16_t milliseconds)
+/**@brief change how often the gps makes a fix, it sends one RMC sentence per fix
+ *
+ * The command goes on the gps link queue and is sent again until the gps acks it.
+ * gps_fix_interval only changes when it was queued, so the loop tries again on the next fix.
+ * @param milliseconds the fix interval, the MT3333 takes 100 to 10000
+ * @return false if the gps link queue was full
  */
 {
-  u32 index;
-  u32 retry_counter;
-  for (retry_counter = 0; retry_counter < retrys; retry_counter++)
+    const uint16_t interval[] = {milliseconds};
+    bool queued;
+    // the two intervals the report policy uses are in flash, anything else is built when sent
+    if (milliseconds == REPORT_DEFAULT_MOVING_FIX_INTERVAL)
     {
-        DEBUG_PRINTLN("Sending init data to gps");
-        DEBUG_PRINTLN(data);
-        for (index = 0; index < strlen(data); index++)
-        {
-            GPSSerial.write(data[index]);
-        }
+        queued = gps_link_send<pmtk_fix_interval<REPORT_DEFAULT_MOVING_FIX_INTERVAL>>(&gps_link);
+    }
+    else if (milliseconds == REPORT_DEFAULT_PARKED_FIX_INTERVAL)
+    {
+        queued = gps_link_send<pmtk_fix_interval<REPORT_DEFAULT_PARKED_FIX_INTERVAL>>(&gps_link);
+    }
+    else
+    {
+        queued = gps_link_send(&gps_link, 220, interval, 1);
+    }
+    if (!queued)
+    {
+        return false;
     }
+    gps_fix_interval = milliseconds;
+    LOG(LOG_FIX_INTERVAL, milliseconds);
+    return true;
 }
 u8 calculate_checksum(const char * sentence, u32 length)
 {
@@ -504,20 +1037,3 @@ u8 bin_to_hex(u8 value)
         return 'A' + (value -10);
 
 }
-void blink(byte PIN, byte DELAY_MS, byte loops) 
-/**@brief this function will tokenize a gps string
- * 
- * this program will blink the led on the Arduino
- * @param PIN  the Pin on the Arduino
- * @param DELAY_MS The delay in Milliseconds
- * @param loops the number of times to blink
- * @return None
- */
-{
-    for (byte i = 0; i < loops; i++)  {
-        digitalWrite(PIN, HIGH);
-        delay(DELAY_MS);
-        digitalWrite(PIN, LOW);
-        delay(DELAY_MS);
-    }
-}
@@ -0,0 +1,209 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  slot_scheduler.cpp
+    @author Ralph Blach
+    @brief The utc time base and the slot gate of the transmit queue.
+**/
+#include <Arduino.h>
+#include <slot_scheduler.h>
+
+#define FRAME_MICROS ((uint32_t)SLOT_FRAME_LENGTH * 1000)
+#define DAY_MS 86400000UL
+
+static_assert(DAY_MS % SLOT_FRAME_LENGTH == 0, "the slot frame has to divide a day");
+
+void slot_scheduler_init(struct slot_scheduler *scheduler, uint8_t slot, uint8_t slots)
+/**@brief start with no time base, the gate is open until the first utc time
+ *
+ * @param scheduler the scheduler
+ * @param slot this tracker's slot, it is taken modulo slots
+ * @param slots slots in a frame, at least 1
+ * @return Nothing
+ */
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->slots = slots != 0 ? slots : 1;
+    scheduler->slot = slot % scheduler->slots;
+}
+
+static uint32_t phase_at(const struct slot_scheduler *scheduler, uint32_t now)
+{
+    /**
+        @brief where in the frame a micros() time is, in us, by the local clock corrected for its rate
+    */
+    uint32_t elapsed = now - scheduler->sync_micros;
+    int32_t correction = (int32_t)(elapsed / 1000) * scheduler->ppm / 1000;
+    return ((scheduler->sync_phase * 1000) + (elapsed - correction)) % FRAME_MICROS;
+}
+
+static bool stale(const struct slot_scheduler *scheduler, uint32_t now)
+{
+    return !scheduler->synced || (uint32_t)(now - scheduler->sync_micros) > SLOT_HOLDOVER * 1000UL;
+}
+
+static void measure_rate(struct slot_scheduler *scheduler, uint32_t local, uint32_t utc)
+{
+    /**
+        @brief compare the local clock with utc since the anchor, once the span is long enough
+    */
+    uint32_t span = (utc + DAY_MS - scheduler->anchor_time) % DAY_MS;
+    int32_t ppm;
+    if (!scheduler->anchored || span > SLOT_HOLDOVER)
+    {
+        scheduler->anchor_micros = local;
+        scheduler->anchor_time = utc;
+        scheduler->anchored = true;
+        return;
+    }
+    if (span < SLOT_RATE_SPAN)
+    {
+        return;
+    }
+    ppm = (int32_t)(local - scheduler->anchor_micros - span * 1000) * 1000 / (int32_t)span;
+    if (ppm > SLOT_MAX_PPM)
+    {
+        ppm = SLOT_MAX_PPM;
+    }
+    else if (ppm < -SLOT_MAX_PPM)
+    {
+        ppm = -SLOT_MAX_PPM;
+    }
+    // each span has the jitter of two line feeds in it, average a few
+    scheduler->ppm = scheduler->rate_known ? scheduler->ppm + (ppm - scheduler->ppm) / 4 : ppm;
+    scheduler->rate_known = true;
+    scheduler->anchor_micros = local;
+    scheduler->anchor_time = utc;
+}
+
+void slot_scheduler_sync(struct slot_scheduler *scheduler, uint32_t time_of_day, uint32_t line_feed)
+/**@brief take the utc time of a valid fix
+ *
+ * @param scheduler the scheduler
+ * @param time_of_day the RMC time in 10 ms ticks, as in a position_fix
+ * @param line_feed micros() of the line feed of the RMC
+ * @return Nothing
+ */
+{
+    uint32_t utc = time_of_day * 10;
+    uint32_t local = line_feed - SLOT_GPS_DELAY * 1000UL;
+    int32_t error;
+    bool pps = false;
+
+    noInterrupts();
+    // the PPS edge is the start of the whole second the fix is for
+    if (scheduler->pps_seen && time_of_day % 100 == 0 && (uint32_t)(line_feed - scheduler->pps_micros) < 1000000UL)
+    {
+        local = scheduler->pps_micros;
+        pps = true;
+    }
+    scheduler->pps_seen = false;
+    interrupts();
+    if (!stale(scheduler, local))
+    {
+        error = (int32_t)((utc % SLOT_FRAME_LENGTH) * 1000 + FRAME_MICROS - phase_at(scheduler, local)) %
+                (int32_t)FRAME_MICROS;
+        if (error > (int32_t)FRAME_MICROS / 2)
+        {
+            error -= FRAME_MICROS;
+        }
+        scheduler->stats.last_error = error;
+        if ((uint32_t)labs(error) > scheduler->stats.worst_error)
+        {
+            scheduler->stats.worst_error = labs(error);
+        }
+    }
+    measure_rate(scheduler, local, utc);
+    scheduler->sync_micros = local;
+    scheduler->sync_phase = utc % SLOT_FRAME_LENGTH;
+    scheduler->synced = true;
+    scheduler->stats.syncs++;
+    if (pps)
+    {
+        scheduler->stats.pps_syncs++;
+    }
+}
+
+void slot_scheduler_pps(struct slot_scheduler *scheduler)
+/**@brief note a PPS edge, call it from the pin interrupt
+ *
+ * @param scheduler the scheduler
+ * @return Nothing
+ */
+{
+    scheduler->pps_micros = micros();
+    scheduler->pps_seen = true;
+}
+
+uint16_t slot_scheduler_wait(struct slot_scheduler *scheduler, uint16_t duration)
+/**@brief how long until this tracker may send
+ *
+ * @param scheduler the scheduler
+ * @param duration ms the frame and its ack need, a frame longer than the slot is sent at its start
+ * @return 0 if it may send now, else the ms until its slot starts
+ */
+{
+    uint32_t now = micros();
+    uint32_t length = FRAME_MICROS / scheduler->slots;
+    uint32_t start = scheduler->slot * length + SLOT_GUARD * 1000UL;
+    uint32_t end = (scheduler->slot + 1) * length - SLOT_GUARD * 1000UL;
+    uint32_t need = duration * 1000UL;
+    uint32_t phase;
+
+    if (stale(scheduler, now))
+    {
+        scheduler->synced = false;
+        return 0;
+    }
+    if (need > end - start)
+    {
+        need = end - start;
+    }
+    phase = phase_at(scheduler, now);
+    if (phase >= start && phase + need <= end)
+    {
+        return 0;
+    }
+    return (uint16_t)(((phase < start ? start - phase : start + FRAME_MICROS - phase) + 999) / 1000);
+}
+
+uint16_t slot_scheduler_gate(void *scheduler, uint16_t duration)
+/**@brief slot_scheduler_wait as a tx_queue gate
+ *
+ * @param scheduler the scheduler, the gate_context of the queue
+ * @param duration ms the frame and its ack need
+ * @return 0 to send now, else the ms to hold the frame
+ */
+{
+    return slot_scheduler_wait((struct slot_scheduler *)scheduler, duration);
+}
+
+void slot_scheduler_print(const struct slot_scheduler *scheduler, Print &out)
+/**@brief print the slot and the time base, for the slot console command
+ *
+ * @param scheduler the scheduler
+ * @param out where to print, Serial
+ * @return Nothing
+ */
+{
+    out.print(F("slot "));
+    out.print(scheduler->slot);
+    out.print(F(" of "));
+    out.print(scheduler->slots);
+    out.print(F(", "));
+    out.print(SLOT_FRAME_LENGTH / scheduler->slots);
+    out.println(scheduler->synced ? F(" ms, synced") : F(" ms, not synced, sending at any time"));
+    out.print(F("syncs "));
+    out.print(scheduler->stats.syncs);
+    out.print(F(" pps "));
+    out.print(scheduler->stats.pps_syncs);
+    out.print(F(" clock "));
+    out.print(scheduler->ppm);
+    out.println(F(" ppm"));
+    out.print(F("last correction "));
+    out.print(scheduler->stats.last_error);
+    out.print(F(" us, worst "));
+    out.print(scheduler->stats.worst_error);
+    out.println(F(" us"));
+}
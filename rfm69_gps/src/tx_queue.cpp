@@ -0,0 +1,370 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  tx_queue.cpp
+    @author Ralph Blach
+    @brief Non-blocking reliable delivery over the RadioHead driver.
+
+    The frames go out with the same header as RHReliableDatagram uses, to, from, a sequence
+    number in the id and the flags, and the ack we look for is the one recvfromAck sends back.
+    Retries carry RH_FLAGS_RETRY so a receiver doing explicit retry dedup drops the copies.
+**/
+#include <Arduino.h>
+#include <RadioHead.h>
+#include <tx_queue.h>
+
+#ifndef RH_FLAGS_RETRY
+#define RH_FLAGS_RETRY 0x40
+#endif
+
+/**
+    @brief room for the payload of an ack, RHReliableDatagram sends a single '!'
+    @param TX_ACK_BUFFER_SIZE
+*/
+#define TX_ACK_BUFFER_SIZE 4
+
+void tx_queue_init(struct tx_queue *queue, RHGenericDriver *driver, uint8_t this_address)
+/**@brief set up an empty queue
+ *
+ * @param queue the queue
+ * @param driver the radio driver, it must already have been initialized
+ * @param this_address our node address, the acks are addressed to it
+ * @return Nothing
+ */
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->driver = driver;
+    queue->this_address = this_address;
+    queue->retries = TX_QUEUE_DEFAULT_RETRIES;
+    queue->ack_timeout = TX_QUEUE_DEFAULT_ACK_TIMEOUT;
+    queue->backoff = TX_QUEUE_DEFAULT_BACKOFF;
+    queue->bit_rate = TX_QUEUE_DEFAULT_BIT_RATE;
+    queue->state = TX_STATE_IDLE;
+    queue->stats.latency_min = 0xffff;
+}
+
+void tx_queue_set_retries(struct tx_queue *queue, uint8_t retries, uint16_t ack_timeout, uint16_t backoff)
+/**@brief change the retry policy, takes effect with the next frame
+ *
+ * @param queue the queue
+ * @param retries resends after the first try, 0 sends each frame once
+ * @param ack_timeout how long to wait for an ack in milliseconds
+ * @param backoff the backoff step in milliseconds, retry n waits a random 0 to n * backoff
+ * @return Nothing
+ */
+{
+    queue->retries = retries;
+    queue->ack_timeout = ack_timeout;
+    queue->backoff = backoff;
+}
+
+uint8_t *tx_queue_reserve(struct tx_queue *queue)
+/**@brief get the payload buffer of the next free frame so a packet can be built in place
+ *
+ * Nothing is queued until tx_queue_commit is called.
+ * @param queue the queue
+ * @return a buffer of RH_RF69_MAX_MESSAGE_LEN bytes, or NULL if the queue is full
+ */
+{
+    if (queue->count >= TX_QUEUE_CAPACITY)
+    {
+        queue->stats.dropped++;
+        return NULL;
+    }
+    return queue->frames[(queue->head + queue->count) % TX_QUEUE_CAPACITY].data;
+}
+
+bool tx_queue_commit(struct tx_queue *queue, uint8_t length, uint8_t to)
+/**@brief queue the frame built in the buffer from tx_queue_reserve
+ *
+ * @param queue the queue
+ * @param length the payload length, 0 throws the frame away
+ * @param to the destination address
+ * @return true if the frame was queued
+ */
+{
+    return tx_queue_commit_from(queue, length, to, micros());
+}
+
+bool tx_queue_commit_from(struct tx_queue *queue, uint8_t length, uint8_t to, uint32_t origin)
+/**@brief queue the frame built in the buffer from tx_queue_reserve, and say when its data came in
+ *
+ * @param queue the queue
+ * @param length the payload length, 0 throws the frame away
+ * @param to the destination address
+ * @param origin micros() when the data was received, the on_complete callback gets it back in
+ *        the frame so the whole latency can be measured
+ * @return true if the frame was queued
+ */
+{
+    struct tx_frame *frame;
+    if (queue->count >= TX_QUEUE_CAPACITY || length == 0 || length > RH_RF69_MAX_MESSAGE_LEN)
+    {
+        return false;
+    }
+    frame = &queue->frames[(queue->head + queue->count) % TX_QUEUE_CAPACITY];
+    frame->to = to;
+    frame->length = length;
+    frame->committed = micros();
+    frame->origin = origin;
+    queue->count++;
+    queue->stats.queued++;
+    return true;
+}
+
+bool tx_queue_push(struct tx_queue *queue, const uint8_t *data, uint8_t length, uint8_t to)
+/**@brief copy a payload onto the queue
+ *
+ * @param queue the queue
+ * @param data the payload
+ * @param length the payload length
+ * @param to the destination address
+ * @return true if the frame was queued
+ */
+{
+    uint8_t *buffer;
+    if (length > RH_RF69_MAX_MESSAGE_LEN)
+    {
+        return false;
+    }
+    buffer = tx_queue_reserve(queue);
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    memcpy(buffer, data, length);
+    return tx_queue_commit(queue, length, to);
+}
+
+bool tx_queue_idle(const struct tx_queue *queue)
+/**@brief check if there is nothing to send or wait for
+ *
+ * @param queue the queue
+ * @return true if the queue is empty and nothing is on the air
+ */
+{
+    return queue->count == 0 && queue->state == TX_STATE_IDLE;
+}
+
+uint32_t tx_queue_airtime(const struct tx_queue *queue)
+/**@brief the time the frames and their acks have had the channel
+ *
+ * It is worked out from the lengths and the bit rate, the radio is not timed.
+ * @param queue the queue
+ * @return milliseconds on the air
+ */
+{
+    return queue->stats.air_bits / (queue->bit_rate / 1000);
+}
+
+static void start_wait(struct tx_queue *queue, uint8_t state, uint16_t length)
+{
+    queue->state = state;
+    queue->timer_start = millis();
+    queue->timer_length = length;
+}
+
+static bool wait_expired(const struct tx_queue *queue)
+{
+    return (uint32_t)(millis() - queue->timer_start) >= queue->timer_length;
+}
+
+static uint16_t exchange_time(const struct tx_queue *queue)
+{
+    /**
+        @brief ms on the air for the head frame and the one byte ack that answers it, rounded up
+    */
+    uint32_t bits = (2 * TX_QUEUE_FRAME_OVERHEAD + queue->frames[queue->head].length + 1) * 8UL;
+    return (uint16_t)((bits * 1000 + queue->bit_rate - 1) / queue->bit_rate);
+}
+
+static void start_send(struct tx_queue *queue)
+{
+    /**
+        @brief put the head frame on the air
+
+        RH_RF69::send only waits if a previous packet is still going out, and that cannot happen
+        here, so this returns as soon as the frame is in the radio fifo.
+    */
+    struct tx_frame *frame = &queue->frames[queue->head];
+    queue->driver->setHeaderTo(frame->to);
+    queue->driver->setHeaderFrom(queue->this_address);
+    queue->driver->setHeaderId(queue->sequence);
+    queue->driver->setHeaderFlags(queue->attempt ? RH_FLAGS_RETRY : RH_FLAGS_NONE, RH_FLAGS_ACK | RH_FLAGS_RETRY);
+    queue->attempt++;
+    queue->sent_at = millis();
+    if (queue->driver->send(frame->data, frame->length))
+    {
+        queue->stats.air_bits += (TX_QUEUE_FRAME_OVERHEAD + frame->length) * 8UL;
+        queue->state = TX_STATE_SENDING;
+    }
+    else
+    {
+        // the channel was busy, treat it like a missing ack
+        start_wait(queue, TX_STATE_WAIT_ACK, 0);
+    }
+}
+
+static bool ack_received(struct tx_queue *queue)
+{
+    /**
+        @brief look at what the radio received for the ack of the head frame
+
+        Anything that is not our ack is thrown away.
+
+        @return true if the ack arrived
+    */
+    uint8_t buffer[TX_ACK_BUFFER_SIZE];
+    uint8_t length;
+    struct tx_frame *frame = &queue->frames[queue->head];
+    while (queue->driver->available())
+    {
+        length = sizeof(buffer);
+        if (!queue->driver->recv(buffer, &length))
+        {
+            continue;
+        }
+        if ((queue->driver->headerFlags() & RH_FLAGS_ACK) && queue->driver->headerTo() == queue->this_address &&
+            queue->driver->headerFrom() == frame->to && queue->driver->headerId() == queue->sequence)
+        {
+            queue->stats.last_ack_rssi = queue->driver->lastRssi();
+            queue->stats.air_bits += (TX_QUEUE_FRAME_OVERHEAD + length) * 8UL;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void finish(struct tx_queue *queue, bool delivered)
+{
+    /**
+        @brief take the head frame off the queue and account for it
+    */
+    struct tx_frame *frame = &queue->frames[queue->head];
+    uint32_t latency = (uint32_t)(micros() - frame->committed) / 1000;
+    if (delivered)
+    {
+        queue->stats.delivered++;
+        queue->stats.latency_total += latency;
+        if (latency > 0xffff)
+        {
+            latency = 0xffff;
+        }
+        if (latency < queue->stats.latency_min)
+        {
+            queue->stats.latency_min = (uint16_t)latency;
+        }
+        if (latency > queue->stats.latency_max)
+        {
+            queue->stats.latency_max = (uint16_t)latency;
+        }
+    }
+    else
+    {
+        queue->stats.failed++;
+    }
+    if (queue->on_complete != NULL)
+    {
+        queue->on_complete(queue, frame, delivered, queue->attempt);
+    }
+    queue->head = (queue->head + 1) % TX_QUEUE_CAPACITY;
+    queue->count--;
+    queue->state = TX_STATE_IDLE;
+}
+
+void tx_queue_service(struct tx_queue *queue)
+{
+    /**
+        @brief run the transmit state machine, never waits
+
+        Call it from loop() as often as possible.  It keeps stepping while there is something
+        to do right now, and returns as soon as it would have to wait for the radio or a timer.
+
+        @param queue the queue
+        @return Nothing
+    */
+    while (true)
+    {
+        switch (queue->state)
+        {
+        case TX_STATE_IDLE:
+            if (queue->count == 0)
+            {
+                return;
+            }
+            queue->sequence++;
+            queue->attempt = 0;
+            start_wait(queue, TX_STATE_HOLD, 0);
+            break;
+        case TX_STATE_HOLD:
+            // the ack of the last try can still come in while a retry is held
+            if (queue->attempt != 0 && ack_received(queue))
+            {
+                finish(queue, true);
+                break;
+            }
+            if (!wait_expired(queue))
+            {
+                return;
+            }
+            if (queue->gate != NULL)
+            {
+                uint16_t hold = queue->gate(queue->gate_context, exchange_time(queue));
+                if (hold != 0)
+                {
+                    if (queue->timer_length == 0)
+                    {
+                        queue->stats.held++;
+                    }
+                    start_wait(queue, TX_STATE_HOLD, hold);
+                    return;
+                }
+            }
+            start_send(queue);
+            break;
+        case TX_STATE_SENDING:
+            // the driver leaves transmit mode by itself when the packet sent interrupt fires
+            if (queue->driver->mode() == RHGenericDriver::RHModeTx)
+            {
+                return;
+            }
+            if (queue->frames[queue->head].to == RH_BROADCAST_ADDRESS)
+            {
+                // nobody acks a broadcast
+                finish(queue, true);
+                break;
+            }
+            start_wait(queue, TX_STATE_WAIT_ACK, queue->ack_timeout);
+            break;
+        case TX_STATE_WAIT_ACK:
+        case TX_STATE_BACKOFF:
+            // an ack that was late is still good during the backoff
+            if (ack_received(queue))
+            {
+                finish(queue, true);
+                break;
+            }
+            if (!wait_expired(queue))
+            {
+                return;
+            }
+            if (queue->state == TX_STATE_BACKOFF)
+            {
+                start_wait(queue, TX_STATE_HOLD, 0);
+                break;
+            }
+            if (queue->attempt > queue->retries)
+            {
+                finish(queue, false);
+                break;
+            }
+            queue->stats.retries++;
+            start_wait(queue, TX_STATE_BACKOFF, (uint16_t)random((long)queue->backoff * queue->attempt + 1));
+            break;
+        default:
+            queue->state = TX_STATE_IDLE;
+            break;
+        }
+    }
+}
@@ -0,0 +1,298 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_base_station.cpp
+    @author Ralph Blach
+    @brief The RX lines, each payload the base station decodes, and the duplicates it drops.
+
+    pio test -e native_test -f test_base_station
+**/
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unity.h>
+#include <packet_builder.h>
+#include <link_adapter.h>
+#include "../../tools/base_station.h"
+
+/**
+    @brief the tracker the frames come from
+*/
+#define TEST_ADDRESS 2
+#define TEST_RSSI -67
+
+static struct position_fix fix;
+
+static void make_fix(uint32_t second, struct position_fix *made)
+{
+    /**
+        @brief a fix second seconds into the day at 35.7796 N 78.6382 W, going north
+    */
+    memset(made, 0, sizeof(*made));
+    memcpy(made->call_sign, "KD4XYZ", CALL_SIGN_LENGTH);
+    made->flags = POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID;
+    made->latitude = 357796000 + (int32_t)second * 462;
+    made->longitude = -786382000;
+    made->time_of_day = second * 100;
+    made->date = (26 << 9) | (10 << 5) | 16;
+    made->speed = 1000;
+}
+
+static void make_frame(uint8_t id, const uint8_t *data, uint8_t length, struct base_frame *frame)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->time = 81234;
+    frame->from = TEST_ADDRESS;
+    frame->id = id;
+    frame->rssi = TEST_RSSI;
+    frame->length = length;
+    memcpy(frame->data, data, length);
+}
+
+static std::string line_of(uint8_t id, const uint8_t *data, uint8_t length)
+{
+    /**
+        @brief the RX line the receiver prints for a payload
+    */
+    struct base_frame frame;
+    char line[36 + 2 * BASE_FRAME_MAX];
+    make_frame(id, data, length, &frame);
+    TEST_ASSERT_NOT_EQUAL(0, base_frame_format(&frame, line, sizeof(line)));
+    return line;
+}
+
+static std::string position_line(uint8_t id, uint32_t second)
+{
+    struct position_fix made;
+    uint8_t buffer[BASE_FRAME_MAX];
+    make_fix(second, &made);
+    return line_of(id, buffer, position_packet_encode(&made, buffer, sizeof(buffer)));
+}
+
+static uint8_t decode(const uint8_t *data, uint8_t length, std::vector<struct position_fix> &fixes)
+{
+    struct base_frame frame;
+    make_frame(1, data, length, &frame);
+    return base_frame_decode(&frame, fixes);
+}
+
+void setUp(void)
+{
+    make_fix(3600, &fix);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_line_round_trip(void)
+{
+    static const uint8_t payload[] = {0xB1, 0x00, 0x7f, 0xff};
+    struct base_frame frame;
+    std::string line = line_of(17, payload, sizeof(payload));
+    TEST_ASSERT_EQUAL_STRING("RX 81234 2 17 0 -67 B1007FFF\n", line.c_str());
+    // the receiver may end its lines with a carriage return too
+    line.insert(line.size() - 1, "\r");
+    TEST_ASSERT_TRUE(base_frame_parse(line.data(), line.size(), &frame));
+    TEST_ASSERT_EQUAL_UINT32(81234, frame.time);
+    TEST_ASSERT_EQUAL_UINT8(TEST_ADDRESS, frame.from);
+    TEST_ASSERT_EQUAL_UINT8(17, frame.id);
+    TEST_ASSERT_EQUAL_INT16(TEST_RSSI, frame.rssi);
+    TEST_ASSERT_EQUAL_UINT8(sizeof(payload), frame.length);
+    TEST_ASSERT_EQUAL_MEMORY(payload, frame.data, sizeof(payload));
+}
+
+static void test_bad_lines(void)
+{
+    static const char *const lines[] = {
+        "rx 81234 2 17 0 -67 B1",  "RX 81234 256 17 0 -67 B1", "RX 81234 2 17 0 -67 B10",
+        "RX 81234 2 17 0 -67 B1G0", "RX 81234 2 17 0",          "RX -1 2 17 0 -67 B1",
+    };
+    struct base_frame frame;
+    for (uint8_t index = 0; index < sizeof(lines) / sizeof(lines[0]); index++)
+    {
+        TEST_ASSERT_FALSE(base_frame_parse(lines[index], strlen(lines[index]), &frame));
+    }
+}
+
+static void test_ascii(void)
+{
+    static const char with_fix[] = "KD4XYZ,123519.00,A,3546.776,N,07838.292,W,161026";
+    static const char without_fix[] = "KD4XYZ,V,";
+    std::vector<struct position_fix> fixes;
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_ASCII, decode((const uint8_t *)with_fix, strlen(with_fix), fixes));
+    TEST_ASSERT_EQUAL_UINT32(1, fixes.size());
+    TEST_ASSERT_EQUAL_MEMORY("KD4XYZ", fixes[0].call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_INT32(357796000, fixes[0].latitude);
+    TEST_ASSERT_EQUAL_INT32(-786382000, fixes[0].longitude);
+    TEST_ASSERT_EQUAL_UINT32(12 * 360000 + 35 * 6000 + 1900, fixes[0].time_of_day);
+    TEST_ASSERT_EQUAL_UINT16(fix.date, fixes[0].date);
+    // it is still a legacy packet, it only has no position
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_ASCII, decode((const uint8_t *)without_fix, strlen(without_fix), fixes));
+    TEST_ASSERT_EQUAL_UINT32(1, fixes.size());
+}
+
+static void test_position(void)
+{
+    uint8_t buffer[BASE_FRAME_MAX];
+    uint8_t length = position_packet_encode(&fix, buffer, sizeof(buffer));
+    std::vector<struct position_fix> fixes;
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_POSITION, decode(buffer, length, fixes));
+    TEST_ASSERT_EQUAL_UINT32(1, fixes.size());
+    TEST_ASSERT_EQUAL_INT32(fix.latitude, fixes[0].latitude);
+    TEST_ASSERT_EQUAL_UINT32(fix.time_of_day, fixes[0].time_of_day);
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_UNKNOWN, decode(buffer, length - 1, fixes));
+    TEST_ASSERT_EQUAL_UINT32(1, fixes.size());
+}
+
+static void test_history(void)
+{
+    uint8_t records[3][POSITION_RECORD_LENGTH];
+    uint8_t buffer[BASE_FRAME_MAX];
+    struct position_fix made;
+    uint8_t length;
+    std::vector<struct position_fix> fixes;
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        make_fix(3600 + index, &made);
+        position_record_pack(&made, records[index]);
+    }
+    length = position_history_encode("KD4XYZ", records[0], 3, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_HISTORY, decode(buffer, length, fixes));
+    TEST_ASSERT_EQUAL_UINT32(3, fixes.size());
+    TEST_ASSERT_EQUAL_UINT32(360200, fixes[2].time_of_day);
+}
+
+static void test_batch(void)
+{
+    struct position_fix fixes[3];
+    uint8_t buffer[BASE_FRAME_MAX];
+    struct packet_builder builder;
+    std::vector<struct position_fix> decoded;
+    make_fix(3600, &fixes[0]);
+    packet_builder_start(&builder, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(position_batch_start(&builder, "KD4XYZ", &fixes[0]));
+    for (uint8_t index = 1; index < 3; index++)
+    {
+        make_fix(3600 + index, &fixes[index]);
+        TEST_ASSERT_TRUE(position_batch_append(&builder, &fixes[index - 1], &fixes[index]));
+    }
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_BATCH, decode(buffer, packet_builder_finish(&builder), decoded));
+    TEST_ASSERT_EQUAL_UINT32(3, decoded.size());
+    TEST_ASSERT_EQUAL_INT32(fixes[2].latitude, decoded[2].latitude);
+    TEST_ASSERT_EQUAL_UINT32(fixes[2].time_of_day, decoded[2].time_of_day);
+}
+
+static void test_link_telemetry_and_unknown(void)
+{
+    uint8_t link[LINK_PROFILE_LENGTH] = {LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION, 5};
+    uint8_t telemetry[LATENCY_TELEMETRY_LENGTH] = {LATENCY_TELEMETRY_MAGIC | LATENCY_TELEMETRY_VERSION};
+    uint8_t other[] = {0x90, 0x01};
+    std::vector<struct position_fix> fixes;
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_LINK, decode(link, sizeof(link), fixes));
+    link[1] = LINK_PROFILE_COUNT;
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_UNKNOWN, decode(link, sizeof(link), fixes));
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_TELEMETRY, decode(telemetry, sizeof(telemetry), fixes));
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_UNKNOWN, decode(telemetry, sizeof(telemetry) - 1, fixes));
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_UNKNOWN, decode(other, sizeof(other), fixes));
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_UNKNOWN, decode(other, 0, fixes));
+    TEST_ASSERT_EQUAL_UINT32(0, fixes.size());
+}
+
+static void test_duplicates(void)
+{
+    uint8_t records[2][POSITION_RECORD_LENGTH];
+    uint8_t buffer[BASE_FRAME_MAX];
+    struct position_fix made;
+    std::string text;
+    unsigned called = 0;
+    base_station station(0, [&called](const struct base_node &node, const struct base_fix &entry) { called++; });
+
+    text += "rfm69_gps ready\n";
+    text += position_line(5, 3600);
+    // the ack was lost and the same frame comes again
+    text += position_line(5, 3600);
+    text += "RX 81234 2 6 0 -67 B1G0\n";
+    // the fix store sends 3600 again with one that was never heard
+    make_fix(3600, &made);
+    position_record_pack(&made, records[0]);
+    make_fix(3590, &made);
+    position_record_pack(&made, records[1]);
+    text += line_of(7, buffer, position_history_encode("KD4XYZ", records[0], 2, buffer, sizeof(buffer)));
+    station.feed(text.data(), text.size());
+    station.finish();
+
+    TEST_ASSERT_EQUAL_UINT64(5, station.stats.lines);
+    TEST_ASSERT_EQUAL_UINT64(1, station.stats.text);
+    TEST_ASSERT_EQUAL_UINT64(1, station.stats.bad);
+    TEST_ASSERT_EQUAL_UINT64(3, station.stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(1, station.stats.duplicate_frames);
+    TEST_ASSERT_EQUAL_UINT64(1, station.stats.duplicate_fixes);
+    TEST_ASSERT_EQUAL_UINT64(2, station.stats.fixes);
+    TEST_ASSERT_EQUAL_UINT32(2, called);
+    const struct base_node &node = station.nodes[TEST_ADDRESS];
+    TEST_ASSERT_EQUAL_STRING("KD4XYZ", node.call_sign);
+    TEST_ASSERT_EQUAL_UINT32(1, node.backfilled);
+    TEST_ASSERT_EQUAL_UINT32(2, node.track.size());
+    TEST_ASSERT_EQUAL_UINT8(BASE_KIND_HISTORY, node.track[1].kind);
+    TEST_ASSERT_EQUAL_UINT32(359000, node.track[1].fix.time_of_day);
+}
+
+static void test_threads_agree(void)
+{
+    // several batches of frames from a few trackers, with some sent twice
+    std::string text;
+    for (uint32_t index = 0; text.size() < 4 * BASE_BATCH_BYTES; index++)
+    {
+        std::string line = position_line((uint8_t)index, index / 4);
+        line.replace(line.find(" 2 "), 3, " " + std::to_string(2 + index % 4) + " ");
+        text += line;
+        if (index % 7 == 0)
+        {
+            text += line;
+        }
+    }
+    base_station single(0);
+    base_station threaded(4);
+    // in pieces that do not end on a line
+    for (size_t offset = 0; offset < text.size(); offset += 1000)
+    {
+        single.feed(text.data() + offset, std::min((size_t)1000, text.size() - offset));
+        threaded.feed(text.data() + offset, std::min((size_t)1000, text.size() - offset));
+    }
+    single.finish();
+    threaded.finish();
+    TEST_ASSERT_EQUAL_UINT64(0, single.stats.bad);
+    TEST_ASSERT_TRUE(single.stats.duplicate_frames > 0);
+    TEST_ASSERT_EQUAL_UINT64(single.stats.lines, threaded.stats.lines);
+    TEST_ASSERT_EQUAL_UINT64(single.stats.duplicate_frames, threaded.stats.duplicate_frames);
+    TEST_ASSERT_EQUAL_UINT64(single.stats.fixes, threaded.stats.fixes);
+    TEST_ASSERT_EQUAL_UINT32(4, threaded.nodes.size());
+    for (uint8_t address = 2; address < 6; address++)
+    {
+        const std::vector<struct base_fix> &expected = single.nodes[address].track;
+        const std::vector<struct base_fix> &actual = threaded.nodes[address].track;
+        TEST_ASSERT_EQUAL_UINT32(expected.size(), actual.size());
+        for (size_t index = 0; index < expected.size(); index++)
+        {
+            TEST_ASSERT_EQUAL_UINT32(expected[index].fix.time_of_day, actual[index].fix.time_of_day);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_line_round_trip);
+    RUN_TEST(test_bad_lines);
+    RUN_TEST(test_ascii);
+    RUN_TEST(test_position);
+    RUN_TEST(test_history);
+    RUN_TEST(test_batch);
+    RUN_TEST(test_link_telemetry_and_unknown);
+    RUN_TEST(test_duplicates);
+    RUN_TEST(test_threads_agree);
+    return UNITY_END();
+}
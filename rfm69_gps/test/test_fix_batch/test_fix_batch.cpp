@@ -0,0 +1,200 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_fix_batch.cpp
+    @author Ralph Blach
+    @brief The batch packet round trip, and when fix_batch queues a batch.
+
+    pio test -e native_test -f test_fix_batch
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <RH_RF69.h>
+#include <packet_builder.h>
+#include <fix_batch.h>
+#include <tx_queue.h>
+
+/**
+    @brief the batches
+*/
+#define TEST_FIXES 4           /*!< fixes in a full batch */
+#define TEST_MAX_LATENCY 5000  /*!< ms the first fix of a batch may wait */
+
+extern RH_RF69 rf69;
+
+static struct fix_batch batch;
+static struct tx_queue queue;
+
+static void make_fix(uint32_t second, struct position_fix *fix)
+{
+    /**
+        @brief a fix a second going south west, slowing down
+    */
+    memset(fix, 0, sizeof(*fix));
+    memcpy(fix->call_sign, "KD4XYZ", CALL_SIGN_LENGTH);
+    fix->flags = POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID;
+    fix->latitude = 357796000 - (int32_t)second * 1234;
+    fix->longitude = -786382000 - (int32_t)second * 2345;
+    fix->time_of_day = 5000000 + second * 100;
+    fix->date = (26 << 9) | (10 << 5) | 16;
+    fix->speed = (uint16_t)(6000 - second * 7);
+    fix->course = 22500;
+}
+
+static uint8_t decode_all(const uint8_t *buffer, uint8_t length, struct position_fix *fixes, uint8_t size)
+{
+    struct position_batch_reader reader;
+    uint8_t count = 0;
+    if (!position_batch_first(&reader, buffer, length, &fixes[0]))
+    {
+        return 0;
+    }
+    for (count = 1; count < size; count++)
+    {
+        fixes[count] = fixes[count - 1];
+        if (!position_batch_next(&reader, &fixes[count]))
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+void setUp(void)
+{
+    native_set_micros(10000000);
+    tx_queue_init(&queue, &rf69, 2);
+    fix_batch_init(&batch, TEST_FIXES, TEST_MAX_LATENCY);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_round_trip(void)
+{
+    uint8_t buffer[RH_RF69_MAX_MESSAGE_LEN];
+    struct packet_builder builder;
+    struct position_fix fixes[8];
+    struct position_fix decoded[8];
+    uint8_t count = 1;
+    uint8_t length;
+
+    make_fix(0, &fixes[0]);
+    packet_builder_start(&builder, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(position_batch_start(&builder, "KD4XYZ", &fixes[0]));
+    // a jump the wrong way round the globe, whose change of longitude does not fit an int32_t,
+    // one across the equator and a speed that wraps, the changes still round trip
+    for (; count < 8; count++)
+    {
+        make_fix(count, &fixes[count]);
+        if (count == 2)
+        {
+            fixes[count].longitude = 1799999999;
+        }
+        if (count == 3)
+        {
+            fixes[count].latitude = -fixes[count].latitude;
+            fixes[count].longitude = 1799999999;
+            fixes[count].speed = 0;
+            fixes[count].flags = POSITION_FLAG_VALID;
+        }
+        if (!position_batch_append(&builder, &fixes[count - 1], &fixes[count]))
+        {
+            break;
+        }
+    }
+    length = packet_builder_finish(&builder);
+    TEST_ASSERT_TRUE(count >= 4);
+    TEST_ASSERT_EQUAL_HEX8(POSITION_BATCH_MAGIC | POSITION_BATCH_VERSION, buffer[0]);
+    TEST_ASSERT_EQUAL_UINT8(count, buffer[POSITION_BATCH_COUNT]);
+    TEST_ASSERT_EQUAL_UINT8(count, decode_all(buffer, length, decoded, 8));
+    for (uint8_t index = 0; index < count; index++)
+    {
+        TEST_ASSERT_EQUAL_MEMORY(&fixes[index], &decoded[index], sizeof(decoded[index]));
+    }
+    // cut short, the fixes that are whole still decode
+    TEST_ASSERT_EQUAL_UINT8(count - 1, decode_all(buffer, length - 1, decoded, 8));
+}
+
+static void test_append_refused(void)
+{
+    uint8_t buffer[RH_RF69_MAX_MESSAGE_LEN];
+    struct packet_builder builder;
+    struct position_fix first;
+    struct position_fix fix;
+
+    make_fix(10, &first);
+    packet_builder_start(&builder, buffer, sizeof(buffer));
+    position_batch_start(&builder, "KD4XYZ", &first);
+    make_fix(9, &fix);
+    TEST_ASSERT_FALSE(position_batch_append(&builder, &first, &fix));
+    make_fix(11, &fix);
+    fix.date++;
+    TEST_ASSERT_FALSE(position_batch_append(&builder, &first, &fix));
+    TEST_ASSERT_EQUAL_UINT8(1, buffer[POSITION_BATCH_COUNT]);
+    TEST_ASSERT_EQUAL_UINT8(POSITION_BATCH_HEADER + POSITION_HISTORY_ENTRY, packet_builder_finish(&builder));
+    // the count is at a fixed place in the buffer, a packet after something else is refused
+    packet_builder_start(&builder, buffer, sizeof(buffer));
+    packet_builder_append_char(&builder, 0);
+    TEST_ASSERT_FALSE(position_batch_start(&builder, "KD4XYZ", &first));
+}
+
+static void test_full_batch_queued(void)
+{
+    struct position_fix fix;
+    struct position_fix decoded[TEST_FIXES];
+    const struct tx_frame *frame;
+    for (uint32_t second = 0; second < TEST_FIXES; second++)
+    {
+        make_fix(second, &fix);
+        TEST_ASSERT_TRUE(fix_batch_add(&batch, &queue, "KD4XYZ", &fix, 1, micros()));
+        TEST_ASSERT_EQUAL_UINT8(second + 1 == TEST_FIXES ? 1 : 0, queue.count);
+    }
+    frame = &queue.frames[queue.head];
+    TEST_ASSERT_EQUAL_UINT8(1, frame->to);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FIXES, decode_all(frame->data, frame->length, decoded, TEST_FIXES));
+    TEST_ASSERT_EQUAL_INT32(fix.latitude, decoded[TEST_FIXES - 1].latitude);
+    TEST_ASSERT_EQUAL_UINT16(1, batch.stats.full);
+    TEST_ASSERT_EQUAL_UINT8(0, batch.count);
+}
+
+static void test_new_date_closes(void)
+{
+    struct position_fix fix;
+    make_fix(0, &fix);
+    fix_batch_add(&batch, &queue, "KD4XYZ", &fix, 1, micros());
+    make_fix(1, &fix);
+    fix.date++;
+    fix_batch_add(&batch, &queue, "KD4XYZ", &fix, 1, micros());
+    TEST_ASSERT_EQUAL_UINT8(1, queue.count);
+    TEST_ASSERT_EQUAL_UINT16(1, batch.stats.closed);
+    TEST_ASSERT_EQUAL_UINT8(1, batch.count);
+}
+
+static void test_timed_out(void)
+{
+    struct position_fix fix;
+    make_fix(0, &fix);
+    fix_batch_add(&batch, &queue, "KD4XYZ", &fix, 1, micros());
+    native_advance_micros((TEST_MAX_LATENCY - 1) * 1000UL);
+    fix_batch_service(&batch, &queue);
+    TEST_ASSERT_EQUAL_UINT8(0, queue.count);
+    native_advance_micros(1000);
+    fix_batch_service(&batch, &queue);
+    TEST_ASSERT_EQUAL_UINT8(1, queue.count);
+    TEST_ASSERT_EQUAL_UINT16(1, batch.stats.timed_out);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_append_refused);
+    RUN_TEST(test_full_batch_queued);
+    RUN_TEST(test_new_date_closes);
+    RUN_TEST(test_timed_out);
+    return UNITY_END();
+}
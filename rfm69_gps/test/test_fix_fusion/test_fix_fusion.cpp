@@ -0,0 +1,213 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_fix_fusion.cpp
+    @author Ralph Blach
+    @brief The epochs fix_fusion puts together, the GGA and GSA fields it decodes and the
+    sentence slots it holds.
+
+    pio test -e native_test -f test_fix_fusion
+**/
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <Arduino.h>
+#include <gps_ingest.h>
+#include <fix_fusion.h>
+#include "nmea_corpus.h"
+
+/**
+    @brief feeding the uart
+*/
+#define TEST_CHUNK 32 /*!< bytes fed between services, less than the ring */
+
+static struct fix_fusion fusion;
+static struct gps_ingest_stats before;
+
+static void add(const char *body)
+{
+    /**
+        @brief send one sentence through gps_ingest and give it to the fusion
+    */
+    std::string bytes = nmea_with_checksum(body) + "\r\n";
+    struct gps_sentence *sentence;
+    for (size_t offset = 0; offset < bytes.size(); offset += TEST_CHUNK)
+    {
+        Serial1.native_feed((const uint8_t *)bytes.data() + offset,
+                            bytes.size() - offset < TEST_CHUNK ? bytes.size() - offset : TEST_CHUNK);
+        gps_ingest_service();
+    }
+    sentence = gps_ingest_next();
+    TEST_ASSERT_NOT_NULL(sentence);
+    fix_fusion_add(&fusion, sentence);
+}
+
+static void add_epoch(uint8_t second)
+{
+    char body[96];
+    snprintf(body, sizeof(body), "GPGGA,1405%02u.000,3546.7760,N,07838.2920,W,1,09,0.92,-3.7,M,-33.7,M,,", second);
+    add(body);
+    add("GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79");
+    snprintf(body, sizeof(body), "GPRMC,1405%02u.000,A,3546.7760,N,07838.2920,W,0.51,193.93,171210,,,A", second);
+    add(body);
+}
+
+static uint8_t slots_held(void)
+{
+    /**
+        @brief how many slots are not free, every one that can be filled is filled and counted
+    */
+    struct gps_sentence *taken[GPS_SENTENCE_SLOTS];
+    uint8_t free_slots = 0;
+    std::string bytes = nmea_with_checksum("GPTXT,01,01,02,X") + "\r\n";
+    while (free_slots < GPS_SENTENCE_SLOTS)
+    {
+        Serial1.native_feed((const uint8_t *)bytes.data(), bytes.size());
+        gps_ingest_service();
+        if ((taken[free_slots] = gps_ingest_next()) == NULL)
+        {
+            break;
+        }
+        free_slots++;
+    }
+    for (uint8_t index = 0; index < free_slots; index++)
+    {
+        gps_ingest_release(taken[index]);
+    }
+    return GPS_SENTENCE_SLOTS - free_slots;
+}
+
+void setUp(void)
+{
+    gps_ingest_begin(9600);
+    Serial1.native_clear();
+    fix_fusion_init(&fusion, FIX_HAVE_GGA | FIX_HAVE_GSA);
+    gps_ingest_get_stats(&before);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_epoch_decoded(void)
+{
+    struct fix_epoch *epoch;
+    struct position_fix fix;
+    add_epoch(0);
+    epoch = fix_fusion_next(&fusion);
+    TEST_ASSERT_NOT_NULL(epoch);
+    TEST_ASSERT_EQUAL_HEX8(FIX_HAVE_RMC | FIX_HAVE_GGA | FIX_HAVE_GSA, epoch->present);
+    TEST_ASSERT_EQUAL_UINT32((14 * 60UL + 5) * 6000, epoch->time_of_day);
+    TEST_ASSERT_NOT_NULL(epoch->sentences[FIX_RMC]);
+    TEST_ASSERT_NULL(epoch->sentences[FIX_GGA]);
+    TEST_ASSERT_NULL(epoch->sentences[FIX_GSA]);
+    memset(&fix, 0, sizeof(fix));
+    fix.flags = POSITION_FLAG_VALID;
+    fix_epoch_quality(epoch, &fix);
+    TEST_ASSERT_EQUAL_HEX8(POSITION_FLAG_VALID | POSITION_FLAG_ALTITUDE_VALID | POSITION_FLAG_DOP_VALID, fix.flags);
+    TEST_ASSERT_EQUAL_INT32(-37, fix.altitude);
+    TEST_ASSERT_EQUAL_UINT8(9, fix.satellites);
+    TEST_ASSERT_EQUAL_UINT16(92, fix.hdop);
+    TEST_ASSERT_EQUAL_UINT8(3, epoch->fix_type);
+    // the finished epoch waits in the slot of its RMC alone
+    TEST_ASSERT_EQUAL_UINT8(1, slots_held());
+    fix_fusion_release(epoch);
+    TEST_ASSERT_EQUAL_UINT8(0, slots_held());
+}
+
+static void test_waiting_epoch_and_full_current(void)
+{
+    /**
+        @brief the loop leaves a finished epoch waiting while the next one is gathered in full,
+        no sentence may be lost for a slot
+    */
+    struct gps_ingest_stats after;
+    struct fix_epoch *epoch;
+    add_epoch(0);
+    add_epoch(1);
+    TEST_ASSERT_EQUAL_UINT8(FIX_SENTENCE_COUNT + 1, slots_held());
+    // slots_held fills every slot there is, count from here
+    gps_ingest_get_stats(&before);
+    add_epoch(2);
+    gps_ingest_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT16(before.dropped_sentences, after.dropped_sentences);
+    TEST_ASSERT_EQUAL_UINT16(1, fusion.stats.dropped);
+    epoch = fix_fusion_next(&fusion);
+    TEST_ASSERT_NOT_NULL(epoch);
+    TEST_ASSERT_EQUAL_UINT32((14 * 60UL + 5) * 6000 + 100, epoch->time_of_day);
+    fix_fusion_release(epoch);
+    epoch = fix_fusion_next(&fusion);
+    TEST_ASSERT_NOT_NULL(epoch);
+    TEST_ASSERT_EQUAL_UINT32((14 * 60UL + 5) * 6000 + 200, epoch->time_of_day);
+    fix_fusion_release(epoch);
+    TEST_ASSERT_EQUAL_UINT8(0, slots_held());
+}
+
+static void test_two_dimensional_fix(void)
+{
+    struct fix_epoch *epoch;
+    struct position_fix fix;
+    add("GPGGA,140500.000,3546.7760,N,07838.2920,W,1,03,,96.3,M,-33.7,M,,");
+    add("GPGSA,A,2,10,13,15,,,,,,,,,,2.50,1.80,1.70");
+    add("GPRMC,140500.000,A,3546.7760,N,07838.2920,W,0.51,193.93,171210,,,A");
+    epoch = fix_fusion_next(&fusion);
+    TEST_ASSERT_NOT_NULL(epoch);
+    memset(&fix, 0, sizeof(fix));
+    fix.flags = POSITION_FLAG_VALID;
+    fix_epoch_quality(epoch, &fix);
+    // no altitude from a 2D fix, and the hdop comes from the GSA when the GGA has none
+    TEST_ASSERT_EQUAL_HEX8(POSITION_FLAG_VALID | POSITION_FLAG_DOP_VALID, fix.flags);
+    TEST_ASSERT_EQUAL_UINT8(2, epoch->fix_type);
+    TEST_ASSERT_EQUAL_UINT16(180, fix.hdop);
+    fix_fusion_release(epoch);
+}
+
+static void test_missing_gga(void)
+{
+    /**
+        @brief a gps that stops sending the GGA costs one epoch, then the fusion stops waiting
+        for it
+    */
+    struct fix_epoch *epoch;
+    add("GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79");
+    add("GPRMC,140500.000,A,3546.7760,N,07838.2920,W,0.51,193.93,171210,,,A");
+    TEST_ASSERT_NULL(fix_fusion_next(&fusion));
+    add("GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79");
+    add("GPRMC,140501.000,A,3546.7760,N,07838.2920,W,0.51,193.93,171210,,,A");
+    epoch = fix_fusion_next(&fusion);
+    TEST_ASSERT_NOT_NULL(epoch);
+    TEST_ASSERT_EQUAL_UINT16(1, fusion.stats.partial);
+    TEST_ASSERT_EQUAL_HEX8(FIX_HAVE_RMC | FIX_HAVE_GSA, epoch->present);
+    TEST_ASSERT_EQUAL_HEX8(FIX_HAVE_RMC | FIX_HAVE_GSA, fusion.expected);
+    fix_fusion_release(epoch);
+    add("GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79");
+    add("GPRMC,140502.000,A,3546.7760,N,07838.2920,W,0.51,193.93,171210,,,A");
+    epoch = fix_fusion_next(&fusion);
+    TEST_ASSERT_NOT_NULL(epoch);
+    TEST_ASSERT_EQUAL_UINT32((14 * 60UL + 5) * 6000 + 100, epoch->time_of_day);
+    fix_fusion_release(epoch);
+    TEST_ASSERT_EQUAL_UINT16(1, fusion.stats.partial);
+    TEST_ASSERT_EQUAL_UINT8(1, slots_held());
+}
+
+static void test_no_rmc(void)
+{
+    add("GPGGA,140500.000,3546.7760,N,07838.2920,W,1,09,0.92,96.3,M,-33.7,M,,");
+    add("GPGGA,140501.000,3546.7760,N,07838.2920,W,1,09,0.92,96.3,M,-33.7,M,,");
+    TEST_ASSERT_NULL(fix_fusion_next(&fusion));
+    TEST_ASSERT_EQUAL_UINT16(1, fusion.stats.no_rmc);
+    TEST_ASSERT_EQUAL_UINT8(1, slots_held());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_epoch_decoded);
+    RUN_TEST(test_waiting_epoch_and_full_current);
+    RUN_TEST(test_two_dimensional_fix);
+    RUN_TEST(test_missing_gga);
+    RUN_TEST(test_no_rmc);
+    return UNITY_END();
+}
@@ -0,0 +1,214 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_fix_store.cpp
+    @author Ralph Blach
+    @brief The history packet round trip, and the fixes fix_store keeps in the eeprom ring
+    across a reboot and sends back oldest first.
+
+    pio test -e native_test -f test_fix_store
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <RH_RF69.h>
+#include <fix_store.h>
+#include <tx_queue.h>
+
+/**
+    @brief the date of every fix
+*/
+#define TEST_DATE ((26 << 9) | (10 << 5) | 16)
+
+extern RH_RF69 rf69;
+
+static struct fix_store store;
+static struct tx_queue queue;
+
+static void make_fix(int32_t number, struct position_fix *fix)
+{
+    memset(fix, 0, sizeof(*fix));
+    memcpy(fix->call_sign, "KD4XYZ", CALL_SIGN_LENGTH);
+    fix->flags = POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID;
+    fix->latitude = -350000000 + number;
+    fix->longitude = 780000000 - number;
+    fix->time_of_day = 5000000 + number * 100;
+    fix->date = TEST_DATE;
+    fix->speed = (uint16_t)number;
+}
+
+static void not_acked(int32_t number)
+{
+    /**
+        @brief a position packet the queue gave up on, then the eeprom writes it starts
+    */
+    struct tx_frame frame;
+    struct position_fix fix;
+    make_fix(number, &fix);
+    frame.length = position_packet_encode(&fix, frame.data, sizeof(frame.data));
+    fix_store_complete(&store, &frame, false);
+    for (uint8_t pass = 0; pass < 2 * FIX_STORE_SLOT_SIZE; pass++)
+    {
+        fix_store_service(&store);
+    }
+}
+
+static void acked(void)
+{
+    /**
+        @brief a live packet is acked, the base station is answering again
+    */
+    struct tx_frame frame;
+    struct position_fix fix;
+    make_fix(-1, &fix);
+    frame.length = position_packet_encode(&fix, frame.data, sizeof(frame.data));
+    fix_store_complete(&store, &frame, true);
+}
+
+static int32_t backfill(uint8_t *count)
+{
+    /**
+        @brief queue a history packet and ack it
+
+        @param count set to the number of fixes in it
+        @return the number of the oldest fix in it
+    */
+    struct position_fix fix;
+    const struct tx_frame *frame;
+    native_advance_micros(FIX_STORE_BACKFILL_INTERVAL * 1000UL);
+    TEST_ASSERT_TRUE(fix_store_backfill(&store, &queue, "KD4XYZ", 1));
+    frame = &queue.frames[queue.head];
+    *count = position_history_count(frame->data, frame->length);
+    TEST_ASSERT_TRUE(position_history_decode(frame->data, frame->length, 0, &fix));
+    fix_store_complete(&store, frame, true);
+    queue.count = 0;
+    return fix.latitude + 350000000;
+}
+
+void setUp(void)
+{
+    for (uint16_t address = 0; address < EEPROM.length(); address++)
+    {
+        EEPROM.update(address, 0xff);
+    }
+    native_set_micros(10000000);
+    tx_queue_init(&queue, &rf69, 2);
+    fix_store_begin(&store);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_history_round_trip(void)
+{
+    uint8_t records[3][POSITION_RECORD_LENGTH];
+    uint8_t buffer[RH_RF69_MAX_MESSAGE_LEN];
+    struct position_fix fixes[3];
+    struct position_fix decoded;
+    uint8_t length;
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        make_fix(index * 1000, &fixes[index]);
+        position_record_pack(&fixes[index], records[index]);
+    }
+    length = position_history_encode("KD4XYZ", records[0], 3, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_UINT8(POSITION_HISTORY_HEADER + 3 * POSITION_HISTORY_ENTRY, length);
+    TEST_ASSERT_EQUAL_UINT8(3, position_history_count(buffer, length));
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        TEST_ASSERT_TRUE(position_history_decode(buffer, length, index, &decoded));
+        TEST_ASSERT_EQUAL_MEMORY(&fixes[index], &decoded, sizeof(decoded));
+    }
+    TEST_ASSERT_FALSE(position_history_decode(buffer, length, 3, &decoded));
+    // a packet cut short or of another kind has no fixes
+    TEST_ASSERT_EQUAL_UINT8(0, position_history_count(buffer, length - 1));
+    buffer[0] = POSITION_PACKET_MAGIC | POSITION_PACKET_VERSION;
+    TEST_ASSERT_EQUAL_UINT8(0, position_history_count(buffer, length));
+    TEST_ASSERT_EQUAL_UINT8(0, position_history_encode("KD4XYZ", records[0], 3, buffer, length - 1));
+}
+
+static void test_acked_not_stored(void)
+{
+    struct tx_frame frame;
+    struct position_fix fix;
+    make_fix(1, &fix);
+    frame.length = position_packet_encode(&fix, frame.data, sizeof(frame.data));
+    fix_store_complete(&store, &frame, true);
+    TEST_ASSERT_EQUAL_UINT16(0, fix_store_waiting(&store));
+    // nor is a report of no fix
+    fix.flags = 0;
+    frame.length = position_packet_encode(&fix, frame.data, sizeof(frame.data));
+    fix_store_complete(&store, &frame, false);
+    TEST_ASSERT_EQUAL_UINT16(0, fix_store_waiting(&store));
+}
+
+static void test_backfill_oldest_first(void)
+{
+    uint8_t count;
+    uint8_t sent = 0;
+    for (int32_t number = 0; number < FIX_STORE_RAM_RECORDS + 4; number++)
+    {
+        not_acked(number);
+    }
+    TEST_ASSERT_EQUAL_UINT16(FIX_STORE_RAM_RECORDS + 4, fix_store_waiting(&store));
+    TEST_ASSERT_EQUAL_UINT8(4, store.count);
+    TEST_ASSERT_FALSE(fix_store_backfill(&store, &queue, "KD4XYZ", 1));
+    acked();
+    while (fix_store_waiting(&store) != 0)
+    {
+        TEST_ASSERT_EQUAL_INT32(sent, backfill(&count));
+        TEST_ASSERT_TRUE(count >= 1 && count <= FIX_STORE_BATCH);
+        sent += count;
+    }
+    TEST_ASSERT_EQUAL_UINT8(FIX_STORE_RAM_RECORDS + 4, sent);
+    TEST_ASSERT_EQUAL_UINT32(sent, store.stats.backfilled);
+}
+
+static void test_eeprom_kept_across_boot(void)
+{
+    uint8_t count;
+    for (int32_t number = 0; number < FIX_STORE_RAM_RECORDS + 5; number++)
+    {
+        not_acked(number);
+    }
+    // the first history packet is acked and its slots get their delivered bits
+    acked();
+    TEST_ASSERT_EQUAL_INT32(0, backfill(&count));
+    for (uint8_t pass = 0; pass < FIX_STORE_SLOTS; pass++)
+    {
+        fix_store_service(&store);
+    }
+    // the ram records are gone after a reboot, the eeprom ones are still waiting in order
+    fix_store_begin(&store);
+    TEST_ASSERT_EQUAL_UINT16(5 - count, fix_store_waiting(&store));
+    TEST_ASSERT_EQUAL_INT32(count, backfill(&count));
+}
+
+static void test_ring_written_over(void)
+{
+    uint8_t count;
+    for (int32_t number = 0; number < FIX_STORE_SLOTS + FIX_STORE_RAM_RECORDS + 5; number++)
+    {
+        not_acked(number);
+    }
+    TEST_ASSERT_EQUAL_UINT16(5, store.stats.lost);
+    TEST_ASSERT_EQUAL_UINT8(FIX_STORE_SLOTS, store.count);
+    fix_store_begin(&store);
+    TEST_ASSERT_EQUAL_UINT8(FIX_STORE_SLOTS, store.count);
+    // the oldest five were written over
+    TEST_ASSERT_EQUAL_INT32(5, backfill(&count));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_history_round_trip);
+    RUN_TEST(test_acked_not_stored);
+    RUN_TEST(test_backfill_oldest_first);
+    RUN_TEST(test_eeprom_kept_across_boot);
+    RUN_TEST(test_ring_written_over);
+    return UNITY_END();
+}
@@ -0,0 +1,104 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_geo_fixed.cpp
+    @author Ralph Blach
+    @brief Known values of the integer distance, bearing and unit kernel.  The bench geo
+    suite sweeps every input against doubles, these pin the corners.
+
+    pio test -e native_test -f test_geo_fixed
+**/
+#include <unity.h>
+#include <geo_fixed.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_cos_sin(void)
+{
+    TEST_ASSERT_EQUAL_INT16(GEO_Q15_ONE, geo_cos(0));
+    TEST_ASSERT_EQUAL_INT16(GEO_Q15_ONE, geo_sin(9000));
+    TEST_ASSERT_EQUAL_INT16(-GEO_Q15_ONE, geo_cos(18000));
+    TEST_ASSERT_INT_WITHIN(40, 0, geo_cos(9000));
+    TEST_ASSERT_INT_WITHIN(40, 0, geo_sin(0));
+    // cos 60 is a half, and the angle goes round
+    TEST_ASSERT_INT_WITHIN(40, 16384, geo_cos(6000));
+    TEST_ASSERT_INT_WITHIN(40, 16384, geo_cos(30000));
+    TEST_ASSERT_INT_WITHIN(40, -GEO_Q15_ONE, geo_sin(27000));
+}
+
+static void test_isqrt(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, geo_isqrt(0));
+    TEST_ASSERT_EQUAL_UINT32(1, geo_isqrt(3));
+    TEST_ASSERT_EQUAL_UINT32(2, geo_isqrt(4));
+    TEST_ASSERT_EQUAL_UINT32(45254, geo_isqrt(2048000000UL));
+    TEST_ASSERT_EQUAL_UINT32(65535, geo_isqrt(0xffffffffUL));
+    TEST_ASSERT_EQUAL_UINT32(65534, geo_isqrt(65535UL * 65535 - 1));
+}
+
+static void test_length(void)
+{
+    TEST_ASSERT_EQUAL_UINT16(5, geo_length(3, -4));
+    TEST_ASSERT_EQUAL_UINT16(GEO_MAX_OFFSET, geo_length(-100000, 0));
+}
+
+static void test_bearing(void)
+{
+    TEST_ASSERT_EQUAL_UINT16(0, geo_bearing(0, 0));
+    TEST_ASSERT_EQUAL_UINT16(0, geo_bearing(0, 10));
+    TEST_ASSERT_EQUAL_UINT16(9000, geo_bearing(10, 0));
+    TEST_ASSERT_EQUAL_UINT16(18000, geo_bearing(0, -10));
+    TEST_ASSERT_EQUAL_UINT16(27000, geo_bearing(-10, 0));
+    TEST_ASSERT_INT_WITHIN(2, 4500, geo_bearing(7, 7));
+    TEST_ASSERT_INT_WITHIN(2, 22500, geo_bearing(-7, -7));
+    // atan 1 / 2 is 26.565 degrees, and the values are scaled down before they overflow
+    TEST_ASSERT_INT_WITHIN(2, 2657, geo_bearing(1000000000L, 2000000000L));
+    TEST_ASSERT_INT_WITHIN(2, 36000 - 2657, geo_bearing(-1, 2));
+}
+
+static void test_distance(void)
+{
+    int32_t east;
+    int32_t north;
+    // 0.001 degrees of latitude is 111.2 m anywhere
+    TEST_ASSERT_INT_WITHIN(2, 111, geo_distance(0, 0, 10000, 0));
+    // a degree of longitude is half as long at 60 degrees
+    geo_offset(600000000L, 100000000L, 600000000L, 100100000L, &east, &north);
+    TEST_ASSERT_INT_WITHIN(6, 557, east);
+    TEST_ASSERT_EQUAL_INT32(0, north);
+    // south west is negative both ways
+    geo_offset(-350000000L, -780000000L, -350010000L, -780010000L, &east, &north);
+    TEST_ASSERT_TRUE(east < 0 && north < 0);
+    // across the date line the short way round
+    geo_offset(0, 1799995000L, 0, -1799995000L, &east, &north);
+    TEST_ASSERT_INT_WITHIN(2, 111, east);
+    // too far is clamped
+    TEST_ASSERT_TRUE(geo_distance(0, 0, 100000000L, 100000000L) >= GEO_MAX_OFFSET);
+}
+
+static void test_knots_to_cms(void)
+{
+    TEST_ASSERT_EQUAL_UINT16(0, geo_knots_to_cms(0));
+    TEST_ASSERT_EQUAL_UINT16(51, geo_knots_to_cms(100));
+    TEST_ASSERT_EQUAL_UINT16(514, geo_knots_to_cms(1000));
+    TEST_ASSERT_EQUAL_UINT16(33714, geo_knots_to_cms(65535));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cos_sin);
+    RUN_TEST(test_isqrt);
+    RUN_TEST(test_length);
+    RUN_TEST(test_bearing);
+    RUN_TEST(test_distance);
+    RUN_TEST(test_knots_to_cms);
+    return UNITY_END();
+}
@@ -0,0 +1,227 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_gps_ingest.cpp
+    @author Ralph Blach
+    @brief What the ingestion layer accepts and rejects from the synthetic corpus, and the
+    order it hands the sentences out in.
+
+    pio test -e native_test -f test_gps_ingest
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <Arduino.h>
+#include <gps_ingest.h>
+#include "nmea_corpus.h"
+
+/**
+    @brief the corpus
+*/
+#define TEST_SENTENCES 2000 /*!< lines in the synthetic corpus */
+#define TEST_SEED 7         /*!< so every run sees the same corpus */
+#define TEST_CHUNK 32       /*!< bytes fed between services, less than the ring */
+
+static struct gps_ingest_stats before;
+
+static void feed(const std::string &bytes)
+{
+    /**
+        @brief a chunk at a time with a service after each, as the loop would
+    */
+    for (size_t offset = 0; offset < bytes.size(); offset += TEST_CHUNK)
+    {
+        size_t length = bytes.size() - offset < TEST_CHUNK ? bytes.size() - offset : TEST_CHUNK;
+        Serial1.native_feed((const uint8_t *)bytes.data() + offset, length);
+        gps_ingest_service();
+    }
+}
+
+static std::string numbered(uint8_t number)
+{
+    /**
+        @brief a good sentence that says which it was
+    */
+    char body[24];
+    snprintf(body, sizeof(body), "GPTXT,01,01,02,%u", number);
+    return nmea_with_checksum(body) + "\r\n";
+}
+
+static uint8_t number_of(struct gps_sentence *sentence)
+{
+    return (uint8_t)atoi(gps_sentence_field(sentence, 4));
+}
+
+void setUp(void)
+{
+    gps_ingest_begin(9600);
+    Serial1.native_clear();
+    gps_ingest_get_stats(&before);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_corpus_counts(void)
+{
+    nmea_corpus corpus;
+    struct gps_ingest_stats after;
+    uint32_t accepted = 0;
+    uint32_t rmc = 0;
+
+    nmea_corpus_synthesize(TEST_SENTENCES, TEST_SEED, corpus);
+    for (size_t offset = 0; offset < corpus.bytes.size(); offset += TEST_CHUNK)
+    {
+        struct gps_sentence *sentence;
+        feed(corpus.bytes.substr(offset, TEST_CHUNK));
+        while ((sentence = gps_ingest_next()) != NULL)
+        {
+            TEST_ASSERT_TRUE(nmea_fields_valid(&sentence->fields));
+            TEST_ASSERT_EQUAL_UINT8(strlen(sentence->data) + 1, sentence->fields.offset[1]);
+            accepted++;
+            rmc += strncmp(sentence->data + 3, "RMC", 3) == 0;
+            gps_ingest_release(sentence);
+        }
+    }
+    gps_ingest_get_stats(&after);
+    // every good line and only those, nothing lost to a full ring or a busy slot
+    TEST_ASSERT_EQUAL_UINT32(corpus.kind_count[NMEA_LINE_VALID_RMC] + corpus.kind_count[NMEA_LINE_VOID_RMC] +
+                                 corpus.kind_count[NMEA_LINE_OTHER],
+                             accepted);
+    TEST_ASSERT_EQUAL_UINT32(corpus.kind_count[NMEA_LINE_VALID_RMC] + corpus.kind_count[NMEA_LINE_VOID_RMC], rmc);
+    TEST_ASSERT_EQUAL_UINT32(accepted, after.sentences - before.sentences);
+    TEST_ASSERT_EQUAL_UINT32(corpus.bytes.size(), after.bytes_received - before.bytes_received);
+    TEST_ASSERT_EQUAL_UINT16(before.dropped_bytes, after.dropped_bytes);
+    TEST_ASSERT_EQUAL_UINT16(before.dropped_sentences, after.dropped_sentences);
+    // a cut line has lost its *hh, so it fails like a bad checksum, and so does garbage with a $ in it
+    TEST_ASSERT_EQUAL_UINT16(0, after.truncated - before.truncated);
+    TEST_ASSERT_GREATER_OR_EQUAL(corpus.kind_count[NMEA_LINE_TRUNCATED] + corpus.kind_count[NMEA_LINE_BAD_CHECKSUM],
+                                 (uint16_t)(after.checksum_errors - before.checksum_errors));
+    TEST_ASSERT_LESS_OR_EQUAL(corpus.kind_count[NMEA_LINE_TRUNCATED] + corpus.kind_count[NMEA_LINE_BAD_CHECKSUM] +
+                                  corpus.kind_count[NMEA_LINE_GARBAGE],
+                              (uint16_t)(after.checksum_errors - before.checksum_errors));
+}
+
+static void test_bad_checksum_rejected(void)
+{
+    struct gps_ingest_stats after;
+    std::string good = nmea_with_checksum("GPRMC,094330.000,A,3113.3156,N,12121.2686,E,0.51,193.93,171210,,,A") + "\r\n";
+    std::string bad = good;
+    bad[good.size() - 3] ^= 1;
+    feed(bad);
+    TEST_ASSERT_NULL(gps_ingest_next());
+    feed(good);
+    struct gps_sentence *sentence = gps_ingest_next();
+    TEST_ASSERT_NOT_NULL(sentence);
+    TEST_ASSERT_EQUAL_STRING("A", gps_sentence_field(sentence, 2));
+    gps_ingest_release(sentence);
+    gps_ingest_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT16(1, after.checksum_errors - before.checksum_errors);
+}
+
+static void test_too_long_thrown_away(void)
+{
+    struct gps_ingest_stats after;
+    feed("$GPTXT," + std::string(GPS_RECEIVER_BUFFER_SIZE, 'A') + "*00\r\n");
+    TEST_ASSERT_NULL(gps_ingest_next());
+    gps_ingest_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT16(1, after.truncated - before.truncated);
+}
+
+static void test_oldest_first(void)
+{
+    /**
+        @brief a held slot makes a newer sentence land in a higher slot than an older one,
+        the older one still comes out first
+    */
+    struct gps_sentence *held;
+    struct gps_sentence *second;
+    struct gps_sentence *third;
+    struct gps_sentence *sentence;
+
+    feed(numbered(1));
+    held = gps_ingest_next();
+    feed(numbered(2));
+    feed(numbered(3));
+    second = gps_ingest_next();
+    third = gps_ingest_next();
+    TEST_ASSERT_EQUAL_UINT8(2, number_of(second));
+    TEST_ASSERT_EQUAL_UINT8(3, number_of(third));
+    gps_ingest_release(second);
+    feed(numbered(4));
+    feed(numbered(5));
+    for (uint8_t number = 4; number <= 5; number++)
+    {
+        sentence = gps_ingest_next();
+        TEST_ASSERT_NOT_NULL(sentence);
+        TEST_ASSERT_EQUAL_UINT8(number, number_of(sentence));
+        gps_ingest_release(sentence);
+    }
+    TEST_ASSERT_NULL(gps_ingest_next());
+    gps_ingest_release(held);
+    gps_ingest_release(third);
+}
+
+static void test_no_free_slot(void)
+{
+    struct gps_sentence *sentences[GPS_SENTENCE_SLOTS];
+    struct gps_ingest_stats after;
+    for (uint8_t index = 0; index < GPS_SENTENCE_SLOTS; index++)
+    {
+        feed(numbered(index));
+        sentences[index] = gps_ingest_next();
+        TEST_ASSERT_NOT_NULL(sentences[index]);
+    }
+    feed(numbered(99));
+    TEST_ASSERT_NULL(gps_ingest_next());
+    gps_ingest_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT16(1, after.dropped_sentences - before.dropped_sentences);
+    for (uint8_t index = 0; index < GPS_SENTENCE_SLOTS; index++)
+    {
+        gps_ingest_release(sentences[index]);
+    }
+}
+
+static void test_set_baud_keeps_sentences(void)
+{
+    /**
+        @brief a rate change during the search lets go of the half sentence, not the finished ones
+    */
+    struct gps_sentence *held;
+    struct gps_sentence *sentence;
+    std::string next = numbered(3);
+    feed(numbered(1));
+    feed(numbered(2));
+    held = gps_ingest_next();
+    feed(next.substr(0, 10));
+    gps_ingest_set_baud(38400);
+    TEST_ASSERT_EQUAL_UINT32(38400, Serial1.native_baud());
+    feed(next.substr(10));
+    feed(numbered(4));
+    TEST_ASSERT_EQUAL_UINT8(1, number_of(held));
+    TEST_ASSERT_EQUAL_UINT8(GPS_SLOT_IN_USE, held->state);
+    sentence = gps_ingest_next();
+    TEST_ASSERT_EQUAL_UINT8(2, number_of(sentence));
+    gps_ingest_release(sentence);
+    sentence = gps_ingest_next();
+    TEST_ASSERT_EQUAL_UINT8(4, number_of(sentence));
+    gps_ingest_release(sentence);
+    TEST_ASSERT_NULL(gps_ingest_next());
+    gps_ingest_release(held);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_counts);
+    RUN_TEST(test_bad_checksum_rejected);
+    RUN_TEST(test_too_long_thrown_away);
+    RUN_TEST(test_oldest_first);
+    RUN_TEST(test_no_free_slot);
+    RUN_TEST(test_set_baud_keeps_sentences);
+    return UNITY_END();
+}
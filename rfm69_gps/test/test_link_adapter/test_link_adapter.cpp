@@ -0,0 +1,296 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_link_adapter.cpp
+    @author Ralph Blach
+    @brief When the link adapter moves up and down, probes after a lost ack, gives up, and goes
+    home after a silence.
+
+    pio test -e native_test -f test_link_adapter
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <RadioHead.h>
+#include <RH_RF69.h>
+#include <tx_queue.h>
+#include <link_adapter.h>
+
+/**
+    @brief the addresses and the retry policy
+*/
+#define TEST_THIS_ADDRESS 2  /*!< the tracker */
+#define TEST_BASE_ADDRESS 1  /*!< the base station */
+#define TEST_RETRIES 2       /*!< resends after the first try */
+#define TEST_ACK_TIMEOUT 200 /*!< ms */
+#define TEST_BACKOFF 100     /*!< ms a retry */
+
+/**
+    @brief ack rssi in dBm.  At TEST_FAR_RSSI profile 5, 250 kbps at +20 dBm, has 14 dB of margin
+    and profile 6 at +13 dBm only 7, at TEST_NEAR_RSSI the quietest profile 8 has 16
+*/
+#define TEST_FAR_RSSI -80
+#define TEST_NEAR_RSSI -60
+#define TEST_FAR_PROFILE 5
+#define TEST_NEAR_PROFILE 8
+
+extern RH_RF69 rf69;
+
+static struct tx_queue queue;
+static struct link_adapter adapter;
+static uint8_t applied;
+static struct link_profile applied_profile;
+
+static void on_apply(void *context, const struct link_profile *profile)
+{
+    applied++;
+    applied_profile = *profile;
+}
+
+static void on_complete(struct tx_queue *queue, const struct tx_frame *frame, bool delivered, uint8_t attempts)
+{
+    link_adapter_complete(&adapter, frame, delivered, attempts);
+}
+
+static void finish(void)
+{
+    /**
+        @brief service the queue until the frame on it is acked or given up on
+    */
+    for (uint16_t pass = 0; pass < 1000 && !tx_queue_idle(&queue); pass++)
+    {
+        native_advance_micros(10000);
+        tx_queue_service(&queue);
+    }
+    TEST_ASSERT_TRUE(tx_queue_idle(&queue));
+}
+
+static void send_data(bool acked)
+{
+    /**
+        @brief a position report that is acked on the first try, or never
+    */
+    static const uint8_t payload[] = {0xB1, 'K', 'D', '4', 'X', 'Y', 'Z'};
+    rf69.native_auto_ack = acked;
+    TEST_ASSERT_TRUE(tx_queue_push(&queue, payload, sizeof(payload), TEST_BASE_ADDRESS));
+    tx_queue_service(&queue);
+    finish();
+}
+
+static void send_request(bool acked)
+{
+    /**
+        @brief let the adapter queue the request it wants, and send it
+    */
+    const struct tx_frame *frame;
+    rf69.native_auto_ack = acked;
+    TEST_ASSERT_TRUE(link_adapter_service(&adapter, TEST_BASE_ADDRESS));
+    frame = &queue.frames[queue.head];
+    TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_LENGTH, frame->length);
+    TEST_ASSERT_EQUAL_HEX8(LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION, frame->data[0]);
+    tx_queue_service(&queue);
+    finish();
+}
+
+static void move_up(int16_t rssi, uint8_t index)
+{
+    /**
+        @brief a streak of acks at rssi, and the change it asks for
+    */
+    rf69.native_ack_rssi = rssi;
+    for (uint8_t frame = 0; frame < LINK_ADAPT_UP_FRAMES; frame++)
+    {
+        send_data(true);
+    }
+    TEST_ASSERT_EQUAL_UINT8(index, adapter.want);
+    send_request(true);
+    TEST_ASSERT_EQUAL_UINT8(index, adapter.profile);
+}
+
+void setUp(void)
+{
+    native_set_micros(10000000);
+    native_set_random_state(1);
+    rf69.native_sent.clear();
+    rf69.native_received.clear();
+    rf69.native_auto_ack = true;
+    rf69.native_ack_rssi = TEST_FAR_RSSI;
+    rf69.setModeIdle();
+    tx_queue_init(&queue, &rf69, TEST_THIS_ADDRESS);
+    tx_queue_set_retries(&queue, TEST_RETRIES, TEST_ACK_TIMEOUT, TEST_BACKOFF);
+    queue.on_complete = on_complete;
+    applied = 0;
+    link_adapter_init(&adapter, &queue, on_apply, NULL);
+}
+
+void tearDown(void)
+{
+    rf69.native_auto_ack = true;
+    rf69.native_ack_rssi = -60;
+}
+
+static void test_home_after_init(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(LINK_ADAPT_HOME, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT8(1, applied);
+    TEST_ASSERT_EQUAL_UINT32(9600, applied_profile.bit_rate);
+    TEST_ASSERT_EQUAL_UINT32(9600, queue.bit_rate);
+    TEST_ASSERT_FALSE(link_adapter_service(&adapter, TEST_BASE_ADDRESS));
+}
+
+static void test_up_after_streak(void)
+{
+    rf69.native_ack_rssi = TEST_FAR_RSSI;
+    for (uint8_t frame = 1; frame < LINK_ADAPT_UP_FRAMES; frame++)
+    {
+        send_data(true);
+        TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_NONE, adapter.want);
+    }
+    send_data(true);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.want);
+    // the tracker changes only when the base station has acked the request
+    TEST_ASSERT_TRUE(link_adapter_service(&adapter, TEST_BASE_ADDRESS));
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.requested);
+    TEST_ASSERT_EQUAL_UINT8(LINK_ADAPT_HOME, adapter.profile);
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_NONE, adapter.requested);
+    TEST_ASSERT_EQUAL_UINT32(250000, queue.bit_rate);
+    TEST_ASSERT_EQUAL_INT8(20, applied_profile.power);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.requests);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.up);
+}
+
+static void test_up_to_quietest(void)
+{
+    move_up(TEST_NEAR_RSSI, TEST_NEAR_PROFILE);
+    TEST_ASSERT_EQUAL_INT8(2, applied_profile.power);
+    TEST_ASSERT_INT_WITHIN(1, 16, link_adapter_margin(&adapter, adapter.profile));
+}
+
+static void test_down_on_lost_frame(void)
+{
+    move_up(TEST_FAR_RSSI, TEST_FAR_PROFILE);
+    send_data(false);
+    // profile 4 at 125 kbps has 17 dB of margin
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE - 1, adapter.want);
+    send_request(true);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE - 1, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.down);
+}
+
+static void test_down_on_fading_margin(void)
+{
+    uint8_t frame;
+    move_up(TEST_FAR_RSSI, TEST_FAR_PROFILE);
+    // the tracker drives off, at -92 dBm profile 5 has 2 dB left
+    rf69.native_ack_rssi = -92;
+    for (frame = 0; frame < 20 && adapter.want == LINK_PROFILE_NONE; frame++)
+    {
+        send_data(true);
+    }
+    TEST_ASSERT_TRUE(link_adapter_margin(&adapter, TEST_FAR_PROFILE) < LINK_ADAPT_MARGIN / 2);
+    TEST_ASSERT_TRUE(adapter.want < TEST_FAR_PROFILE);
+    TEST_ASSERT_TRUE(link_adapter_margin(&adapter, adapter.want) >= LINK_ADAPT_MARGIN);
+}
+
+static void test_frames_during_probe_ignored(void)
+{
+    rf69.native_ack_rssi = TEST_FAR_RSSI;
+    for (uint8_t frame = 0; frame < LINK_ADAPT_UP_FRAMES; frame++)
+    {
+        send_data(true);
+    }
+    send_request(false);
+    // a report lost while probing says nothing about the profile, the probe still goes
+    send_data(false);
+    TEST_ASSERT_TRUE(adapter.probing);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.want);
+    send_request(true);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT16(0, adapter.stats.down);
+}
+
+static void test_probe_after_lost_ack(void)
+{
+    rf69.native_ack_rssi = TEST_FAR_RSSI;
+    for (uint8_t frame = 0; frame < LINK_ADAPT_UP_FRAMES; frame++)
+    {
+        send_data(true);
+    }
+    send_request(false);
+    // the base may have changed, ask again on the new profile
+    TEST_ASSERT_TRUE(adapter.probing);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT8(LINK_ADAPT_HOME, adapter.probe_from);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.probes);
+    send_request(true);
+    TEST_ASSERT_FALSE(adapter.probing);
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.up);
+    TEST_ASSERT_EQUAL_UINT16(2, adapter.stats.requests);
+}
+
+static void test_refused(void)
+{
+    rf69.native_ack_rssi = TEST_FAR_RSSI;
+    for (uint8_t frame = 0; frame < LINK_ADAPT_UP_FRAMES; frame++)
+    {
+        send_data(true);
+    }
+    send_request(false);
+    send_request(false);
+    // neither profile heard it, go back to the one the base station was last known on
+    TEST_ASSERT_FALSE(adapter.probing);
+    TEST_ASSERT_EQUAL_UINT8(LINK_ADAPT_HOME, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT32(9600, queue.bit_rate);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.refused);
+    TEST_ASSERT_EQUAL_UINT16(0, adapter.stats.up);
+}
+
+static void test_silence_goes_home(void)
+{
+    move_up(TEST_FAR_RSSI, TEST_FAR_PROFILE);
+    native_advance_micros(LINK_ADAPT_SILENCE * 1000ULL);
+    TEST_ASSERT_FALSE(link_adapter_service(&adapter, TEST_BASE_ADDRESS));
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, adapter.profile);
+    native_advance_micros(1000);
+    TEST_ASSERT_FALSE(link_adapter_service(&adapter, TEST_BASE_ADDRESS));
+    TEST_ASSERT_EQUAL_UINT8(LINK_ADAPT_HOME, adapter.profile);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.silences);
+    // a silence at home is not counted
+    native_advance_micros((LINK_ADAPT_SILENCE + 1) * 1000ULL);
+    link_adapter_service(&adapter, TEST_BASE_ADDRESS);
+    TEST_ASSERT_EQUAL_UINT16(1, adapter.stats.silences);
+}
+
+static void test_decode(void)
+{
+    uint8_t packet[LINK_PROFILE_LENGTH] = {LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION, TEST_FAR_PROFILE};
+    uint8_t index = LINK_PROFILE_NONE;
+    TEST_ASSERT_TRUE(link_profile_decode(packet, sizeof(packet), &index));
+    TEST_ASSERT_EQUAL_UINT8(TEST_FAR_PROFILE, index);
+    TEST_ASSERT_FALSE(link_profile_decode(packet, sizeof(packet) - 1, &index));
+    packet[1] = LINK_PROFILE_COUNT;
+    TEST_ASSERT_FALSE(link_profile_decode(packet, sizeof(packet), &index));
+    packet[1] = TEST_FAR_PROFILE;
+    packet[0] = LINK_PROFILE_MAGIC | (LINK_PROFILE_VERSION + 1);
+    TEST_ASSERT_FALSE(link_profile_decode(packet, sizeof(packet), &index));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_home_after_init);
+    RUN_TEST(test_up_after_streak);
+    RUN_TEST(test_up_to_quietest);
+    RUN_TEST(test_down_on_lost_frame);
+    RUN_TEST(test_down_on_fading_margin);
+    RUN_TEST(test_frames_during_probe_ignored);
+    RUN_TEST(test_probe_after_lost_ack);
+    RUN_TEST(test_refused);
+    RUN_TEST(test_silence_goes_home);
+    RUN_TEST(test_decode);
+    return UNITY_END();
+}
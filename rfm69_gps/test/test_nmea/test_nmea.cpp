@@ -0,0 +1,192 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_nmea.cpp
+    @author Ralph Blach
+    @brief The tokenizer, its checksum and empty fields, and the RMC to position_fix conversion.
+
+    pio test -e native_test -f test_nmea
+**/
+#include <string.h>
+#include <unity.h>
+#include <nmea.h>
+#include <position_packet.h>
+
+/**
+    @brief a sentence run through the tokenizer the way gps_ingest.cpp stores it
+*/
+struct tokenized
+{
+    char data[100];
+    char *tokens[NMEA_MAX_FIELDS];
+    struct nmea_fields fields;
+    bool valid;
+};
+
+static void tokenize(const char *sentence, struct tokenized *result)
+{
+    /**
+        @brief store the $ at 0, feed the rest up to the CR and split the fields
+    */
+    uint8_t length = 1;
+    result->data[0] = '$';
+    nmea_fields_start(&result->fields);
+    for (sentence++; *sentence != 0 && *sentence != '\r'; sentence++)
+    {
+        result->data[length] = nmea_fields_feed(&result->fields, *sentence, length);
+        length++;
+    }
+    result->data[length] = 0;
+    for (uint8_t index = 0; index < result->fields.count; index++)
+    {
+        result->tokens[index] = result->data + result->fields.offset[index];
+    }
+    result->valid = nmea_fields_valid(&result->fields);
+}
+
+static const char rmc[] = "$GPRMC,094330.000,A,3113.3156,N,12121.2686,E,0.51,193.93,171210,,,A*68\r\n";
+static const char call_sign[] = "KD4XYZ";
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_checksum_accepted(void)
+{
+    struct tokenized sentence;
+    tokenize(rmc, &sentence);
+    TEST_ASSERT_TRUE(sentence.valid);
+    TEST_ASSERT_EQUAL_HEX8(0x68, sentence.fields.received_checksum);
+}
+
+static void test_checksum_rejected(void)
+{
+    struct tokenized sentence;
+    tokenize("$GPRMC,094330.000,A,3113.3156,N,12121.2686,E,0.51,193.93,171210,,,A*69\r\n", &sentence);
+    TEST_ASSERT_FALSE(sentence.valid);
+    // a changed character is caught by the xor
+    tokenize("$GPRMC,094330.000,A,3113.3157,N,12121.2686,E,0.51,193.93,171210,,,A*68\r\n", &sentence);
+    TEST_ASSERT_FALSE(sentence.valid);
+}
+
+static void test_missing_or_bad_checksum(void)
+{
+    struct tokenized sentence;
+    tokenize("$GPRMC,094330.000,A,3113.3156,N\r\n", &sentence);
+    TEST_ASSERT_FALSE(sentence.valid);
+    tokenize("$GPRMC,094330.000,A,3113.3156,N*6\r\n", &sentence);
+    TEST_ASSERT_FALSE(sentence.valid);
+    tokenize("$GPRMC,094330.000,A,3113.3156,N*6G\r\n", &sentence);
+    TEST_ASSERT_EQUAL_UINT8(NMEA_STATE_ERROR, sentence.fields.state);
+    TEST_ASSERT_FALSE(sentence.valid);
+    tokenize(rmc, &sentence);
+    // nothing may follow the two digits
+    nmea_fields_feed(&sentence.fields, '0', 80);
+    TEST_ASSERT_FALSE(nmea_fields_valid(&sentence.fields));
+}
+
+static void test_empty_fields_kept(void)
+{
+    struct tokenized sentence;
+    tokenize("$GPRMC,235947.000,V,,,,,,,070123,,,N*44\r\n", &sentence);
+    TEST_ASSERT_TRUE(sentence.valid);
+    TEST_ASSERT_EQUAL_UINT8(13, sentence.fields.count);
+    TEST_ASSERT_EQUAL_STRING("$GPRMC", sentence.tokens[RMC_HEADER]);
+    TEST_ASSERT_EQUAL_STRING("V", sentence.tokens[RMC_STATUS]);
+    TEST_ASSERT_EQUAL_STRING("", sentence.tokens[RMC_LATITUDE]);
+    TEST_ASSERT_EQUAL_STRING("", sentence.tokens[RMC_COURSE_OVER_GROUND]);
+    TEST_ASSERT_EQUAL_STRING("070123", sentence.tokens[RMC_DATE]);
+}
+
+static void test_gsa_fields(void)
+{
+    struct tokenized sentence;
+    tokenize("$GPGSA,A,3,10,13,15,18,20,23,24,29,,,,,1.21,0.92,0.79*05\r\n", &sentence);
+    TEST_ASSERT_TRUE(sentence.valid);
+    TEST_ASSERT_EQUAL_UINT8(NMEA_MAX_FIELDS, sentence.fields.count);
+    TEST_ASSERT_EQUAL_STRING("3", sentence.tokens[GSA_FIX_TYPE]);
+    TEST_ASSERT_EQUAL_STRING("", sentence.tokens[14]);
+    TEST_ASSERT_EQUAL_STRING("0.92", sentence.tokens[GSA_HDOP]);
+    TEST_ASSERT_EQUAL_STRING("0.79", sentence.tokens[GSA_VDOP]);
+}
+
+static void test_rmc_to_fix(void)
+{
+    struct tokenized sentence;
+    struct position_fix fix;
+    tokenize(rmc, &sentence);
+    TEST_ASSERT_TRUE(position_fix_from_rmc(sentence.tokens, sentence.fields.count, call_sign, &fix));
+    TEST_ASSERT_EQUAL_MEMORY(call_sign, fix.call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_HEX8(POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID, fix.flags);
+    // 31 degrees 13.3156 minutes and 121 degrees 21.2686 minutes in 1e-7 degrees
+    TEST_ASSERT_EQUAL_INT32(312219267, fix.latitude);
+    TEST_ASSERT_EQUAL_INT32(1213544767, fix.longitude);
+    TEST_ASSERT_EQUAL_UINT32(((9 * 60UL + 43) * 60 + 30) * 100, fix.time_of_day);
+    TEST_ASSERT_EQUAL_UINT16((10 << 9) | (12 << 5) | 17, fix.date);
+    TEST_ASSERT_EQUAL_UINT16(51, fix.speed);
+    TEST_ASSERT_EQUAL_UINT16(19393, fix.course);
+}
+
+static void test_southern_and_western(void)
+{
+    struct tokenized sentence;
+    struct position_fix fix;
+    tokenize("$GPRMC,094330.000,A,3113.3156,S,12121.2686,W,0.51,193.93,171210,,,A*67\r\n", &sentence);
+    TEST_ASSERT_TRUE(sentence.valid);
+    TEST_ASSERT_TRUE(position_fix_from_rmc(sentence.tokens, sentence.fields.count, call_sign, &fix));
+    TEST_ASSERT_EQUAL_INT32(-312219267, fix.latitude);
+    TEST_ASSERT_EQUAL_INT32(-1213544767, fix.longitude);
+}
+
+static void test_coordinate_rounding(void)
+{
+    bool present;
+    // the sixth digit of the minutes rounds the fifth
+    TEST_ASSERT_EQUAL_INT32(481173058, nmea_parse_coordinate("4807.038345", "N", &present));
+    TEST_ASSERT_EQUAL_INT32(481173057, nmea_parse_coordinate("4807.038344", "N", &present));
+    // 31 minutes is 0.516666 degrees, the last digit rounds up and keeps its sign
+    TEST_ASSERT_EQUAL_INT32(-115166667, nmea_parse_coordinate("01131.000", "W", &present));
+    TEST_ASSERT_TRUE(present);
+    TEST_ASSERT_EQUAL_INT32(0, nmea_parse_coordinate("", "N", &present));
+    TEST_ASSERT_FALSE(present);
+}
+
+static void test_void_rmc(void)
+{
+    struct tokenized sentence;
+    struct position_fix fix;
+    tokenize("$GPRMC,235947.000,V,,,,,,,070123,,,N*44\r\n", &sentence);
+    TEST_ASSERT_TRUE(position_fix_from_rmc(sentence.tokens, sentence.fields.count, call_sign, &fix));
+    TEST_ASSERT_EQUAL_HEX8(0, fix.flags);
+    TEST_ASSERT_EQUAL_INT32(0, fix.latitude);
+    TEST_ASSERT_EQUAL_UINT16((23 << 9) | (1 << 5) | 7, fix.date);
+}
+
+static void test_short_rmc(void)
+{
+    struct tokenized sentence;
+    struct position_fix fix;
+    tokenize("$GPRMC,094330.000,A,3113.3156,N*78\r\n", &sentence);
+    TEST_ASSERT_FALSE(position_fix_from_rmc(sentence.tokens, sentence.fields.count, call_sign, &fix));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_checksum_accepted);
+    RUN_TEST(test_checksum_rejected);
+    RUN_TEST(test_missing_or_bad_checksum);
+    RUN_TEST(test_empty_fields_kept);
+    RUN_TEST(test_gsa_fields);
+    RUN_TEST(test_rmc_to_fix);
+    RUN_TEST(test_southern_and_western);
+    RUN_TEST(test_coordinate_rounding);
+    RUN_TEST(test_void_rmc);
+    RUN_TEST(test_short_rmc);
+    return UNITY_END();
+}
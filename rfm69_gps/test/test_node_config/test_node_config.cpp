@@ -0,0 +1,210 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_node_config.cpp
+    @author Ralph Blach
+    @brief The crc of the settings block, the blocks that are not used, and the move from a
+    version 1 block and from the old single bytes.
+
+    pio test -e native_test -f test_node_config
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <node_config.h>
+
+/**
+    @brief the settings of a tracker with nothing in the eeprom
+*/
+static const struct node_config defaults = {
+    NODE_CONFIG_MAGIC, NODE_CONFIG_VERSION, {0x2d, 0xd4}, 915000, {'N', '0', 'C', 'A', 'L', 'L'}, 2, 1, 0xff, 0,
+    1000, 5000, 5, 300, 0,
+};
+
+static struct node_config config;
+
+static void put_legacy(const char *bytes)
+{
+    /**
+        @brief the call sign, the sync words and the slot of a tracker built before the block
+    */
+    for (uint8_t index = 0; index <= NODE_CONFIG_LEGACY_SLOT; index++)
+    {
+        EEPROM.update(NODE_CONFIG_LEGACY_CALL_SIGN + index, (uint8_t)bytes[index]);
+    }
+}
+
+void setUp(void)
+{
+    for (uint16_t address = 0; address < EEPROM.length(); address++)
+    {
+        EEPROM.update(address, 0xff);
+    }
+    memset(&config, 0, sizeof(config));
+}
+
+void tearDown(void)
+{
+}
+
+static void test_crc_check_value(void)
+{
+    // the check value of crc 16 ccitt false
+    TEST_ASSERT_EQUAL_HEX16(0x29b1, node_config_crc((const uint8_t *)"123456789", 9));
+    TEST_ASSERT_EQUAL_HEX16(0xffff, node_config_crc((const uint8_t *)"", 0));
+}
+
+static void test_erased_gives_defaults(void)
+{
+    uint32_t writes = EEPROM.native_writes();
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_DEFAULTS, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY(&defaults, &config, sizeof(config));
+    TEST_ASSERT_EQUAL_UINT32(writes, EEPROM.native_writes());
+}
+
+static void test_block_round_trip(void)
+{
+    struct node_config saved = defaults;
+    uint16_t crc;
+    TEST_ASSERT_TRUE(node_config_set_call_sign(&saved, "KD4XYZ"));
+    saved.slot = 7;
+    saved.moving_fix_interval = 200;
+    node_config_save(&saved);
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_BLOCK, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY(&saved, &config, sizeof(config));
+    // the crc is little endian after everything it covers
+    crc = EEPROM.read(NODE_CONFIG_EEPROM_START + offsetof(struct node_config, crc)) |
+          EEPROM.read(NODE_CONFIG_EEPROM_START + offsetof(struct node_config, crc) + 1) << 8;
+    TEST_ASSERT_EQUAL_HEX16(node_config_crc((const uint8_t *)&saved, offsetof(struct node_config, crc)), crc);
+}
+
+static void test_corrupt_block(void)
+{
+    struct node_config saved = defaults;
+    TEST_ASSERT_TRUE(node_config_set_call_sign(&saved, "KD4XYZ"));
+    node_config_save(&saved);
+    // a bit of the call sign flips, the crc no longer matches
+    EEPROM.update(NODE_CONFIG_EEPROM_START + 9, EEPROM.read(NODE_CONFIG_EEPROM_START + 9) ^ 0x01);
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_DEFAULTS, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY("N0CALL", config.call_sign, CALL_SIGN_LENGTH);
+    // a block of a later version is not read either
+    node_config_save(&saved);
+    EEPROM.update(NODE_CONFIG_EEPROM_START + 1, NODE_CONFIG_VERSION + 1);
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_DEFAULTS, node_config_load(&config, &defaults));
+    // and erase spoils the magic
+    node_config_save(&saved);
+    node_config_erase();
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_DEFAULTS, node_config_load(&config, &defaults));
+}
+
+static void test_legacy_moved(void)
+{
+    put_legacy("KD4XYZ\x2e\xa5\x03");
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_LEGACY, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY("KD4XYZ", config.call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_HEX8(0x2e, config.sync_words[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xa5, config.sync_words[1]);
+    TEST_ASSERT_EQUAL_UINT8(3, config.slot);
+    TEST_ASSERT_EQUAL_UINT16(defaults.heartbeat, config.heartbeat);
+    // written once, the next boot reads the block
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_BLOCK, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY("KD4XYZ", config.call_sign, CALL_SIGN_LENGTH);
+}
+
+static void test_legacy_erased_sync_words(void)
+{
+    // a short call sign padded with spaces, erased sync words keep the default network
+    put_legacy("W1AW  \xff\xff\xff");
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_LEGACY, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY("W1AW  ", config.call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_MEMORY(defaults.sync_words, config.sync_words, 2);
+    TEST_ASSERT_EQUAL_UINT8(0xff, config.slot);
+    // a 0 sync byte is not taken either
+    put_legacy("W1AW  \x2e\x00\x01");
+    node_config_erase();
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_LEGACY, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_MEMORY(defaults.sync_words, config.sync_words, 2);
+}
+
+static void test_legacy_garbage(void)
+{
+    static const char *const garbage[] = {
+        "\xff\xff\xff\xff\xff\xff\xff\xff\xff", // erased
+        "KDXYZW\x2e\xa5\x03",                   // no digit
+        "123456\x2e\xa5\x03",                   // no letter
+        " KD4XY\x2e\xa5\x03",                   // starts with a space
+        "KD 4XY\x2e\xa5\x03",                   // a space inside
+        "KD4X\x01Z\x2e\xa5\x03",                // not printable
+    };
+    uint32_t writes;
+    for (uint8_t index = 0; index < sizeof(garbage) / sizeof(garbage[0]); index++)
+    {
+        put_legacy(garbage[index]);
+        writes = EEPROM.native_writes();
+        TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_DEFAULTS, node_config_load(&config, &defaults));
+        TEST_ASSERT_EQUAL_MEMORY("N0CALL", config.call_sign, CALL_SIGN_LENGTH);
+        TEST_ASSERT_EQUAL_UINT32(writes, EEPROM.native_writes());
+    }
+}
+
+static void test_version_1_upgraded(void)
+{
+    struct node_config saved = defaults;
+    uint8_t block[NODE_CONFIG_VERSION_1_LENGTH];
+    TEST_ASSERT_TRUE(node_config_set_call_sign(&saved, "KD4XYZ"));
+    saved.address = 9;
+    saved.profile = 4;
+    node_config_save(&saved);
+    // the same settings as version 1 left them, the crc straight after the link profile
+    EEPROM.get(NODE_CONFIG_EEPROM_START, block);
+    block[1] = 1;
+    EEPROM.put(NODE_CONFIG_EEPROM_START, block);
+    EEPROM.put(NODE_CONFIG_EEPROM_START + NODE_CONFIG_VERSION_1_LENGTH, node_config_crc(block, sizeof(block)));
+    EEPROM.put(NODE_CONFIG_EEPROM_START + NODE_CONFIG_VERSION_1_LENGTH + 2, (uint16_t)0x1234);
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_VERSION_1, node_config_load(&config, &defaults));
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_VERSION, config.version);
+    TEST_ASSERT_EQUAL_MEMORY("KD4XYZ", config.call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_UINT8(9, config.address);
+    TEST_ASSERT_EQUAL_UINT8(4, config.profile);
+    TEST_ASSERT_EQUAL_UINT16(defaults.moving_fix_interval, config.moving_fix_interval);
+    TEST_ASSERT_EQUAL_UINT16(defaults.parked_fix_interval, config.parked_fix_interval);
+    TEST_ASSERT_EQUAL_UINT16(defaults.min_interval, config.min_interval);
+    TEST_ASSERT_EQUAL_UINT16(defaults.heartbeat, config.heartbeat);
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_BLOCK, node_config_load(&config, &defaults));
+    // a version 1 block with a bad crc is not used
+    EEPROM.put(NODE_CONFIG_EEPROM_START, block);
+    EEPROM.put(NODE_CONFIG_EEPROM_START + NODE_CONFIG_VERSION_1_LENGTH,
+               (uint16_t)(node_config_crc(block, sizeof(block)) ^ 1));
+    TEST_ASSERT_EQUAL_UINT8(NODE_CONFIG_FROM_DEFAULTS, node_config_load(&config, &defaults));
+}
+
+static void test_set_call_sign(void)
+{
+    config = defaults;
+    TEST_ASSERT_TRUE(node_config_set_call_sign(&config, "W1AW"));
+    TEST_ASSERT_EQUAL_MEMORY("W1AW  ", config.call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_TRUE(node_config_set_call_sign(&config, "kd4xyz"));
+    TEST_ASSERT_EQUAL_MEMORY("kd4xyz", config.call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_FALSE(node_config_set_call_sign(&config, "KD4XYZA"));
+    TEST_ASSERT_FALSE(node_config_set_call_sign(&config, ""));
+    TEST_ASSERT_FALSE(node_config_set_call_sign(&config, "KD-4XY"));
+    TEST_ASSERT_FALSE(node_config_set_call_sign(&config, "KDXYZ"));
+    TEST_ASSERT_EQUAL_MEMORY("kd4xyz", config.call_sign, CALL_SIGN_LENGTH);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_check_value);
+    RUN_TEST(test_erased_gives_defaults);
+    RUN_TEST(test_block_round_trip);
+    RUN_TEST(test_corrupt_block);
+    RUN_TEST(test_legacy_moved);
+    RUN_TEST(test_legacy_erased_sync_words);
+    RUN_TEST(test_legacy_garbage);
+    RUN_TEST(test_version_1_upgraded);
+    RUN_TEST(test_set_call_sign);
+    return UNITY_END();
+}
@@ -0,0 +1,137 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_position_packet.cpp
+    @author Ralph Blach
+    @brief Round trips of the version 1 and 2 position packets and of a stored record.
+
+    pio test -e native_test -f test_position_packet
+**/
+#include <string.h>
+#include <unity.h>
+#include <position_packet.h>
+
+static struct position_fix fix;
+
+void setUp(void)
+{
+    /**
+        @brief a fix in the southern and western hemispheres, so the signs are carried
+    */
+    memset(&fix, 0, sizeof(fix));
+    memcpy(fix.call_sign, "KD4XYZ", CALL_SIGN_LENGTH);
+    fix.flags = POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID;
+    fix.latitude = -312219267;
+    fix.longitude = -1213544767;
+    fix.time_of_day = 8639999;
+    fix.date = (26 << 9) | (10 << 5) | 16;
+    fix.speed = 65535;
+    fix.course = 35999;
+}
+
+void tearDown(void)
+{
+}
+
+static void assert_same(const struct position_fix *expected, const struct position_fix *actual)
+{
+    TEST_ASSERT_EQUAL_MEMORY(expected->call_sign, actual->call_sign, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_HEX8(expected->flags, actual->flags);
+    TEST_ASSERT_EQUAL_INT32(expected->latitude, actual->latitude);
+    TEST_ASSERT_EQUAL_INT32(expected->longitude, actual->longitude);
+    TEST_ASSERT_EQUAL_UINT32(expected->time_of_day, actual->time_of_day);
+    TEST_ASSERT_EQUAL_UINT16(expected->date, actual->date);
+    TEST_ASSERT_EQUAL_UINT16(expected->speed, actual->speed);
+    TEST_ASSERT_EQUAL_UINT16(expected->course, actual->course);
+    TEST_ASSERT_EQUAL_INT32(expected->altitude, actual->altitude);
+    TEST_ASSERT_EQUAL_UINT8(expected->satellites, actual->satellites);
+    TEST_ASSERT_EQUAL_UINT16(expected->hdop, actual->hdop);
+}
+
+static void test_version_1_round_trip(void)
+{
+    uint8_t buffer[40];
+    struct position_fix decoded;
+    TEST_ASSERT_EQUAL_UINT8(POSITION_PACKET_LENGTH, position_packet_encode(&fix, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_HEX8(POSITION_PACKET_MAGIC | POSITION_PACKET_VERSION, buffer[0]);
+    TEST_ASSERT_TRUE(position_packet_decode(buffer, POSITION_PACKET_LENGTH, &decoded));
+    assert_same(&fix, &decoded);
+}
+
+static void test_version_2_round_trip(void)
+{
+    uint8_t buffer[40];
+    struct position_fix decoded;
+    fix.flags |= POSITION_FLAG_ALTITUDE_VALID | POSITION_FLAG_DOP_VALID;
+    // below sea level, the 24 bit altitude has to be sign extended
+    fix.altitude = -4300;
+    fix.satellites = 12;
+    fix.hdop = 92;
+    TEST_ASSERT_EQUAL_UINT8(POSITION_PACKET_QUALITY_LENGTH, position_packet_encode(&fix, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_HEX8(POSITION_PACKET_MAGIC | POSITION_PACKET_QUALITY_VERSION, buffer[0]);
+    TEST_ASSERT_TRUE(position_packet_decode(buffer, POSITION_PACKET_QUALITY_LENGTH, &decoded));
+    assert_same(&fix, &decoded);
+}
+
+static void test_little_endian_layout(void)
+{
+    uint8_t buffer[40];
+    fix.latitude = 0x01020304;
+    position_packet_encode(&fix, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_MEMORY("KD4XYZ", buffer + 1, CALL_SIGN_LENGTH);
+    TEST_ASSERT_EQUAL_HEX8(0x04, buffer[8]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, buffer[11]);
+}
+
+static void test_decode_rejects(void)
+{
+    uint8_t buffer[40];
+    struct position_fix decoded;
+    position_packet_encode(&fix, buffer, sizeof(buffer));
+    TEST_ASSERT_FALSE(position_packet_decode(buffer, POSITION_PACKET_LENGTH - 1, &decoded));
+    buffer[0] = POSITION_PACKET_MAGIC | 7;
+    TEST_ASSERT_FALSE(position_packet_decode(buffer, POSITION_PACKET_LENGTH, &decoded));
+    buffer[0] = POSITION_HISTORY_MAGIC | POSITION_HISTORY_VERSION;
+    TEST_ASSERT_FALSE(position_packet_decode(buffer, POSITION_PACKET_LENGTH, &decoded));
+    // a version 2 packet cut to the version 1 length is not taken for one
+    fix.flags |= POSITION_FLAG_ALTITUDE_VALID;
+    position_packet_encode(&fix, buffer, sizeof(buffer));
+    TEST_ASSERT_FALSE(position_packet_decode(buffer, POSITION_PACKET_LENGTH, &decoded));
+}
+
+static void test_buffer_too_small(void)
+{
+    uint8_t buffer[POSITION_PACKET_LENGTH];
+    TEST_ASSERT_EQUAL_UINT8(0, position_packet_encode(&fix, buffer, POSITION_PACKET_LENGTH - 1));
+    fix.flags |= POSITION_FLAG_DOP_VALID;
+    TEST_ASSERT_EQUAL_UINT8(0, position_packet_encode(&fix, buffer, sizeof(buffer)));
+}
+
+static void test_record_round_trip(void)
+{
+    uint8_t record[POSITION_RECORD_LENGTH];
+    struct position_fix unpacked;
+    memcpy(unpacked.call_sign, fix.call_sign, CALL_SIGN_LENGTH);
+    fix.flags |= POSITION_FLAG_ALTITUDE_VALID;
+    fix.altitude = 963;
+    position_record_pack(&fix, record);
+    TEST_ASSERT_EQUAL_UINT16(fix.date, position_record_date(record));
+    position_record_unpack(record, &unpacked);
+    // a record keeps neither the altitude nor its flag
+    fix.flags &= ~POSITION_FLAG_ALTITUDE_VALID;
+    fix.altitude = 0;
+    assert_same(&fix, &unpacked);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_version_1_round_trip);
+    RUN_TEST(test_version_2_round_trip);
+    RUN_TEST(test_little_endian_layout);
+    RUN_TEST(test_decode_rejects);
+    RUN_TEST(test_buffer_too_small);
+    RUN_TEST(test_record_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_report_policy.cpp
+    @author Ralph Blach
+    @brief Which fixes the report policy sends and why, and the fix interval it picks.
+
+    pio test -e native_test -f test_report_policy
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <report_policy.h>
+
+/**
+    @brief a tracker going north at 10 knots, 5.144 m a second is about 462 1e-7 degrees of
+    latitude
+*/
+#define TEST_SPEED 1000        /*!< 0.01 knots */
+#define TEST_NORTH_A_SECOND 462 /*!< 1e-7 degrees */
+
+static struct report_policy policy;
+
+static void make_fix(uint32_t second, uint16_t speed, struct position_fix *fix)
+{
+    /**
+        @brief a fix second seconds into the day, moving north at speed from 35.7796 N 78.6382 W
+    */
+    memset(fix, 0, sizeof(*fix));
+    memcpy(fix->call_sign, "KD4XYZ", CALL_SIGN_LENGTH);
+    fix->flags = POSITION_FLAG_VALID | POSITION_FLAG_SPEED_VALID | POSITION_FLAG_COURSE_VALID;
+    fix->latitude = 357796000 + (int32_t)(second * TEST_NORTH_A_SECOND * speed / TEST_SPEED);
+    fix->longitude = -786382000;
+    fix->time_of_day = second * 100;
+    fix->date = (26 << 9) | (10 << 5) | 16;
+    fix->speed = speed;
+    fix->course = 0;
+}
+
+void setUp(void)
+{
+    report_policy_init(&policy);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_first_then_nothing_new(void)
+{
+    struct position_fix fix;
+    make_fix(3600, 0, &fix);
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_FIRST, report_policy_check(&policy, &fix));
+    for (uint32_t second = 3601; second < 3600 + REPORT_DEFAULT_HEARTBEAT; second++)
+    {
+        make_fix(3600, 0, &fix);
+        fix.time_of_day = second * 100;
+        TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+    }
+    TEST_ASSERT_EQUAL_UINT32(REPORT_DEFAULT_HEARTBEAT - 1, policy.suppressed);
+    fix.time_of_day = (3600 + REPORT_DEFAULT_HEARTBEAT) * 100;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_HEARTBEAT, report_policy_check(&policy, &fix));
+}
+
+static void test_heartbeat_across_midnight(void)
+{
+    struct position_fix fix;
+    make_fix(86400 - 10, 0, &fix);
+    report_policy_check(&policy, &fix);
+    fix.time_of_day = 100;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+    fix.time_of_day = (REPORT_DEFAULT_HEARTBEAT - 10) * 100;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_HEARTBEAT, report_policy_check(&policy, &fix));
+}
+
+static void test_status_change(void)
+{
+    struct position_fix fix;
+    make_fix(3600, 0, &fix);
+    report_policy_check(&policy, &fix);
+    make_fix(3601, 0, &fix);
+    fix.flags = 0;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_STATUS, report_policy_check(&policy, &fix));
+    // a void fix has no position, only the heartbeat or the fix coming back send it
+    make_fix(3700, 0, &fix);
+    fix.flags = 0;
+    fix.latitude += 10000000;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+    make_fix(3701, 0, &fix);
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_STATUS, report_policy_check(&policy, &fix));
+}
+
+static void test_dead_reckoned(void)
+{
+    struct position_fix fix;
+    make_fix(3600, TEST_SPEED, &fix);
+    report_policy_check(&policy, &fix);
+    // where the base expects it, going straight on at the same speed
+    for (uint32_t second = 3601; second <= 3660; second++)
+    {
+        make_fix(second, TEST_SPEED, &fix);
+        TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+    }
+}
+
+static void test_distance(void)
+{
+    struct position_fix fix;
+    make_fix(3600, 0, &fix);
+    report_policy_check(&policy, &fix);
+    // 60 m north while standing still, held back until min_interval has passed
+    make_fix(3600 + REPORT_DEFAULT_MIN_INTERVAL - 1, 0, &fix);
+    fix.latitude += 5400;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+    fix.time_of_day += 100;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_DISTANCE, report_policy_check(&policy, &fix));
+    // 30 m more is inside the distance
+    fix.time_of_day += REPORT_DEFAULT_MIN_INTERVAL * 100;
+    fix.latitude += 2700;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+}
+
+static void test_turn_starts_burst(void)
+{
+    struct position_fix fix;
+    make_fix(3600, TEST_SPEED, &fix);
+    report_policy_check(&policy, &fix);
+    make_fix(3601, TEST_SPEED, &fix);
+    fix.course = REPORT_DEFAULT_COURSE_CHANGE;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_COURSE, report_policy_check(&policy, &fix));
+    for (uint8_t index = 1; index < REPORT_DEFAULT_BURST_LENGTH; index++)
+    {
+        make_fix(3601 + index, TEST_SPEED, &fix);
+        fix.course = REPORT_DEFAULT_COURSE_CHANGE;
+        TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_BURST, report_policy_check(&policy, &fix));
+    }
+    TEST_ASSERT_EQUAL_UINT16(1, policy.reasons[REPORT_REASON_COURSE]);
+    TEST_ASSERT_EQUAL_UINT16(REPORT_DEFAULT_BURST_LENGTH - 1, policy.reasons[REPORT_REASON_BURST]);
+}
+
+static void test_course_wraps(void)
+{
+    struct position_fix fix;
+    make_fix(3600, TEST_SPEED, &fix);
+    fix.course = 35900;
+    report_policy_check(&policy, &fix);
+    // 359 to 1 degree is a turn of 2, not 358
+    make_fix(3601, TEST_SPEED, &fix);
+    fix.course = 100;
+    fix.latitude = policy.last.latitude + TEST_NORTH_A_SECOND;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+}
+
+static void test_course_ignored_standing_still(void)
+{
+    struct position_fix fix;
+    make_fix(3600, REPORT_DEFAULT_MOVING_SPEED - 1, &fix);
+    report_policy_check(&policy, &fix);
+    make_fix(3601, REPORT_DEFAULT_MOVING_SPEED - 1, &fix);
+    fix.course = 18000;
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_NONE, report_policy_check(&policy, &fix));
+}
+
+static void test_speed_change(void)
+{
+    struct position_fix fix;
+    make_fix(3600, TEST_SPEED, &fix);
+    report_policy_check(&policy, &fix);
+    make_fix(3601, TEST_SPEED + REPORT_DEFAULT_SPEED_CHANGE, &fix);
+    TEST_ASSERT_EQUAL_UINT8(REPORT_REASON_SPEED, report_policy_check(&policy, &fix));
+}
+
+static void test_fix_interval(void)
+{
+    struct position_fix fix;
+    TEST_ASSERT_EQUAL_UINT16(REPORT_DEFAULT_PARKED_FIX_INTERVAL, policy.fix_interval);
+    make_fix(3600, TEST_SPEED, &fix);
+    report_policy_check(&policy, &fix);
+    TEST_ASSERT_EQUAL_UINT16(REPORT_DEFAULT_MOVING_FIX_INTERVAL, policy.fix_interval);
+    // it stays fast until the tracker has stood still for parked_fixes fixes
+    for (uint8_t index = 1; index <= REPORT_DEFAULT_PARKED_FIXES; index++)
+    {
+        make_fix(3600 + index, 0, &fix);
+        report_policy_check(&policy, &fix);
+        TEST_ASSERT_EQUAL_UINT16(REPORT_DEFAULT_MOVING_FIX_INTERVAL, policy.fix_interval);
+    }
+    make_fix(3700, 0, &fix);
+    report_policy_check(&policy, &fix);
+    TEST_ASSERT_EQUAL_UINT16(REPORT_DEFAULT_PARKED_FIX_INTERVAL, policy.fix_interval);
+    // a void fix changes nothing
+    fix.flags = 0;
+    fix.speed = TEST_SPEED;
+    report_policy_check(&policy, &fix);
+    TEST_ASSERT_EQUAL_UINT16(REPORT_DEFAULT_PARKED_FIX_INTERVAL, policy.fix_interval);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_then_nothing_new);
+    RUN_TEST(test_heartbeat_across_midnight);
+    RUN_TEST(test_status_change);
+    RUN_TEST(test_dead_reckoned);
+    RUN_TEST(test_distance);
+    RUN_TEST(test_turn_starts_burst);
+    RUN_TEST(test_course_wraps);
+    RUN_TEST(test_course_ignored_standing_still);
+    RUN_TEST(test_speed_change);
+    RUN_TEST(test_fix_interval);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_slot_scheduler.cpp
+    @author Ralph Blach
+    @brief Where the slot of a tracker falls in the frame, and how the clock follows utc.
+
+    pio test -e native_test -f test_slot_scheduler
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <slot_scheduler.h>
+
+/**
+    @brief 10 slots of 100 ms, this tracker has slot 3, from 305 to 395 ms after the second
+*/
+#define TEST_SLOTS 10
+#define TEST_SLOT 3
+#define TEST_START 10000000ULL     /*!< micros() of the first sync */
+#define TEST_NOON (12 * 3600 * 100UL) /*!< 10 ms ticks */
+
+static struct slot_scheduler scheduler;
+
+static void sync_at(uint32_t second, int32_t ppm)
+{
+    /**
+        @brief a fix for second seconds after noon whose line feed comes when a local clock
+        running ppm fast says so, the virtual clock is set to it
+    */
+    uint64_t local = TEST_START + (uint64_t)second * 1000000ULL + (int64_t)second * ppm;
+    native_set_micros(local);
+    slot_scheduler_sync(&scheduler, TEST_NOON + second * 100, (uint32_t)local);
+}
+
+void setUp(void)
+{
+    native_set_micros(TEST_START);
+    slot_scheduler_init(&scheduler, TEST_SLOT, TEST_SLOTS);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_open_until_synced(void)
+{
+    TEST_ASSERT_FALSE(scheduler.synced);
+    TEST_ASSERT_EQUAL_UINT16(0, slot_scheduler_wait(&scheduler, 10));
+    slot_scheduler_init(&scheduler, TEST_SLOTS + TEST_SLOT, TEST_SLOTS);
+    TEST_ASSERT_EQUAL_UINT8(TEST_SLOT, scheduler.slot);
+}
+
+static void test_phase(void)
+{
+    sync_at(0, 0);
+    TEST_ASSERT_EQUAL_UINT16(305, slot_scheduler_wait(&scheduler, 10));
+    native_advance_micros(305000);
+    TEST_ASSERT_EQUAL_UINT16(0, slot_scheduler_wait(&scheduler, 10));
+    native_advance_micros(80000);
+    TEST_ASSERT_EQUAL_UINT16(0, slot_scheduler_wait(&scheduler, 10));
+    // 385 ms, 10 ms more runs into the guard at the end, wait for the next frame
+    TEST_ASSERT_EQUAL_UINT16(920, slot_scheduler_wait(&scheduler, 11));
+    native_advance_micros(10000);
+    TEST_ASSERT_EQUAL_UINT16(910, slot_scheduler_wait(&scheduler, 1));
+}
+
+static void test_long_frame_at_slot_start(void)
+{
+    sync_at(0, 0);
+    native_advance_micros(305000);
+    TEST_ASSERT_EQUAL_UINT16(0, slot_scheduler_wait(&scheduler, 500));
+    native_advance_micros(1000);
+    TEST_ASSERT_EQUAL_UINT16(999, slot_scheduler_wait(&scheduler, 500));
+}
+
+static void test_phase_of_later_fix(void)
+{
+    // a fix for 250 ms after the second, the phase carries on from it
+    sync_at(0, 0);
+    native_set_micros(TEST_START + 3250000);
+    slot_scheduler_sync(&scheduler, TEST_NOON + 325, (uint32_t)(TEST_START + 3250000));
+    TEST_ASSERT_EQUAL_UINT16(55, slot_scheduler_wait(&scheduler, 10));
+    TEST_ASSERT_EQUAL_INT32(0, scheduler.stats.last_error);
+}
+
+static void test_drift_measured(void)
+{
+    // the local clock runs 0.2 percent fast, each second it is 2 ms ahead of utc
+    for (uint32_t second = 0; second <= SLOT_RATE_SPAN / 1000 * 4; second++)
+    {
+        sync_at(second, 2000);
+    }
+    TEST_ASSERT_TRUE(scheduler.rate_known);
+    TEST_ASSERT_INT_WITHIN(20, 2000, scheduler.ppm);
+    // once the rate is known a sync only moves the edge by the rounding
+    TEST_ASSERT_INT_WITHIN(20, 0, scheduler.stats.last_error);
+    // the slot starts 305 ms of utc after the second, which is 305.61 ms of the local clock
+    native_advance_micros(305000);
+    TEST_ASSERT_EQUAL_UINT16(1, slot_scheduler_wait(&scheduler, 10));
+    native_advance_micros(620);
+    TEST_ASSERT_EQUAL_UINT16(0, slot_scheduler_wait(&scheduler, 10));
+}
+
+static void test_drift_without_rate(void)
+{
+    // before the rate is known the edge moves by what the clock ran off in a second
+    sync_at(0, 2000);
+    sync_at(1, 2000);
+    TEST_ASSERT_FALSE(scheduler.rate_known);
+    TEST_ASSERT_INT_WITHIN(2, -2000, scheduler.stats.last_error);
+    TEST_ASSERT_EQUAL_UINT32(2000, scheduler.stats.worst_error);
+}
+
+static void test_holdover(void)
+{
+    // the slots are kept for SLOT_HOLDOVER without a fix, then the gate opens
+    sync_at(0, 0);
+    native_advance_micros(SLOT_HOLDOVER * 1000ULL);
+    TEST_ASSERT_EQUAL_UINT16(305, slot_scheduler_wait(&scheduler, 10));
+    native_advance_micros(1);
+    TEST_ASSERT_EQUAL_UINT16(0, slot_scheduler_wait(&scheduler, 10));
+    TEST_ASSERT_FALSE(scheduler.synced);
+}
+
+static void test_pps(void)
+{
+    // the edge of the second, the RMC for it comes 80 ms later
+    native_set_micros(TEST_START);
+    slot_scheduler_pps(&scheduler);
+    native_set_micros(TEST_START + 80000);
+    slot_scheduler_sync(&scheduler, TEST_NOON, (uint32_t)(TEST_START + 80000));
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.stats.pps_syncs);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)TEST_START, scheduler.sync_micros);
+    TEST_ASSERT_EQUAL_UINT16(225, slot_scheduler_wait(&scheduler, 10));
+    // a fix that is not on a whole second does not use the edge
+    slot_scheduler_pps(&scheduler);
+    native_advance_micros(50000);
+    slot_scheduler_sync(&scheduler, TEST_NOON + 13, micros());
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.stats.pps_syncs);
+    TEST_ASSERT_FALSE(scheduler.pps_seen);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_open_until_synced);
+    RUN_TEST(test_phase);
+    RUN_TEST(test_long_frame_at_slot_start);
+    RUN_TEST(test_phase_of_later_fix);
+    RUN_TEST(test_drift_measured);
+    RUN_TEST(test_drift_without_rate);
+    RUN_TEST(test_holdover);
+    RUN_TEST(test_pps);
+    return UNITY_END();
+}
@@ -0,0 +1,239 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  test_tx_queue.cpp
+    @author Ralph Blach
+    @brief The acks, the retries and their flags, and the backoff of the transmit queue.
+
+    pio test -e native_test -f test_tx_queue
+**/
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <RadioHead.h>
+#include <RH_RF69.h>
+#include <tx_queue.h>
+
+/**
+    @brief the addresses and the retry policy
+*/
+#define TEST_THIS_ADDRESS 2  /*!< the tracker */
+#define TEST_BASE_ADDRESS 1  /*!< the base station */
+#define TEST_RETRIES 2       /*!< resends after the first try */
+#define TEST_ACK_TIMEOUT 200 /*!< ms */
+#define TEST_BACKOFF 100     /*!< ms a retry */
+
+extern RH_RF69 rf69;
+
+static struct tx_queue queue;
+static uint8_t completed;
+static bool completed_delivered;
+static uint8_t completed_attempts;
+
+static void on_complete(struct tx_queue *queue, const struct tx_frame *frame, bool delivered, uint8_t attempts)
+{
+    completed++;
+    completed_delivered = delivered;
+    completed_attempts = attempts;
+}
+
+static void push(void)
+{
+    static const uint8_t payload[] = {0xB1, 'K', 'D', '4', 'X', 'Y', 'Z'};
+    TEST_ASSERT_TRUE(tx_queue_push(&queue, payload, sizeof(payload), TEST_BASE_ADDRESS));
+}
+
+static void advance(uint32_t milliseconds)
+{
+    native_advance_micros(milliseconds * 1000ULL);
+    tx_queue_service(&queue);
+}
+
+static void inject_ack(uint8_t id)
+{
+    native_rf69_frame ack;
+    ack.to = TEST_THIS_ADDRESS;
+    ack.from = TEST_BASE_ADDRESS;
+    ack.id = id;
+    ack.flags = RH_FLAGS_ACK;
+    ack.rssi = -70;
+    ack.payload.push_back('!');
+    rf69.native_inject(ack);
+}
+
+void setUp(void)
+{
+    native_set_micros(10000000);
+    native_set_random_state(1);
+    rf69.native_sent.clear();
+    rf69.native_received.clear();
+    rf69.native_auto_ack = false;
+    rf69.setModeIdle();
+    tx_queue_init(&queue, &rf69, TEST_THIS_ADDRESS);
+    tx_queue_set_retries(&queue, TEST_RETRIES, TEST_ACK_TIMEOUT, TEST_BACKOFF);
+    queue.on_complete = on_complete;
+    completed = 0;
+    completed_delivered = false;
+    completed_attempts = 0;
+}
+
+void tearDown(void)
+{
+    rf69.native_auto_ack = true;
+}
+
+static void test_acked_once(void)
+{
+    rf69.native_auto_ack = true;
+    push();
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT32(1, rf69.native_sent.size());
+    TEST_ASSERT_EQUAL_UINT8(TEST_BASE_ADDRESS, rf69.native_sent[0].to);
+    TEST_ASSERT_EQUAL_UINT8(TEST_THIS_ADDRESS, rf69.native_sent[0].from);
+    TEST_ASSERT_EQUAL_HEX8(RH_FLAGS_NONE, rf69.native_sent[0].flags);
+    TEST_ASSERT_EQUAL_UINT8(1, completed);
+    TEST_ASSERT_TRUE(completed_delivered);
+    TEST_ASSERT_EQUAL_UINT8(1, completed_attempts);
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats.delivered);
+    TEST_ASSERT_EQUAL_INT16(-60, queue.stats.last_ack_rssi);
+    TEST_ASSERT_TRUE(tx_queue_idle(&queue));
+}
+
+static void test_retries_flagged(void)
+{
+    push();
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT8(TX_STATE_WAIT_ACK, queue.state);
+    // every retry has the flag and the id of the first try, so the base can drop the copies
+    for (uint8_t attempt = 1; attempt <= TEST_RETRIES; attempt++)
+    {
+        advance(TEST_ACK_TIMEOUT - 1);
+        TEST_ASSERT_EQUAL_UINT32(attempt, rf69.native_sent.size());
+        advance(1);
+        TEST_ASSERT_EQUAL_UINT8(TX_STATE_BACKOFF, queue.state);
+        advance(TEST_BACKOFF * attempt);
+        TEST_ASSERT_EQUAL_UINT32(attempt + 1, rf69.native_sent.size());
+        TEST_ASSERT_EQUAL_HEX8(RH_FLAGS_RETRY, rf69.native_sent[attempt].flags);
+        TEST_ASSERT_EQUAL_UINT8(rf69.native_sent[0].id, rf69.native_sent[attempt].id);
+    }
+    advance(TEST_ACK_TIMEOUT);
+    TEST_ASSERT_EQUAL_UINT8(1, completed);
+    TEST_ASSERT_FALSE(completed_delivered);
+    TEST_ASSERT_EQUAL_UINT8(TEST_RETRIES + 1, completed_attempts);
+    TEST_ASSERT_EQUAL_UINT32(TEST_RETRIES, queue.stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats.failed);
+    TEST_ASSERT_TRUE(tx_queue_idle(&queue));
+}
+
+static void test_next_frame_new_id(void)
+{
+    uint8_t first;
+    rf69.native_auto_ack = true;
+    push();
+    push();
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT32(2, rf69.native_sent.size());
+    first = rf69.native_sent[0].id;
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)(first + 1), rf69.native_sent[1].id);
+    TEST_ASSERT_EQUAL_HEX8(RH_FLAGS_NONE, rf69.native_sent[1].flags);
+    TEST_ASSERT_EQUAL_UINT32(2, queue.stats.delivered);
+}
+
+static void test_backoff_grows(void)
+{
+    uint16_t longest[TEST_RETRIES + 1] = {0};
+    bool differ = false;
+    uint16_t first = 0;
+    uint16_t backoff;
+    // the backoff of retry n is random between 0 and n steps
+    for (unsigned long seed = 1; seed <= 50; seed++)
+    {
+        setUp();
+        native_set_random_state(seed);
+        push();
+        tx_queue_service(&queue);
+        for (uint8_t attempt = 1; attempt <= TEST_RETRIES; attempt++)
+        {
+            advance(TEST_ACK_TIMEOUT);
+            // a backoff of 0 has already sent the retry
+            backoff = queue.state == TX_STATE_BACKOFF ? queue.timer_length : 0;
+            TEST_ASSERT_LESS_OR_EQUAL(TEST_BACKOFF * attempt, backoff);
+            if (backoff > longest[attempt])
+            {
+                longest[attempt] = backoff;
+            }
+            if (attempt == 1)
+            {
+                differ = differ || (seed > 1 && backoff != first);
+                first = seed == 1 ? backoff : first;
+            }
+            advance(backoff);
+            TEST_ASSERT_EQUAL_UINT32(attempt + 1, rf69.native_sent.size());
+        }
+    }
+    // two trackers that collided do not wait the same time, and later retries wait longer
+    TEST_ASSERT_TRUE(differ);
+    TEST_ASSERT_GREATER_THAN(longest[1], longest[2]);
+    TEST_ASSERT_GREATER_THAN(TEST_BACKOFF, longest[2]);
+}
+
+static void test_late_ack_in_backoff(void)
+{
+    push();
+    tx_queue_service(&queue);
+    advance(TEST_ACK_TIMEOUT);
+    TEST_ASSERT_EQUAL_UINT8(TX_STATE_BACKOFF, queue.state);
+    inject_ack(rf69.native_sent[0].id);
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT8(1, completed);
+    TEST_ASSERT_TRUE(completed_delivered);
+    TEST_ASSERT_EQUAL_UINT32(1, rf69.native_sent.size());
+}
+
+static void test_foreign_ack_ignored(void)
+{
+    push();
+    tx_queue_service(&queue);
+    inject_ack((uint8_t)(rf69.native_sent[0].id + 1));
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT8(0, completed);
+    TEST_ASSERT_EQUAL_UINT8(TX_STATE_WAIT_ACK, queue.state);
+    inject_ack(rf69.native_sent[0].id);
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT8(1, completed);
+}
+
+static void test_broadcast_not_acked(void)
+{
+    static const uint8_t payload[] = {'h', 'i'};
+    TEST_ASSERT_TRUE(tx_queue_push(&queue, payload, sizeof(payload), RH_BROADCAST_ADDRESS));
+    tx_queue_service(&queue);
+    TEST_ASSERT_EQUAL_UINT8(1, completed);
+    TEST_ASSERT_TRUE(completed_delivered);
+    TEST_ASSERT_TRUE(tx_queue_idle(&queue));
+}
+
+static void test_full_queue(void)
+{
+    for (uint8_t index = 0; index < TX_QUEUE_CAPACITY; index++)
+    {
+        push();
+    }
+    TEST_ASSERT_NULL(tx_queue_reserve(&queue));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats.dropped);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_acked_once);
+    RUN_TEST(test_retries_flagged);
+    RUN_TEST(test_next_frame_new_id);
+    RUN_TEST(test_backoff_grows);
+    RUN_TEST(test_late_ack_in_backoff);
+    RUN_TEST(test_foreign_ack_ignored);
+    RUN_TEST(test_broadcast_not_acked);
+    RUN_TEST(test_full_queue);
+    return UNITY_END();
+}
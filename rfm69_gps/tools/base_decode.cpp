@@ -0,0 +1,211 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  base_decode.cpp
+    @author Ralph Blach
+    @brief Turns the RX lines of the base station receiver into a track for each tracker, on the host.
+
+    Build it from the rfm69_gps directory with
+        g++ -std=gnu++17 -O2 -pthread -Iinclude -Inative/include tools/base_decode.cpp tools/base_station.cpp \
+            src/position_packet.cpp src/packet_builder.cpp src/nmea.cpp -o base_decode
+    native/include is only there for the arduino types in the headers.  Run it on a capture, or
+    straight on the port once stty has set its speed
+        ./base_decode capture.txt
+        ./base_decode -o tracks /dev/ttyUSB0
+    Without -o every new fix is printed as a csv line as soon as it is decoded.  With -o each
+    tracker's fixes are written to <directory>/<address>.csv at the end, in time order.  The
+    counters of each tracker and the decode rate are printed on stderr at the end.
+        -t <threads>    threads to decode with, the number of cpus by default
+        -o <directory>  write the tracks there instead of printing the fixes
+**/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include "base_station.h"
+
+/**
+    @brief bytes read at a time
+*/
+#define READ_SIZE (1 << 20)
+
+static void print_fix(FILE *out, const struct base_node &node, const struct base_fix &entry)
+{
+    /**
+        @brief one csv line, the columns are in print_header
+    */
+    const struct position_fix &fix = entry.fix;
+    fprintf(out, "%u,%s,20%02u-%02u-%02u,%02u:%02u:%05.2f,", node.address, node.call_sign, fix.date >> 9,
+            (fix.date >> 5) & 0x0f, fix.date & 0x1f, fix.time_of_day / 360000, fix.time_of_day / 6000 % 60,
+            fix.time_of_day % 6000 / 100.0);
+    if (fix.flags & POSITION_FLAG_VALID)
+    {
+        fprintf(out, "%.7f,%.7f,", fix.latitude / 1e7, fix.longitude / 1e7);
+    }
+    else
+    {
+        fputs(",,", out);
+    }
+    if (fix.flags & POSITION_FLAG_SPEED_VALID)
+    {
+        fprintf(out, "%.2f", fix.speed / 100.0);
+    }
+    fputc(',', out);
+    if (fix.flags & POSITION_FLAG_COURSE_VALID)
+    {
+        fprintf(out, "%.2f", fix.course / 100.0);
+    }
+    fputc(',', out);
+    if (fix.flags & POSITION_FLAG_ALTITUDE_VALID)
+    {
+        fprintf(out, "%.1f", fix.altitude / 10.0);
+    }
+    fputc(',', out);
+    if (fix.flags & POSITION_FLAG_DOP_VALID)
+    {
+        fprintf(out, "%u,%.2f", fix.satellites, fix.hdop / 100.0);
+    }
+    else
+    {
+        fputc(',', out);
+    }
+    fprintf(out, ",%s,%u\n", base_kind_names[entry.kind], entry.time);
+}
+
+static void print_header(FILE *out)
+{
+    fputs("address,call_sign,date,time,latitude,longitude,knots,course,altitude_m,satellites,hdop,packet,received_ms\n",
+          out);
+}
+
+static bool write_tracks(const base_station &station, const char *directory)
+{
+    /**
+        @brief a csv file a tracker, its fixes by date and time, history fixes in their place
+    */
+    char path[4096];
+    for (const auto &entry : station.nodes)
+    {
+        std::vector<struct base_fix> track = entry.second.track;
+        FILE *out;
+        std::stable_sort(track.begin(), track.end(), [](const struct base_fix &a, const struct base_fix &b) {
+            return a.fix.date != b.fix.date ? a.fix.date < b.fix.date : a.fix.time_of_day < b.fix.time_of_day;
+        });
+        snprintf(path, sizeof(path), "%s/%u.csv", directory, entry.first);
+        if ((out = fopen(path, "w")) == NULL)
+        {
+            perror(path);
+            return false;
+        }
+        print_header(out);
+        for (const struct base_fix &fix : track)
+        {
+            print_fix(out, entry.second, fix);
+        }
+        fclose(out);
+    }
+    return true;
+}
+
+static void print_summary(const base_station &station, double seconds)
+{
+    const struct base_stats &stats = station.stats;
+    fprintf(stderr, "%5s %-6s %7s %6s %7s %6s %6s %5s %5s %5s %5s %5s %5s %4s\n", "addr", "call", "frames", "dups",
+            "fixes", "again", "backf", "telem", "1try", "2try", "3try", "4+", "fail", "rssi");
+    for (const auto &entry : station.nodes)
+    {
+        const struct base_node &node = entry.second;
+        fprintf(stderr, "%5u %-6s %7u %6u %7zu %6u %6u %5u %5u %5u %5u %5u %5u %4d\n", node.address, node.call_sign,
+                node.frames, node.duplicate_frames, node.track.size(), node.duplicate_fixes, node.backfilled,
+                node.telemetry, node.attempts[0], node.attempts[1], node.attempts[2], node.attempts[3], node.failed,
+                node.rssi);
+    }
+    fprintf(stderr, "%llu lines, %llu console text, %llu bad, %llu frames, %llu sent again, %llu fixes, %llu fixes "
+                    "again\n",
+            (unsigned long long)stats.lines, (unsigned long long)stats.text, (unsigned long long)stats.bad,
+            (unsigned long long)stats.frames, (unsigned long long)stats.duplicate_frames,
+            (unsigned long long)stats.fixes, (unsigned long long)stats.duplicate_fixes);
+    for (uint8_t kind = 0; kind < BASE_KIND_COUNT; kind++)
+    {
+        fprintf(stderr, "%s%s %llu", kind ? ", " : "", base_kind_names[kind], (unsigned long long)stats.kinds[kind]);
+    }
+    fprintf(stderr, "\n%.3f s, %.0f frames/s\n", seconds, seconds > 0 ? stats.frames / seconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *directory = NULL;
+    std::vector<char> buffer(READ_SIZE);
+    int input = 0;
+    int option;
+    ssize_t got;
+
+    while ((option = getopt(argc, argv, "t:o:")) != -1)
+    {
+        switch (option)
+        {
+        case 't':
+            threads = (unsigned)atoi(optarg);
+            break;
+        case 'o':
+            directory = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-o directory] [capture or port]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc && (input = open(argv[optind], O_RDONLY)) < 0)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (directory == NULL)
+    {
+        print_header(stdout);
+    }
+    base_station station(threads, [directory](const struct base_node &node, const struct base_fix &fix) {
+        if (directory == NULL)
+        {
+            print_fix(stdout, node, fix);
+        }
+    });
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while ((got = read(input, buffer.data(), buffer.size())) != 0)
+    {
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("read");
+            break;
+        }
+        station.feed(buffer.data(), (size_t)got);
+        if ((size_t)got < buffer.size())
+        {
+            // a port gives what it has, do not hold a fix back until a batch is full
+            station.flush();
+            fflush(stdout);
+        }
+    }
+    station.finish();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    if (input != 0)
+    {
+        close(input);
+    }
+    print_summary(station, seconds.count());
+    if (directory != NULL && !write_tracks(station, directory))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,556 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  base_station.cpp
+    @author Ralph Blach
+    @brief The RX line format, the payload decoders and the threads of the base station decoder.
+**/
+#include <string.h>
+#include <nmea.h>
+#include <link_adapter.h>
+#include "base_station.h"
+
+const char *const base_kind_names[BASE_KIND_COUNT] = {"unknown", "ascii", "position", "history",
+                                                      "batch", "telemetry", "link"};
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static bool parse_number(const char **text, const char *end, int32_t *value)
+{
+    /**
+        @brief read a decimal number and the space after it, if there is one
+    */
+    const char *position = *text;
+    bool negative = position < end && *position == '-';
+    int64_t number = 0;
+
+    if (negative)
+    {
+        position++;
+    }
+    if (position == end || *position < '0' || *position > '9')
+    {
+        return false;
+    }
+    while (position < end && *position >= '0' && *position <= '9')
+    {
+        number = number * 10 + (*position++ - '0');
+        if (number > INT32_MAX)
+        {
+            return false;
+        }
+    }
+    if (position < end && *position != ' ')
+    {
+        return false;
+    }
+    *value = (int32_t)(negative ? -number : number);
+    *text = position < end ? position + 1 : position;
+    return true;
+}
+
+bool base_frame_parse(const char *line, size_t length, struct base_frame *frame)
+/**@brief read an RX line
+ *
+ * @param line the line, the line feed and a carriage return before it are allowed
+ * @param length its length
+ * @param frame where the frame is put
+ * @return true if it is a whole RX line
+ */
+{
+    const char *end = line + length;
+    const char *position = line + 3;
+    int32_t values[5];
+    uint8_t index;
+
+    while (end > line && (end[-1] == '\n' || end[-1] == '\r'))
+    {
+        end--;
+    }
+    if (end - line < 3 || memcmp(line, "RX ", 3) != 0)
+    {
+        return false;
+    }
+    for (index = 0; index < 5; index++)
+    {
+        if (!parse_number(&position, end, &values[index]))
+        {
+            return false;
+        }
+    }
+    if (values[0] < 0 || values[1] < 0 || values[1] > 255 || values[2] < 0 || values[2] > 255 || values[3] < 0 ||
+        values[3] > 255 || (end - position) % 2 != 0 || (end - position) / 2 > BASE_FRAME_MAX)
+    {
+        return false;
+    }
+    frame->time = (uint32_t)values[0];
+    frame->from = (uint8_t)values[1];
+    frame->id = (uint8_t)values[2];
+    frame->flags = (uint8_t)values[3];
+    frame->rssi = (int16_t)values[4];
+    frame->length = (uint8_t)((end - position) / 2);
+    for (index = 0; index < frame->length; index++)
+    {
+        uint8_t high = nmea_hex_value(position[index * 2]);
+        uint8_t low = nmea_hex_value(position[index * 2 + 1]);
+        if (high == 0xff || low == 0xff)
+        {
+            return false;
+        }
+        frame->data[index] = (uint8_t)(high << 4 | low);
+    }
+    return true;
+}
+
+size_t base_frame_format(const struct base_frame *frame, char *line, size_t size)
+/**@brief write the RX line of a frame, as the receiver prints it
+ *
+ * @param frame the frame
+ * @param line where the line is written, with a line feed and a null after it
+ * @param size the size of line, 36 + 2 * BASE_FRAME_MAX is always enough
+ * @return the length of the line, 0 if it did not fit
+ */
+{
+    int length = snprintf(line, size, "RX %u %u %u %u %d ", frame->time, frame->from, frame->id, frame->flags,
+                          frame->rssi);
+    uint8_t index;
+
+    if (length < 0 || (size_t)length + frame->length * 2 + 2 > size)
+    {
+        return 0;
+    }
+    for (index = 0; index < frame->length; index++)
+    {
+        line[length++] = hex_digits[frame->data[index] >> 4];
+        line[length++] = hex_digits[frame->data[index] & 0x0f];
+    }
+    line[length++] = '\n';
+    line[length] = 0;
+    return (size_t)length;
+}
+
+bool base_ascii_decode(const uint8_t *data, uint8_t length, struct position_fix *fix)
+/**@brief decode the legacy ascii packet of POSITION_PACKET_LEGACY_ASCII
+ *
+ * A fix is sent as call sign,time,A,latitude,N or S,longitude,E or W,date from the fields of
+ * the RMC, without the speed and course.  Without a fix it is call sign,V, and some of the
+ * RMC run together, which has no position in it.
+ * @param data the payload
+ * @param length its length
+ * @param fix where the fix is put
+ * @return true if it had a fix
+ */
+{
+    char text[BASE_FRAME_MAX + 1];
+    char empty[] = "";
+    char *fields[RMC_DATE];
+    char *tokens[RMC_DATE + 1];
+    uint8_t count = 0;
+    char *next;
+
+    if (length <= CALL_SIGN_LENGTH || data[CALL_SIGN_LENGTH] != ',' || length > BASE_FRAME_MAX)
+    {
+        return false;
+    }
+    memcpy(text, data, length);
+    text[length] = 0;
+    next = text + CALL_SIGN_LENGTH + 1;
+    while (next != NULL && count < RMC_DATE)
+    {
+        fields[count++] = next;
+        next = strchr(next, ',');
+        if (next != NULL)
+        {
+            *next++ = 0;
+        }
+    }
+    // time, status, latitude, n/s, longitude, e/w and date, with nothing after them
+    if (count != 7 || next != NULL || fields[1][0] != 'A')
+    {
+        return false;
+    }
+    tokens[RMC_HEADER] = empty;
+    tokens[RMC_TIME] = fields[0];
+    tokens[RMC_STATUS] = fields[1];
+    tokens[RMC_LATITUDE] = fields[2];
+    tokens[RMC_N_S_INDICATOR] = fields[3];
+    tokens[RMC_LONGITUDE] = fields[4];
+    tokens[RMC_E_W_INDICATOR] = fields[5];
+    tokens[RMC_SPEED_OVER_GROUND] = empty;
+    tokens[RMC_COURSE_OVER_GROUND] = empty;
+    tokens[RMC_DATE] = fields[6];
+    return position_fix_from_rmc(tokens, RMC_DATE + 1, (const char *)data, fix);
+}
+
+uint8_t base_frame_decode(const struct base_frame *frame, std::vector<struct position_fix> &fixes)
+/**@brief work out what a payload is and decode its fixes
+ *
+ * @param frame the frame
+ * @param fixes its fixes are added to the end
+ * @return its base_kind, BASE_KIND_UNKNOWN if it did not decode
+ */
+{
+    struct position_fix fix;
+    struct position_batch_reader reader;
+    uint8_t count;
+    uint8_t index;
+
+    if (frame->length == 0)
+    {
+        return BASE_KIND_UNKNOWN;
+    }
+    // a legacy packet starts with a printable call sign, every binary one has the top bit set
+    if ((frame->data[0] & 0x80) == 0)
+    {
+        if (frame->length > CALL_SIGN_LENGTH && frame->data[CALL_SIGN_LENGTH] == ',')
+        {
+            if (base_ascii_decode(frame->data, frame->length, &fix))
+            {
+                fixes.push_back(fix);
+            }
+            return BASE_KIND_ASCII;
+        }
+        return BASE_KIND_UNKNOWN;
+    }
+    switch (frame->data[0] & 0xf0)
+    {
+    case POSITION_PACKET_MAGIC:
+        if (!position_packet_decode(frame->data, frame->length, &fix))
+        {
+            return BASE_KIND_UNKNOWN;
+        }
+        fixes.push_back(fix);
+        return BASE_KIND_POSITION;
+    case POSITION_HISTORY_MAGIC:
+        count = position_history_count(frame->data, frame->length);
+        if (count == 0)
+        {
+            return BASE_KIND_UNKNOWN;
+        }
+        for (index = 0; index < count; index++)
+        {
+            if (position_history_decode(frame->data, frame->length, index, &fix))
+            {
+                fixes.push_back(fix);
+            }
+        }
+        return BASE_KIND_HISTORY;
+    case POSITION_BATCH_MAGIC:
+        if (!position_batch_first(&reader, frame->data, frame->length, &fix))
+        {
+            return BASE_KIND_UNKNOWN;
+        }
+        do
+        {
+            fixes.push_back(fix);
+        } while (position_batch_next(&reader, &fix));
+        return BASE_KIND_BATCH;
+    case LATENCY_TELEMETRY_MAGIC:
+        return frame->data[0] == (LATENCY_TELEMETRY_MAGIC | LATENCY_TELEMETRY_VERSION) &&
+                       frame->length >= LATENCY_TELEMETRY_LENGTH
+                   ? BASE_KIND_TELEMETRY
+                   : BASE_KIND_UNKNOWN;
+    case LINK_PROFILE_MAGIC:
+        // link_profile_decode is in link_adapter.cpp, with the arduino side of the adapter
+        return frame->length == LINK_PROFILE_LENGTH && frame->data[0] == (LINK_PROFILE_MAGIC | LINK_PROFILE_VERSION) &&
+                       frame->data[1] < LINK_PROFILE_COUNT
+                   ? BASE_KIND_LINK
+                   : BASE_KIND_UNKNOWN;
+    default:
+        return BASE_KIND_UNKNOWN;
+    }
+}
+
+static uint16_t get_le16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | buffer[1] << 8);
+}
+
+base_station::base_station(unsigned thread_count, fix_callback fix_added)
+/**@brief start the decoding threads
+ *
+ * @param thread_count threads to decode with, 0 decodes in feed
+ * @param fix_added called for every new fix, or nullptr
+ */
+    : on_fix(fix_added), dropped(0), fed(0), added(0), limit(thread_count * BASE_BATCHES_PER_THREAD), adding(false),
+      closing(false)
+{
+    memset(&stats, 0, sizeof(stats));
+    for (unsigned index = 0; index < thread_count; index++)
+    {
+        threads.emplace_back(&base_station::run, this);
+    }
+}
+
+base_station::~base_station()
+{
+    finish();
+}
+
+void base_station::feed(const char *data, size_t length)
+/**@brief take some more of the port or the capture
+ *
+ * The whole lines are handed to the threads BASE_BATCH_BYTES at a time, call flush to hand
+ * over the rest when nothing more is coming for a while.
+ * @param data what was read
+ * @param length its length
+ * @return Nothing
+ */
+{
+    pending.append(data, length);
+    while (pending.size() >= BASE_BATCH_BYTES)
+    {
+        size_t end = pending.rfind('\n', BASE_BATCH_BYTES - 1);
+        if (end == std::string::npos)
+        {
+            // a line longer than a batch is never a frame, so it is not kept whole either
+            end = pending.find('\n');
+            if (end == std::string::npos)
+            {
+                // the threads add to stats, this is added to it once they are done
+                pending.clear();
+                dropped++;
+                return;
+            }
+        }
+        dispatch(end + 1);
+    }
+}
+
+void base_station::flush()
+/**@brief hand the whole lines that are left to the threads, for a port that has gone quiet
+ *
+ * @return Nothing
+ */
+{
+    size_t end = pending.rfind('\n');
+    if (end != std::string::npos)
+    {
+        dispatch(end + 1);
+    }
+}
+
+void base_station::finish()
+/**@brief decode what is left, a last line without a line feed too, and stop the threads
+ *
+ * @return Nothing
+ */
+{
+    if (!pending.empty())
+    {
+        if (pending.back() != '\n')
+        {
+            pending.push_back('\n');
+        }
+        dispatch(pending.size());
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    progress.wait(guard, [this] { return added == fed; });
+    closing = true;
+    guard.unlock();
+    ready.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    stats.bad += dropped;
+    dropped = 0;
+}
+
+void base_station::dispatch(size_t end)
+{
+    /**
+        @brief make a batch of the first end bytes of pending
+    */
+    std::unique_ptr<batch> work(new batch());
+    work->text.assign(pending, 0, end);
+    pending.erase(0, end);
+    work->sequence = fed++;
+    if (threads.empty())
+    {
+        decode(*work);
+        add(*work);
+        added++;
+        return;
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    // do not read ahead of the threads without end
+    progress.wait(guard, [this] { return fed - 1 - added < limit; });
+    queue.push_back(std::move(work));
+    guard.unlock();
+    ready.notify_one();
+}
+
+void base_station::decode(batch &work)
+{
+    /**
+        @brief parse and decode the lines of a batch, it only touches the batch
+    */
+    const char *text = work.text.data();
+    const char *end = text + work.text.size();
+    struct base_frame frame;
+
+    work.lines = 0;
+    work.text_lines = 0;
+    work.bad = 0;
+    work.frames.reserve(work.text.size() / 64);
+    while (text < end)
+    {
+        const char *line_end = (const char *)memchr(text, '\n', end - text);
+        size_t length = (line_end != NULL ? line_end : end) - text;
+        work.lines++;
+        if (base_frame_parse(text, length, &frame))
+        {
+            size_t before = work.fixes.size();
+            work.frames.push_back(frame);
+            work.kinds.push_back(base_frame_decode(&frame, work.fixes));
+            work.counts.push_back((uint8_t)(work.fixes.size() - before));
+        }
+        else if (length >= 3 && memcmp(text, "RX ", 3) == 0)
+        {
+            work.bad++;
+        }
+        else
+        {
+            work.text_lines++;
+        }
+        text += length + 1;
+    }
+}
+
+void base_station::add(const batch &work)
+{
+    /**
+        @brief add a decoded batch to the nodes, the batches come here one at a time in order
+    */
+    size_t next_fix = 0;
+
+    stats.lines += work.lines;
+    stats.text += work.text_lines;
+    stats.bad += work.bad;
+    for (size_t index = 0; index < work.frames.size(); index++)
+    {
+        const struct base_frame &frame = work.frames[index];
+        uint8_t kind = work.kinds[index];
+        size_t first_fix = next_fix;
+        std::map<uint8_t, struct base_node>::iterator found = nodes.find(frame.from);
+
+        next_fix += work.counts[index];
+        if (found == nodes.end())
+        {
+            struct base_node &created = nodes[frame.from];
+            created.address = frame.from;
+            created.call_sign[0] = 0;
+            created.frames = created.duplicate_frames = created.duplicate_fixes = 0;
+            created.backfilled = created.telemetry = created.link_requests = 0;
+            created.profile = LINK_PROFILE_NONE;
+            created.last_id = -1;
+            memset(created.attempts, 0, sizeof(created.attempts));
+            created.failed = 0;
+            found = nodes.find(frame.from);
+        }
+        struct base_node &node = found->second;
+        stats.frames++;
+        node.frames++;
+        node.rssi = frame.rssi;
+        if (node.last_id == frame.id)
+        {
+            // the ack was lost and it was sent again
+            stats.duplicate_frames++;
+            node.duplicate_frames++;
+            continue;
+        }
+        node.last_id = frame.id;
+        stats.kinds[kind]++;
+        if (kind == BASE_KIND_TELEMETRY)
+        {
+            const uint8_t *counters = frame.data + 7 + 6 * LATENCY_STAGE_COUNT;
+            memcpy(node.call_sign, frame.data + 1, CALL_SIGN_LENGTH);
+            node.call_sign[CALL_SIGN_LENGTH] = 0;
+            for (uint8_t bucket = 0; bucket < LATENCY_ATTEMPT_BUCKETS; bucket++)
+            {
+                node.attempts[bucket] = get_le16(counters + 2 * bucket);
+            }
+            node.failed = get_le16(counters + 2 * LATENCY_ATTEMPT_BUCKETS);
+            node.telemetry++;
+        }
+        else if (kind == BASE_KIND_LINK)
+        {
+            node.profile = frame.data[1];
+            node.link_requests++;
+        }
+        for (size_t fix_index = first_fix; fix_index < next_fix; fix_index++)
+        {
+            const struct position_fix &fix = work.fixes[fix_index];
+            if (!node.seen.insert((uint64_t)fix.date << 32 | fix.time_of_day).second)
+            {
+                stats.duplicate_fixes++;
+                node.duplicate_fixes++;
+                continue;
+            }
+            memcpy(node.call_sign, fix.call_sign, CALL_SIGN_LENGTH);
+            node.call_sign[CALL_SIGN_LENGTH] = 0;
+            if (kind == BASE_KIND_HISTORY)
+            {
+                node.backfilled++;
+            }
+            node.track.push_back({frame.time, kind, fix});
+            stats.fixes++;
+            if (on_fix)
+            {
+                on_fix(node, node.track.back());
+            }
+        }
+    }
+}
+
+void base_station::finished(std::unique_ptr<batch> work)
+{
+    /**
+        @brief keep a decoded batch until the ones before it are in, and add all that can be
+        added, unless another thread is already doing that
+    */
+    std::unique_lock<std::mutex> guard(lock);
+    decoded[work->sequence] = std::move(work);
+    if (adding)
+    {
+        return;
+    }
+    adding = true;
+    while (!decoded.empty() && decoded.begin()->first == added)
+    {
+        std::unique_ptr<batch> next = std::move(decoded.begin()->second);
+        decoded.erase(decoded.begin());
+        guard.unlock();
+        add(*next);
+        guard.lock();
+        added++;
+        progress.notify_all();
+    }
+    adding = false;
+}
+
+void base_station::run()
+{
+    /**
+        @brief a decoding thread
+    */
+    for (;;)
+    {
+        std::unique_ptr<batch> work;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return closing || !queue.empty(); });
+            if (queue.empty())
+            {
+                return;
+            }
+            work = std::move(queue.front());
+            queue.pop_front();
+        }
+        decode(*work);
+        finished(std::move(work));
+    }
+}
@@ -0,0 +1,212 @@
+/* Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file base_station.h
+    @brief Decode the frames the base station receives from a fleet of trackers, on linux.
+
+    The receiver at DEST_ADDRESS prints every frame it acks on its serial port as one line
+        RX <millis> <from> <id> <flags> <rssi> <payload in hex>
+    for example
+        RX 81234 2 17 0 -67 B1434C414E4B...
+    base_frame_format writes that line and base_frame_parse reads it back.  Any other line on
+    the port is console text and is skipped.
+
+    Every payload the firmware sends is understood.  That covers the legacy ascii packet, the
+    position packet in versions 1 and 2, the history and batch packets, all in
+    position_packet.h, the telemetry packet in latency_stats.h and the link change request in
+    link_adapter.h.
+
+    A frame that is sent again because its ack was lost has the same header id as the last
+    one from that address, as RHReliableDatagram has it, and is counted as a duplicate.  Fixes
+    are also kept once per address, date and time of day, so a fix that comes again in a
+    history packet is only added to the track once.
+
+    The lines are cut into batches of about BASE_BATCH_BYTES.  The threads decode the batches
+    side by side, which is where the time goes.  Each decoded batch is then added to the nodes
+    in the order the lines came in, one batch at a time, so the tracks and the duplicate
+    counts do not depend on the number of threads.
+**/
+#ifndef base_station_h
+#define base_station_h
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <position_packet.h>
+#include <latency_stats.h>
+
+/**
+    @brief the longest payload, RH_RF69_MAX_MESSAGE_LEN
+*/
+#define BASE_FRAME_MAX 60
+
+/**
+    @brief bytes of lines in a batch
+    @param BASE_BATCH_BYTES
+*/
+#ifndef BASE_BATCH_BYTES
+#define BASE_BATCH_BYTES 65536
+#endif
+
+/**
+    @brief batches waiting or being decoded for each thread before feed waits
+    @param BASE_BATCHES_PER_THREAD
+*/
+#ifndef BASE_BATCHES_PER_THREAD
+#define BASE_BATCHES_PER_THREAD 4
+#endif
+
+/**
+    @brief what a payload is
+*/
+enum base_kind
+{
+    BASE_KIND_UNKNOWN,   /*!< none of the below, or one that did not decode */
+    BASE_KIND_ASCII,     /*!< the legacy comma separated packet */
+    BASE_KIND_POSITION,  /*!< a position packet, version 1 or 2 */
+    BASE_KIND_HISTORY,   /*!< fixes sent again by the fix store */
+    BASE_KIND_BATCH,     /*!< several live fixes */
+    BASE_KIND_TELEMETRY, /*!< the latency and retry summary */
+    BASE_KIND_LINK,      /*!< a link profile change request */
+    BASE_KIND_COUNT,
+};
+
+extern const char *const base_kind_names[BASE_KIND_COUNT];
+
+/**
+    @brief one received frame
+*/
+struct base_frame
+{
+    uint32_t time;                 /*!< millis() of the receiver when it came in */
+    uint8_t from;                  /*!< the sender address */
+    uint8_t id;                    /*!< the header id */
+    uint8_t flags;                 /*!< the header flags */
+    int16_t rssi;                  /*!< dBm */
+    uint8_t length;                /*!< bytes in data */
+    uint8_t data[BASE_FRAME_MAX];  /*!< the payload */
+};
+
+/**
+    @brief one fix on a track
+*/
+struct base_fix
+{
+    uint32_t time;            /*!< millis() of the receiver when its frame came in */
+    uint8_t kind;             /*!< the base_kind of its frame */
+    struct position_fix fix;  /*!< the fix */
+};
+
+/**
+    @brief everything heard from one address
+*/
+struct base_node
+{
+    uint8_t address;
+    char call_sign[CALL_SIGN_LENGTH + 1];       /*!< from its last fix or telemetry */
+    uint32_t frames;                            /*!< frames received, duplicates too */
+    uint32_t duplicate_frames;                  /*!< of them, sent again after a lost ack */
+    uint32_t duplicate_fixes;                   /*!< fixes already on the track */
+    uint32_t backfilled;                        /*!< fixes first heard in a history packet */
+    uint32_t telemetry;                         /*!< telemetry packets */
+    uint32_t link_requests;                     /*!< link profile change requests */
+    uint8_t profile;                            /*!< the last profile asked for, LINK_PROFILE_NONE for none */
+    int16_t rssi;                               /*!< of the last frame */
+    int16_t last_id;                            /*!< header id of the last frame, -1 before the first */
+    uint16_t attempts[LATENCY_ATTEMPT_BUCKETS]; /*!< acked after 1 to 4 or more tries, from the last telemetry */
+    uint16_t failed;                            /*!< never acked, from the last telemetry */
+    std::vector<struct base_fix> track;         /*!< fixes in the order they were received */
+    std::unordered_set<uint64_t> seen;          /*!< date and time of day of every fix on the track */
+};
+
+/**
+    @brief counters over all nodes
+*/
+struct base_stats
+{
+    uint64_t lines;                    /*!< lines read */
+    uint64_t text;                     /*!< of them, console text */
+    uint64_t bad;                      /*!< RX lines that did not parse, and lines too long to keep */
+    uint64_t frames;                   /*!< frames, duplicates too */
+    uint64_t duplicate_frames;         /*!< frames sent again after a lost ack */
+    uint64_t kinds[BASE_KIND_COUNT];   /*!< frames, duplicates left out, by base_kind */
+    uint64_t fixes;                    /*!< fixes added to a track */
+    uint64_t duplicate_fixes;          /*!< fixes already on their track */
+};
+
+extern bool base_frame_parse(const char *line, size_t length, struct base_frame *frame);
+extern size_t base_frame_format(const struct base_frame *frame, char *line, size_t size);
+extern bool base_ascii_decode(const uint8_t *data, uint8_t length, struct position_fix *fix);
+extern uint8_t base_frame_decode(const struct base_frame *frame, std::vector<struct position_fix> &fixes);
+
+/**
+    @brief the decoding pipeline
+
+    feed it what comes from the port or the capture, in pieces of any size, from one thread.
+    on_fix is called for every new fix, one call at a time and in the order of the lines.  With
+    threads it is called from whichever decoding thread adds the batch, not from the thread
+    that feeds, so anything it shares with that thread needs a lock of its own.  With 0 threads
+    it is called inside feed, flush and finish.  Read nodes and stats after finish.
+*/
+class base_station
+{
+public:
+    typedef std::function<void(const struct base_node &node, const struct base_fix &fix)> fix_callback;
+
+    base_station(unsigned threads, fix_callback on_fix = nullptr);
+    ~base_station();
+    void feed(const char *data, size_t length);
+    void flush();
+    void finish();
+
+    std::map<uint8_t, struct base_node> nodes; /*!< by address */
+    struct base_stats stats;
+
+private:
+    /**
+        @brief some lines, and what they decoded to
+    */
+    struct batch
+    {
+        uint64_t sequence;                     /*!< the order it was fed in */
+        std::string text;                      /*!< whole lines */
+        std::vector<struct base_frame> frames; /*!< the RX lines */
+        std::vector<uint8_t> kinds;            /*!< the base_kind of each frame */
+        std::vector<uint8_t> counts;           /*!< the fixes of each frame */
+        std::vector<struct position_fix> fixes;
+        uint64_t lines;
+        uint64_t text_lines;
+        uint64_t bad;
+    };
+
+    void dispatch(size_t end);
+    void decode(batch &work);
+    void add(const batch &work);
+    void finished(std::unique_ptr<batch> work);
+    void run();
+
+    fix_callback on_fix;
+    std::string pending;                               /*!< lines not in a batch yet */
+    uint64_t dropped;                                  /*!< lines too long to keep, only feed counts them */
+    uint64_t fed;                                      /*!< batches fed */
+    uint64_t added;                                    /*!< batches added to the nodes */
+    unsigned limit;                                    /*!< batches in flight before feed waits */
+    bool adding;                                       /*!< a thread is adding batches */
+    bool closing;                                      /*!< finish was called */
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable ready;                     /*!< a batch was fed or closing was set */
+    std::condition_variable progress;                  /*!< a batch was added */
+    std::deque<std::unique_ptr<batch>> queue;          /*!< batches not decoded yet */
+    std::map<uint64_t, std::unique_ptr<batch>> decoded; /*!< batches waiting for the ones before them */
+};
+
+#endif
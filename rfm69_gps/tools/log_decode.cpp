@@ -0,0 +1,200 @@
+/** \copyright Copyright 2023 by Ralph Blach under the gpl3 public license. see https://www.gnu.org/licenses/gpl-3.0.en.html#license-text
+for the entire text*/
+/**
+ *
+ *  @file  log_decode.cpp
+    @author Ralph Blach
+    @brief Turns the binary event log from the usb serial port back into text, on the host.
+
+    Build it from the rfm69_gps directory with
+        g++ -std=gnu++17 -O2 -Iinclude tools/log_decode.cpp -o log_decode
+    and run it on a capture or straight on the port
+        ./log_decode < /dev/ttyACM0
+    Anything that is not a record, the console text, is passed through as it is.  Each record
+    is printed on a line of its own with the board time in milliseconds since the first record.
+**/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <event_log.h>
+
+/**
+    @brief the name, argument count and text of each event, from the same list as the firmware
+*/
+struct event_text
+{
+    const char *name;
+    uint8_t arguments;
+    const char *format;
+};
+
+static const struct event_text events[] = {
+#define LOG_EVENT(name, level, arguments, format) {#name, arguments, format},
+#include <log_events.def>
+#undef LOG_EVENT
+};
+
+static bool get_varint(const uint8_t *buffer, uint8_t length, uint8_t *position, uint32_t *value)
+{
+    /**
+        @brief read one varint, false if the record ends in the middle of it
+    */
+    uint8_t shift = 0;
+    *value = 0;
+    while (*position < length && shift < 35)
+    {
+        uint8_t byte = buffer[(*position)++];
+        *value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void print_event(const struct event_text *event, const int32_t *arguments)
+{
+    /**
+        @brief print the format of an event with its arguments put in
+    */
+    const char *format = event->format;
+    uint8_t next = 0;
+    while (*format != 0)
+    {
+        if (*format != '%' || format[1] == 0)
+        {
+            putchar(*format++);
+            continue;
+        }
+        format++;
+        if (*format == '%')
+        {
+            putchar('%');
+        }
+        else if (next >= event->arguments)
+        {
+            fputs("?", stdout);
+        }
+        else if (*format == 'd')
+        {
+            printf("%d", arguments[next++]);
+        }
+        else if (*format == 'x')
+        {
+            printf("%x", (uint32_t)arguments[next++]);
+        }
+        else if (*format == 'c')
+        {
+            putchar((char)arguments[next++]);
+        }
+        else
+        {
+            printf("%u", (uint32_t)arguments[next++]);
+        }
+        format++;
+    }
+}
+
+static bool decode(const uint8_t *record, uint8_t length, uint64_t *time)
+{
+    /**
+        @brief print one record, the bytes after the length
+
+        @return false if the record does not make sense, it is then printed as text
+    */
+    const struct event_text *event;
+    int32_t arguments[LOG_MAX_ARGUMENTS];
+    uint8_t position = 1;
+    uint32_t value;
+    uint8_t index;
+
+    if (length < 2 || record[0] >= sizeof(events) / sizeof(events[0]))
+    {
+        return false;
+    }
+    event = &events[record[0]];
+    if (!get_varint(record, length, &position, &value))
+    {
+        return false;
+    }
+    *time += value;
+    for (index = 0; index < event->arguments; index++)
+    {
+        uint32_t argument;
+        if (!get_varint(record, length, &position, &argument))
+        {
+            return false;
+        }
+        arguments[index] = unzigzag(argument);
+    }
+    if (position != length)
+    {
+        return false;
+    }
+    printf("[%10llu] %s: ", (unsigned long long)*time, event->name);
+    print_event(event, arguments);
+    putchar('\n');
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *input = stdin;
+    uint8_t record[256];
+    uint64_t time = 0;
+    bool line_start = true;
+    int byte;
+
+    if (argc > 1 && (input = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    while ((byte = fgetc(input)) != EOF)
+    {
+        int length;
+        int index;
+        if (byte != LOG_RECORD_START)
+        {
+            putchar(byte);
+            line_start = byte == '\n';
+            continue;
+        }
+        if ((length = fgetc(input)) == EOF)
+        {
+            break;
+        }
+        for (index = 0; index < length; index++)
+        {
+            int next = fgetc(input);
+            if (next == EOF)
+            {
+                break;
+            }
+            record[index] = (uint8_t)next;
+        }
+        if (!line_start)
+        {
+            // the record came in the middle of a line of console text
+            putchar('\n');
+            line_start = true;
+        }
+        if (index != length || !decode(record, (uint8_t)length, &time))
+        {
+            printf("[bad record of %d bytes]\n", length);
+        }
+        fflush(stdout);
+    }
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    return 0;
+}